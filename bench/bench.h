@@ -0,0 +1,63 @@
+#if !defined(BENCH_H)
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <affinity.h>
+
+/**
+ * @file bench.h
+ * @brief Utilita' comuni dei microbenchmark delle librerie (bench_bqueue, bench_darray, bench_slist):
+ *          tempo monotono, generatore pseudo-casuale deterministico, percentili e pinning dei thread
+ *          con il piano di affinity di farm (affinity.h, stessa politica dell'opzione -a).
+ */
+
+#define _BENCH_SEED 88172645463325252ULL
+
+static inline uint64_t bench_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline double now_sec(){
+    return bench_ns() / 1e9;
+}
+
+//xorshift: la stessa sequenza ad ogni esecuzione (e per ogni struttura confrontata)
+static inline uint64_t bench_rand(uint64_t *state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static inline int bench_cmp_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void bench_sort(uint64_t *v, size_t n){
+    qsort(v, n, sizeof(uint64_t), bench_cmp_u64);
+}
+
+/**
+ * \brief Percentile p (0-100, nearest rank) degli n campioni ordinati v
+ */
+static inline uint64_t bench_percentile(const uint64_t *v, size_t n, double p){
+    if(n == 0)
+        return 0;
+    size_t rank = (size_t)(p / 100.0 * n + 0.5);
+    return v[(rank == 0) ? 0 : (rank > n) ? n - 1 : rank - 1];
+}
+
+/**
+ * \brief Lega il thread chiamante alla cpu del thread id del piano a (nessun pinning con la politica "")
+ */
+static inline int bench_pin(const affinity_t *a, size_t id){
+    return pin_worker(a, id);
+}
+
+#endif // BENCH_H
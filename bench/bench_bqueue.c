@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <conc_queue.h>
+#include "bench.h"
+
+/**
+ * @file bench_bqueue.c
+ * @brief Microbenchmark della coda concorrente del MasterWorker (BQueue): per ogni combinazione di P producers,
+ *          C consumers e capacita' della coda, n stringhe (come i path inseriti dal Master) attraversano la coda.
+ *          Ogni configurazione viene eseguita una volta con warmup stringhe (scartata) e poi misurata.
+ *          Misura il throughput (stringhe/s) e i percentili di latenza (ns) di push, pop (comprese le attese
+ *          su coda piena o vuota) e della permanenza in coda (dalla push alla pop della stessa stringa).
+ *          I thread vengono legati alle cpu con la politica di affinity di farm (-a, default compact; "" per nessun pinning).
+ *
+ *          uso: ./bench_bqueue [-p lista] [-c lista] [-q lista] [-n stringhe] [-w warmup] [-a politica]
+ *              default: -p 1,2,4 -c 1,4 -q 8,64,1024 -n 200000 -w 20000 -a compact
+ */
+
+#define _DEFAULT_OPS 200000
+#define _DEFAULT_WARMUP 20000
+#define _BENCH_PATH_LEN 255
+#define _BENCH_MAX_LIST 16
+#define _BENCH_MAX_THREADS 256
+
+/** Stato condiviso di una configurazione
+ *
+ */
+typedef struct run
+{
+    BQueue_t *q;
+    affinity_t *aff;
+    pthread_barrier_t start;
+    int record;         // 1 se i campioni vengono salvati
+} run_t;
+
+/** Argomenti e campioni di un thread
+ *
+ */
+typedef struct thread
+{
+    run_t *run;
+    size_t id;          // indice nel piano di affinity (producers, poi consumers)
+    long ops;           // stringhe da inserire (producer)
+    long done;          // stringhe estratte (consumer)
+    uint64_t *op_ns;    // latenza di push o pop
+    uint64_t *stay_ns;  // permanenza in coda (consumer)
+} thread_t;
+
+static void *producer(void *arg){
+    thread_t *t = arg;
+    char path[_BENCH_PATH_LEN];
+    bench_pin(t->run->aff, t->id);
+    pthread_barrier_wait(&t->run->start);
+    for(long i = 0; i < t->ops; i++){
+        uint64_t t0 = bench_ns();
+        //istante di inserimento in testa al path, letto dal consumer
+        snprintf(path, sizeof(path), "%020" PRIu64 "/bench/dir%zu/file%ld.dat", t0, t->id, i);
+        if(push(t->run->q, path) != 0){
+            fprintf(stderr, "bench_bqueue: push failed\n");
+            exit(1);
+        }
+        if(t->run->record)
+            t->op_ns[i] = bench_ns() - t0;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg){
+    thread_t *t = arg;
+    bench_pin(t->run->aff, t->id);
+    pthread_barrier_wait(&t->run->start);
+    for(;;){
+        uint64_t t0 = bench_ns();
+        char *path = pop(t->run->q);
+        uint64_t t1 = bench_ns();
+        if(path == EOS)
+            break;
+        if(!path){
+            fprintf(stderr, "bench_bqueue: pop failed\n");
+            exit(1);
+        }
+        if(t->run->record){
+            t->op_ns[t->done] = t1 - t0;
+            t->stay_ns[t->done] = t1 - strtoull(path, NULL, 10);
+        }
+        t->done++;
+        free(path);
+    }
+    return NULL;
+}
+
+/**
+ * @brief esegue una configurazione; con record == 1 stampa throughput e percentili
+ */
+static int run_config(affinity_t *aff, int np, int nc, size_t cap, long ops, int record){
+    run_t run = {.aff = aff, .record = record};
+    thread_t th[_BENCH_MAX_THREADS];
+    pthread_t tid[_BENCH_MAX_THREADS];
+    uint64_t *push_ns = NULL, *pop_ns = NULL, *stay_ns = NULL;
+    int ret = -1;
+    if(!(run.q = initBQueue(cap, _BENCH_PATH_LEN)))
+        return -1;
+    pthread_barrier_init(&run.start, NULL, np + nc + 1);
+
+    //buffer dei campioni allocati prima di avviare i thread: in caso di errore non c'e' nessun thread da attendere
+    memset(th, 0, sizeof(th));
+    for(int i = 0; i < np + nc; i++){
+        th[i].run = &run;
+        th[i].id = i;
+        th[i].ops = (i < np) ? ops / np + (i < ops % np) : 0;
+        if(record){
+            th[i].op_ns = malloc(ops * sizeof(uint64_t));
+            th[i].stay_ns = (i >= np) ? malloc(ops * sizeof(uint64_t)) : NULL;
+            if(!th[i].op_ns || (i >= np && !th[i].stay_ns)){
+                perror("malloc");
+                goto out;
+            }
+        }
+    }
+    //i thread gia' avviati restano fermi sulla barriera e non possono essere attesi: come per gli errori di push, termino
+    for(int i = 0; i < np + nc; i++)
+        if(pthread_create(&tid[i], NULL, (i < np) ? producer : consumer, &th[i]) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+
+    pthread_barrier_wait(&run.start);
+    uint64_t t0 = bench_ns();
+    for(int i = 0; i < np; i++)
+        pthread_join(tid[i], NULL);
+    if(push(run.q, EOS) != 0){ //EOS resta in coda: termina tutti i consumers
+        fprintf(stderr, "bench_bqueue: push failed\n");
+        exit(1);
+    }
+    for(int i = np; i < np + nc; i++)
+        pthread_join(tid[i], NULL);
+    double elapsed = (bench_ns() - t0) / 1e9;
+
+    long done = 0;
+    for(int i = np; i < np + nc; i++)
+        done += th[i].done;
+    if(done != ops){
+        fprintf(stderr, "bench_bqueue: %ld strings popped, %ld pushed\n", done, ops);
+        goto out;
+    }
+
+    if(record){
+        //campioni di tutti i thread dello stesso tipo concatenati
+        push_ns = malloc(ops * sizeof(uint64_t));
+        pop_ns = malloc(ops * sizeof(uint64_t));
+        stay_ns = malloc(ops * sizeof(uint64_t));
+        if(!push_ns || !pop_ns || !stay_ns){
+            perror("malloc");
+            goto out;
+        }
+        long k = 0;
+        for(int i = 0; i < np; i++){
+            memcpy(push_ns + k, th[i].op_ns, th[i].ops * sizeof(uint64_t));
+            k += th[i].ops;
+        }
+        k = 0;
+        for(int i = np; i < np + nc; i++){
+            memcpy(pop_ns + k, th[i].op_ns, th[i].done * sizeof(uint64_t));
+            memcpy(stay_ns + k, th[i].stay_ns, th[i].done * sizeof(uint64_t));
+            k += th[i].done;
+        }
+        bench_sort(push_ns, ops);
+        bench_sort(pop_ns, ops);
+        bench_sort(stay_ns, ops);
+        printf("%3d %3d %6zu %12.0f %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %11" PRIu64 " %11" PRIu64 " %11" PRIu64 " %11" PRIu64 "\n",
+            np, nc, cap, ops / elapsed,
+            bench_percentile(push_ns, ops, 50), bench_percentile(push_ns, ops, 99),
+            bench_percentile(pop_ns, ops, 50), bench_percentile(pop_ns, ops, 99),
+            bench_percentile(stay_ns, ops, 50), bench_percentile(stay_ns, ops, 99),
+            bench_percentile(stay_ns, ops, 99.9), stay_ns[ops - 1]);
+        fflush(stdout);
+    }
+    ret = 0;
+
+out:
+    free(push_ns);
+    free(pop_ns);
+    free(stay_ns);
+    for(int i = 0; i < np + nc; i++){
+        free(th[i].op_ns);
+        free(th[i].stay_ns);
+    }
+    pthread_barrier_destroy(&run.start);
+    deleteBQueue(run.q);
+    return ret;
+}
+
+static int parse_list(char *list, long *v){
+    int n = 0;
+    for(char *tok = strtok(list, ","); tok && n < _BENCH_MAX_LIST; tok = strtok(NULL, ","))
+        if((v[n++] = strtol(tok, NULL, 10)) <= 0)
+            return -1;
+    return n;
+}
+
+int main(int argc, char **argv){
+    long prods[_BENCH_MAX_LIST] = {1, 2, 4}, conss[_BENCH_MAX_LIST] = {1, 4}, caps[_BENCH_MAX_LIST] = {8, 64, 1024};
+    int np = 3, nc = 2, nq = 3;
+    long ops = _DEFAULT_OPS, warmup = _DEFAULT_WARMUP;
+    const char *policy = "compact";
+
+    int opt;
+    while((opt = getopt(argc, argv, "p:c:q:n:w:a:")) != -1){
+        switch(opt){
+            case 'p': np = parse_list(optarg, prods); break;
+            case 'c': nc = parse_list(optarg, conss); break;
+            case 'q': nq = parse_list(optarg, caps); break;
+            case 'n': ops = strtol(optarg, NULL, 10); break;
+            case 'w': warmup = strtol(optarg, NULL, 10); break;
+            case 'a': policy = optarg; break;
+            default: np = -1; break;
+        }
+    }
+    if(np <= 0 || nc <= 0 || nq <= 0 || ops <= 0 || warmup < 0){
+        fprintf(stderr, "usage: %s [-p producers] [-c consumers] [-q capacities] [-n strings] [-w warmup] [-a policy]\n"
+            "  lists are comma separated, e.g. -p 1,2,4 -c 1,4 -q 8,64,1024\n", argv[0]);
+        return 1;
+    }
+
+    printf("%3s %3s %6s %12s %9s %9s %9s %9s %11s %11s %11s %11s\n", "P", "C", "cap", "strings/s",
+        "push_p50", "push_p99", "pop_p50", "pop_p99", "stay_p50", "stay_p99", "stay_p999", "stay_max");
+    for(int p = 0; p < np; p++)
+        for(int c = 0; c < nc; c++)
+            for(int k = 0; k < nq; k++){
+                if(prods[p] + conss[c] > _BENCH_MAX_THREADS){
+                    fprintf(stderr, "bench_bqueue: at most %d threads\n", _BENCH_MAX_THREADS);
+                    return 1;
+                }
+                affinity_t aff;
+                if(init_affinity(&aff, policy, prods[p] + conss[c]) != A_SUCCESS)
+                    return 1;
+                if((warmup > 0 && run_config(&aff, prods[p], conss[c], caps[k], warmup, 0) != 0) ||
+                    run_config(&aff, prods[p], conss[c], caps[k], ops, 1) != 0)
+                    return 1;
+                delete_affinity(&aff);
+            }
+    return 0;
+}
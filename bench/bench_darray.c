@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <dyn_array.h>
+#include "bench.h"
+
+/**
+ * @file bench_darray.c
+ * @brief Microbenchmark dell'array dinamico delle directory del Master (DArray): per ogni dimensione n (da 10^3 a max_n,
+ *          per potenze di 10) inserisce n path con addDData e li estrae con getDData, partendo sia dalla dimensione
+ *          iniziale di farm (2, con i raddoppi) sia da un array gia' lungo n (nessun raddoppio), cosi' da isolare
+ *          il costo della crescita. Riporta tempo medio, p99 e massimo (i raddoppi) per inserimento ed estrazione (ns).
+ *          Il thread viene legato alla cpu con la politica di affinity di farm (-a, default compact; "" per nessun pinning),
+ *          ogni misura e' preceduta da un'esecuzione di riscaldamento con n = 10^3.
+ *
+ *          uso: ./bench_darray [-n max_n] [-a politica]   (default -n 100000 -a compact)
+ */
+
+#define _DEFAULT_MAX_N 100000
+#define _DARRAY_INIT_SIZE 2 //come DARRAY_INIT_SIZE di farm.c
+#define _BENCH_PATH_LEN 255
+#define _WARMUP_N 1000
+
+/**
+ * @brief inserisce ed estrae n path da un array lungo inizialmente init_size; con add_ns/get_ns != NULL salva le latenze
+ */
+static int run(long n, size_t init_size, uint64_t *add_ns, uint64_t *get_ns){
+    char path[_BENCH_PATH_LEN];
+    DArray *d = initDArray(init_size, _BENCH_PATH_LEN);
+    if(!d)
+        return -1;
+    for(long i = 0; i < n; i++){
+        snprintf(path, sizeof(path), "bench/dir%ld/subdir%ld", i % 97, i);
+        uint64_t t0 = bench_ns();
+        if(addDData(d, path) != 0){
+            perror("addDData");
+            return -1;
+        }
+        if(add_ns)
+            add_ns[i] = bench_ns() - t0;
+    }
+    if(getDUsed(d) != n){
+        fprintf(stderr, "bench_darray: %d elements, %ld added\n", getDUsed(d), n);
+        return -1;
+    }
+    for(long i = 0; i < n; i++){
+        uint64_t t0 = bench_ns();
+        char *s = getDData(d);
+        if(get_ns)
+            get_ns[i] = bench_ns() - t0;
+        if(!s){
+            perror("getDData");
+            return -1;
+        }
+        free(s);
+    }
+    deleteDArray(d);
+    return 0;
+}
+
+static void print_stats(uint64_t *v, long n){
+    uint64_t sum = 0;
+    for(long i = 0; i < n; i++)
+        sum += v[i];
+    bench_sort(v, n);
+    printf(" %9.1f %9" PRIu64 " %11" PRIu64, (double)sum / n, bench_percentile(v, n, 99), v[n - 1]);
+}
+
+int main(int argc, char **argv){
+    long max_n = _DEFAULT_MAX_N;
+    const char *policy = "compact";
+
+    int opt;
+    while((opt = getopt(argc, argv, "n:a:")) != -1){
+        switch(opt){
+            case 'n': max_n = strtol(optarg, NULL, 10); break;
+            case 'a': policy = optarg; break;
+            default: max_n = -1; break;
+        }
+    }
+    if(max_n < 1000){
+        fprintf(stderr, "usage: %s [-n max_n >= 1000] [-a policy]\n", argv[0]);
+        return 1;
+    }
+
+    affinity_t aff;
+    if(init_affinity(&aff, policy, 1) != A_SUCCESS || bench_pin(&aff, 0) != A_SUCCESS)
+        return 1;
+
+    uint64_t *add_ns = malloc(max_n * sizeof(uint64_t)), *get_ns = malloc(max_n * sizeof(uint64_t));
+    if(!add_ns || !get_ns){
+        perror("malloc");
+        return 1;
+    }
+
+    printf("%10s %10s %9s %9s %11s %9s %9s %11s\n", "n", "init_size", "add_avg", "add_p99", "add_max", "get_avg", "get_p99", "get_max");
+    for(long n = 1000; n <= max_n; n *= 10)
+        for(int grow = 1; grow >= 0; grow--){
+            size_t init_size = grow ? _DARRAY_INIT_SIZE : (size_t)n;
+            if(run(_WARMUP_N, init_size, NULL, NULL) != 0 || run(n, init_size, add_ns, get_ns) != 0)
+                return 1;
+            printf("%10ld %10zu", n, init_size);
+            print_stats(add_ns, n);
+            print_stats(get_ns, n);
+            printf("\n");
+            fflush(stdout);
+        }
+
+    free(add_ns);
+    free(get_ns);
+    delete_affinity(&aff);
+    return 0;
+}
@@ -0,0 +1,524 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/**
+ * @file bench_farm.c
+ * @brief Benchmark end-to-end di farm. Genera (una volta, in data_dir) i carichi standard e per ogni carico esegue farm
+ *          su tutte le combinazioni di -n, -q e opzioni del motore (es. "", "-i", "-s", "-c 2"), ripetendo ogni
+ *          combinazione r volte dopo un'esecuzione di riscaldamento (page cache calda).
+ *
+ *          Carichi (scala 1):
+ *              tiny    10000 file da 8-512 byte in 10 directory
+ *              huge    4 file da 32 MB
+ *              skewed  2000 file: 90% da 8-512 byte, 9% da 64-128 KB, 1% da 2-4 MB
+ *              deep    albero binario di directory profondo 10, 4 file piccoli per directory
+ *
+ *          Per ogni combinazione misura tempo totale, file/s, GB/s, tempo al primo risultato (primo byte sullo stdout
+ *          di farm: il Collector stampa i risultati ordinati a raccolta terminata), picco di RSS (il maggiore tra
+ *          MasterWorker e Collector, che farm attende) e utilizzo di CPU (tempo di CPU / tempo totale, in core),
+ *          con media, deviazione standard, coefficiente di variazione, minimo, mediana e massimo delle ripetizioni.
+ *          Il risultato e' un documento JSON sullo stdout; l'avanzamento viene stampato su stderr.
+ *          Con -b baseline ogni ripetizione di farm e' seguita da una della baseline (es. ./farm contro ./farm-pgo: le
+ *          esecuzioni alternate risentono allo stesso modo delle variazioni della macchina) e per ogni combinazione
+ *          vengono riportati anche il tempo della baseline e lo speedup (tempo medio della baseline / tempo medio di farm).
+ *
+ *          uso: ./bench_farm [-s scala] [-r ripetizioni] [-n lista] [-q lista] [-e lista] [-w lista] [-d data_dir] [-f farm] [-b baseline]
+ *              le liste sono separate da virgole, es. -n 1,4,8 -e ",-i,-s,-c 2" -w tiny,deep
+ *              default: -s 1 -r 3 -n 1,4,<cpu online> -q 8,64 -e ",-i,-s" -w tiny,huge,skewed,deep -d bench_data -f ./farm
+ */
+
+#define _DEFAULT_SCALE 1
+#define _DEFAULT_REPEATS 3
+#define _DEFAULT_DATA_DIR "bench_data"
+#define _DEFAULT_FARM "./farm"
+#define _BENCH_MAX_LIST 16
+#define _BENCH_MAX_ARGS 32
+#define _BENCH_PATH_LEN 256
+#define _BENCH_WRITE_LEN (1 << 20)
+#define _BENCH_VALUE_MOD 100 //valori piccoli: nessun overflow nel calcolo di farm nemmeno sui file da 32 MB * scala
+
+/* ------------------- generazione dei carichi ------------------ */
+
+//generatore pseudo-casuale deterministico (xorshift): gli stessi file ad ogni generazione
+static unsigned long long rng_state;
+static unsigned long long next_rand(){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/** Carico di lavoro: directory generata e sue dimensioni
+ *
+ */
+typedef struct workload
+{
+    const char *name;
+    int (*gen)(struct workload *w, const char *dir, long scale);
+    long files;
+    long long bytes;
+} workload_t;
+
+//path di al piu' _BENCH_PATH_LEN byte, -1 se troppo lungo
+static int make_path(char *path, const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(path, _BENCH_PATH_LEN, fmt, ap);
+    va_end(ap);
+    if(n < 0 || n >= _BENCH_PATH_LEN){
+        fprintf(stderr, "bench_farm: path too long\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int make_dir(const char *path){
+    if(mkdir(path, 0755) == -1 && errno != EEXIST){
+        perror("mkdir");
+        fprintf(stderr, "bench_farm: cannot create %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief scrive un file di nelem long pseudo-casuali e lo conta nel carico w
+ */
+static int write_file(workload_t *w, const char *path, long nelem){
+    static long buf[_BENCH_WRITE_LEN / sizeof(long)];
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        perror("open");
+        fprintf(stderr, "bench_farm: cannot create %s\n", path);
+        return -1;
+    }
+    long left = nelem;
+    while(left > 0){
+        long n = (left < (long)(sizeof(buf) / sizeof(long))) ? left : (long)(sizeof(buf) / sizeof(long));
+        for(long i = 0; i < n; i++)
+            buf[i] = next_rand() % _BENCH_VALUE_MOD;
+        size_t len = n * sizeof(long), done = 0;
+        while(done < len){
+            ssize_t r = write(fd, (char *)buf + done, len - done);
+            if(r == -1 && errno == EINTR)
+                continue;
+            if(r == -1){
+                perror("write");
+                close(fd);
+                return -1;
+            }
+            done += r;
+        }
+        left -= n;
+    }
+    w->files++;
+    w->bytes += nelem * sizeof(long);
+    return close(fd);
+}
+
+//numero di long di un file piccolo (8-512 byte)
+static long tiny_nelem(){
+    return 1 + next_rand() % 64;
+}
+
+static int gen_tiny(workload_t *w, const char *dir, long scale){
+    char path[_BENCH_PATH_LEN];
+    for(int d = 0; d < 10; d++){
+        if(make_path(path, "%s/d%d", dir, d) != 0 || make_dir(path) != 0)
+            return -1;
+        for(long i = 0; i < 1000 * scale; i++){
+            if(make_path(path, "%s/d%d/f%ld.dat", dir, d, i) != 0 || write_file(w, path, tiny_nelem()) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int gen_huge(workload_t *w, const char *dir, long scale){
+    char path[_BENCH_PATH_LEN];
+    for(int i = 0; i < 4; i++){
+        if(make_path(path, "%s/h%d.dat", dir, i) != 0 || write_file(w, path, 4L * 1024 * 1024 * scale) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int gen_skewed(workload_t *w, const char *dir, long scale){
+    char path[_BENCH_PATH_LEN];
+    for(int d = 0; d < 20; d++){
+        if(make_path(path, "%s/d%d", dir, d) != 0 || make_dir(path) != 0)
+            return -1;
+        for(long i = 0; i < 100 * scale; i++){
+            unsigned long long r = next_rand() % 100;
+            long nelem = (r < 90) ? tiny_nelem() : (r < 99) ? 8192 + (long)(next_rand() % 8192) : 262144 + (long)(next_rand() % 262144);
+            if(make_path(path, "%s/d%d/f%ld.dat", dir, d, i) != 0 || write_file(w, path, nelem) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int gen_tree(workload_t *w, const char *dir, int depth, long scale){
+    char path[_BENCH_PATH_LEN];
+    for(long i = 0; i < 4 * scale; i++){
+        if(make_path(path, "%s/f%ld.dat", dir, i) != 0 || write_file(w, path, tiny_nelem()) != 0)
+            return -1;
+    }
+    if(depth == 0)
+        return 0;
+    for(int c = 0; c < 2; c++){
+        if(make_path(path, "%s/%c", dir, 'a' + c) != 0 || make_dir(path) != 0 || gen_tree(w, path, depth - 1, scale) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int gen_deep(workload_t *w, const char *dir, long scale){
+    return gen_tree(w, dir, 9, scale);
+}
+
+/**
+ * @brief genera il carico in dir = data_dir/<nome>_s<scala> (_BENCH_PATH_LEN byte), a meno che non sia gia' stato generato
+ *          (il file .manifest contiene numero di file e byte)
+ *
+ * @return 0 se il carico e' pronto, -1 in caso di errore
+ */
+static int prepare(workload_t *w, const char *data_dir, long scale, char *dir){
+    char manifest[_BENCH_PATH_LEN];
+    if(make_path(dir, "%s/%s_s%ld", data_dir, w->name, scale) != 0 || make_path(manifest, "%s/.manifest", dir) != 0)
+        return -1;
+
+    FILE *f = fopen(manifest, "r");
+    if(f){
+        int ok = (fscanf(f, "%ld %lld", &w->files, &w->bytes) == 2);
+        fclose(f);
+        if(ok)
+            return 0;
+    }
+
+    fprintf(stderr, "bench_farm: generating %s\n", dir);
+    w->files = 0;
+    w->bytes = 0;
+    rng_state = 88172645463325252ULL;
+    if(make_dir(data_dir) != 0 || make_dir(dir) != 0 || w->gen(w, dir, scale) != 0)
+        return -1;
+    if(!(f = fopen(manifest, "w")))
+        return -1;
+    fprintf(f, "%ld %lld\n", w->files, w->bytes);
+    return fclose(f);
+}
+
+/* ------------------- esecuzione di farm ------------------ */
+
+/** Misure di un'esecuzione di farm
+ *
+ */
+typedef struct sample
+{
+    double wall;        // s
+    double first;       // s al primo byte dei risultati
+    double rss_kb;      // picco di RSS
+    double cpu;         // tempo di CPU / tempo totale
+    long lines;         // righe stampate (un risultato per riga)
+    int status;         // exit status di farm
+} sample_t;
+
+static double now_sec(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief esegue farm con gli argomenti argv (stdout letto da una pipe, stderr scartato)
+ *
+ * @return 0 se farm e' stato eseguito (s contiene le misure), -1 in caso di errore
+ */
+static int run_farm(char **argv, sample_t *s){
+    int p[2];
+    if(pipe(p) == -1){
+        perror("pipe");
+        return -1;
+    }
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if(pid == -1){
+        perror("fork");
+        return -1;
+    }
+    if(pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+        dup2(p[1], STDOUT_FILENO);
+        if(null != -1)
+            dup2(null, STDERR_FILENO);
+        close(p[0]);
+        close(p[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(p[1]);
+
+    char buf[65536];
+    ssize_t r;
+    s->first = -1;
+    s->lines = 0;
+    while((r = read(p[0], buf, sizeof(buf))) != 0){
+        if(r == -1){
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(s->first < 0)
+            s->first = now_sec() - t0;
+        for(ssize_t i = 0; i < r; i++)
+            s->lines += (buf[i] == '\n');
+    }
+    close(p[0]);
+
+    int status;
+    struct rusage ru;
+    while(wait4(pid, &status, 0, &ru) == -1){
+        if(errno != EINTR){
+            perror("wait4");
+            return -1;
+        }
+    }
+    //il rusage di farm comprende il Collector processo, che farm attende prima di terminare
+    s->wall = now_sec() - t0;
+    if(s->first < 0)
+        s->first = s->wall;
+    s->rss_kb = ru.ru_maxrss;
+    s->cpu = (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6) / s->wall;
+    s->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return 0;
+}
+
+/* ------------------- statistiche e JSON ------------------ */
+
+static int cmp_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief stampa le statistiche dei valori v come membro JSON "name"
+ */
+static void json_stats(const char *name, const double *v, int n){
+    double sorted[n], mean = 0, var = 0;
+    memcpy(sorted, v, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), cmp_double);
+    for(int i = 0; i < n; i++)
+        mean += v[i] / n;
+    for(int i = 0; i < n; i++)
+        var += (v[i] - mean) * (v[i] - mean);
+    double sd = (n > 1) ? sqrt(var / (n - 1)) : 0;
+    double median = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    printf(",\n      \"%s\": {\"mean\": %.6g, \"stddev\": %.6g, \"cv\": %.4f, \"min\": %.6g, \"median\": %.6g, \"max\": %.6g}",
+        name, mean, sd, (mean != 0) ? sd / mean : 0, sorted[0], median, sorted[n - 1]);
+}
+
+//stringa JSON (le opzioni contengono solo caratteri stampabili)
+static void json_string(const char *s){
+    putchar('"');
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\')
+            putchar('\\');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+/* ------------------- opzioni ------------------ */
+
+//divide list (separata da virgole, modificata) in al piu' max elementi, anche vuoti
+static int split_list(char *list, char **items, int max){
+    int n = 0;
+    char *p = list;
+    while(n < max){
+        items[n++] = p;
+        char *comma = strchr(p, ',');
+        if(!comma)
+            break;
+        *comma = '\0';
+        p = comma + 1;
+    }
+    return n;
+}
+
+static int parse_longs(char *list, long *v, int max){
+    char *items[_BENCH_MAX_LIST];
+    int n = split_list(list, items, max);
+    for(int i = 0; i < n; i++){
+        char *end;
+        v[i] = strtol(items[i], &end, 10);
+        if(*items[i] == '\0' || *end != '\0' || v[i] <= 0)
+            return -1;
+    }
+    return n;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "usage: %s [-s scale] [-r repeats] [-n list] [-q list] [-e list] [-w list] [-d data_dir] [-f farm] [-b baseline]\n"
+        "  lists are comma separated, e.g. -n 1,4,8 -q 8,64 -e \",-i,-s,-c 2\" -w tiny,huge,skewed,deep\n", prog);
+}
+
+int main(int argc, char **argv){
+    long scale = _DEFAULT_SCALE, repeats = _DEFAULT_REPEATS;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    long nthreads[_BENCH_MAX_LIST] = {1, 4, ncpu > 0 ? ncpu : 8}, qlens[_BENCH_MAX_LIST] = {8, 64};
+    int nn = (ncpu == 1 || ncpu == 4) ? 2 : 3, nq = 2;
+    char default_engines[] = ",-i,-s", default_workloads[] = "tiny,huge,skewed,deep";
+    char *engines[_BENCH_MAX_LIST], *wnames[_BENCH_MAX_LIST];
+    int ne = split_list(default_engines, engines, _BENCH_MAX_LIST);
+    int nw = split_list(default_workloads, wnames, _BENCH_MAX_LIST);
+    const char *data_dir = _DEFAULT_DATA_DIR, *farm = _DEFAULT_FARM, *baseline = NULL;
+
+    int opt;
+    while((opt = getopt(argc, argv, "s:r:n:q:e:w:d:f:b:")) != -1){
+        switch(opt){
+            case 's': scale = strtol(optarg, NULL, 10); break;
+            case 'r': repeats = strtol(optarg, NULL, 10); break;
+            case 'n': nn = parse_longs(optarg, nthreads, _BENCH_MAX_LIST); break;
+            case 'q': nq = parse_longs(optarg, qlens, _BENCH_MAX_LIST); break;
+            case 'e': ne = split_list(optarg, engines, _BENCH_MAX_LIST); break;
+            case 'w': nw = split_list(optarg, wnames, _BENCH_MAX_LIST); break;
+            case 'd': data_dir = optarg; break;
+            case 'f': farm = optarg; break;
+            case 'b': baseline = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(scale <= 0 || scale > 64 || repeats <= 0 || repeats > 1000 || nn <= 0 || nq <= 0){
+        usage(argv[0]);
+        return 1;
+    }
+    if(access(farm, X_OK) != 0){
+        fprintf(stderr, "bench_farm: %s not found (make farm)\n", farm);
+        return 1;
+    }
+    if(baseline && access(baseline, X_OK) != 0){
+        fprintf(stderr, "bench_farm: baseline %s not found (make farm)\n", baseline);
+        return 1;
+    }
+
+    workload_t all[] = {{"tiny", gen_tiny, 0, 0}, {"huge", gen_huge, 0, 0}, {"skewed", gen_skewed, 0, 0}, {"deep", gen_deep, 0, 0}};
+    workload_t *ws[_BENCH_MAX_LIST];
+    char dirs[_BENCH_MAX_LIST][_BENCH_PATH_LEN];
+    for(int i = 0; i < nw; i++){
+        ws[i] = NULL;
+        for(size_t j = 0; j < sizeof(all) / sizeof(all[0]); j++)
+            if(strcmp(wnames[i], all[j].name) == 0)
+                ws[i] = &all[j];
+        if(!ws[i]){
+            fprintf(stderr, "bench_farm: unknown workload %s (tiny, huge, skewed, deep)\n", wnames[i]);
+            return 1;
+        }
+        if(prepare(ws[i], data_dir, scale, dirs[i]) != 0)
+            return 1;
+    }
+
+    printf("{\n  \"bench\": \"farm\",\n  \"farm\": ");
+    json_string(farm);
+    if(baseline){
+        printf(",\n  \"baseline\": ");
+        json_string(baseline);
+    }
+    printf(",\n  \"scale\": %ld,\n  \"repeats\": %ld,\n  \"cpus\": %ld,\n  \"results\": [", scale, repeats, ncpu);
+
+    int first = 1, failed = 0;
+    sample_t s[repeats], bs[repeats];
+    double v[repeats];
+    for(int w = 0; w < nw; w++)
+        for(int e = 0; e < ne; e++)
+            for(int n = 0; n < nn; n++)
+                for(int q = 0; q < nq; q++){
+                    //argomenti: farm -n N -q Q <opzioni del motore> -d dir
+                    char nbuf[32], qbuf[32], ebuf[_BENCH_PATH_LEN];
+                    char *args[_BENCH_MAX_ARGS];
+                    int na = 0;
+                    snprintf(nbuf, sizeof(nbuf), "%ld", nthreads[n]);
+                    snprintf(qbuf, sizeof(qbuf), "%ld", qlens[q]);
+                    snprintf(ebuf, sizeof(ebuf), "%s", engines[e]);
+                    args[na++] = (char *)farm;
+                    args[na++] = "-n";
+                    args[na++] = nbuf;
+                    args[na++] = "-q";
+                    args[na++] = qbuf;
+                    for(char *tok = strtok(ebuf, " "); tok && na < _BENCH_MAX_ARGS - 3; tok = strtok(NULL, " "))
+                        args[na++] = tok;
+                    args[na++] = "-d";
+                    args[na++] = dirs[w];
+                    args[na] = NULL;
+
+                    int ok = 1;
+                    sample_t warm;
+                    if(run_farm(args, &warm) != 0) //riscaldamento: page cache e directory in memoria
+                        return 1;
+                    for(long r = 0; r < repeats; r++){
+                        if(run_farm(args, &s[r]) != 0)
+                            return 1;
+                        ok = ok && s[r].status == 0 && s[r].lines == ws[w]->files;
+                        if(baseline){ //stessi argomenti, eseguibile della baseline
+                            args[0] = (char *)baseline;
+                            int err = run_farm(args, &bs[r]);
+                            args[0] = (char *)farm;
+                            if(err != 0)
+                                return 1;
+                            ok = ok && bs[r].status == 0 && bs[r].lines == ws[w]->files;
+                        }
+                    }
+                    failed |= !ok;
+
+                    printf("%s\n    {\"workload\": \"%s\", \"files\": %ld, \"bytes\": %lld, \"nthread\": %ld, \"qlen\": %ld, \"engine\": ",
+                        first ? "" : ",", ws[w]->name, ws[w]->files, ws[w]->bytes, nthreads[n], qlens[q]);
+                    json_string(engines[e]);
+                    printf(", \"ok\": %s", ok ? "true" : "false");
+                    first = 0;
+                    for(long r = 0; r < repeats; r++) v[r] = s[r].wall;
+                    json_stats("wall_s", v, repeats);
+                    for(long r = 0; r < repeats; r++) v[r] = ws[w]->files / s[r].wall;
+                    json_stats("files_per_s", v, repeats);
+                    for(long r = 0; r < repeats; r++) v[r] = ws[w]->bytes / s[r].wall / 1e9;
+                    json_stats("gb_per_s", v, repeats);
+                    for(long r = 0; r < repeats; r++) v[r] = s[r].first;
+                    json_stats("first_result_s", v, repeats);
+                    for(long r = 0; r < repeats; r++) v[r] = s[r].rss_kb;
+                    json_stats("peak_rss_kb", v, repeats);
+                    for(long r = 0; r < repeats; r++) v[r] = s[r].cpu;
+                    json_stats("cpu_util", v, repeats);
+
+                    double mean = 0, base_mean = 0;
+                    for(long r = 0; r < repeats; r++)
+                        mean += s[r].wall / repeats;
+                    if(baseline){
+                        for(long r = 0; r < repeats; r++){
+                            v[r] = bs[r].wall;
+                            base_mean += bs[r].wall / repeats;
+                        }
+                        json_stats("baseline_wall_s", v, repeats);
+                        printf(",\n      \"speedup\": %.4f", base_mean / mean);
+                    }
+                    printf("}");
+                    fflush(stdout);
+
+                    fprintf(stderr, "%-7s -n %-3ld -q %-3ld %-8s %9.4f s", ws[w]->name, nthreads[n], qlens[q],
+                        engines[e][0] ? engines[e] : "default", mean);
+                    if(baseline)
+                        fprintf(stderr, " (baseline %.4f s, speedup %.3f)", base_mean, base_mean / mean);
+                    fprintf(stderr, " %s\n", ok ? "" : "(FAILED)");
+                }
+    printf("\n  ]\n}\n");
+    return failed;
+}
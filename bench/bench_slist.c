@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sor_list.h>
+#include "bench.h"
+
+/**
+ * @file bench_slist.c
+ * @brief Benchmark della lista ordinata del Collector (B+-tree) contro la precedente lista concatenata.
+ *          Per ogni distribuzione degli index e per ogni dimensione n (da 10^4 a max_n, per potenze di 10) misura
+ *          l'inserimento di n risultati, la visita ordinata, la stampa (printSList su /dev/null), lo snapshot (snapSList,
+ *          la pausa della raccolta ad ogni SIGUSR1) e la memoria per risultato;
+ *          la lista concatenata (O(n^2)) viene misurata solo fino a legacy_max_n (a 10^5 richiede gia' qualche minuto).
+ *          Distribuzioni: uniform (pseudo-casuali), sorted (crescenti), reverse (decrescenti), dup (100 valori distinti).
+ *          Il thread viene legato ad una cpu (politica compact di farm) ed ogni misura e' preceduta da un inserimento
+ *          di riscaldamento di 10^4 risultati.
+ *
+ *          uso: ./bench_slist [max_n] [legacy_max_n] [distribuzioni]   (default 10^6, 10^4 e uniform,sorted,reverse,dup)
+ */
+
+#define _DEFAULT_MAX_N 1000000
+#define _DEFAULT_LEGACY_MAX_N 10000
+#define _BENCH_PATH_LEN 255
+#define _WARMUP_N 10000
+
+/* ------------------- lista concatenata (implementazione precedente) ------------------ */
+
+typedef struct legacy_node
+{
+    char* string;
+    long index;
+    struct legacy_node *next;
+} LNode;
+
+typedef struct legacy_list
+{
+    LNode *head;
+    size_t str_len;
+} LList;
+
+static int legacyAdd(LList *l, char *string, long index){
+    LNode *new_node = malloc(sizeof(LNode));
+    if (!new_node)
+        return -1;
+    new_node->string = (char *)calloc(l->str_len, sizeof(char));
+    if (!new_node->string)
+        return -1;
+    strncpy(new_node->string, string, l->str_len);
+    new_node->index = index;
+
+    LNode *current_node = l->head;
+    LNode *previous_node = NULL;
+    while(current_node != NULL && index > current_node->index){
+        previous_node = current_node;
+        current_node = current_node->next;
+    }
+    if(previous_node == NULL){
+        new_node->next = l->head;
+        l->head = new_node;
+    }
+    else{
+        previous_node->next = new_node;
+        new_node->next = current_node;
+    }
+    return 0;
+}
+
+static void legacyDelete(LList *l){
+    LNode *n = l->head;
+    while(n != NULL){
+        LNode *next = n->next;
+        free(n->string);
+        free(n);
+        n = next;
+    }
+}
+
+/* ------------------- distribuzioni degli index ------------------ */
+
+typedef enum { DIST_UNIFORM, DIST_SORTED, DIST_REVERSE, DIST_DUP, DIST_N } dist_t;
+static const char *dist_names[DIST_N] = {"uniform", "sorted", "reverse", "dup"};
+
+//sequenza deterministica (stesso seme per ogni struttura), i-esimo index di n
+static uint64_t rng_state;
+static long next_index(dist_t dist, long i, long n){
+    switch(dist){
+        case DIST_SORTED: return i * 1000;
+        case DIST_REVERSE: return (n - i) * 1000;
+        case DIST_DUP: return (long)(bench_rand(&rng_state) % 100) * 1000;
+        default: return (long)(bench_rand(&rng_state) % 4000000000ULL);
+    }
+}
+
+//inserisce n risultati nella lista (B+-tree), NULL in caso di errore
+static SList *fill(dist_t dist, long n){
+    char path[_BENCH_PATH_LEN];
+    SList *l = initSList(_BENCH_PATH_LEN);
+    if(!l)
+        return NULL;
+    rng_state = _BENCH_SEED;
+    for(long i = 0; i < n; i++){
+        snprintf(path, sizeof(path), "dir/file%ld.dat", i);
+        if(addNode(l, path, next_index(dist, i, n)) != 0){
+            perror("addNode");
+            deleteSList(l);
+            return NULL;
+        }
+    }
+    return l;
+}
+
+int main(int argc, char **argv){
+    long max_n = _DEFAULT_MAX_N;
+    long legacy_max_n = _DEFAULT_LEGACY_MAX_N;
+    int dists[DIST_N] = {1, 1, 1, 1};
+    if((argc > 1 && (max_n = strtol(argv[1], NULL, 10)) < 10000) || (argc > 2 && (legacy_max_n = strtol(argv[2], NULL, 10)) < 0)){
+        fprintf(stderr, "usage: %s [max_n >= 10000] [legacy_max_n >= 0] [uniform,sorted,reverse,dup]\n", argv[0]);
+        return 1;
+    }
+    if(argc > 3){
+        memset(dists, 0, sizeof(dists));
+        for(char *tok = strtok(argv[3], ","); tok; tok = strtok(NULL, ",")){
+            int found = 0;
+            for(int d = 0; d < DIST_N; d++)
+                if(strcmp(tok, dist_names[d]) == 0)
+                    found = dists[d] = 1;
+            if(!found){
+                fprintf(stderr, "%s: unknown distribution %s (uniform, sorted, reverse, dup)\n", argv[0], tok);
+                return 1;
+            }
+        }
+    }
+
+    affinity_t aff;
+    if(init_affinity(&aff, "compact", 1) != A_SUCCESS || bench_pin(&aff, 0) != A_SUCCESS)
+        return 1;
+
+    int devnull = open("/dev/null", O_WRONLY);
+    if(devnull == -1){
+        perror("open /dev/null");
+        return 1;
+    }
+
+    char path[_BENCH_PATH_LEN];
+    printf("%8s %10s %14s %14s %14s %14s %14s %14s\n", "dist", "n", "legacy_ins(s)", "btree_ins(s)", "btree_iter(s)", "btree_print(s)", "btree_snap(s)", "btree_B/res");
+
+    for(dist_t dist = 0; dist < DIST_N; dist++){
+        if(!dists[dist])
+            continue;
+        for(long n = 10000; n <= max_n; n *= 10){
+            //lista concatenata
+            double legacy = -1;
+            if(n <= legacy_max_n){
+                LList ll = {NULL, _BENCH_PATH_LEN};
+                rng_state = _BENCH_SEED;
+                double t0 = now_sec();
+                for(long i = 0; i < n; i++){
+                    snprintf(path, sizeof(path), "dir/file%ld.dat", i);
+                    if(legacyAdd(&ll, path, next_index(dist, i, n)) != 0){
+                        perror("legacyAdd");
+                        return 1;
+                    }
+                }
+                legacy = now_sec() - t0;
+                legacyDelete(&ll);
+            }
+
+            //B+-tree, dopo un riscaldamento (allocatore e cache)
+            SList *l = fill(dist, _WARMUP_N);
+            if(!l)
+                return 1;
+            deleteSList(l);
+            double t0 = now_sec();
+            if(!(l = fill(dist, n)))
+                return 1;
+            double ins = now_sec() - t0;
+
+            //visita ordinata (come printSList, senza il costo della formattazione)
+            t0 = now_sec();
+            long prev = -1, sorted = 1;
+            size_t bytes = 0;
+            for(SLeaf *leaf = l->first; leaf != NULL; leaf = leaf->next)
+                for(int i = 0; i < leaf->n; i++){
+                    if(leaf->index[i] < prev)
+                        sorted = 0;
+                    prev = leaf->index[i];
+                    bytes += l->dir_len[leaf->dir[i]] + strlen(leaf->base[i]);
+                }
+            double iter = now_sec() - t0;
+            if(!sorted || l->lsize != (size_t)n || bytes == 0){
+                fprintf(stderr, "bench_slist: invalid list (n=%ld, lsize=%zu)\n", n, l->lsize);
+                return 1;
+            }
+
+            t0 = now_sec();
+            if(printSList(l, devnull) != 0){
+                perror("printSList");
+                return 1;
+            }
+            double print = now_sec() - t0;
+
+            t0 = now_sec();
+            SList *s = snapSList(l);
+            double snap = now_sec() - t0;
+            if(!s){
+                perror("snapSList");
+                return 1;
+            }
+            deleteSList(s);
+            double per_res = (double)l->mem / n;
+            deleteSList(l);
+
+            if(legacy < 0)
+                printf("%8s %10ld %14s %14.4f %14.4f %14.4f %14.6f %14.1f\n", dist_names[dist], n, "skipped", ins, iter, print, snap, per_res);
+            else
+                printf("%8s %10ld %14.4f %14.4f %14.4f %14.4f %14.6f %14.1f\n", dist_names[dist], n, legacy, ins, iter, print, snap, per_res);
+            fflush(stdout);
+        }
+    }
+
+    close(devnull);
+    delete_affinity(&aff);
+    return 0;
+}
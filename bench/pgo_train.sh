@@ -0,0 +1,44 @@
+#!/bin/bash
+
+#
+# Addestramento della build PGO (make farm-pgo): esegue la farm strumentata sul corpus generato con generatree,
+# coprendo la visita delle directory (albero profondo di file minuscoli), la contesa sulla coda (molti Worker, coda corta),
+# il calcolo (file grandi) e la ricezione del Collector (processo, thread -i, thread di ingestione -c, ring -s, batch).
+# Ogni esecuzione viene confrontata con il manifest: un profilo raccolto su una farm che sbaglia non serve.
+#
+# uso: ./bench/pgo_train.sh farm data_dir
+#
+
+farm=${1:-./farm-pgo}
+data=${2:-pgo_data}
+ncpu=$(nproc)
+[[ $ncpu -lt 4 ]] && ncpu=4
+
+mkdir -p "$data"
+# visita: 4 livelli con fan-out 6 (1555 directory), file minuscoli ed alcuni non .dat
+[[ -d $data/traverse ]] || ./generatree -d "$data/traverse" -n 20000 -s uniform:8:256 -D 4 -F 6 -x 0.05 || exit 1
+# misto: dimensioni log-normali, come un dataset reale
+[[ -d $data/mixed ]] || ./generatree -d "$data/mixed" -n 5000 -s lognormal:4096:1.5 -D 2 -F 4 || exit 1
+# calcolo: pochi file grandi
+[[ -d $data/compute ]] || ./generatree -d "$data/compute" -n 32 -s uniform:1048576:4194304 -D 0 || exit 1
+
+res=0
+run(){
+    local dir=$1
+    shift
+    "$farm" "$@" -d "$data/$dir" 2> /dev/null | LC_ALL=C sort -k1,1n -k2,2 | diff -q - "$data/$dir.manifest" > /dev/null || {
+        echo "pgo_train: $farm $* -d $data/$dir: wrong output" >&2
+        res=1
+    }
+}
+
+for opt in "" "-i" "-s" "-c 2" "-b 64 -l 5"; do
+    run traverse -n 4 -q 16 $opt
+    run mixed -n $ncpu -q 64 $opt
+done
+run traverse -n $((ncpu * 2)) -q 1
+run mixed -n $((ncpu * 2)) -q 2 -i
+run compute -n $ncpu -q 8
+run compute -n 2 -q 4 -i
+
+exit $res
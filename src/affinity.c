@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <affinity.h>
+#include <util.h>
+
+#define MAX_SYSFS_LINE 4096
+
+/**
+ * \file affinity.c
+ * \brief Implementazione dell'interfaccia affinity.h (topologia letta da sysfs)
+ */
+
+/** Informazioni di topologia di una singola cpu
+ *
+ */
+typedef struct cpuInfo
+{
+    int cpu;
+    int package;
+    int core;
+    int node;
+    int sibling_rank; // posizione della cpu tra gli hyperthread dello stesso core
+} cpuInfo_t;
+
+/**
+ * \brief Legge la prima riga del file path in buf
+ *
+ * \retval 0 in caso di successo
+ * \retval -1 in caso di errore
+ */
+static int read_sysfs_line(const char *path, char *buf, size_t len){
+    FILE *f = fopen(path, "r");
+    if(!f)
+        return -1;
+    if(!fgets(buf, len, f)){
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/**
+ * \brief Legge un intero dal file path (def se il file non esiste)
+ */
+static int read_sysfs_int(const char *path, int def){
+    char buf[64];
+    long v;
+    if(read_sysfs_line(path, buf, sizeof(buf)) != 0 || isNumber(buf, &v) != 0)
+        return def;
+    return (int)v;
+}
+
+/**
+ * \brief Parsing di una lista di cpu nel formato sysfs ("0-3,8,10-11")
+ *
+ * \param s stringa da parsare
+ * \param out array in cui vengono salvate le cpu
+ * \param max dimensione di out
+ *
+ * \retval n numero di cpu salvate in out
+ * \retval -1 se la stringa non è valida
+ */
+static int parse_cpulist(const char *s, int *out, int max){
+    int n = 0;
+    const char *p = s;
+    while(*p != '\0'){
+        char *e;
+        errno = 0;
+        long lo = strtol(p, &e, 10);
+        if(e == p || errno != 0 || lo < 0)
+            return -1;
+        long hi = lo;
+        p = e;
+        if(*p == '-'){
+            p++;
+            hi = strtol(p, &e, 10);
+            if(e == p || errno != 0 || hi < lo)
+                return -1;
+            p = e;
+        }
+        for(long c = lo; c <= hi; c++){
+            if(n == max || c >= CPU_SETSIZE)
+                return -1;
+            out[n++] = (int)c;
+        }
+        if(*p == ',')
+            p++;
+        else if(*p != '\0')
+            return -1;
+    }
+    return n;
+}
+
+static int cmp_compact(const void *a, const void *b){
+    const cpuInfo_t *x = a, *y = b;
+    if(x->node != y->node) return x->node - y->node;
+    if(x->package != y->package) return x->package - y->package;
+    if(x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static int cmp_scatter(const void *a, const void *b){
+    const cpuInfo_t *x = a, *y = b;
+    if(x->node != y->node) return x->node - y->node;
+    if(x->sibling_rank != y->sibling_rank) return x->sibling_rank - y->sibling_rank;
+    if(x->package != y->package) return x->package - y->package;
+    if(x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+/**
+ * \brief Legge da sysfs la topologia delle cpu utilizzabili dal processo
+ *
+ * \param cpus array (allocato dalla funzione) con le informazioni delle cpu
+ * \param a piano di affinity in cui vengono salvati i nodi NUMA
+ *
+ * \retval n numero di cpu
+ * \retval -1 in caso di errore
+ */
+static int read_topology(cpuInfo_t **cpus, affinity_t *a){
+    char line[MAX_SYSFS_LINE];
+    char path[MAX_SYSFS_LINE];
+    int online[CPU_SETSIZE];
+
+    int nonline;
+    if(read_sysfs_line(SYSFS_CPU_DIR "/online", line, sizeof(line)) != 0 || (nonline = parse_cpulist(line, online, CPU_SETSIZE)) <= 0){
+        print_error("cannot read online cpus from %s/online\n", SYSFS_CPU_DIR);
+        return -1;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    CHECK_NEQ_RETURN("sched_getaffinity", sched_getaffinity(0, sizeof(allowed), &allowed), 0, -1, "sched_getaffinity failed\n");
+
+    CHECK_EQ_RETURN("calloc", *cpus = calloc(nonline, sizeof(cpuInfo_t)), NULL, -1, "calloc failed\n");
+
+    int n = 0;
+    for(int i = 0; i < nonline; i++){
+        int c = online[i];
+        if(!CPU_ISSET(c, &allowed)) //cpu non utilizzabile (es. cgroup/taskset)
+            continue;
+        (*cpus)[n].cpu = c;
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/topology/physical_package_id", c);
+        (*cpus)[n].package = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/topology/core_id", c);
+        (*cpus)[n].core = read_sysfs_int(path, c);
+        (*cpus)[n].node = 0;
+        n++;
+    }
+
+    //nodi NUMA (in assenza di SYSFS_NODE_DIR si assume un solo nodo)
+    int *node_of = calloc(CPU_SETSIZE, sizeof(int));
+    if(!node_of){
+        free(*cpus);
+        return -1;
+    }
+    int list[CPU_SETSIZE];
+    int found = 0;
+    for(int node = 0; node < _MAX_NUMA_NODES; node++){
+        snprintf(path, sizeof(path), SYSFS_NODE_DIR "/node%d/cpulist", node);
+        if(read_sysfs_line(path, line, sizeof(line)) != 0)
+            continue;
+        int k = parse_cpulist(line, list, CPU_SETSIZE);
+        for(int j = 0; j < k; j++)
+            node_of[list[j]] = node;
+        found = 1;
+    }
+    for(int i = 0; i < n && found; i++)
+        (*cpus)[i].node = node_of[(*cpus)[i].cpu];
+    free(node_of);
+
+    //rank tra gli hyperthread dello stesso core
+    for(int i = 0; i < n; i++){
+        (*cpus)[i].sibling_rank = 0;
+        for(int j = 0; j < n; j++)
+            if((*cpus)[j].package == (*cpus)[i].package && (*cpus)[j].core == (*cpus)[i].core && (*cpus)[j].cpu < (*cpus)[i].cpu)
+                (*cpus)[i].sibling_rank++;
+    }
+
+    //cpu raggruppate per nodo (ordinate per nodo grazie a cmp_compact)
+    qsort(*cpus, n, sizeof(cpuInfo_t), cmp_compact);
+    if(!(a->node_cpus = calloc(n, sizeof(int)))){
+        perror("calloc");
+        free(*cpus);
+        *cpus = NULL;
+        return -1;
+    }
+    a->nnodes = 0;
+    for(int i = 0; i < n; i++){
+        if(i == 0 || (*cpus)[i].node != (*cpus)[i-1].node){
+            if(a->nnodes == _MAX_NUMA_NODES)
+                break;
+            a->node_off[a->nnodes++] = i;
+        }
+        a->node_cpus[i] = (*cpus)[i].cpu;
+    }
+    a->node_off[a->nnodes] = n;
+
+    return n;
+}
+
+int init_affinity(affinity_t *a, const char *policy, size_t nworkers){
+    memset(a, 0, sizeof(affinity_t));
+    a->nworkers = nworkers;
+
+    if(policy == NULL || policy[0] == '\0' || strcmp(policy, "none") == 0){
+        a->policy = AFF_NONE;
+        return A_SUCCESS;
+    }
+
+    if(strcmp(policy, "compact") == 0)
+        a->policy = AFF_COMPACT;
+    else if(strcmp(policy, "scatter") == 0)
+        a->policy = AFF_SCATTER;
+    else if(strcmp(policy, "numa") == 0)
+        a->policy = AFF_NUMA;
+    else
+        a->policy = AFF_LIST;
+
+    cpuInfo_t *cpus = NULL;
+    int ncpus = read_topology(&cpus, a);
+    if(ncpus <= 0){
+        free(cpus); //nessuna cpu utilizzabile: l'array e' allocato anche senza errori
+        delete_affinity(a);
+        return A_FAILURE;
+    }
+
+    int *order = calloc(ncpus, sizeof(int));
+    int norder = 0;
+    a->worker_cpu = calloc(nworkers, sizeof(int));
+    a->worker_node = calloc(nworkers, sizeof(int));
+    a->free_cpus = calloc(ncpus, sizeof(int));
+    if(!order || !a->worker_cpu || !a->worker_node || !a->free_cpus){
+        perror("calloc");
+        free(order);
+        free(cpus);
+        delete_affinity(a);
+        return A_FAILURE;
+    }
+
+    switch(a->policy){
+        case AFF_COMPACT: //cpu contigue: riempio prima i core e i socket già usati
+            for(int i = 0; i < ncpus; i++)
+                order[norder++] = cpus[i].cpu;
+            break;
+        case AFF_SCATTER: { //un worker per core e alternanza tra nodi, poi gli hyperthread
+            qsort(cpus, ncpus, sizeof(cpuInfo_t), cmp_scatter);
+            int *next = calloc(a->nnodes, sizeof(int));
+            int *off = calloc(a->nnodes + 1, sizeof(int));
+            if(!next || !off){
+                free(next);
+                free(off);
+                break;
+            }
+            //dopo cmp_scatter le cpu restano raggruppate per nodo
+            for(int i = 0, k = 0; i < ncpus; i++)
+                if(i == 0 || cpus[i].node != cpus[i-1].node)
+                    off[k++] = i;
+            off[a->nnodes] = ncpus;
+            while(norder < ncpus)
+                for(int k = 0; k < a->nnodes; k++)
+                    if(off[k] + next[k] < off[k+1])
+                        order[norder++] = cpus[off[k] + next[k]++].cpu;
+            free(next);
+            free(off);
+            break;
+        }
+        case AFF_LIST: { //lista esplicita, accetto solo cpu utilizzabili dal processo
+            int list[CPU_SETSIZE];
+            int k = parse_cpulist(policy, list, CPU_SETSIZE);
+            if(k <= 0){
+                print_error("affinity policy '%s' not recognized (compact, scatter, numa or a cpu list like 0,2,4-6)\n", policy);
+                break;
+            }
+            for(int j = 0; j < k; j++){
+                int ok = 0;
+                for(int i = 0; i < ncpus; i++)
+                    if(cpus[i].cpu == list[j])
+                        ok = 1;
+                if(!ok){
+                    print_error("cpu %d in affinity list is not online or not allowed\n", list[j]);
+                    norder = 0;
+                    break;
+                }
+                order[norder++] = list[j];
+            }
+            break;
+        }
+        case AFF_NUMA: //ogni worker legato a tutte le cpu di un nodo, nodi assegnati round-robin
+            norder = a->nnodes;
+            break;
+        default:
+            break;
+    }
+
+    if(norder == 0){
+        free(order);
+        free(cpus);
+        delete_affinity(a);
+        return A_FAILURE;
+    }
+
+    char *used = calloc(CPU_SETSIZE, sizeof(char));
+    if(!used){
+        free(order);
+        free(cpus);
+        delete_affinity(a);
+        return A_FAILURE;
+    }
+    for(size_t w = 0; w < nworkers; w++){
+        if(a->policy == AFF_NUMA){
+            int node = w % a->nnodes;
+            a->worker_cpu[w] = -1;
+            a->worker_node[w] = node;
+            for(int i = a->node_off[node]; i < a->node_off[node+1]; i++)
+                used[a->node_cpus[i]] = 1;
+        }
+        else{
+            int c = order[w % norder];
+            a->worker_cpu[w] = c;
+            a->worker_node[w] = 0;
+            for(int k = 0; k < a->nnodes; k++)
+                for(int i = a->node_off[k]; i < a->node_off[k+1]; i++)
+                    if(a->node_cpus[i] == c)
+                        a->worker_node[w] = k;
+            used[c] = 1;
+        }
+    }
+
+    //cpu rimaste libere per Master e Collector
+    a->nfree = 0;
+    for(int i = 0; i < ncpus; i++)
+        if(!used[cpus[i].cpu])
+            a->free_cpus[a->nfree++] = cpus[i].cpu;
+
+    free(used);
+    free(order);
+    free(cpus);
+    return A_SUCCESS;
+}
+
+int pin_worker(const affinity_t *a, size_t id){
+    if(!a || a->policy == AFF_NONE || id >= a->nworkers)
+        return A_SUCCESS;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(a->worker_cpu[id] >= 0)
+        CPU_SET(a->worker_cpu[id], &set);
+    else{
+        int node = a->worker_node[id];
+        for(int i = a->node_off[node]; i < a->node_off[node+1]; i++)
+            CPU_SET(a->node_cpus[i], &set);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(err != 0){
+        errno = err;
+        perror("pthread_setaffinity_np");
+        print_error("pinning of worker %zu failed\n", id);
+        return A_FAILURE;
+    }
+    return A_SUCCESS;
+}
+
+int pin_outside_workers(const affinity_t *a, int slot){
+    if(!a || a->policy == AFF_NONE || a->nfree == 0)
+        return A_SUCCESS;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(a->free_cpus[slot % a->nfree], &set);
+    CHECK_NEQ_RETURN("sched_setaffinity", sched_setaffinity(0, sizeof(set), &set), 0, A_FAILURE, "sched_setaffinity failed\n");
+    return A_SUCCESS;
+}
+
+int get_worker_node(const affinity_t *a, size_t id){
+    if(!a || a->policy == AFF_NONE || id >= a->nworkers)
+        return -1;
+    return a->worker_node[id];
+}
+
+void delete_affinity(affinity_t *a){
+    if(!a)
+        return;
+    free(a->worker_cpu);
+    free(a->worker_node);
+    free(a->node_cpus);
+    free(a->free_cpus);
+    a->worker_cpu = a->worker_node = a->node_cpus = a->free_cpus = NULL;
+}
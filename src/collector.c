@@ -1,10 +1,26 @@
 #define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <collector.h>
 #include <util.h>
 #include <conn.h>
+#include <proto.h>
+#include <net.h>
+#include <query.h>
+#include <metrics.h>
+#include <trace.h>
+
+//metriche del Collector (un solo Collector per processo): aggiornate dal Collector e dai thread di ingestione
+static collectorMetrics_t cmetrics;
+
+collectorMetrics_t *get_collector_metrics(){
+    return &cmetrics;
+}
 
 /**
  * @brief funzione di gestione segnali (comportamento spiegato nella relazione)
@@ -30,56 +46,739 @@ void handle_collector_signals(){
     CHECK_EQ_EXIT("sigaction", sigaction(SIGTERM, &s, NULL), -1, "sigaction failed\n");
     CHECK_EQ_EXIT("sigaction", sigaction(SIGHUP, &s, NULL), -1, "sigaction failed\n");
     CHECK_EQ_EXIT("sigaction", sigaction(SIGUSR1, &s, NULL), -1, "sigaction failed\n");
+    CHECK_EQ_EXIT("sigaction", sigaction(SIGUSR2, &s, NULL), -1, "sigaction failed\n");
+    //i client del socket di controllo (-Q) possono chiudere la connessione prima della risposta
+    CHECK_EQ_EXIT("sigaction", sigaction(SIGPIPE, &s, NULL), -1, "sigaction failed\n");
     
     //ripristino tutti i segnali
     CHECK_EQ_EXIT("sigemptyset", sigemptyset(&set), -1, "sigemptyset failed\n");
     CHECK_EQ_EXIT("pthread_sigmask", pthread_sigmask(SIG_SETMASK, &set, NULL), -1, "pthread_sigmask failed\n");
 }
 
+/** Thread di ingestione (modalità -c): gestisce un sottoinsieme delle connessioni dei Workers
+ *  con un proprio epoll e salva i risultati in una lista privata (shard)
+ */
+typedef struct ingestThread
+{
+    pthread_t tid;
+    int epfd;               // epoll delle connessioni assegnate al thread
+    int stopfd;             // eventfd con cui il Collector chiede la terminazione
+    int nconns;             // connessioni aperte (incrementato dal Collector, decrementato dal thread)
+    SList *shard;           // risultati ricevuti dal thread
+    pthread_mutex_t m;      // protegge shard
+    int max_path_len;
+    size_t part_len;
+} ingestThread_t;
+
+/**
+ * @brief sposta i risultati degli shard nella lista l (che resta ordinata). Gli shard contengono solo i risultati
+ *          arrivati dall'ultima chiamata e vengono svuotati: ogni risultato viene spostato una volta sola, con m
+ *          inserimenti O(log n) se lo shard e' piccolo rispetto a l, altrimenti con la fusione lineare O(n + m) che
+ *          costa O(1) ammortizzato per risultato (vedi SLIST_MERGE_RATIO). Una richiesta sul socket di controllo paga
+ *          quindi solo i risultati ricevuti dopo la precedente, non la dimensione di l
+ *
+ * @param l lista in cui vengono raccolti i risultati
+ * @param ith thread di ingestione (NULL se il Collector e' a thread singolo)
+ * @param nith numero di thread di ingestione
+ */
+static void collect_shards(SList *l, ingestThread_t *ith, size_t nith){
+    for(size_t i = 0; i < nith; i++){
+        LOCK(&ith[i].m);
+        mergeSList(l, ith[i].shard);
+        UNLOCK(&ith[i].m);
+    }
+}
+
+/** Thread di stampa degli snapshot (SIGUSR1): il Collector accoda una copia della lista (o i soli risultati nuovi
+ *  con -D) e continua a ricevere risultati mentre il thread la stampa; le stampe avvengono nell'ordine delle richieste
+ */
+typedef struct snapPrinter
+{
+    pthread_t tid;
+    pthread_mutex_t m;
+    pthread_cond_t cond;                    // segnalata ad ogni snapshot accodato o stampato
+    SList *snaps[_COLLECTOR_MAX_SNAPS];     // coda circolare degli snapshot
+    size_t head;                            // prossimo snapshot da stampare
+    size_t tail;                            // prima posizione libera
+    size_t count;                           // snapshot accodati o in stampa (0: thread inattivo)
+    int stop;
+    int outfd;                              // file descriptor su cui stampare gli snapshot
+    int delta;                              // stampa dei soli risultati nuovi (-D)
+} snapPrinter_t;
+
+static void *snap_printer(void *arg){
+    snapPrinter_t *sp = (snapPrinter_t *)arg;
+    LOCK(&sp->m);
+    while(1){
+        while(sp->count == 0 && !sp->stop)
+            WAIT(&sp->cond, &sp->m);
+        if(sp->count == 0) //stop e coda vuota
+            break;
+        SList *s = sp->snaps[sp->head];
+        sp->head = (sp->head + 1) % _COLLECTOR_MAX_SNAPS;
+        UNLOCK(&sp->m);
+
+        if(printSList(s, sp->outfd) != 0){
+            perror("printSList");
+            print_error("printSList failed (snapshot)\n");
+        }
+        deleteSList(s);
+
+        LOCK(&sp->m);
+        sp->count--;
+        BCAST(&sp->cond);
+    }
+    UNLOCK(&sp->m);
+    return NULL;
+}
+
+/**
+ * @brief avvia il thread di stampa degli snapshot
+ *
+ * @param sp stato del thread
+ * @param l lista dei risultati (con delta attivata se delta == 1)
+ * @param outfd file descriptor su cui stampare gli snapshot
+ * @param delta 1 per stampare solo i risultati arrivati dallo snapshot precedente
+ *
+ * @return C_SUCCESS se tutto va bene, C_FAILURE in caso di errore
+ */
+static int start_snap_printer(snapPrinter_t *sp, SList *l, int outfd, int delta){
+    sp->head = sp->tail = sp->count = 0;
+    sp->stop = 0;
+    sp->outfd = outfd;
+    sp->delta = delta;
+    CHECK_EQ_RETURN("setSListDelta", setSListDelta(l, delta), -1, C_FAILURE, "setSListDelta failed\n");
+    CHECK_NEQ_RETURN("pthread_mutex_init", pthread_mutex_init(&sp->m, NULL), 0, C_FAILURE, "pthread_mutex_init failed\n");
+    CHECK_NEQ_RETURN("pthread_cond_init", pthread_cond_init(&sp->cond, NULL), 0, C_FAILURE, "pthread_cond_init failed\n");
+    int err = pthread_create(&sp->tid, NULL, snap_printer, sp);
+    if(err != 0){
+        errno = err;
+        perror("pthread_create");
+        print_error("pthread_create failed (snapshot printer)\n");
+        return C_FAILURE;
+    }
+    return C_SUCCESS;
+}
+
+/**
+ * @brief termina il thread di stampa dopo che ha stampato gli snapshot accodati (la stampa finale li segue)
+ *          e disattiva la delta di l
+ */
+static void stop_snap_printer(snapPrinter_t *sp, SList *l){
+    LOCK(&sp->m);
+    sp->stop = 1;
+    BCAST(&sp->cond);
+    UNLOCK(&sp->m);
+    CHECK_NEQ_EXIT("pthread_join", pthread_join(sp->tid, NULL), 0, "pthread_join failed (snapshot printer)\n");
+    pthread_mutex_destroy(&sp->m);
+    pthread_cond_destroy(&sp->cond);
+    setSListDelta(l, 0);
+}
+
+/**
+ * @brief stampa uno snapshot di l senza bloccare la raccolta: lo snapshot (foglie condivise copy-on-write e nodi interni
+ *          ricostruiti, O(n / SLIST_ORDER), o la sola delta con -D)
+ *          viene accodato al thread di stampa. Se lo snapshot non puo' essere creato la lista viene stampata direttamente,
+ *          dopo gli snapshot gia' accodati (con -D i risultati restano nella delta per lo snapshot successivo)
+ */
+static void snapshot(snapPrinter_t *sp, SList *l){
+    SList *s = sp->delta ? takeSListDelta(l) : snapSList(l);
+
+    LOCK(&sp->m);
+    //coda piena o stampa diretta: attendo il thread di stampa
+    while((s && sp->count == _COLLECTOR_MAX_SNAPS) || (!s && sp->count > 0))
+        WAIT(&sp->cond, &sp->m);
+    if(s){
+        sp->snaps[sp->tail] = s;
+        sp->tail = (sp->tail + 1) % _COLLECTOR_MAX_SNAPS;
+        sp->count++;
+        BCAST(&sp->cond);
+    }
+    UNLOCK(&sp->m);
+    if(s)
+        return;
+
+    perror(sp->delta ? "takeSListDelta" : "snapSList");
+    if(sp->delta){
+        print_error("snapshot delta not available, results kept for the next snapshot\n");
+        return;
+    }
+    print_error("snapshot copy not available, printing synchronously\n");
+    if(printSList(l, sp->outfd) != 0){
+        perror("printSList");
+        print_error("printSList failed (snapshot)\n");
+    }
+}
+
 /**
  * @brief funzione che interpreta comunicazioni da parte del Master
  *
  * @param l lista in cui vengono caricati i risultati
+ * @param ith thread di ingestione, i cui shard vengono uniti a l prima della stampa (NULL se assenti)
+ * @param nith numero di thread di ingestione
+ * @param sp thread di stampa degli snapshot
  * @param end indica la fine della raccolta dati da parte del collector
  * @param msg messaggio del Master
  */
 
-static void master_comms(SList *l, int *end, char* msg){
+static void master_comms(SList *l, ingestThread_t *ith, size_t nith, snapPrinter_t *sp, int *end, char* msg){
     if(strcmp(msg, "quit") == 0)
         *end = 1;
     else if(strcmp(msg, "usr1") == 0){
-        printSList(l);
+        __atomic_add_fetch(&cmetrics.snapshots, 1, __ATOMIC_RELAXED);
+        collect_shards(l, ith, nith);
+        snapshot(sp, l);
     }
-    /*
-    else if(strcmp(msg, "usr2") == 0){
-        //other behaviors
+    else if(strcmp(msg, "usr2") == 0){ //SIGUSR2: metriche del Collector su stderr
+        if(write_collector_metrics(&cmetrics, STDERR_FILENO) != MT_SUCCESS)
+            print_error("write of the collector metrics failed\n");
     }
-    */
     else
         print_error("'%s' command not recognized", msg);
     return;
 }
 
+//tipi di descrittore registrati nell'epoll del Collector
+#define CONN_LISTEN 0       // socket AF_UNIX in ascolto
+#define CONN_MASTER 1       // Master locale
+#define CONN_RING 2         // doorbell del ring
+#define CONN_WORKER 3       // Worker (locale o di un nodo remoto dopo l'hello)
+#define CONN_TCP_LISTEN 4   // socket TCP in ascolto per i nodi remoti (modalità -L)
+#define CONN_HELLO 5        // connessione TCP in attesa dell'hello
+#define CONN_NODE 6         // Master di un nodo remoto
+#define CONN_CTRL_LISTEN 7  // socket di controllo in ascolto (-Q)
+#define CONN_CTRL 8         // client del socket di controllo
+
+/** Connessione registrata nell'epoll: per le connessioni con i Workers contiene i byte di un frame
+ *  parziale (al piu' un header e un path) non ancora decodificati, per quelle TCP l'hello parziale
+ */
+typedef struct connBuf
+{
+    int fd;
+    int type;       // CONN_*
+    uint32_t node;  // nodo di provenienza (0: MasterWorker locale)
+    char *part;
+    size_t len;
+    qOut_t out;     // risposte da inviare (CONN_CTRL)
+    int want_out;   // connessione registrata per EPOLLOUT (CONN_CTRL)
+} connBuf_t;
+
+/**
+ * @brief chiude una connessione e libera i suoi buffer (la close la rimuove anche dall'epoll)
+ */
+static void free_conn(connBuf_t *c){
+    close(c->fd);
+    free(c->part);
+    free(c);
+}
+
+/**
+ * @brief decodifica tutti i frame completi presenti in buf e li inserisce in l;
+ *          gli eventuali byte di un frame parziale restano in testa al buffer
+ *
+ * @param l lista in cui vengono caricati i risultati
+ * @param buf buffer contenente i frame
+ * @param len byte validi in buf (aggiornato con i byte non decodificati)
+ * @param max_path_len massima lunghezza dei path ricevuti dai Workers
+ * @param jobs job della modalita' server, a cui vanno i frame con il campo job (NULL fuori dalla modalita' server)
+ *
+ * @return 0 se tutto va bene, -1 se il buffer contiene un frame non valido
+ */
+static int decode_frames(SList *l, char *buf, size_t *len, int max_path_len, jobTable_t *jobs){
+    size_t off = 0, nres = 0, nerr = 0;
+    frameHeader_t h;
+    char path[max_path_len];
+    uint64_t start = TRACE_ON ? now_ns(CLOCK_MONOTONIC) : 0;
+
+    while(*len - off >= FRAME_HEADER_LEN){
+        if(decode_header(buf + off, &h, max_path_len) != 0){ //versione non supportata o frame corrotto
+            print_error("invalid frame (version %d) from worker, connection closed\n", (int)h.version);
+            return -1;
+        }
+        if(*len - off < FRAME_HEADER_LEN + h.path_len) //frame parziale
+            break;
+        memcpy(path, buf + off + FRAME_HEADER_LEN, h.path_len);
+        path[h.path_len] = '\0';
+        off += FRAME_HEADER_LEN + h.path_len;
+        nres++;
+        nerr += (h.status != FRAME_OK);
+
+        if(h.job != 0 && jobs){ //risultato di un job: lo riceve il client del job
+            if(job_result(jobs, h.job, path, h.result, h.status) != SV_SUCCESS)
+                print_error("result of %s for unknown job %d\n", path, (int)h.job);
+        }
+        else if(h.status == FRAME_OK){
+            CHECK_EQ_EXIT("addNode", addNode(l, path, h.result), -1,"addNode failed (alloc error)");
+            TRACE_EVENT(TR_RECEIVE, start, start, path, 0);
+        }
+        else{ //l'esito resta nella lista (per il file binario dei risultati), ma non viene stampato
+            print_error("%s: %s\n", path, (h.status == FRAME_OVERFLOW) ? "overflow" : "file error");
+            CHECK_EQ_EXIT("addNodeStatus", addNodeStatus(l, path, 0, h.status), -1,"addNodeStatus failed (alloc error)");
+        }
+    }
+
+    //una sola somma atomica per blocco di frame (i thread di ingestione decodificano in parallelo)
+    __atomic_add_fetch(&cmetrics.results, nres, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cmetrics.errors, nerr, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cmetrics.bytes, off, __ATOMIC_RELAXED);
+    if(nres > 0)
+        TRACE_EVENT(TR_DECODE, start, now_ns(CLOCK_MONOTONIC), NULL, nres);
+
+    memmove(buf, buf + off, *len - off);
+    *len -= off;
+    return 0;
+}
+
+/**
+ * @brief controlla (senza bloccarsi) se ci sono connessioni in attesa di accept su listenfd
+ */
+static int pending_connections(int listenfd){
+    struct pollfd pfd = {listenfd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+/**
+ * @brief decodifica tutti gli slot pubblicati nel ring (ogni slot contiene solo frame completi)
+ */
+static void drain_ring(SList *l, SRing_t *ring, int max_path_len){
+    char *data;
+    size_t len;
+    while((data = sringPeek(ring, &len)) != NULL){
+        decode_frames(l, data, &len, max_path_len, NULL);
+        sringRelease(ring);
+    }
+}
+
+/**
+ * @brief registra la connessione di un Worker nell'epoll del Collector oppure, in modalità -c,
+ *          la assegna a turno all'epoll di un thread di ingestione
+ *
+ * @param epfd epoll del Collector
+ * @param c connessione del Worker
+ * @param ith thread di ingestione (NULL se il Collector e' a thread singolo)
+ * @param nith numero di thread di ingestione
+ * @param next prossimo thread a cui assegnare una connessione
+ *
+ * @return 1 se registrata nell'epoll del Collector, 0 se assegnata a un thread, -1 in caso di errore
+ */
+static int register_worker(int epfd, connBuf_t *c, ingestThread_t *ith, size_t nith, size_t *next){
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    c->type = CONN_WORKER;
+    if(nith > 0){ //la connessione viene contata prima di essere visibile al thread
+        ingestThread_t *t = &ith[(*next)++ % nith];
+        __atomic_add_fetch(&t->nconns, 1, __ATOMIC_SEQ_CST);
+        if(epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1){
+            perror("epoll_ctl");
+            __atomic_sub_fetch(&t->nconns, 1, __ATOMIC_SEQ_CST);
+            return -1;
+        }
+        return 0;
+    }
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1){
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief accetta tutte le connessioni pendenti (listenfd e' non bloccante, epoll edge-triggered).
+ *          Le connessioni locali sono di Workers (vedi register_worker); quelle TCP restano nell'epoll
+ *          del Collector fino all'hello, che ne stabilisce il ruolo
+ *
+ * @param epfd epoll del Collector
+ * @param listenfd socket in ascolto
+ * @param part_len dimensione del buffer per il frame parziale di ogni connessione
+ * @param hello 1 se le connessioni devono presentarsi con un hello (socket TCP)
+ * @param ith thread di ingestione (NULL se il Collector e' a thread singolo)
+ * @param nith numero di thread di ingestione
+ * @param next prossimo thread a cui assegnare una connessione
+ *
+ * @return numero di connessioni registrate nell'epoll del Collector, -1 in caso di errore
+ */
+static int accept_conns(int epfd, int listenfd, size_t part_len, int hello, ingestThread_t *ith, size_t nith, size_t *next){
+    int n = 0;
+    while(1){
+        int connfd = accept(listenfd, (struct sockaddr *)NULL, NULL);
+        if(connfd == -1){
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return n;
+            perror("accept");
+            return -1;
+        }
+        int flags = fcntl(connfd, F_GETFL, 0);
+        connBuf_t *c = calloc(1, sizeof(connBuf_t));
+        if(flags == -1 || fcntl(connfd, F_SETFL, flags | O_NONBLOCK) == -1 || !c || !(c->part = malloc(part_len))){
+            perror("accept_conns");
+            print_error("connection refused\n");
+            if(c)
+                free(c->part);
+            free(c);
+            close(connfd);
+            continue;
+        }
+        c->fd = connfd;
+        int r;
+        if(hello){
+            struct epoll_event ev;
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = c;
+            c->type = CONN_HELLO;
+            if((r = epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &ev)) == -1)
+                perror("epoll_ctl");
+            else
+                r = 1;
+        }
+        else
+            r = register_worker(epfd, c, ith, nith, next);
+        if(r == -1){
+            free_conn(c);
+            continue;
+        }
+        n += r;
+    }
+}
+
+/**
+ * @brief legge tutto cio' che e' disponibile su una connessione con un Worker (edge-triggered: fino a EAGAIN).
+ *          Il frame parziale della lettura precedente viene ricopiato in testa al buffer condiviso,
+ *          che viene poi riempito e decodificato; l'eventuale nuovo frame parziale torna nella connessione
+ *
+ * @return 0 se la connessione resta aperta, -1 se va chiusa (EOF, errore o frame non valido)
+ */
+static int read_worker(SList *l, connBuf_t *c, char *rbuf, int max_path_len){
+    size_t len = c->len;
+    memcpy(rbuf, c->part, len);
+    while(1){
+        ssize_t r = read(c->fd, rbuf + len, _COLLECTOR_READ_LEN - len);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if(r <= 0) //EOF o errore
+            return -1;
+        len += r;
+        if(decode_frames(l, rbuf, &len, max_path_len, NULL) != 0)
+            return -1;
+    }
+    memcpy(c->part, rbuf, len);
+    c->len = len;
+    return 0;
+}
+
+/**
+ * @brief ciclo di vita di un thread di ingestione: legge e decodifica i frame delle proprie connessioni
+ *          nel proprio shard, fino alla richiesta di terminazione e alla chiusura di tutte le connessioni
+ *
+ * @param arg thread di ingestione (ingestThread_t)
+ */
+static void *ingest_thread(void *arg){
+    ingestThread_t *t = (ingestThread_t *)arg;
+    char *rbuf;
+    CHECK_EQ_EXIT("malloc", rbuf = malloc(_COLLECTOR_READ_LEN), NULL, "malloc failed\n");
+    TRACE_THREAD("ingest", -1);
+
+    struct epoll_event events[_COLLECTOR_MAX_EVENTS];
+    int stop = 0;
+    while(!stop || __atomic_load_n(&t->nconns, __ATOMIC_SEQ_CST) > 0){
+        int nfd = epoll_wait(t->epfd, events, _COLLECTOR_MAX_EVENTS, -1);
+        if(nfd == -1){
+            if(errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for(int i = 0; i < nfd; i++){
+            connBuf_t *c = events[i].data.ptr;
+            if(c == NULL){ //richiesta di terminazione: nessuna nuova connessione verra' assegnata
+                uint64_t v;
+                while(read(t->stopfd, &v, sizeof(v)) == -1 && errno == EINTR);
+                stop = 1;
+                continue;
+            }
+            //lo shard e' condiviso solo con le stampe (SIGUSR1), quindi la lock e' quasi sempre libera
+            LOCK(&t->m);
+            int r = read_worker(t->shard, c, rbuf, t->max_path_len);
+            UNLOCK(&t->m);
+            if(r == 0)
+                continue;
+            free_conn(c);
+            __atomic_sub_fetch(&t->nconns, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    free(rbuf);
+    return NULL;
+}
+
+/**
+ * @brief avvia nith thread di ingestione, ognuno con il proprio epoll e il proprio shard
+ *          (con budget di memoria budget, 0 se illimitato)
+ *
+ * @return C_SUCCESS se tutto va bene, C_FAILURE in caso di errore
+ */
+static int start_ingest_threads(ingestThread_t *ith, size_t nith, int max_path_len, size_t part_len, size_t budget){
+    for(size_t i = 0; i < nith; i++){
+        ingestThread_t *t = &ith[i];
+        t->max_path_len = max_path_len;
+        t->part_len = part_len;
+        t->nconns = 0;
+        CHECK_EQ_RETURN("initSList", t->shard = initSList(max_path_len), NULL, C_FAILURE, "initSList failed\n");
+        CHECK_EQ_RETURN("setSListBudget", setSListBudget(t->shard, budget), -1, C_FAILURE, "setSListBudget failed\n");
+        CHECK_NEQ_RETURN("pthread_mutex_init", pthread_mutex_init(&t->m, NULL), 0, C_FAILURE, "pthread_mutex_init failed\n");
+        CHECK_EQ_RETURN("epoll_create1", t->epfd = epoll_create1(EPOLL_CLOEXEC), -1, C_FAILURE, "epoll_create1 failed\n");
+        CHECK_EQ_RETURN("eventfd", t->stopfd = eventfd(0, EFD_CLOEXEC), -1, C_FAILURE, "eventfd failed\n");
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        CHECK_EQ_RETURN("epoll_ctl", epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->stopfd, &ev), -1, C_FAILURE, "epoll_ctl failed\n");
+        int err = pthread_create(&t->tid, NULL, ingest_thread, t);
+        if(err != 0){
+            errno = err;
+            perror("pthread_create");
+            print_error("pthread_create failed (ingest thread %zu)\n", i);
+            return C_FAILURE;
+        }
+    }
+    return C_SUCCESS;
+}
+
+/**
+ * @brief termina i thread di ingestione (dopo che hanno chiuso le proprie connessioni)
+ *          e sposta i loro shard in l
+ */
+static void stop_ingest_threads(SList *l, ingestThread_t *ith, size_t nith){
+    uint64_t one = 1;
+    for(size_t i = 0; i < nith; i++)
+        while(write(ith[i].stopfd, &one, sizeof(one)) == -1 && errno == EINTR);
+    for(size_t i = 0; i < nith; i++){
+        CHECK_NEQ_EXIT("pthread_join", pthread_join(ith[i].tid, NULL), 0, "pthread_join failed (ingest thread)\n");
+        mergeSList(l, ith[i].shard);
+        deleteSList(ith[i].shard);
+        pthread_mutex_destroy(&ith[i].m);
+        close(ith[i].epfd);
+        close(ith[i].stopfd);
+    }
+}
+
+/**
+ * @brief accetta un client del socket di controllo in uno degli slot liberi di ctrl (fd == -1)
+ *
+ * @param epfd epoll del Collector
+ * @param ctrlfd socket di controllo in ascolto (non bloccante)
+ * @param ctrl slot delle connessioni di controllo (_QUERY_MAX_CONNS)
+ */
+static void accept_ctrl(int epfd, int ctrlfd, connBuf_t *ctrl){
+    int fd = accept(ctrlfd, (struct sockaddr *)NULL, NULL);
+    if(fd == -1){
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            perror("accept");
+        return;
+    }
+    connBuf_t *c = NULL;
+    for(int i = 0; i < _QUERY_MAX_CONNS && !c; i++)
+        if(ctrl[i].fd == -1)
+            c = &ctrl[i];
+    if(!c || (!c->part && !(c->part = malloc(_QUERY_LINE_LEN)))){
+        print_error("control connection refused (max %d)\n", _QUERY_MAX_CONNS);
+        close(fd);
+        return;
+    }
+    //le risposte vengono inviate senza bloccare il ciclo di eventi (un client lento non ferma la raccolta)
+    int flags = fcntl(fd, F_GETFL, 0);
+    if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1){
+        perror("fcntl");
+        close(fd);
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1){
+        perror("epoll_ctl");
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    c->len = 0;
+    c->out.len = c->out.off = 0;
+    c->want_out = 0;
+}
+
+//chiude una connessione di controllo, lasciando lo slot (e i suoi buffer) per la prossima
+static void close_ctrl(connBuf_t *c){
+    close(c->fd);
+    c->fd = -1;
+}
+
+/**
+ * @brief serve un evento di un client del socket di controllo: legge le richieste, accoda le risposte a quelle complete
+ *          (che includono i risultati degli shard dei thread di ingestione) e le invia senza bloccarsi.
+ *          Finche' restano risposte da inviare il client viene atteso solo in scrittura (EPOLLOUT) e le sue
+ *          richieste non vengono lette: un client che non legge le risposte non fa crescere il buffer
+ */
+static void serve_ctrl(int epfd, SList *l, ingestThread_t *ith, size_t nith, connBuf_t *c, uint32_t events){
+    if(c->out.len == 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))){
+        ssize_t r = read(c->fd, c->part + c->len, _QUERY_LINE_LEN - c->len);
+        if(r == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if(r <= 0){
+            close_ctrl(c);
+            return;
+        }
+        c->len += r;
+    }
+
+    size_t off = 0;
+    char *nl;
+    while(c->out.len == 0 && (nl = memchr(c->part + off, '\n', c->len - off)) != NULL){
+        *nl = '\0';
+        if(nl > c->part + off && nl[-1] == '\r')
+            nl[-1] = '\0';
+        __atomic_add_fetch(&cmetrics.queries, 1, __ATOMIC_RELAXED);
+        int err;
+        if(strcmp(c->part + off, "metrics") == 0){ //metriche del Collector, nel formato del socket -M del MasterWorker
+            size_t len;
+            char *text = collector_metrics_text(&cmetrics, &len);
+            err = (!text || q_append(&c->out, text, len) != Q_SUCCESS || q_append(&c->out, "\n", 1) != Q_SUCCESS);
+            free(text);
+        }
+        else{
+            collect_shards(l, ith, nith);
+            err = (answer_query(l, c->part + off, &c->out) != Q_SUCCESS);
+        }
+        if(err){
+            close_ctrl(c);
+            return;
+        }
+        off = nl - c->part + 1;
+        if(q_flush(&c->out, c->fd) == Q_FAILURE){
+            close_ctrl(c);
+            return;
+        }
+    }
+    memmove(c->part, c->part + off, c->len - off);
+    c->len -= off;
+    if(c->out.len > 0 && q_flush(&c->out, c->fd) == Q_FAILURE){
+        close_ctrl(c);
+        return;
+    }
+    if(c->out.len == 0 && c->len == _QUERY_LINE_LEN){ //richiesta senza fine riga
+        const char *msg = "error: query too long\n\n";
+        if(q_append(&c->out, msg, strlen(msg)) == Q_SUCCESS)
+            q_flush(&c->out, c->fd); //best effort: la connessione viene chiusa
+        close_ctrl(c);
+        return;
+    }
+
+    //in attesa della scrittura finche' restano risposte da inviare, poi di nuove richieste
+    int want_out = (c->out.len > 0);
+    if(want_out != c->want_out){
+        struct epoll_event ev;
+        ev.events = want_out ? EPOLLOUT : EPOLLIN;
+        ev.data.ptr = c;
+        if(epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1){
+            perror("epoll_ctl");
+            close_ctrl(c);
+            return;
+        }
+        c->want_out = want_out;
+    }
+    //richieste gia' ricevute mentre la risposta precedente era in attesa: nessun nuovo evento EPOLLIN le segnalera'
+    if(!want_out && memchr(c->part, '\n', c->len) != NULL)
+        serve_ctrl(epfd, l, ith, nith, c, 0);
+}
+
+/**
+ * @brief legge (senza bloccarsi) i byte mancanti di un messaggio di len byte di una connessione TCP
+ *          (l'hello o un comando del Master di un nodo remoto), accumulandoli in c->part
+ *
+ * @return 1 se il messaggio e' completo, 0 se mancano ancora byte, -1 in caso di EOF o errore
+ */
+static int read_fixed(connBuf_t *c, size_t len){
+    while(c->len < len){
+        ssize_t r = read(c->fd, c->part + c->len, len - c->len);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if(r <= 0)
+            return -1;
+        c->len += r;
+    }
+    return 1;
+}
+
+/**
+ * @brief completa la registrazione di un nodo remoto: risponde all'hello del suo Master con l'identificativo
+ *          assegnato (c->node); i comandi del Master del nodo vengono poi letti senza bloccarsi (level-triggered),
+ *          accumulando quelli incompleti in c->part, cosi' un nodo lento non ferma il ciclo di eventi
+ *
+ * @param msg_len lunghezza dei comandi del Master
+ *
+ * @return 0 se tutto va bene, -1 in caso di errore
+ */
+static int register_node(int epfd, connBuf_t *c, size_t msg_len){
+    char reply[HELLO_LEN];
+    encode_hello(reply, HELLO_MASTER, c->node);
+    char *part = realloc(c->part, msg_len); //il buffer del frame parziale potrebbe essere piu' corto di un comando
+    if(part)
+        c->part = part;
+    if(!part || writen(c->fd, reply, HELLO_LEN) != 1){
+        perror("register_node");
+        print_error("registration of node %u failed\n", (unsigned)c->node);
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    c->type = CONN_NODE;
+    if(epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1){
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * @brief funzione che raccoglie i risultati dai Workers
  *
  * @param l lista in cui verranno salvati i risultati
+ * @param copts opzioni del Collector (ring, thread di ingestione, nodi remoti)
  */
 
-int receive_results(SList *l, int max_path_len, int max_comms_len, const char* sockname) {
+int receive_results(SList *l, int max_path_len, int max_comms_len, const char* sockname, const collectorOpts_t *copts) {
 
     
     if(max_path_len < _MIN_MESS_LEN || max_path_len > _MAX_MESS_LEN)
         return C_FAILURE;
-    const size_t MAX_WORKER_MESS_LEN = max_path_len + 1 + 10; //+1 term char + 10 long size
     if(max_comms_len < _MIN_MESS_LEN || max_comms_len > _MAX_MESS_LEN)
         return C_FAILURE;
     const size_t MAX_MASTER_MESS_LEN = max_comms_len;
+    //un frame parziale e' al piu' un header seguito da un path troncato
+    const size_t PART_LEN = FRAME_HEADER_LEN + max_path_len;
+    SRing_t *ring = copts->ring;
+    size_t nith = copts->nith;
+    bind_thread_clock(&cmetrics.cpu);
+    TRACE_THREAD("collector", -1);
 
-    int listenfd, fdmax = 0; 
+    int listenfd, epfd, tcpfd = -1;
 
-    char msg[MAX_WORKER_MESS_LEN];
+    char msg[MAX_MASTER_MESS_LEN];
     int end = 0;
+    int nconns = 0; //connessioni aperte con i Workers (e connessioni TCP in attesa dell'hello)
+
+    //nodi remoti (modalità -L): registrati, ancora attivi (Master connesso) e attesi prima di terminare
+    uint32_t nreg = 0;
+    size_t nopen = 0;
+
+    //buffer di lettura condiviso da tutte le connessioni (i frame parziali restano nelle singole connessioni)
+    char *rbuf;
+    CHECK_EQ_EXIT("malloc", rbuf = malloc(_COLLECTOR_READ_LEN), NULL, "malloc failed\n");
 
     struct sockaddr_un serv_addr;
     CHECK_NEQ_EXIT("memset", memset(&serv_addr, 0, sizeof(serv_addr)), &serv_addr, "memset failed\n");
@@ -92,80 +791,308 @@ int receive_results(SList *l, int max_path_len, int max_comms_len, const char* s
     SYSCALL_EXIT("bind", unused, bind(listenfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)), "bind failed\n");
     SYSCALL_EXIT("listen", unused, listen(listenfd, MAXBACKLOG), "listen failed\n");
 
-    fd_set set, tmpset;
-
-    FD_ZERO(&set);
-    FD_ZERO(&tmpset);
-
-    FD_SET(listenfd, &set);
-    fdmax = listenfd;
+    //socket TCP per i nodi remoti: le connessioni restano in coda fino all'avvio del ciclo di eventi
+    if(copts->tcp_port)
+        SYSCALL_EXIT("tcp_listen", tcpfd, tcp_listen(copts->tcp_port), "tcp_listen failed\n");
 
     //accept() chiamata bloccante che attende la connessione con il Master
     int masterfd;
     SYSCALL_EXIT("accept", masterfd, accept(listenfd, (struct sockaddr *)NULL, NULL), "accept master failed\n");
 
-    FD_SET(masterfd, &set);
+    //da qui in poi le connessioni dei Workers vengono accettate dal ciclo di eventi
+    int flags;
+    SYSCALL_EXIT("fcntl", flags, fcntl(listenfd, F_GETFL, 0), "fcntl failed\n");
+    SYSCALL_EXIT("fcntl", unused, fcntl(listenfd, F_SETFL, flags | O_NONBLOCK), "fcntl failed\n");
+    if(tcpfd != -1){
+        SYSCALL_EXIT("fcntl", flags, fcntl(tcpfd, F_GETFL, 0), "fcntl failed\n");
+        SYSCALL_EXIT("fcntl", unused, fcntl(tcpfd, F_SETFL, flags | O_NONBLOCK), "fcntl failed\n");
+    }
+
+    SYSCALL_EXIT("epoll_create1", epfd, epoll_create1(EPOLL_CLOEXEC), "epoll_create1 failed\n");
+
+    //socket in ascolto in edge-triggered; Master (messaggi di lunghezza fissa, letti uno per evento) e doorbell del ring in level-triggered
+    connBuf_t lconn = {listenfd, CONN_LISTEN, 0, NULL, 0}, mconn = {masterfd, CONN_MASTER, 0, NULL, 0};
+    connBuf_t rconn = {ring ? ring->efd : -1, CONN_RING, 0, NULL, 0}, tconn = {tcpfd, CONN_TCP_LISTEN, 0, NULL, 0};
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &lconn;
+    SYSCALL_EXIT("epoll_ctl", unused, epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev), "epoll_ctl failed\n");
+    if(tcpfd != -1){
+        ev.data.ptr = &tconn;
+        SYSCALL_EXIT("epoll_ctl", unused, epoll_ctl(epfd, EPOLL_CTL_ADD, tcpfd, &ev), "epoll_ctl failed\n");
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &mconn;
+    SYSCALL_EXIT("epoll_ctl", unused, epoll_ctl(epfd, EPOLL_CTL_ADD, masterfd, &ev), "epoll_ctl failed\n");
+    if(ring){ //il doorbell del ring viene segnalato dai Workers solo quando il Collector e' in attesa
+        ev.data.ptr = &rconn;
+        SYSCALL_EXIT("epoll_ctl", unused, epoll_ctl(epfd, EPOLL_CTL_ADD, ring->efd, &ev), "epoll_ctl failed\n");
+    }
+
+    //thread di ingestione (modalità -c): ricevono le connessioni dei Workers accettate dal Collector
+    ingestThread_t *ith = NULL;
+    size_t next = 0;
+    if(nith > 0){
+        //il budget di memoria (-m) viene diviso tra la lista del Collector e gli shard
+        size_t share = l->budget / (nith + 1);
+        if(l->budget > 0)
+            CHECK_EQ_EXIT("setSListBudget", setSListBudget(l, share > 0 ? share : 1), -1, "setSListBudget failed\n");
+        CHECK_EQ_EXIT("calloc", ith = calloc(nith, sizeof(ingestThread_t)), NULL, "calloc failed\n");
+        CHECK_EQ_EXIT("start_ingest_threads", start_ingest_threads(ith, nith, max_path_len, PART_LEN, l->budget), C_FAILURE, "start_ingest_threads failed\n");
+    }
+
+    //socket di controllo (-Q): le interrogazioni vengono servite dal ciclo di eventi, tra una lettura e l'altra
+    int ctrlfd = -1;
+    connBuf_t cconn = {-1, CONN_CTRL_LISTEN, 0, NULL, 0};
+    connBuf_t ctrl[_QUERY_MAX_CONNS];
+    for(int i = 0; i < _QUERY_MAX_CONNS; i++){
+        ctrl[i].fd = -1;
+        ctrl[i].type = CONN_CTRL;
+        ctrl[i].node = 0;
+        ctrl[i].part = NULL;
+        ctrl[i].len = 0;
+        memset(&ctrl[i].out, 0, sizeof(qOut_t));
+        ctrl[i].want_out = 0;
+    }
+    if(copts->ctrl){
+        CHECK_EQ_EXIT("setSListIndex", setSListIndex(l, 1), -1, "setSListIndex failed\n");
+        SYSCALL_EXIT("ctrl_listen", ctrlfd, ctrl_listen(copts->ctrl), "ctrl_listen of %s failed\n", copts->ctrl);
+        cconn.fd = ctrlfd;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &cconn;
+        SYSCALL_EXIT("epoll_ctl", unused, epoll_ctl(epfd, EPOLL_CTL_ADD, ctrlfd, &ev), "epoll_ctl failed\n");
+    }
+
+    //thread di stampa degli snapshot (SIGUSR1)
+    snapPrinter_t sp;
+    CHECK_EQ_EXIT("start_snap_printer", start_snap_printer(&sp, l, copts->outfd, copts->delta), C_FAILURE, "start_snap_printer failed\n");
 
-    if(masterfd > fdmax)
-        fdmax = masterfd;
+    //eventuali connessioni arrivate prima della registrazione dei socket in ascolto
+    int acc;
+    SYSCALL_EXIT("accept_conns", acc, accept_conns(epfd, listenfd, PART_LEN, 0, ith, nith, &next), "accept failed\n");
+    nconns += acc;
+    if(tcpfd != -1){
+        SYSCALL_EXIT("accept_conns", acc, accept_conns(epfd, tcpfd, PART_LEN, 1, ith, nith, &next), "accept failed\n");
+        nconns += acc;
+    }
 
+    struct epoll_event events[_COLLECTOR_MAX_EVENTS];
     int nfd;
     
-    while (!end) { //fino a quando non si chiude fd del master
-        tmpset = set;
-        if((nfd = select(fdmax + 1, &tmpset, NULL, NULL, NULL)) == -1) {
+    //termino quando il Master ha chiuso la connessione, tutti i nodi remoti attesi si sono registrati e hanno terminato
+    //e tutti i Workers hanno chiuso la propria (i Workers si connettono prima che il proprio Master chiuda,
+    //quindi controllo anche le accept pendenti)
+    while (!end || nconns > 0 || nreg < copts->nnodes || nopen > 0 || pending_connections(listenfd) || (tcpfd != -1 && pending_connections(tcpfd))) {
+        if(ring){ //svuoto il ring e mi metto in attesa sul doorbell solo se e' vuoto
+            drain_ring(l, ring, max_path_len);
+            if(sringPrepareWait(ring))
+                continue;
+        }
+        if(end && nconns == 0 && nreg >= copts->nnodes && nopen == 0){ //restano solo accept pendenti (edge-triggered: non attendo un nuovo evento)
+            SYSCALL_EXIT("accept_conns", acc, accept_conns(epfd, listenfd, PART_LEN, 0, ith, nith, &next), "accept failed\n");
+            nconns += acc;
+            if(tcpfd != -1){
+                SYSCALL_EXIT("accept_conns", acc, accept_conns(epfd, tcpfd, PART_LEN, 1, ith, nith, &next), "accept failed\n");
+                nconns += acc;
+            }
+            continue;
+        }
+        if((nfd = epoll_wait(epfd, events, _COLLECTOR_MAX_EVENTS, -1)) == -1) {
             if(errno == EINTR) {
                 continue;
             }  
-            perror("select");
+            perror("epoll_wait");
             unlink(sockname);
             return C_FAILURE;
         }
-        else {
-            for (int fd = 0; fd < fdmax + 1; fd++) {
-            
-                if(FD_ISSET(fd, &tmpset)) {
-                    long connfd;
-                    if(fd == listenfd) {  //nuova richiesta di connessione
-                        SYSCALL_RETURN("accept", connfd, accept(listenfd, (struct sockaddr *)NULL, NULL), C_FAILURE, "accept failed");
-                        FD_SET(connfd, &set); // aggiungo il descrittore al master set
-                        if (connfd > fdmax)
-                            fdmax = connfd; // ricalcolo il massimo
-                        continue;
+        //costo proporzionale ai soli descrittori pronti
+        for (int i = 0; i < nfd; i++) {
+            connBuf_t *c = events[i].data.ptr;
+            switch(c->type){
+                case CONN_LISTEN: //nuove richieste di connessione
+                case CONN_TCP_LISTEN:
+                    SYSCALL_RETURN("accept_conns", acc, accept_conns(epfd, c->fd, PART_LEN, c->type == CONN_TCP_LISTEN, ith, nith, &next), C_FAILURE, "accept failed");
+                    nconns += acc;
+                    break;
+                case CONN_RING: //doorbell: il ring viene svuotato a inizio ciclo
+                    sringWakeup(ring);
+                    break;
+                case CONN_CTRL_LISTEN: //nuovo client del socket di controllo
+                    accept_ctrl(epfd, ctrlfd, ctrl);
+                    break;
+                case CONN_CTRL: //richieste di un client del socket di controllo
+                    serve_ctrl(epfd, l, ith, nith, c, events[i].events);
+                    break;
+                case CONN_MASTER: //comunicazione da parte del Master
+                    if(readn(masterfd, msg, MAX_MASTER_MESS_LEN) <=0) {
+                        epoll_ctl(epfd, EPOLL_CTL_DEL, masterfd, NULL);
+                        close(masterfd);
+                        end = 1;
+                        break;
                     }
-                    else if(fd == masterfd) {  //comunicazione da parte del Master
-                        if(readn(fd, msg, MAX_MASTER_MESS_LEN) <=0) {
-                            FD_CLR(fd, &set);
-                            close(fd);
-                            end = 1;
-                            continue;
-                        }
 
-                        master_comms(l, &end, msg);
-                    
-                        CHECK_NEQ_RETURN("memset", memset(msg, 0, MAX_MASTER_MESS_LEN), msg, C_FAILURE, "memset failed\n");
-                    } 
-                    else { //lettura
-                        if(readn(fd, msg, MAX_WORKER_MESS_LEN)<=0) {
-                            FD_CLR(fd, &set);
-                            close(fd);
-                            continue;
+                    master_comms(l, ith, nith, &sp, &end, msg);
+                
+                    CHECK_NEQ_RETURN("memset", memset(msg, 0, MAX_MASTER_MESS_LEN), msg, C_FAILURE, "memset failed\n");
+                    break;
+                case CONN_NODE: { //comunicazione da parte del Master di un nodo remoto (la chiusura indica la fine del nodo)
+                    int r = read_fixed(c, MAX_MASTER_MESS_LEN);
+                    if(r == 0) //comando incompleto: il resto arriva con un prossimo evento
+                        break;
+                    if(r == -1) {
+                        free_conn(c);
+                        nopen--;
+                        break;
+                    }
+                    memcpy(msg, c->part, MAX_MASTER_MESS_LEN);
+                    c->len = 0;
+                    int node_end = 0; //un nodo non puo' terminare il Collector centrale
+                    master_comms(l, ith, nith, &sp, &node_end, msg);
+                    CHECK_NEQ_RETURN("memset", memset(msg, 0, MAX_MASTER_MESS_LEN), msg, C_FAILURE, "memset failed\n");
+                    break;
+                }
+                case CONN_HELLO: { //handshake di una connessione TCP
+                    int r = read_fixed(c, HELLO_LEN);
+                    if(r == 0) //hello incompleto
+                        break;
+                    uint8_t role;
+                    uint32_t id;
+                    if(r == -1 || decode_hello(c->part, &role, &id) != 0 || (role == HELLO_WORKER && (id == 0 || id > nreg))){
+                        if(r != -1)
+                            print_error("invalid hello from a node, connection closed\n");
+                        free_conn(c);
+                        nconns--;
+                        break;
+                    }
+                    c->len = 0;
+                    if(role == HELLO_MASTER){ //registro il nodo e gli comunico il suo identificativo
+                        c->node = ++nreg;
+                        nconns--;
+                        if(register_node(epfd, c, MAX_MASTER_MESS_LEN) != 0){
+                            free_conn(c);
+                            break;
                         }
-                        
-                        char * file_path;
-                        long result;
-
-                        result = strtol(msg, &file_path, 10); //divido risultato da file_path
-                        
-                        CHECK_EQ_EXIT("addNode", addNode(l, file_path, result), -1,"addNode failed (alloc error)");
-
-                        CHECK_NEQ_RETURN("memset", memset(msg, 0, MAX_WORKER_MESS_LEN), msg, C_FAILURE, "memset failed\n");
+                        nopen++;
+                        break;
                     }
+                    c->node = id;
+                    if(nith > 0){ //passo la connessione a un thread di ingestione (l'ADD segnala i dati gia' arrivati)
+                        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                        nconns--;
+                        if(register_worker(epfd, c, ith, nith, &next) == -1)
+                            free_conn(c);
+                        break;
+                    }
+                    c->type = CONN_WORKER; //edge-triggered: leggo subito i frame gia' arrivati dopo l'hello
+                    if(read_worker(l, c, rbuf, max_path_len) != 0){
+                        free_conn(c);
+                        nconns--;
+                    }
+                    break;
                 }
+                default: //lettura di tutti i frame disponibili (anche parziali)
+                    if(read_worker(l, c, rbuf, max_path_len) == 0)
+                        break;
+                    //EOF, errore o frame non valido: chiudo la connessione
+                    free_conn(c);
+                    nconns--;
             }
-        } 
+        }
     }
 
+    //il Master chiude la connessione dopo la terminazione dei Workers: gli ultimi slot sono gia' pubblicati
+    if(ring)
+        drain_ring(l, ring, max_path_len);
+
+    //gli snapshot richiesti vengono stampati prima della stampa finale
+    stop_snap_printer(&sp, l);
+
+    //nessuna nuova connessione: i thread di ingestione terminano dopo aver letto le proprie
+    if(nith > 0){
+        stop_ingest_threads(l, ith, nith);
+        free(ith);
+    }
+
+    if(ctrlfd != -1){
+        for(int i = 0; i < _QUERY_MAX_CONNS; i++){
+            if(ctrl[i].fd != -1)
+                close(ctrl[i].fd);
+            free(ctrl[i].part);
+            free(ctrl[i].out.buf);
+        }
+        close(ctrlfd);
+        unlink(copts->ctrl);
+        setSListIndex(l, 0);
+    }
+
+    free(rbuf);
+    close(epfd);
+    if(tcpfd != -1)
+        close(tcpfd);
+    close(listenfd);
     unlink(sockname);
     return C_SUCCESS;
+}
+
+/**
+ * @brief ciclo di vita del Collector thread (modalità -i): preleva dalla coda i blocchi di frame dei Workers
+ *          e i comandi del Master, fino al messaggio MQ_QUIT
+ *
+ * @param arg argomenti del Collector thread (collectorArgs_t)
+ */
+void *collector_thread(void *arg){
+    collectorArgs_t *cARGS = (collectorArgs_t *)arg;
+
+    //pinning lontano dai core dei workers (se richiesto con -a)
+    pin_outside_workers(cARGS->aff, 1);
+    bind_thread_clock(&cmetrics.cpu);
+    TRACE_THREAD("collector", -1);
+
+    snapPrinter_t sp;
+    CHECK_EQ_EXIT("start_snap_printer", start_snap_printer(&sp, cARGS->l, cARGS->outfd, cARGS->delta), C_FAILURE, "start_snap_printer failed\n");
+
+    int end = 0;
+    while(!end){
+        MQNode_t *n;
+        CHECK_EQ_RETURN("mqPopAll", n = mqPopAll(cARGS->mq), NULL, NULL, "mqPopAll failed\n");
+        while(n != NULL){
+            MQNode_t *next = n->next;
+            if(n->type == MQ_FRAMES){ //ogni blocco contiene solo frame completi
+                size_t len = n->len;
+                decode_frames(cARGS->l, n->data, &len, cARGS->max_path_len, cARGS->jobs);
+            }
+            else if(n->type == MQ_CMD)
+                master_comms(cARGS->l, NULL, 0, &sp, &end, n->data);
+            else //MQ_QUIT: i Workers hanno gia' terminato, non arrivano altri risultati
+                end = 1;
+            free(n);
+            n = next;
+        }
+    }
+    stop_snap_printer(&sp, cARGS->l);
+    close_thread_clock(&cmetrics.cpu);
+    return NULL;
+}
+
+/**
+ * @brief avvia il Collector thread con i segnali mascherati (vengono gestiti dal Master)
+ *
+ * @param tid identificatore del thread avviato
+ * @param cARGS argomenti del Collector thread
+ *
+ * @return C_SUCCESS se tutto va bene, C_FAILURE in caso di errore
+ */
+int start_collector_thread(pthread_t *tid, collectorArgs_t *cARGS){
+    sigset_t mask, oldmask;
+    CHECK_EQ_RETURN("sigfillset", sigfillset(&mask), -1, C_FAILURE, "sigfillset failed\n");
+    CHECK_NEQ_RETURN("pthread_sigmask", pthread_sigmask(SIG_BLOCK, &mask, &oldmask), 0, C_FAILURE, "pthread_sigmask failed\n");
+    int err = pthread_create(tid, NULL, collector_thread, cARGS);
+    CHECK_NEQ_RETURN("pthread_sigmask", pthread_sigmask(SIG_SETMASK, &oldmask, NULL), 0, C_FAILURE, "pthread_sigmask failed\n");
+    if(err != 0){
+        errno = err;
+        perror("pthread_create");
+        print_error("pthread_create failed (Collector)\n");
+        return C_FAILURE;
+    }
+    return C_SUCCESS;
 }
\ No newline at end of file
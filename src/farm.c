@@ -7,12 +7,20 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 
 #include <master.h>
 #include <collector.h>
 #include <conc_queue.h>
 #include <dyn_array.h>
 #include <util.h>
+#include <affinity.h>
+#include <watcher.h>
+#include <shm_ring.h>
+#include <proto.h>
+#include <net.h>
+#include <res_file.h>
+#include <trace.h>
 
 #define F_SUCCESS 0
 #define F_FAILURE -1
@@ -30,54 +38,218 @@
  * @brief programma farm
  */
 
+/**
+ * @brief apre il file su cui il Collector stampa i risultati (-o), troncandolo
+ *
+ * @param outfile nome del file (stringa vuota per stdout)
+ *
+ * @return file descriptor del file (STDOUT_FILENO senza -o), -1 in caso di errore
+ */
+static int open_output(const char *outfile){
+    if(outfile[0] == '\0')
+        return STDOUT_FILENO;
+    return open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+/**
+ * @brief scrive i risultati finali nel file binario indicizzato (-B), se richiesto
+ *
+ * @param l lista dei risultati
+ * @param binfile nome del file (stringa vuota se non richiesto)
+ *
+ * @return F_SUCCESS se tutto va bene, F_FAILURE in caso di errore
+ */
+static int write_binary(SList *l, const char *binfile){
+    if(binfile[0] == '\0')
+        return F_SUCCESS;
+    int fd;
+    CHECK_EQ_RETURN("open", fd = open(binfile, O_WRONLY | O_CREAT | O_TRUNC, 0644), -1, F_FAILURE, "cannot open result file %s\n", binfile);
+    if(writeResultFile(l, fd) != RF_SUCCESS){
+        perror("writeResultFile");
+        print_error("cannot write result file %s\n", binfile);
+        close(fd);
+        return F_FAILURE;
+    }
+    return (close(fd) == 0) ? F_SUCCESS : F_FAILURE;
+}
+
 int main(int argc, char **argv){
 
-    //fork con avvio collector
-    int collector_id;
-    SYSCALL_RETURN("fork", collector_id, fork(), M_FAILURE, "fork failed");
+    //dichiaro e inizializzo (con valore di default) gli argomenti
+    size_t nthread = _DEFAULT_NTHREAD_VALUE;
+    size_t qlen = _DEFAULT_QLEN_VALUE;
+    size_t delay = _DEFAULT_DELAY_VALUE; 
 
-	if (collector_id != 0){ // master branch:
-        //gestione segnali
-        handle_master_signals();
+    int argc_index = 0; // conterrà optind
+
+    DArray *dirs;
+    //array dinamico contenente -d args fino a optind
+    CHECK_EQ_EXIT("initDArray", dirs = initDArray(DARRAY_INIT_SIZE, MAX_PATH_LEN), NULL, "initDArray failed\n");
+
+    farmOpts_t opts;
+    CHECK_NEQ_RETURN("memset", memset(&opts, 0, sizeof(farmOpts_t)), &opts, F_FAILURE, "memset failed\n");
+    opts.batch = _DEFAULT_BATCH_VALUE;
+    opts.latency = _DEFAULT_LATENCY_VALUE;
+    opts.cthreads = _DEFAULT_CTHREADS_VALUE;
+    opts.nnodes = _DEFAULT_NNODES_VALUE;
+    opts.membudget = _DEFAULT_MEMBUDGET_VALUE;
+
+    //parsing argomenti (prima della fork, cosi' anche il Collector conosce le opzioni)
+    if(parse_first_args(argc, argv, &nthread, &qlen, &delay, &argc_index, dirs, &opts) != M_SUCCESS)
+        return F_FAILURE;
+
+    //trace del ciclo di vita dei file (-T, solo con make tracefarm): attivato prima della fork, vale anche per il Collector
+    if(opts.trace[0] != '\0' && TRACE_INIT(opts.trace) != TR_SUCCESS){
+        perror("trace_init");
+        print_error("trace %s not written (tracing requires make tracefarm)\n", opts.trace);
+    }
+
+    //piano di affinity dei workers (le cpu rimaste libere vanno a Master e Collector)
+    affinity_t aff;
+    if(init_affinity(&aff, opts.affinity, nthread) != A_SUCCESS){
+        print_error("affinity policy %s not applied\n", opts.affinity);
+        init_affinity(&aff, NULL, nthread);
+    }
+
+    //modalità server (-S): i risultati di ogni job vengono smistati dal Collector thread (server.h)
+    if(opts.server[0] != '\0'){
+        if(opts.remote[0] != '\0' || opts.watch)
+            print_error("server mode (-S) ignores options -R and -w\n");
+        opts.remote[0] = '\0';
+        opts.watch = 0;
+        opts.inproc = 1;
+        opts.shm = 0;
+    }
+
+    //nodo remoto (-R): nessun Collector locale, Master e Workers inviano al Collector centrale via TCP
+    int remote = (opts.remote[0] != '\0');
+    if(remote)
+        opts.inproc = opts.shm = 0;
 
-        //dichiaro e inizializzo (con valore di default) gli argomenti
-        size_t nthread = _DEFAULT_NTHREAD_VALUE;
-        size_t qlen = _DEFAULT_QLEN_VALUE;
-        size_t delay = _DEFAULT_DELAY_VALUE; 
+    //ring condiviso tra Workers e Collector (modalità -s): va creato prima della fork;
+    //se non e' disponibile i risultati viaggiano sui socket
+    SRing_t *ring = NULL;
+    if(opts.shm && !opts.inproc){
+        if(SRING_DEFAULT_SLOT_SIZE < FRAME_HEADER_LEN + MAX_PATH_LEN || (ring = initSRing(SRING_DEFAULT_SLOTS, SRING_DEFAULT_SLOT_SIZE)) == NULL)
+            print_error("shared-memory ring not available, falling back to sockets\n");
+    }
 
-        int argc_index = 0; // conterrà optind
+    //fork con avvio collector (in modalità -i il Collector e' invece un thread del MasterWorker)
+    int collector_id = 0;
+    if(!opts.inproc && !remote)
+        SYSCALL_RETURN("fork", collector_id, fork(), M_FAILURE, "fork failed");
 
-        DArray *dirs;
-        //array dinamico contenente -d args fino a optind
-        CHECK_EQ_EXIT("initDArray", dirs = initDArray(DARRAY_INIT_SIZE, MAX_PATH_LEN), NULL, "initDArray failed\n");
+	if (opts.inproc || remote || collector_id != 0){ // master branch:
+        //gestione segnali
+        handle_master_signals();
 
-        //parsing argomenti
-        if(parse_first_args(argc, argv, &nthread, &qlen, &delay, &argc_index, dirs) != M_SUCCESS)
-            return F_FAILURE;
+        //pinning del Master lontano dai core dei workers
+        pin_outside_workers(&aff, 0);
 
         //dichiaro e inizializzo coda concorrente
         BQueue_t *q;
         CHECK_EQ_EXIT("initBQueue", q = initBQueue(qlen, MAX_PATH_LEN), NULL, "initBQueue failed\n");
 
-        //connetto il Master al Collector
-        int collectorfd;
-        CHECK_EQ_RETURN("connect_master", collectorfd = connect_master(SOCKNAME, RETRY_TIME), M_FAILURE, M_FAILURE, "connect_master failed\n");
+        int collectorfd = -1;
+        uint32_t node_id = 0;
+        MQueue_t *mq = NULL;
+        SList *l = NULL;
+        pthread_t collector_tid;
+        collectorArgs_t cARGS;
+        jobTable_t *jobs = NULL;
+        if(opts.server[0] != '\0')
+            CHECK_EQ_EXIT("init_jobs", jobs = init_jobs(MAX_PATH_LEN), NULL, "init_jobs failed\n");
+        if(opts.inproc){ //avvio il Collector thread, alimentato dalla coda mq
+            CHECK_EQ_EXIT("initMQueue", mq = initMQueue(), NULL, "initMQueue failed\n");
+            CHECK_EQ_EXIT("initSList", l = initSList(MAX_PATH_LEN), NULL, "initSList failed\n");
+            CHECK_EQ_EXIT("setSListBudget", setSListBudget(l, opts.membudget * 1024), -1, "setSListBudget failed\n");
+            if(opts.watch) //un file riscritto sostituisce il proprio risultato
+                CHECK_EQ_EXIT("setSListReplace", setSListReplace(l, 1), -1, "setSListReplace failed\n");
+            CHECK_EQ_EXIT("open", cARGS.outfd = open_output(opts.outfile), -1, "cannot open output file %s\n", opts.outfile);
+            cARGS.l = l;
+            cARGS.mq = mq;
+            cARGS.max_path_len = MAX_PATH_LEN;
+            cARGS.aff = &aff;
+            cARGS.delta = opts.delta;
+            cARGS.jobs = jobs;
+            CHECK_EQ_RETURN("start_collector_thread", start_collector_thread(&collector_tid, &cARGS), C_FAILURE, M_FAILURE, "start_collector_thread failed\n");
+        }
+        else if(remote){ //registro il nodo presso il Collector centrale, che gli assegna un identificativo
+            CHECK_EQ_RETURN("tcp_connect", collectorfd = tcp_connect(opts.remote, RETRY_TIME), N_FAILURE, M_FAILURE, "tcp_connect to %s failed\n", opts.remote);
+            CHECK_NEQ_RETURN("node_hello", node_hello(collectorfd, HELLO_MASTER, &node_id), N_SUCCESS, M_FAILURE, "node_hello failed\n");
+        }
+        else //connetto il Master al Collector
+            CHECK_EQ_RETURN("connect_master", collectorfd = connect_master(SOCKNAME, RETRY_TIME), M_FAILURE, M_FAILURE, "connect_master failed\n");
     
         //inizializzo argomenti master
         masterArgs mARGS;
         CHECK_NEQ_RETURN("memset", memset(&mARGS, 0, sizeof(masterArgs)), &mARGS, M_FAILURE, "memset failed\n");
         CHECK_EQ_RETURN("init_master_args", init_master_args(&mARGS, q, nthread, collectorfd, SOCKNAME, EXT, delay, MAX_PATH_LEN, MAX_MCOMMS_LEN), M_FAILURE, M_FAILURE, 
             "error in consts defined in farm.c; check master interface to see possible values for cons\n");
+        mARGS.aff = &aff;
+        mARGS.mq = mq;
+        mARGS.ring = ring;
+        if(ring && collector_id != 0) //i Workers smettono di attendere il ring se il Collector processo termina
+            sringSetConsumer(ring, collector_id);
+        mARGS.remote = remote ? opts.remote : NULL;
+        mARGS.node_id = node_id;
+        mARGS.batch = opts.batch;
+        mARGS.latency = opts.latency;
+        mARGS.server = jobs ? opts.server : NULL;
+        mARGS.jobs = jobs;
+
+        //metriche di Master e Workers (e del Collector thread in modalità -i), stampate con SIGUSR2 o lette dal socket -M
+        metrics_t *metrics;
+        CHECK_EQ_EXIT("init_metrics", metrics = init_metrics(nthread), NULL, "init_metrics failed\n");
+        metrics->collector = opts.inproc ? get_collector_metrics() : NULL;
+        mARGS.metrics = metrics;
+        mARGS.metrics_sock = (opts.metrics[0] != '\0') ? opts.metrics : NULL;
+
+        //modalità watch: il watcher viene popolato da file_seeker durante la scansione iniziale
+        watcher_t w;
+        if(opts.watch){
+            CHECK_EQ_RETURN("init_watcher", init_watcher(&w, MAX_PATH_LEN), W_FAILURE, M_FAILURE, "init_watcher failed\n");
+            mARGS.w = &w;
+        }
 
         //richiamo la funzione di inserimento files in BQueue_t q
         CHECK_EQ_RETURN("init_master_args", execute_master(mARGS, argc, argv, argc_index, dirs), M_FAILURE, M_FAILURE, 
             "execute_master failed\n");
 
-        //chiudo la connessione al Collector
-        close(collectorfd);
+        if(opts.inproc){ //tutti i Workers hanno terminato: fermo il Collector thread e stampo i risultati
+            MQNode_t *quit;
+            CHECK_EQ_EXIT("allocMQNode", quit = allocMQNode(MQ_QUIT, 0), NULL, "allocMQNode failed\n");
+            CHECK_NEQ_EXIT("mqPush", mqPush(mq, quit), 0, "mqPush failed\n");
+            CHECK_NEQ_EXIT("pthread_join", pthread_join(collector_tid, NULL), 0, "pthread_join failed (Collector)\n");
+            CHECK_EQ_EXIT("printSList", printSList(l, cARGS.outfd), -1, "printSList failed\n");
+            if(cARGS.outfd != STDOUT_FILENO)
+                close(cARGS.outfd);
+            write_binary(l, opts.binfile);
+            deleteSList(l);
+            deleteMQueue(mq);
+            if(jobs)
+                delete_jobs(jobs);
+        }
+        else //chiudo la connessione al Collector
+            close(collectorfd);
+
+        if(ring)
+            deleteSRing(ring);
+
+        delete_metrics(metrics);
+
+        if(opts.watch)
+            delete_watcher(&w);
 
         //cancello coda
         deleteBQueue(q);
+        delete_affinity(&aff);
+
+        if(opts.inproc || remote){ //nessun Collector processo da attendere (i risultati dei nodi li stampa il Collector centrale)
+            if(TRACE_WRITE(0) != TR_SUCCESS)
+                print_error("cannot write trace %s\n", opts.trace);
+            return M_SUCCESS;
+        }
 
         //attendo che Collector termini
         int status;
@@ -88,26 +260,60 @@ int main(int argc, char **argv){
             fflush(stdout);
         }
 
+        //il Collector ha scritto i propri eventi: li accodo al trace
+        if(TRACE_WRITE(0) != TR_SUCCESS)
+            print_error("cannot write trace %s\n", opts.trace);
+
         return M_SUCCESS;
     }
     else{ // collector branch:
         //gestisco i segnali
         handle_collector_signals();
 
+        //il Collector non usa le directories parsate dal Master
+        deleteDArray(dirs);
+
+        //pinning del Collector lontano dai core dei workers (e dal Master, se possibile)
+        pin_outside_workers(&aff, 1);
+        delete_affinity(&aff);
+
         //inizializzo lista
         SList *l;
         CHECK_EQ_EXIT("initSList", l = initSList(MAX_PATH_LEN), NULL, "initSList failed\n");
+        //oltre il budget (-m) i risultati vengono scritti su disco in run ordinate, fuse al momento della stampa
+        CHECK_EQ_EXIT("setSListBudget", setSListBudget(l, opts.membudget * 1024), -1, "setSListBudget failed\n");
+        //in modalità watch un file riscritto (o ricreato) sostituisce il proprio risultato
+        if(opts.watch)
+            CHECK_EQ_EXIT("setSListReplace", setSListReplace(l, 1), -1, "setSListReplace failed\n");
+
+        //opzioni del Collector: ring, thread di ingestione e nodi remoti (modalità -L)
+        collectorOpts_t copts;
+        copts.ring = ring;
+        copts.nith = opts.cthreads;
+        copts.tcp_port = (opts.tcp_port[0] != '\0') ? opts.tcp_port : NULL;
+        copts.nnodes = copts.tcp_port ? opts.nnodes : 0;
+        copts.delta = opts.delta;
+        copts.ctrl = (opts.ctrl[0] != '\0') ? opts.ctrl : NULL;
+        CHECK_EQ_EXIT("open", copts.outfd = open_output(opts.outfile), -1, "cannot open output file %s\n", opts.outfile);
 
         //la carico con i risultati ricevuti dai Workers
-        CHECK_EQ_RETURN("receive_results", receive_results(l, MAX_PATH_LEN, MAX_MCOMMS_LEN, SOCKNAME), C_FAILURE, C_SUCCESS, 
+        CHECK_EQ_RETURN("receive_results", receive_results(l, MAX_PATH_LEN, MAX_MCOMMS_LEN, SOCKNAME, &copts), C_FAILURE, C_SUCCESS, 
             "receive_results failed\n");
+        if(ring)
+            deleteSRing(ring);
 
         //stampo la lista
-        printSList(l); 
+        CHECK_EQ_EXIT("printSList", printSList(l, copts.outfd), -1, "printSList failed\n");
+        if(copts.outfd != STDOUT_FILENO)
+            close(copts.outfd);
+        write_binary(l, opts.binfile);
 
         //e infine la cancello
         deleteSList(l);
 
+        if(TRACE_WRITE(1) != TR_SUCCESS)
+            print_error("cannot write trace %s%s\n", opts.trace, _TRACE_COLLECTOR_SUFFIX);
+
         return C_SUCCESS;
     }
 }
\ No newline at end of file
@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <compact_file.h>
+
+/**
+ * @file farmconv.c
+ * @brief Convertitore tra i file di input grezzi di farm (array di long) ed il formato compatto (compact_file.h).
+ *          Senza opzioni sceglie la codifica piu' piccola tra gli elementi della minima larghezza che rappresenta
+ *          tutti i valori e le differenze in varint; -w (elementi di width byte) e -e la impongono.
+ *          Con -r riconverte un file compatto in grezzo.
+ *          Stampa su stderr la codifica scelta e le dimensioni.
+ *
+ *          uso: ./farmconv [-w 1|2|4|8] [-e plain|delta] [-r] <input> <output>
+ */
+
+/**
+ * @brief legge tutto il file path in un buffer allocato (lungo un numero intero di long)
+ */
+static void *read_file(const char *path, size_t *len){
+    int fd = open(path, O_RDONLY);
+    if(fd == -1){
+        perror("open");
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == -1){
+        perror("fstat");
+        close(fd);
+        return NULL;
+    }
+    char *buf = malloc((st.st_size / sizeof(long) + 1) * sizeof(long));
+    if(!buf){
+        perror("malloc");
+        close(fd);
+        return NULL;
+    }
+    size_t done = 0;
+    while(done < (size_t)st.st_size){
+        ssize_t r = read(fd, buf + done, st.st_size - done);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r <= 0){
+            perror("read");
+            free(buf);
+            close(fd);
+            return NULL;
+        }
+        done += r;
+    }
+    close(fd);
+    *len = done;
+    return buf;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "usage: %s [-w 1|2|4|8] [-e plain|delta] [-r] <input> <output>\n", prog);
+}
+
+int main(int argc, char **argv){
+    int width = 0, encoding = -1, reverse = 0, opt;
+    while((opt = getopt(argc, argv, "w:e:r")) != -1){
+        switch(opt){
+            case 'w': width = atoi(optarg); break;
+            case 'e': encoding = (strcmp(optarg, "plain") == 0) ? CF_PLAIN : (strcmp(optarg, "delta") == 0) ? CF_DELTA : -2; break;
+            case 'r': reverse = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(argc - optind != 2 || encoding == -2 || (width != 0 && width != 1 && width != 2 && width != 4 && width != 8)){
+        usage(argv[0]);
+        return 1;
+    }
+    const char *in = argv[optind], *out = argv[optind + 1];
+
+    size_t len;
+    long *data = read_file(in, &len);
+    if(!data)
+        return 1;
+    long *v = data;
+    size_t n = len / sizeof(long);
+    if(cfIsCompact(data, len)){
+        long count = cfCount(data, len);
+        if(count < 0 || !(v = malloc((count ? count : 1) * sizeof(long))) || cfDecode(data, len, v) != CF_SUCCESS){
+            fprintf(stderr, "farmconv: invalid compact file %s\n", in);
+            return 1;
+        }
+        n = count;
+    }
+    else if(reverse){
+        fprintf(stderr, "farmconv: %s is not a compact file\n", in);
+        return 1;
+    }
+
+    int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        perror("open");
+        return 1;
+    }
+    int err = 0;
+    size_t out_len;
+    if(reverse){
+        out_len = n * sizeof(long);
+        for(size_t done = 0; done < out_len && !err; ){
+            ssize_t w = write(fd, (char *)v + done, out_len - done);
+            if(w == -1 && errno == EINTR)
+                continue;
+            if(w == -1)
+                err = 1;
+            else
+                done += w;
+        }
+        fprintf(stderr, "farmconv: %s: %zu elements, raw %zu bytes\n", out, n, out_len);
+    }
+    else{
+        int min_width = cfMinWidth(v, n);
+        if(width != 0 && width < min_width){
+            fprintf(stderr, "farmconv: %s needs %d bytes per element\n", in, min_width);
+            return 1;
+        }
+        if(encoding == -1 && width != 0) //larghezza imposta: elementi di width byte
+            encoding = CF_PLAIN;
+        if(width == 0)
+            width = min_width;
+        if(encoding == -1) //la codifica piu' piccola
+            encoding = (cfSize(v, n, 0, CF_DELTA) < cfSize(v, n, width, CF_PLAIN)) ? CF_DELTA : CF_PLAIN;
+        out_len = cfSize(v, n, width, encoding);
+        err = cfWrite(fd, v, n, width, encoding) != CF_SUCCESS;
+        if(encoding == CF_PLAIN)
+            fprintf(stderr, "farmconv: %s: %zu elements, plain %d bytes, %zu bytes (raw %zu, %.2fx)\n",
+                out, n, width, out_len, n * sizeof(long), (double)n * sizeof(long) / out_len);
+        else
+            fprintf(stderr, "farmconv: %s: %zu elements, delta varint, %zu bytes (raw %zu, %.2fx)\n",
+                out, n, out_len, n * sizeof(long), (double)n * sizeof(long) / out_len);
+    }
+    if(close(fd) != 0 || err){
+        perror("write");
+        return 1;
+    }
+    if(v != data)
+        free(v);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <pack_file.h>
+
+/**
+ * @file farmpack.c
+ * @brief Packer degli archivi di input di farm (pack_file.h): copia in un solo file .fpk i file .dat passati come
+ *          argomenti e quelli delle directory passate con -d (visitate ricorsivamente come fa il Master).
+ *          Il nome logico di ogni entry e' il path che farm stamperebbe per il file (file come passato, directory/nome):
+ *          farm sull'archivio stampa gli stessi risultati che sui file originali.
+ *          Stampa su stderr il numero di entry e la dimensione dell'archivio.
+ *
+ *          uso: ./farmpack <archivio.fpk> {<file.dat> | -d <directory>}...
+ */
+
+#define MAX_PATH_LEN 255
+
+/** Elenco dei file da copiare nell'archivio
+ *
+ */
+typedef struct file_list
+{
+    char **paths;
+    size_t n;
+    size_t cap;
+} FileList;
+
+static int add_file(FileList *l, const char *path){
+    if(l->n == l->cap){
+        size_t cap = l->cap ? 2 * l->cap : 1024;
+        char **paths = realloc(l->paths, cap * sizeof(char *));
+        if(!paths){
+            perror("realloc");
+            return -1;
+        }
+        l->paths = paths;
+        l->cap = cap;
+    }
+    size_t len = strlen(path);
+    if(!(l->paths[l->n] = malloc(len + 1))){
+        perror("malloc");
+        return -1;
+    }
+    memcpy(l->paths[l->n++], path, len + 1);
+    return 0;
+}
+
+//file .dat (come quelli accettati dal Master)
+static int is_dat(const char *name){
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".dat") == 0;
+}
+
+/**
+ * @brief aggiunge ad l i file .dat della directory basepath e delle sue sottodirectory
+ */
+static int add_dir(FileList *l, const char *basepath){
+    DIR *dir = opendir(basepath);
+    if(!dir){
+        fprintf(stderr, "farmpack: opendir of %s failed: %s\n", basepath, strerror(errno));
+        return -1;
+    }
+    int err = 0;
+    struct dirent *dp;
+    while(!err && (errno = 0, dp = readdir(dir)) != NULL){
+        if(strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+            continue;
+        char path[MAX_PATH_LEN];
+        if(snprintf(path, sizeof(path), "%s/%s", basepath, dp->d_name) >= (int)sizeof(path)){
+            fprintf(stderr, "farmpack: file or sub-directory %s/%s is too long\n", basepath, dp->d_name);
+            continue;
+        }
+        struct stat st;
+        if(stat(path, &st) == -1){
+            fprintf(stderr, "farmpack: stat of %s failed: %s\n", path, strerror(errno));
+            continue;
+        }
+        if(S_ISDIR(st.st_mode))
+            err = add_dir(l, path);
+        else if(S_ISREG(st.st_mode) && is_dat(dp->d_name))
+            err = add_file(l, path);
+    }
+    if(!err && errno != 0){
+        perror("readdir");
+        err = -1;
+    }
+    closedir(dir);
+    return err;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "usage: %s <archive.fpk> {<file.dat> | -d <directory>}...\n", prog);
+}
+
+int main(int argc, char **argv){
+    if(argc < 3){
+        usage(argv[0]);
+        return 1;
+    }
+    FileList l = {NULL, 0, 0};
+    for(int i = 2; i < argc; i++){
+        int err;
+        if(strcmp(argv[i], "-d") == 0){
+            if(++i == argc){
+                usage(argv[0]);
+                return 1;
+            }
+            err = add_dir(&l, argv[i]);
+        }
+        else if(strlen(argv[i]) >= MAX_PATH_LEN){
+            fprintf(stderr, "farmpack: file %s is too long\n", argv[i]);
+            err = -1;
+        }
+        else
+            err = add_file(&l, argv[i]);
+        if(err)
+            return 1;
+    }
+
+    int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        perror("open");
+        return 1;
+    }
+    //i nomi logici sono i path stessi
+    int err = pkWrite(fd, l.paths, l.paths, l.n, MAX_PATH_LEN) != PK_SUCCESS;
+    if(err)
+        perror("pkWrite");
+    off_t size = lseek(fd, 0, SEEK_END);
+    if(close(fd) != 0 && !err){
+        perror("close");
+        err = 1;
+    }
+    if(!err)
+        fprintf(stderr, "farmpack: %s: %zu entries, %lld bytes\n", argv[1], l.n, (long long)size);
+
+    for(size_t i = 0; i < l.n; i++)
+        free(l.paths[i]);
+    free(l.paths);
+    return err;
+}
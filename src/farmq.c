@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <conn.h>
+#include <query.h>
+#include <server.h>
+
+/**
+ * @file farmq.c
+ * @brief Client del socket di controllo del Collector (-Q), delle metriche (-M) e della modalita' server (-S):
+ *          invia una richiesta (gli argomenti separati da spazi) e stampa la risposta, fino alla riga vuota che la
+ *          termina (protocolli descritti in query.h e server.h).
+ *          Exit status 1 se la risposta e' "not found" o contiene un errore.
+ *
+ *          uso: ./farmq <socket> <richiesta...>   (es. ./farmq ./farm_ctrl.sck pct 99)
+ */
+
+int main(int argc, char **argv){
+    if(argc < 3){
+        fprintf(stderr, "usage: %s <socket> count | path <path> | rank <k> | pct <p> | above <v> | top [k] | metrics | run <arg>...\n", argv[0]);
+        return 2;
+    }
+
+    static char req[_SERVER_LINE_LEN]; //le richieste run possono elencare molti file
+    size_t len = 0;
+    for(int i = 2; i < argc; i++){
+        int n = snprintf(req + len, sizeof(req) - len, (i > 2) ? " %s" : "%s", argv[i]);
+        if(n < 0 || (size_t)n >= sizeof(req) - len){
+            fprintf(stderr, "%s: query too long\n", argv[0]);
+            return 2;
+        }
+        len += n;
+    }
+    req[len++] = '\n';
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, argv[1], UNIX_PATH_MAX - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1){
+        perror("connect");
+        fprintf(stderr, "%s: cannot connect to %s\n", argv[0], argv[1]);
+        return 2;
+    }
+    if(writen(fd, req, len) != 1){
+        perror("write");
+        close(fd);
+        return 2;
+    }
+
+    //la risposta termina con una riga vuota
+    char buf[4096];
+    char last[2] = {0, 0}, line[16] = {0};
+    size_t col = 0, nlines = 0;
+    int notfound = 0, err = 0;
+    ssize_t r;
+    int end = 0;
+    while(!end && (r = read(fd, buf, sizeof(buf))) > 0){
+        for(ssize_t i = 0; i < r && !end; i++){
+            if(col < sizeof(line) - 1)
+                line[col] = buf[i];
+            col++;
+            if(buf[i] == '\n'){ //controllo l'inizio di ogni riga
+                notfound |= (nlines++ == 0 && strncmp(line, "not found", 9) == 0);
+                err |= (strncmp(line, "error", 5) == 0);
+                memset(line, 0, sizeof(line));
+                col = 0;
+            }
+            end = (buf[i] == '\n' && last[1] == '\n');
+            last[0] = last[1];
+            last[1] = buf[i];
+            if(!end)
+                putchar(buf[i]);
+        }
+    }
+    close(fd);
+    if(!end){
+        fprintf(stderr, "%s: incomplete reply\n", argv[0]);
+        return 2;
+    }
+    return (notfound || err) ? 1 : 0;
+}
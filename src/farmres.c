@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <res_file.h>
+#include <proto.h>
+
+/**
+ * @file farmres.c
+ * @brief Lettore del file binario dei risultati scritto dal Collector (-B).
+ *          Senza opzioni stampa i risultati validi come farm ("risultato path", in ordine);
+ *          -p cerca un path con l'indice hash, -r stampa il record di un rank, -v il primo rank di un risultato valido >= valore
+ *          (i record con errori vengono saltati).
+ *          I record vengono stampati come "rank risultato stato path".
+ *
+ *          uso: ./farmres <file> [-p <path>] [-r <rank>] [-v <valore>]
+ */
+
+static const char *status_name(uint8_t status){
+    switch(status){
+        case FRAME_OK: return "ok";
+        case FRAME_OVERFLOW: return "overflow";
+        case FRAME_FILE_ERROR: return "file_error";
+        default: return "unknown";
+    }
+}
+
+static int print_record(const RFile_t *rf, uint64_t rank){
+    const rfRecord_t *r = rfByRank(rf, rank);
+    if(!r){
+        printf("not found\n");
+        return 1;
+    }
+    printf("%" PRIu64 " %" PRId64 " %s %s\n", rank, r->result, status_name(r->status), rfPath(rf, r));
+    return 0;
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s <file> [-p <path>] [-r <rank>] [-v <value>]\n", argv[0]);
+        return 2;
+    }
+
+    RFile_t *rf = openResultFile(argv[1]);
+    if(!rf){
+        perror("openResultFile");
+        fprintf(stderr, "%s: cannot open result file %s\n", argv[0], argv[1]);
+        return 2;
+    }
+
+    int opt, ret = 0, query = 0;
+    optind = 2;
+    while((opt = getopt(argc, argv, "p:r:v:")) != -1){
+        query = 1;
+        switch(opt){
+            case 'p':{
+                long rank = rfFindPath(rf, optarg);
+                ret |= (rank < 0) ? (printf("not found\n"), 1) : print_record(rf, rank);
+                break;
+            }
+            case 'r':
+                ret |= print_record(rf, strtoull(optarg, NULL, 10));
+                break;
+            case 'v':
+                ret |= print_record(rf, rfLowerBound(rf, strtoll(optarg, NULL, 10)));
+                break;
+            default:
+                fprintf(stderr, "usage: %s <file> [-p <path>] [-r <rank>] [-v <value>]\n", argv[0]);
+                closeResultFile(rf);
+                return 2;
+        }
+    }
+
+    if(!query){ //stampa come farm
+        for(uint64_t i = 0; i < rf->h->nrecords; i++)
+            if(rf->rec[i].status == FRAME_OK)
+                printf("%" PRId64 " %s\n", rf->rec[i].result, rfPath(rf, &rf->rec[i]));
+    }
+
+    closeResultFile(rf);
+    return ret;
+}
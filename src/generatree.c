@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/**
+ * @file generatree.c
+ * @brief Generatore parallelo di alberi di file per farm: n file distribuiti (round-robin) sulle directory di un albero
+ *          completo di profondita' depth e fan-out fanout sotto root, con dimensione estratta da una distribuzione
+ *          (in byte, arrotondata a multipli di sizeof(long)):
+ *              fixed:B                 tutti i file lunghi B
+ *              uniform:MIN:MAX         uniforme in [MIN, MAX]
+ *              lognormal:MEDIAN:SIGMA  log-normale di mediana MEDIAN
+ *              zipf:S:MAX              legge di potenza di esponente S su [8, MAX] (pochi file grandi, molti piccoli)
+ *          Una frazione dei file ha un'estensione diversa da .dat (ignorati da farm) ed una frazione va in overflow.
+ *          Ogni file dipende solo dal seme e dal proprio indice (generatore counter-based, senza dipendenze tra
+ *          elementi: il ciclo di generazione e somma e' vettorizzabile), quindi il risultato non dipende dal numero di thread.
+ *          Il manifest contiene i risultati attesi dei file che farm stampa, nel formato di farm ("risultato path", con i path
+ *          come li costruisce farm -d root), ordinati per risultato e path: si confronta con
+ *          ./farm -d root | LC_ALL=C sort -k1,1n -k2,2 | diff - manifest
+ *          (con -O 0: in farm il Worker che rileva un overflow termina, quindi i file in overflow servono a provare
+ *          la gestione degli errori e con -O > 0 farm non stampa tutti i risultati del manifest).
+ *
+ *          uso: ./generatree -d root [-n file] [-s dimensione] [-D profondita'] [-F fan-out] [-x frazione non .dat]
+ *                  [-O frazione overflow] [-j thread] [-S seme] [-m manifest]
+ *              default: -n 1000 -s uniform:8:4096 -D 2 -F 4 -x 0 -O 0 -j <cpu online> -S 1 -m root.manifest (fuori dall'albero)
+ */
+
+#define _MAX_PATH_LEN 255 //come MAX_PATH_LEN di farm.c
+#define _MAX_DIRS (1 << 20)
+#define _CHUNK_FILES 64
+#define _WRITE_LEN (1 << 20)
+
+typedef enum { SIZE_FIXED, SIZE_UNIFORM, SIZE_LOGNORMAL, SIZE_ZIPF } sizeDist_t;
+enum { ST_OK, ST_OVERFLOW, ST_OTHER, ST_ERROR };
+
+/** Parametri della generazione e stato condiviso tra i thread
+ *
+ */
+typedef struct gen
+{
+    const char *root;
+    unsigned long files;
+    sizeDist_t dist;
+    double p1, p2;          // parametri della distribuzione
+    double other;           // frazione di file non .dat
+    double overflow;        // frazione di file in overflow
+    unsigned long long seed;
+    char **dirs;            // path delle directory (indice in ampiezza, 0 = root)
+    unsigned long ndirs;
+    unsigned long next;     // prossimo blocco di file da generare
+    long *result;           // risultato atteso di ogni file
+    unsigned char *status;
+    unsigned long long bytes;
+} gen_t;
+
+/* ------------------- generatore counter-based ------------------ */
+
+//funzione di mixing di splitmix64: mix(seme + contatore) e' un generatore senza stato
+static inline unsigned long long mix(unsigned long long x){
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+#define GOLDEN 0x9e3779b97f4a7c15ULL
+
+//k-esimo uniforme in [0, 1) del file (k distinti per le diverse estrazioni del file)
+static inline double file_uniform(unsigned long long fseed, unsigned k){
+    return (mix(fseed ^ (0xd1b54a32d192ed03ULL * (k + 1))) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief numero di long del file con seme fseed secondo la distribuzione delle dimensioni
+ */
+static long file_nelem(const gen_t *g, unsigned long long fseed){
+    double u = file_uniform(fseed, 0), bytes;
+    switch(g->dist){
+        case SIZE_FIXED:
+            bytes = g->p1;
+            break;
+        case SIZE_UNIFORM:
+            bytes = g->p1 + u * (g->p2 - g->p1 + 1);
+            break;
+        case SIZE_LOGNORMAL:{ //Box-Muller
+            double v = file_uniform(fseed, 1);
+            bytes = g->p1 * exp(g->p2 * sqrt(-2.0 * log(1.0 - u)) * cos(2 * M_PI * v));
+            break;
+        }
+        default:{ //inversa della CDF della legge di potenza continua su [1, K], K = MAX / 8
+            double k = g->p2 / sizeof(long), e = 1.0 - g->p1;
+            double x = (fabs(e) < 1e-9) ? pow(k, u) : pow(u * (pow(k, e) - 1.0) + 1.0, 1.0 / e);
+            bytes = x * sizeof(long);
+            break;
+        }
+    }
+    if(bytes < 0)
+        bytes = 0;
+    return (long)(bytes / sizeof(long));
+}
+
+/* ------------------- scrittura dei file ------------------ */
+
+static int write_all(int fd, const void *buf, size_t len){
+    size_t done = 0;
+    while(done < len){
+        ssize_t r = write(fd, (const char *)buf + done, len - done);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r == -1)
+            return -1;
+        done += r;
+    }
+    return 0;
+}
+
+/**
+ * @brief genera il file idx e ne salva il risultato atteso (quello calcolato da farm: somma di i * arr[i])
+ */
+static int make_file(gen_t *g, unsigned long idx, long *buf){
+    unsigned long long fseed = mix(g->seed * GOLDEN + idx);
+    int other = file_uniform(fseed, 2) < g->other;
+    int overflow = !other && file_uniform(fseed, 3) < g->overflow;
+    long n = file_nelem(g, fseed);
+    if(overflow && n < 4) //con almeno 4 elementi da LONG_MAX / n la somma supera LONG_MAX
+        n = 4;
+
+    //valori con al piu' bits bit: (2^bits - 1) * n * (n - 1) / 2 non supera LONG_MAX (nessun overflow non voluto)
+    int bits = 8;
+    while(bits > 0 && ((1UL << bits) - 1) * ((double)n * (n - 1) / 2) >= 9.2e18)
+        bits--;
+    long big = overflow ? __LONG_MAX__ / n : 0;
+
+    char path[_MAX_PATH_LEN + 1];
+    int len = snprintf(path, sizeof(path), "%s/f%lu.%s", g->dirs[idx % g->ndirs], idx, other ? "txt" : "dat");
+    if(len < 0 || len >= _MAX_PATH_LEN){
+        fprintf(stderr, "generatree: path of file %lu too long\n", idx);
+        g->status[idx] = ST_ERROR;
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        perror("open");
+        fprintf(stderr, "generatree: cannot create %s\n", path);
+        g->status[idx] = ST_ERROR;
+        return -1;
+    }
+
+    const long per_chunk = _WRITE_LEN / sizeof(long);
+    unsigned long long ctr = fseed * GOLDEN;
+    long sum = 0;
+    for(long off = 0; off < n; off += per_chunk){
+        long m = (n - off < per_chunk) ? n - off : per_chunk;
+        if(overflow){
+            for(long i = 0; i < m; i++)
+                buf[i] = big;
+        }
+        else{
+            //nessuna dipendenza tra le iterazioni (oltre alla riduzione della somma): vettorizzabile
+            long s = 0;
+            for(long i = 0; i < m; i++){
+                long v = (bits == 0) ? 0 : (long)(mix(ctr + (unsigned long long)(off + i)) >> (64 - bits));
+                buf[i] = v;
+                s += v * (off + i);
+            }
+            sum += s;
+        }
+        if(write_all(fd, buf, m * sizeof(long)) != 0){
+            perror("write");
+            close(fd);
+            g->status[idx] = ST_ERROR;
+            return -1;
+        }
+    }
+    if(close(fd) != 0){
+        perror("close");
+        g->status[idx] = ST_ERROR;
+        return -1;
+    }
+
+    g->result[idx] = sum;
+    g->status[idx] = other ? ST_OTHER : overflow ? ST_OVERFLOW : ST_OK;
+    __atomic_add_fetch(&g->bytes, (unsigned long long)n * sizeof(long), __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief thread generatore: preleva blocchi di _CHUNK_FILES file fino ad esaurimento
+ */
+static void *generator(void *arg){
+    gen_t *g = arg;
+    long *buf = malloc(_WRITE_LEN);
+    if(!buf){
+        perror("malloc");
+        return (void *)1;
+    }
+    long err = 0;
+    for(;;){
+        unsigned long first = __atomic_fetch_add(&g->next, _CHUNK_FILES, __ATOMIC_RELAXED);
+        if(first >= g->files)
+            break;
+        for(unsigned long i = first; i < first + _CHUNK_FILES && i < g->files; i++)
+            if(make_file(g, i, buf) != 0)
+                err = 1;
+    }
+    free(buf);
+    return (void *)err;
+}
+
+/* ------------------- albero e manifest ------------------ */
+
+/**
+ * @brief crea le directory dell'albero completo (in ampiezza: i figli della directory k sono k * fanout + 1 ...)
+ */
+static int make_dirs(gen_t *g, int depth, int fanout){
+    unsigned long level = 1, n = 1;
+    for(int d = 0; d < depth; d++){
+        level *= fanout;
+        n += level;
+        if(n > _MAX_DIRS){
+            fprintf(stderr, "generatree: at most %d directories\n", _MAX_DIRS);
+            return -1;
+        }
+    }
+    if(!(g->dirs = calloc(n, sizeof(char *))))
+        return -1;
+    g->ndirs = n;
+    if(mkdir(g->root, 0755) == -1 && errno != EEXIST){
+        perror("mkdir");
+        fprintf(stderr, "generatree: cannot create %s\n", g->root);
+        return -1;
+    }
+    if(!(g->dirs[0] = strdup(g->root)))
+        return -1;
+    for(unsigned long k = 1; k < n; k++){
+        char path[_MAX_PATH_LEN + 1];
+        int len = snprintf(path, sizeof(path), "%s/d%lu", g->dirs[(k - 1) / fanout], (k - 1) % fanout);
+        if(len < 0 || len >= _MAX_PATH_LEN){
+            fprintf(stderr, "generatree: directory tree too deep for paths of %d characters\n", _MAX_PATH_LEN);
+            return -1;
+        }
+        if((mkdir(path, 0755) == -1 && errno != EEXIST) || !(g->dirs[k] = strdup(path))){
+            perror("mkdir");
+            fprintf(stderr, "generatree: cannot create %s\n", path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static gen_t *sort_gen; //generazione ordinata da cmp_manifest (qsort non ha argomento utente in C99)
+
+static int cmp_manifest(const void *a, const void *b){
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+    long rx = sort_gen->result[x], ry = sort_gen->result[y];
+    if(rx != ry)
+        return (rx > ry) - (rx < ry);
+    char px[_MAX_PATH_LEN + 1], py[_MAX_PATH_LEN + 1];
+    snprintf(px, sizeof(px), "%s/f%lu.dat", sort_gen->dirs[x % sort_gen->ndirs], x);
+    snprintf(py, sizeof(py), "%s/f%lu.dat", sort_gen->dirs[y % sort_gen->ndirs], y);
+    return strcmp(px, py);
+}
+
+/**
+ * @brief scrive il manifest: "risultato path" dei file stampati da farm, ordinati per risultato e path
+ */
+static int write_manifest(gen_t *g, const char *manifest, unsigned long *counts){
+    unsigned long *idx = malloc(g->files * sizeof(unsigned long)), n = 0;
+    if(!idx){
+        perror("malloc");
+        return -1;
+    }
+    for(unsigned long i = 0; i < g->files; i++){
+        counts[g->status[i]]++;
+        if(g->status[i] == ST_OK)
+            idx[n++] = i;
+    }
+    sort_gen = g;
+    qsort(idx, n, sizeof(unsigned long), cmp_manifest);
+
+    FILE *f = fopen(manifest, "w");
+    if(!f){
+        perror("fopen");
+        fprintf(stderr, "generatree: cannot create manifest %s\n", manifest);
+        free(idx);
+        return -1;
+    }
+    for(unsigned long i = 0; i < n; i++)
+        fprintf(f, "%ld %s/f%lu.dat\n", g->result[idx[i]], g->dirs[idx[i] % g->ndirs], idx[i]);
+    free(idx);
+    return (fclose(f) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief legge la distribuzione delle dimensioni ("nome:p1[:p2]")
+ */
+static int parse_size(gen_t *g, const char *spec){
+    double a = 0, b = 0;
+    if(sscanf(spec, "fixed:%lf", &a) == 1 && a >= 0){
+        g->dist = SIZE_FIXED;
+        b = a;
+    }
+    else if(sscanf(spec, "uniform:%lf:%lf", &a, &b) == 2 && a >= 0 && b >= a)
+        g->dist = SIZE_UNIFORM;
+    else if(sscanf(spec, "lognormal:%lf:%lf", &a, &b) == 2 && a > 0 && b >= 0)
+        g->dist = SIZE_LOGNORMAL;
+    else if(sscanf(spec, "zipf:%lf:%lf", &a, &b) == 2 && a > 0 && b >= sizeof(long))
+        g->dist = SIZE_ZIPF;
+    else
+        return -1;
+    g->p1 = a;
+    g->p2 = b;
+    return 0;
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "usage: %s -d root [-n files] [-s size] [-D depth] [-F fanout] [-x non-dat fraction] [-O overflow fraction] [-j threads] [-S seed] [-m manifest]\n"
+        "  size (bytes): fixed:B | uniform:MIN:MAX | lognormal:MEDIAN:SIGMA | zipf:S:MAX (default uniform:8:4096)\n", prog);
+}
+
+int main(int argc, char **argv){
+    gen_t g;
+    memset(&g, 0, sizeof(g));
+    g.files = 1000;
+    g.dist = SIZE_UNIFORM;
+    g.p1 = 8;
+    g.p2 = 4096;
+    g.seed = 1;
+    int depth = 2, fanout = 4;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *manifest = NULL;
+    char manifest_buf[_MAX_PATH_LEN + 32];
+
+    int opt, bad = 0;
+    while((opt = getopt(argc, argv, "d:n:s:D:F:x:O:j:S:m:")) != -1){
+        switch(opt){
+            case 'd': g.root = optarg; break;
+            case 'n': g.files = strtoul(optarg, NULL, 10); break;
+            case 's': bad |= parse_size(&g, optarg) != 0; break;
+            case 'D': depth = atoi(optarg); break;
+            case 'F': fanout = atoi(optarg); break;
+            case 'x': g.other = atof(optarg); break;
+            case 'O': g.overflow = atof(optarg); break;
+            case 'j': nthreads = atol(optarg); break;
+            case 'S': g.seed = strtoull(optarg, NULL, 10); break;
+            case 'm': manifest = optarg; break;
+            default: bad = 1; break;
+        }
+    }
+    if(bad || !g.root || depth < 0 || fanout < 1 || nthreads < 1 || g.other < 0 || g.other > 1 || g.overflow < 0 || g.overflow > 1){
+        usage(argv[0]);
+        return 1;
+    }
+    if(!manifest){
+        snprintf(manifest_buf, sizeof(manifest_buf), "%s.manifest", g.root);
+        manifest = manifest_buf;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if(make_dirs(&g, depth, fanout) != 0)
+        return 1;
+    g.result = calloc(g.files ? g.files : 1, sizeof(long));
+    g.status = calloc(g.files ? g.files : 1, sizeof(unsigned char));
+    pthread_t *tid = malloc(nthreads * sizeof(pthread_t));
+    if(!g.result || !g.status || !tid){
+        perror("calloc");
+        return 1;
+    }
+
+    long started = 0, err = 0;
+    for(; started < nthreads; started++)
+        if(pthread_create(&tid[started], NULL, generator, &g) != 0){
+            perror("pthread_create");
+            err = 1;
+            break;
+        }
+    for(long i = 0; i < started; i++){
+        void *r;
+        pthread_join(tid[i], &r);
+        err |= (long)r;
+    }
+
+    unsigned long counts[ST_ERROR + 1] = {0};
+    if(write_manifest(&g, manifest, counts) != 0)
+        err = 1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "generatree: %lu files (%lu .dat, %lu overflow, %lu other, %lu errors) in %lu directories, %.3f GB in %.2f s (%.2f GB/s)\n",
+        g.files, counts[ST_OK], counts[ST_OVERFLOW], counts[ST_OTHER], counts[ST_ERROR], g.ndirs, g.bytes / 1e9, secs, g.bytes / 1e9 / secs);
+
+    for(unsigned long k = 0; k < g.ndirs; k++)
+        free(g.dirs[k]);
+    free(g.dirs);
+    free(g.result);
+    free(g.status);
+    free(tid);
+    return err ? 1 : 0;
+}
@@ -7,16 +7,25 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <getopt.h> //non incluso con -std=C99
 #include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #include <master.h>
 #include <worker.h>
 #include <util.h>
 #include <conn.h>
+#include <query.h>
+#include <trace.h>
+#include <pack_file.h>
+#include <server.h>
 
 volatile sig_atomic_t print = 0;
 volatile sig_atomic_t end = 0;
+//eventfd del thread delle metriche, segnalato da SIGUSR2 (-1 se il thread non e' attivo)
+static int metrics_efd = -1;
 
 /**
  * \file master.c
@@ -24,7 +33,7 @@ volatile sig_atomic_t end = 0;
  */
 
 /**
- * \brief funzione chiamata dai segnali SIGHUP/SIGINT/SIGQUIT/SIGTERM/SIGUSR1(comportamento spiegato nella relazione)
+ * \brief funzione chiamata dai segnali SIGHUP/SIGINT/SIGQUIT/SIGTERM/SIGUSR1/SIGUSR2(comportamento spiegato nella relazione)
  *
  * \param signum numero segnale
  */
@@ -39,6 +48,14 @@ static void sighandler(int signum) {
         case SIGUSR1: 
             print = 1;
             break;
+        case SIGUSR2: //stampa delle metriche, servita dal thread delle metriche (write e' async-signal-safe)
+            metrics_dump = 1;
+            if(metrics_efd != -1){
+                uint64_t one = 1;
+                ssize_t unused = write(metrics_efd, &one, sizeof(one));
+                (void)unused;
+            }
+            break;
     }
 }
 
@@ -65,6 +82,7 @@ void handle_master_signals(){
     CHECK_EQ_EXIT("sigaction", sigaction(SIGTERM, &s, NULL), -1, "sigaction failed\n");
     CHECK_EQ_EXIT("sigaction", sigaction(SIGHUP, &s, NULL), -1, "sigaction failed\n");
     CHECK_EQ_EXIT("sigaction", sigaction(SIGUSR1, &s, NULL), -1, "sigaction failed\n");
+    CHECK_EQ_EXIT("sigaction", sigaction(SIGUSR2, &s, NULL), -1, "sigaction failed\n");
 
     s.sa_handler = SIG_IGN;
     CHECK_EQ_EXIT("sigaction", sigaction(SIGPIPE, &s, NULL), -1, "sigaction failed\n");
@@ -93,18 +111,31 @@ void send_to_sockfd(const int sockfd, const char* msg, const int max_mcomms_len)
 }
 
 /**
- * \brief Funzione di inizializzazione threads
+ * \brief Funzione di invio comando msg al Collector (socket oppure coda del Collector thread in modalità -i)
  *
- * \param th array di threads
- * \param threadpool_size dimensione threadpool
- * \param thARGS argomento dei workers
- * 
- * \retval M_SUCCESS in caso di successo
- * \retval M_FAILURE in caso di errore
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ * \param msg comando da inviare
  */
-static int init_threads(pthread_t *th, size_t threadpool_size, threadArgs_t *thARGS){
+void notify_collector(const masterArgs *mARGS, const char* msg){
+    if(mARGS->mq){
+        MQNode_t *n;
+        CHECK_EQ_EXIT("allocMQNode", n = allocMQNode(MQ_CMD, mARGS->max_mcomms_len), NULL, "allocMQNode failed\n");
+        strncpy(n->data, msg, mARGS->max_mcomms_len);
+        n->data[mARGS->max_mcomms_len - 1] = '\0';
+        CHECK_NEQ_EXIT("mqPush", mqPush(mARGS->mq, n), 0, "mqPush failed\n");
+    }
+    else
+        send_to_sockfd(mARGS->collectorfd, msg, mARGS->max_mcomms_len);
+}
+
+/**
+ * \brief Maschera nel thread chiamante i segnali gestiti dal Master, cosi' che i thread creati non li ricevano
+ *
+ * \param oldmask maschera precedente, da ripristinare dopo la creazione dei threads
+ */
+static void block_master_signals(sigset_t *oldmask){
 
-    sigset_t mask, oldmask;
+    sigset_t mask;
     CHECK_EQ_EXIT("sigemptyset", sigemptyset(&mask), -1, "sigemptyset failed\n");
     CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGINT), -1, "sigaddset failed\n");
     CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGQUIT), -1, "sigaddset failed\n");
@@ -112,12 +143,29 @@ static int init_threads(pthread_t *th, size_t threadpool_size, threadArgs_t *thA
     CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGHUP), -1, "sigaddset failed\n");
     CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGPIPE), -1, "sigaddset failed\n");
     CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGUSR1), -1, "sigaddset failed\n");
+    CHECK_EQ_EXIT("sigaddset", sigaddset(&mask, SIGUSR2), -1, "sigaddset failed\n");
+
+    CHECK_EQ_EXIT("pthread_sigmask", pthread_sigmask(SIG_BLOCK, &mask, oldmask), -1, "pthread_sigmask failed\n");
+}
+
+/**
+ * \brief Funzione di inizializzazione threads
+ *
+ * \param th array di threads
+ * \param threadpool_size dimensione threadpool
+ * \param thARGS array di argomenti dei workers (uno per Worker)
+ * 
+ * \retval M_SUCCESS in caso di successo
+ * \retval M_FAILURE in caso di errore
+ */
+static int init_threads(pthread_t *th, size_t threadpool_size, threadArgs_t *thARGS){
 
     //maschero i segnali che non devono essere visibili ai workers
-    CHECK_EQ_EXIT("pthread_sigmask", pthread_sigmask(SIG_BLOCK, &mask, &oldmask), -1, "pthread_sigmask failed\n");
+    sigset_t oldmask;
+    block_master_signals(&oldmask);
 
     for (int i = 0; i < threadpool_size; ++i) // avvio workers
-        CHECK_NEQ_EXIT("pthread_create", pthread_create(&th[i], NULL, main_worker, thARGS), 0, "pthread_create failed (Worker)");
+        CHECK_NEQ_EXIT("pthread_create", pthread_create(&th[i], NULL, main_worker, &thARGS[i]), 0, "pthread_create failed (Worker)");
 
     //ripristino la vecchia maschera
     CHECK_EQ_EXIT("pthread_sigmask", pthread_sigmask(SIG_SETMASK, &oldmask, NULL), -1, "pthread_sigmask failed\n");
@@ -139,15 +187,138 @@ static void join_threads(pthread_t *th, size_t threadpool_size){
     free(th);
 }
 
+/** Thread delle metriche: stampa le metriche su stderr alla ricezione di SIGUSR2 (inoltrando il comando "usr2"
+ *  al Collector processo) e risponde ai client del socket -M, senza interferire con Master e Workers
+ */
+typedef struct metricsThread
+{
+    pthread_t tid;
+    int listenfd;               // socket delle metriche (-M), -1 se non richiesto
+    int stop;
+    const masterArgs *mARGS;
+} metricsThread_t;
+
+/**
+ * \brief risponde a un client del socket delle metriche: legge la richiesta (una riga, con un'attesa massima
+ *          di _METRICS_CLIENT_MS) e scrive le metriche seguite da una riga vuota, poi chiude la connessione
+ *
+ * \param m metriche del MasterWorker
+ * \param fd connessione con il client
+ */
+static void serve_metrics_client(metrics_t *m, int fd){
+    char req[_QUERY_LINE_LEN];
+    size_t len = 0;
+    char *nl = NULL;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    while(!nl && len < sizeof(req) && poll(&pfd, 1, _METRICS_CLIENT_MS) == 1){
+        ssize_t r = read(fd, req + len, sizeof(req) - len);
+        if(r <= 0)
+            break;
+        len += r;
+        nl = memchr(req, '\n', len);
+    }
+    if(nl){
+        *nl = '\0';
+        if(nl > req && nl[-1] == '\r')
+            nl[-1] = '\0';
+        char err[] = "error: invalid query (metrics)\n\n";
+        if(strcmp(req, "metrics") != 0)
+            writen(fd, err, sizeof(err) - 1);
+        else if(write_metrics(m, fd) == MT_SUCCESS)
+            writen(fd, "\n", 1);
+    }
+    close(fd);
+}
+
+static void *metrics_thread(void *arg){
+    metricsThread_t *mt = (metricsThread_t *)arg;
+    const masterArgs *mARGS = mt->mARGS;
+    struct pollfd pfd[2] = {{metrics_efd, POLLIN, 0}, {mt->listenfd, POLLIN, 0}};
+
+    while(!__atomic_load_n(&mt->stop, __ATOMIC_ACQUIRE)){
+        if(metrics_dump){ //SIGUSR2 (anche se arrivato prima dell'avvio del thread)
+            metrics_dump = 0;
+            if(write_metrics(mARGS->metrics, STDERR_FILENO) != MT_SUCCESS)
+                print_error("write of the metrics failed\n");
+            if(!mARGS->mq) //il Collector thread (-i) e' gia' compreso nelle metriche del MasterWorker
+                notify_collector(mARGS, "usr2");
+        }
+        if(poll(pfd, (mt->listenfd != -1) ? 2 : 1, -1) == -1){
+            if(errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+        if(pfd[0].revents & POLLIN){
+            uint64_t v;
+            while(read(metrics_efd, &v, sizeof(v)) == -1 && errno == EINTR);
+        }
+        if(mt->listenfd != -1 && (pfd[1].revents & POLLIN)){
+            int fd = accept(mt->listenfd, (struct sockaddr *)NULL, NULL);
+            if(fd != -1)
+                serve_metrics_client(mARGS->metrics, fd);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief avvia il thread delle metriche (con i segnali del Master mascherati) e, con -M, il socket delle metriche
+ *
+ * \param mt stato del thread
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ *
+ * \retval M_SUCCESS in caso di successo
+ * \retval M_FAILURE in caso di errore
+ */
+static int start_metrics_thread(metricsThread_t *mt, const masterArgs *mARGS){
+    mt->mARGS = mARGS;
+    mt->stop = 0;
+    mt->listenfd = -1;
+    if(mARGS->metrics_sock && (mt->listenfd = ctrl_listen(mARGS->metrics_sock)) == Q_FAILURE){
+        print_error("ctrl_listen of %s failed\n", mARGS->metrics_sock);
+        return M_FAILURE;
+    }
+    SYSCALL_RETURN("eventfd", metrics_efd, eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), M_FAILURE, "eventfd failed\n");
+
+    sigset_t oldmask;
+    block_master_signals(&oldmask);
+    int err = pthread_create(&mt->tid, NULL, metrics_thread, mt);
+    CHECK_EQ_EXIT("pthread_sigmask", pthread_sigmask(SIG_SETMASK, &oldmask, NULL), -1, "pthread_sigmask failed\n");
+    if(err != 0){
+        errno = err;
+        perror("pthread_create");
+        print_error("pthread_create failed (metrics)\n");
+        return M_FAILURE;
+    }
+    return M_SUCCESS;
+}
+
+/**
+ * \brief termina il thread delle metriche e rimuove il socket delle metriche
+ */
+static void stop_metrics_thread(metricsThread_t *mt){
+    uint64_t one = 1;
+    __atomic_store_n(&mt->stop, 1, __ATOMIC_RELEASE);
+    while(write(metrics_efd, &one, sizeof(one)) == -1 && errno == EINTR);
+    CHECK_NEQ_EXIT("pthread_join", pthread_join(mt->tid, NULL), 0, "pthread_join failed (metrics)\n");
+    int efd = metrics_efd;
+    metrics_efd = -1;
+    close(efd);
+    if(mt->listenfd != -1){
+        close(mt->listenfd);
+        unlink(mt->mARGS->metrics_sock);
+    }
+}
+
 /**
  * \brief nanosleep() per i richiesti msec ms
  * 
  * \param msec ms da attendere
- * \param sockfd file descriptor del socket
- * \param max_mcomms_len lunghezza massima del messaggio da parte del master in caso di eventuale comunicazine
+ * \param mARGS argomenti del master, per l'eventuale comunicazione con il Collector
  * 
  */
-static inline void ms_sleep(size_t msec, const int sockfd, const int max_mcomms_len)
+static inline void ms_sleep(size_t msec, const masterArgs *mARGS)
 {
     struct timespec ts;
     int res;
@@ -158,18 +329,95 @@ static inline void ms_sleep(size_t msec, const int sockfd, const int max_mcomms_
     do {
         res = nanosleep(&ts, &ts);
         if(print){ //se interruzione setta flag print = 1
-            send_to_sockfd(sockfd, "usr1", max_mcomms_len); //mando comando di print
+            notify_collector(mARGS, "usr1"); //mando comando di print
             print = 0;
         }
-        else if(res != 0 && end == 0){ //non sono stato fermato da end o print
+        else if(res != 0 && end == 0 && errno != EINTR){ //non sono stato fermato da end, print o da un altro segnale (SIGUSR2)
             perror("nanosleep");
             print_error("nanosleep failed with errno=%d", errno);
         }
     } while (res && !end); //esco solo se finisce tempo delay o interruzione chiama fine programma
 }
 
+//scansione da interrompere: terminazione del Master o, in modalità server, errore di push del job
+static inline int scan_stopped(const masterArgs *mARGS){
+    return end != 0 || (mARGS->failed && *mARGS->failed);
+}
+
+//incremento di un contatore del Master: in modalità server i thread dei job scansionano in parallelo
+static inline void master_add(uint64_t *field, uint64_t v, const masterArgs *mARGS){
+    if(mARGS->server)
+        METRIC_ADD_SHARED(*field, v);
+    else
+        METRIC_ADD(*field, v);
+}
+
 /**
- * \brief Funzione di push stringa in coda concorrente
+ * \brief Inserisce in coda un task (path di un file o task di un archivio) di files file e bytes byte
+ *
+ * \param task stringa da inserire
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+static void enqueue_task(char *task, size_t files, uint64_t bytes, const masterArgs *mARGS){
+    //i byte vengono contati prima della push, cosi' non possono risultare letti dai Workers prima di essere in coda
+    //con il trace attivo ogni push viene cronometrata
+    masterMetrics_t *mm = &mARGS->metrics->master;
+    int sample = (METRIC_GET(mm->files) % _METRICS_SAMPLE) == 0 || TRACE_ON;
+    uint64_t start = sample ? now_ns(CLOCK_MONOTONIC) : 0;
+    master_add(&mm->files, files, mARGS);
+    master_add(&mm->bytes, bytes, mARGS);
+    int ret = push(mARGS->q, task);
+    while(ret == -2 && mARGS->server && end == 0) //modalità server: la coda del job resta piena finché i Workers servono altri job
+        ret = push(mARGS->q, task);
+    if(ret == 0 && mARGS->server) //modalità server: sveglio il dispatcher, che altrimenti attende i task del job
+        job_task_ready(mARGS->jobs);
+    if(sample){
+        uint64_t stop = now_ns(CLOCK_MONOTONIC);
+        master_add(&mm->push_ns, stop - start, mARGS);
+        master_add(&mm->pushes, 1, mARGS);
+        if(ret == 0)
+            TRACE_EVENT(TR_PUSH, start, stop, task, 0);
+    }
+    if(ret == 0) //operazione andata a buon fine
+        ms_sleep(mARGS->delay, mARGS);
+    else if(mARGS->failed) //modalità server: termino solo la scansione del job
+        *mARGS->failed = 1;
+    else if(ret == -1) //push error
+        end = 1; //termino coda
+    else if(ret == -2) //timeout su coda concorrente
+        end = 2; //termino coda
+}
+
+/**
+ * \brief Inserisce in coda i task dell'archivio pack_path, uno ogni PK_TASK_ENTRIES entry
+ *          (i Worker mappano l'archivio e calcolano le entry del task, vedi pack_file.h)
+ *
+ * \param pack_path path dell'archivio
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+static void push_pack(char *pack_path, const masterArgs *mARGS){
+    Pack_t pack;
+    if(pkOpen(&pack, pack_path) != PK_SUCCESS){
+        perror("pkOpen");
+        print_error("%s is not a valid pack\n", pack_path);
+        return;
+    }
+    char task[mARGS->max_path_len];
+    for(uint64_t first = 0; first < pack.h->nentries && !scan_stopped(mARGS); first += PK_TASK_ENTRIES){
+        uint64_t count = (pack.h->nentries - first < PK_TASK_ENTRIES) ? pack.h->nentries - first : PK_TASK_ENTRIES, bytes = 0;
+        if(pkFormatTask(task, sizeof(task), pack_path, first, count) != PK_SUCCESS){
+            print_error("pack path %s is too long\n", pack_path);
+            break;
+        }
+        for(uint64_t i = first; i < first + count; i++)
+            bytes += pack.idx[i].length;
+        enqueue_task(task, count, bytes, mARGS);
+    }
+    pkClose(&pack);
+}
+
+/**
+ * \brief Funzione di push stringa in coda concorrente (gli archivi .fpk vengono inseriti come task di entry)
  *
  * \param to_push stringa da inserire
  * \param mARGS argomenti del master (controllare definizione di masterArgs)
@@ -177,15 +425,12 @@ static inline void ms_sleep(size_t msec, const int sockfd, const int max_mcomms_
  */
 static void push_into_queue(char *to_push, masterArgs mARGS){
 
-    if(isRegular(to_push) == 0 && isExt(to_push, mARGS.ext) == 0){ //se il file ha le proprietà corrette
-        int ret = push(mARGS.q, to_push);
-        if(ret == 0) //operazione andata a buon fine
-            ms_sleep(mARGS.delay, mARGS.collectorfd, mARGS.max_mcomms_len);
-        else if(ret == -1) //push error
-            end = 1; //termino coda
-        else if(ret == -2) //timeout su coda concorrente
-            end = 2; //termino coda
-    }
+    struct stat statbuf;
+    int regular = stat(to_push, &statbuf) == 0 && S_ISREG(statbuf.st_mode);
+    if(regular && isExt(to_push, mARGS.ext) == 0) //se il file ha le proprietà corrette
+        enqueue_task(to_push, 1, statbuf.st_size, &mARGS);
+    else if(regular && isExt(to_push, PK_EXT) == 0) //archivio di file
+        push_pack(to_push, &mARGS);
     else{ //file non rispetta le proprietà desiderate
         print_error("%s is not a regular file or is not a file.%s\n", to_push, mARGS.ext);
     }
@@ -203,14 +448,23 @@ static void file_seeker(char *basepath, masterArgs mARGS){
     struct dirent *dp;
     DIR *dir;
     CHECK_EQ_RETURN("opendir", dir = opendir(basepath), NULL, ,"opendir of %s failed\n", basepath);
+    master_add(&mARGS.metrics->master.dirs, 1, &mARGS);
 
-    if(end)
+    if(scan_stopped(&mARGS)){
+        closedir(dir);
         return;
+    }
+
+    //in modalità watch monitoro la directory prima di leggerla, cosi' non perdo i file creati durante la scansione
+    if(mARGS.w)
+        add_watch_dir(mARGS.w, basepath);
 
     while ((errno = 0, dp = readdir(dir)) != NULL){
 
-        if(end)
+        if(scan_stopped(&mARGS)){
+            closedir(dir);
             return;
+        }
         //aggiungo path sottodirectory al basepath se basepath len + sottodirectory len < MAX_PATH_LEN
         if(strlen(basepath) + strlen(dp->d_name) < mARGS.max_path_len - 6){ //-6 perch`e name_len minima di file .dat `e 5 (x.dat) + char '/' da inserire nel path
             CHECK_NEQ_CONTINUE("strncpy", strncpy(path, basepath, mARGS.max_path_len), path, "strcpy of %s failed\n", basepath);
@@ -245,6 +499,212 @@ static void file_seeker(char *basepath, masterArgs mARGS){
 
 }
 
+/**
+ * \brief Ciclo della modalità watch: inserisce in coda i file .ext chiusi dopo una scrittura (o spostati)
+ *          nelle directories monitorate, e scansiona le nuove sotto-directory. Termina quando end != 0
+ *
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+static void watch_loop(masterArgs mARGS){
+
+    char events[_WATCH_EVENTS_BUF_LEN] __attribute__((aligned(8)));
+    char path[mARGS.max_path_len];
+    struct pollfd pfd;
+    pfd.fd = mARGS.w->fd;
+    pfd.events = POLLIN;
+
+    while(!end){
+        int r = poll(&pfd, 1, _WATCH_POLL_MS); //timeout per ricontrollare end/print anche senza eventi
+        if(print){ //SIGUSR1: il Collector stampa i risultati raccolti finora
+            notify_collector(&mARGS, "usr1");
+            print = 0;
+        }
+        if(r == -1){
+            if(errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+        if(r == 0)
+            continue;
+
+        long n = read_watch_events(mARGS.w, events);
+        if(n < 0){
+            perror("read");
+            print_error("read of inotify events failed\n");
+            break;
+        }
+
+        long off = 0;
+        watchEvent_t ev;
+        while(!end && (ev = next_watch_event(mARGS.w, events, n, &off, path)) != WATCH_NONE){
+            if(ev == WATCH_DIR) //nuova sotto-directory: la monitoro e inserisco i file gia' presenti
+                file_seeker(path, mARGS);
+            else if(isExt(path, mARGS.ext) == 0) //ignoro silenziosamente i file con altra estensione
+                push_into_queue(path, mARGS);
+        }
+    }
+}
+
+/**
+ * \brief Inserisce in mARGS.q i file (e gli archivi) di argv a partire da opt_index e quelli delle directories
+ *          precedute da "-d", come per gli argomenti di farm. Usata anche dai job della modalità server
+ *
+ * \param argc int che indica dimensione di argv
+ * \param argv argomenti (file e "-d" seguito da una directory)
+ * \param opt_index indice del primo argomento
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+void scan_args(int argc, char **argv, int opt_index, masterArgs mARGS){
+
+    char to_push[mARGS.max_path_len];
+
+    while(opt_index < argc && !scan_stopped(&mARGS)){ //itero per tutte le stringhe di argv rimaste
+        fflush(stdout);
+        if(strcmp(argv[opt_index], "-d") != 0){ //se non si tratta del flag -d
+            CHECK_NEQ_RETURN("strncpy", strncpy(to_push, argv[opt_index], mARGS.max_path_len), to_push, , "strncpy of %s failed\n", argv[opt_index]);
+            to_push[mARGS.max_path_len-1] = '\0';
+
+            push_into_queue(to_push, mARGS); //provo a inserire in queue argv[opt_index]
+        }
+        else{ //trovo un flag -d
+            if (opt_index == argc - 1) // se non contiene argomento
+            {
+                print_error("last -d flag doesn't have an argument\n");
+                break;
+            }
+            struct stat statbuf;
+            opt_index++; //punto ad argomento di -d
+            stat(argv[opt_index], &statbuf);
+            if(stat(argv[opt_index], &statbuf) < 0){ //non esco dal programma in caso stat fallisca, ma semplicemente passo al prossimo argv
+                print_error("stat of %s failed with errno=%d -> ", argv[opt_index], errno);
+                perror("stat");
+                continue;
+            }
+            if (S_ISDIR(statbuf.st_mode)) //se viene passata una directory
+                file_seeker(argv[opt_index], mARGS); //itero ricorsivamente sui files
+            else // altrimenti errore
+                print_error("%s is not a directory\n", argv[opt_index]);
+        }
+        opt_index++;
+    }
+}
+
+/** Connessione della modalità server di cui il Master sta leggendo la richiesta
+ *
+ */
+typedef struct pendingReq
+{
+    int fd;
+    char *req;          // richiesta ricevuta finora (_SERVER_LINE_LEN byte)
+    size_t len;
+    uint64_t deadline;  // scadenza della richiesta (CLOCK_MONOTONIC, ns)
+} pendingReq_t;
+
+/**
+ * \brief Legge dal client p la richiesta (senza attendere, dopo un poll con POLLIN) e, se e' completa, avvia il job
+ *
+ * \retval 1 se la connessione non e' piu' del Master (job avviato o connessione chiusa)
+ * \retval 0 se la richiesta non e' ancora completa
+ */
+static int read_request(pendingReq_t *p, struct jobTable *jobs){
+    ssize_t n = read(p->fd, p->req + p->len, _SERVER_LINE_LEN - p->len);
+    if(n == -1 && errno == EINTR)
+        return 0;
+    if(n <= 0){
+        close(p->fd);
+        return 1;
+    }
+    char *nl = memchr(p->req + p->len, '\n', n);
+    p->len += n;
+    if(!nl){
+        if(p->len < _SERVER_LINE_LEN)
+            return 0;
+        close(p->fd); //richiesta troppo lunga
+        return 1;
+    }
+    *nl = '\0';
+    if(nl > p->req && nl[-1] == '\r')
+        nl[-1] = '\0';
+    submit_job(jobs, p->fd, p->req); //in caso di errore la risposta e' gia' stata scritta
+    return 1;
+}
+
+/**
+ * \brief Modalità server (-S): accetta le richieste sul socket di controllo mARGS.server ed avvia un job per ognuna
+ *          (server.h), fino a SIGINT/SIGTERM/...; poi attende la fine dei job in corso.
+ *          Le richieste vengono lette da un solo poll su tutte le connessioni accettate (al massimo
+ *          _SERVER_MAX_PENDING, ognuna con _SERVER_CLIENT_MS per completare la propria riga): un client lento non
+ *          ritarda gli altri
+ *
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+static void server_loop(masterArgs mARGS){
+    int listenfd;
+    if((listenfd = ctrl_listen(mARGS.server)) == Q_FAILURE){
+        print_error("ctrl_listen of %s failed\n", mARGS.server);
+        return;
+    }
+    if(start_jobs(mARGS.jobs, &mARGS) != SV_SUCCESS){
+        print_error("start_jobs failed\n");
+        close(listenfd);
+        unlink(mARGS.server);
+        return;
+    }
+
+    pendingReq_t pend[_SERVER_MAX_PENDING];
+    struct pollfd pfd[_SERVER_MAX_PENDING + 1];
+    size_t npend = 0;
+    while(end == 0){
+        //con _SERVER_MAX_PENDING richieste in lettura le nuove connessioni attendono nel backlog del socket
+        pfd[0] = (struct pollfd){listenfd, (npend < _SERVER_MAX_PENDING) ? POLLIN : 0, 0};
+        for(size_t i = 0; i < npend; i++)
+            pfd[i + 1] = (struct pollfd){pend[i].fd, POLLIN, 0};
+        int r = poll(pfd, npend + 1, _SERVER_POLL_MS); //ricontrollo end e le scadenze almeno ogni _SERVER_POLL_MS
+        if(r == -1 && errno != EINTR){
+            perror("poll");
+            break;
+        }
+
+        //dall'ultima, cosi' la connessione spostata al posto di una terminata e' gia' stata servita
+        uint64_t now = now_ns(CLOCK_MONOTONIC);
+        for(size_t i = npend; i-- > 0;){
+            int gone = (r > 0 && pfd[i + 1].revents) ? read_request(&pend[i], mARGS.jobs) : 0;
+            if(!gone && now >= pend[i].deadline){ //richiesta non completata in _SERVER_CLIENT_MS
+                close(pend[i].fd);
+                gone = 1;
+            }
+            if(gone){
+                free(pend[i].req);
+                pend[i] = pend[--npend];
+            }
+        }
+
+        if(r <= 0 || !(pfd[0].revents & POLLIN))
+            continue;
+        int fd = accept(listenfd, (struct sockaddr *)NULL, NULL);
+        if(fd == -1)
+            continue;
+        if(!(pend[npend].req = malloc(_SERVER_LINE_LEN))){
+            perror("malloc");
+            close(fd);
+            continue;
+        }
+        pend[npend].fd = fd;
+        pend[npend].len = 0;
+        pend[npend].deadline = now + (uint64_t)_SERVER_CLIENT_MS * 1000000;
+        npend++;
+    }
+
+    for(size_t i = 0; i < npend; i++){
+        close(pend[i].fd);
+        free(pend[i].req);
+    }
+    stop_jobs(mARGS.jobs);
+    close(listenfd);
+    unlink(mARGS.server);
+}
+
 /**
  * \brief Funzione di inserimento files da argv in coda concorrente
  *
@@ -260,15 +720,46 @@ static void file_seeker(char *basepath, masterArgs mARGS){
  */
 static int feed_files(int argc, char **argv, int opt_index, pthread_t *th, masterArgs mARGS, DArray *dirs){
     
-    //definisco argomento dei threads
-    threadArgs_t thARGS;
-    CHECK_NEQ_RETURN("memset", memset(&thARGS, 0, sizeof(threadArgs_t)), &thARGS, M_FAILURE, "memset failed\n");
-    thARGS.q = mARGS.q;
-    thARGS.max_path_len = mARGS.max_path_len;
-    thARGS.sockname = mARGS.sockname;
+    //definisco argomenti dei threads (uno per Worker, per il pinning)
+    threadArgs_t *thARGS;
+    CHECK_EQ_EXIT("calloc", thARGS = calloc(mARGS.threadpool_size, sizeof(threadArgs_t)), NULL, "calloc error");
+    for (size_t i = 0; i < mARGS.threadpool_size; i++){
+        thARGS[i].q = mARGS.q;
+        thARGS[i].max_path_len = mARGS.max_path_len;
+        thARGS[i].sockname = mARGS.sockname;
+        thARGS[i].mq = mARGS.mq;
+        thARGS[i].ring = mARGS.ring;
+        thARGS[i].remote = mARGS.remote;
+        thARGS[i].node_id = mARGS.node_id;
+        thARGS[i].batch = mARGS.batch;
+        thARGS[i].latency = mARGS.latency;
+        thARGS[i].id = i;
+        thARGS[i].aff = mARGS.aff;
+        thARGS[i].metrics = &mARGS.metrics->workers[i];
+        thARGS[i].server = (mARGS.server != NULL);
+    }
+
+    //thread delle metriche (SIGUSR2 e socket -M), avviato prima dei workers
+    bind_thread_clock(&mARGS.metrics->master.cpu);
+    TRACE_THREAD("master", -1);
+    metricsThread_t mt;
+    CHECK_EQ_RETURN("start_metrics_thread", start_metrics_thread(&mt, &mARGS), M_FAILURE, M_FAILURE, "start_metrics_thread failed\n");
 
     //inizializzo threads
-    CHECK_EQ_RETURN("init_threads", init_threads(th, mARGS.threadpool_size, &thARGS), M_FAILURE, M_FAILURE, "init_threads failed\n");
+    CHECK_EQ_RETURN("init_threads", init_threads(th, mARGS.threadpool_size, thARGS), M_FAILURE, M_FAILURE, "init_threads failed\n");
+
+    if(mARGS.server){ //modalità server: gli input arrivano con le richieste dei client
+        if(opt_index < argc || getDUsed(dirs) != 0)
+            print_error("server mode (-S): input files / directories on the command line are ignored\n");
+        deleteDArray(dirs);
+        server_loop(mARGS);
+        __atomic_store_n(&mARGS.metrics->master.scan_done, 1, __ATOMIC_RELAXED);
+        push(mARGS.q, EOS);
+        join_threads(th, mARGS.threadpool_size);
+        stop_metrics_thread(&mt);
+        free(thARGS);
+        return M_SUCCESS;
+    }
 
     char to_push[mARGS.max_path_len];
 
@@ -293,40 +784,21 @@ static int feed_files(int argc, char **argv, int opt_index, pthread_t *th, maste
 
     deleteDArray(dirs);
 
-    while(opt_index < argc && end == 0){ //itero per tutte le stringhe di argv rimaste
-        fflush(stdout);
-        if(strcmp(argv[opt_index], "-d") != 0){ //se non si tratta del flag -d
-            CHECK_NEQ_RETURN("strncpy", strncpy(to_push, argv[opt_index], mARGS.max_path_len), to_push, M_FAILURE, "strncpy of %s failed\n", argv[opt_index]);
-            to_push[mARGS.max_path_len-1] = '\0';
+    scan_args(argc, argv, opt_index, mARGS);
 
-            push_into_queue(to_push, mARGS); //provo a inserire in queue argv[opt_index]
-        }
-        else{ //trovo un flag -d
-            if (opt_index == argc - 1) // se non contiene argomento
-            {
-                print_error("last -d flag doesn't have an argument\n");
-                break;
-            }
-            struct stat statbuf;
-            opt_index++; //punto ad argomento di -d
-            stat(argv[opt_index], &statbuf);
-            if(stat(argv[opt_index], &statbuf) < 0){ //non esco dal programma in caso stat fallisca, ma semplicemente passo al prossimo argv
-                print_error("stat of %s failed with errno=%d -> ", argv[opt_index], errno);
-                perror("stat");
-                continue;
-            }
-            if (S_ISDIR(statbuf.st_mode)) //se viene passata una directory
-                file_seeker(argv[opt_index], mARGS); //itero ricorsivamente sui files
-            else // altrimenti errore
-                print_error("%s is not a directory\n", argv[opt_index]);
-        }
-        opt_index++;
-    }
+    __atomic_store_n(&mARGS.metrics->master.scan_done, 1, __ATOMIC_RELAXED);
+
+    if(mARGS.w && mARGS.w->npaths == 0) //nessuna directory monitorata
+        print_error("watch mode (-w) requires at least one directory (-d)\n");
+    else if(mARGS.w && end == 0) //modalità watch: resto in ascolto fino a SIGINT/SIGTERM/...
+        watch_loop(mARGS);
 
     if(end != 2) //se non esco per timeout sull'attesa di coda piena del Master
         push(mARGS.q, EOS); //inserisco EOS all'interno della coda
 
     join_threads(th, mARGS.threadpool_size); //e infine effettuo il join dei threads
+    stop_metrics_thread(&mt);
+    free(thARGS);
 
     return M_SUCCESS;
 }
@@ -345,7 +817,7 @@ static int feed_files(int argc, char **argv, int opt_index, pthread_t *th, maste
  */
 int execute_master(masterArgs mARGS, int argc, char **argv, int argc_index, DArray *dirs){
 
-    if(argc_index == argc && getDUsed(dirs) == 0){ //caso in cui non vengono inseriti files / directory
+    if(!mARGS.server && argc_index == argc && getDUsed(dirs) == 0){ //caso in cui non vengono inseriti files / directory
         printf("Master: no input files / directory\n");
         return M_SUCCESS;
     }
@@ -421,7 +893,7 @@ int init_master_args(masterArgs *mARGS, BQueue_t *q, size_t nthread, int collect
     mARGS->collectorfd = collectorfd;
 
     mARGS->q = q;
-    strncpy(mARGS->ext, ext, _MAX_EXT_LEN);
+    strncpy(mARGS->ext, ext, _MAX_EXT_LEN - 1);
 
     char sockname_ext[4] = "sck";
     if((strlen(sockname) < _MIN_SOCKNAME_LEN || strlen(sockname) > _MAX_SOCKNAME_LEN) || isExt(sockname, sockname_ext) != 0)
@@ -440,7 +912,34 @@ int init_master_args(masterArgs *mARGS, BQueue_t *q, size_t nthread, int collect
 }
 
 /**
- * \brief Funzione di parsing argomenti -n -q -t -d (andiamo a salvare gli argomenti di -d in dirs)
+ * \brief Adatta il numero di Workers al limite di file descriptor del processo (RLIMIT_NOFILE, ereditato dal
+ *          Collector): se serve alza il limite soft fino a quello hard, altrimenti riduce nthread
+ *
+ * \param nthread numero di Workers richiesto
+ *
+ * \return numero di Workers utilizzabile
+ */
+static size_t fit_nofile(size_t nthread){
+    struct rlimit rl;
+    rlim_t need = (rlim_t)nthread * _NTHREAD_FDS + _RESERVED_FDS;
+    if(getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= need)
+        return nthread;
+    rlim_t soft = rl.rlim_cur;
+    if(rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= need)
+        rl.rlim_cur = need;
+    else
+        rl.rlim_cur = rl.rlim_max;
+    if(setrlimit(RLIMIT_NOFILE, &rl) != 0)
+        rl.rlim_cur = soft;
+    if(rl.rlim_cur >= need)
+        return nthread;
+    size_t fit = (rl.rlim_cur > _RESERVED_FDS + _NTHREAD_FDS) ? (rl.rlim_cur - _RESERVED_FDS) / _NTHREAD_FDS : 1;
+    print_error("%zu Workers exceed the file descriptor limit (%llu): using %zu Workers\n", nthread, (unsigned long long)rl.rlim_cur, fit);
+    return fit;
+}
+
+/**
+ * \brief Funzione di parsing argomenti -n -q -t -d -a -w -b -l -i -s -c -R -L -N -m -o -B -D -Q -M -T (andiamo a salvare gli argomenti di -d in dirs)
  *
  * \param argc intero che indica dimensione di argv
  * \param argv array contenente gli argomenti inseriti sulla command line durante l'avvio del programma
@@ -449,17 +948,18 @@ int init_master_args(masterArgs *mARGS, BQueue_t *q, size_t nthread, int collect
  * \param delay specifica delay tra richieste del Master (in ms)
  * \param argc_index intero che a fine funzione conterr`a il valore di optind
  * \param dirs array dinamico in cui verranno salvati i nomi delle directories 
+ * \param opts opzioni aggiuntive (controllare definizione di farmOpts_t)
  * 
  * \retval M_SUCCESS se gli args sono stati parsati correttamente
  * \retval M_FAILURE altrimenti
  */
-int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_t *delay, int *argc_index, DArray *dirs){
+int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_t *delay, int *argc_index, DArray *dirs, farmOpts_t *opts){
     
     char *programname = argv[0]; //program name
 
     int opt;
 
-    while((opt = getopt(argc, argv, "n:q:d:t:")) != -1) {
+    while((opt = getopt(argc, argv, "n:q:d:t:a:wb:l:isc:R:L:N:m:o:B:DQ:M:T:S:")) != -1) {
         long tmp_par = 0;
         //gli argomenti n, q, t necessitano di un numero compreso tra i massimi valori disponibili per quel campo
         //in caso venga passato un valore non accettabile, essi manterranno il loro valore di default
@@ -470,7 +970,7 @@ int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_
                     break;
                 }
                 if(tmp_par >= _MIN_NTHREAD_VALUE && tmp_par < _MAX_NTHREAD_VALUE)
-                    *nthread = tmp_par;
+                    *nthread = fit_nofile(tmp_par);
                 else
                     print_error("option %c requires a number > %d and < %d (default value assigned: %d)\n", opt, _MIN_NTHREAD_VALUE, _MAX_NTHREAD_VALUE, _DEFAULT_NTHREAD_VALUE);
                 break;
@@ -500,6 +1000,75 @@ int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_
                 else
                     print_error("option %c requires a number > %d and < %d (default value assigned: %d)\n", opt, _MIN_DELAY_VALUE, _MAX_DELAY_VALUE, _DEFAULT_DELAY_VALUE);
                 break;
+            case 'a': //politica di affinity (compact, scatter, numa o lista di cpu)
+                if(strlen(optarg) >= _MAX_AFFINITY_LEN){
+                    print_error("option %c argument too long (no affinity applied)\n", opt);
+                    break;
+                }
+                strncpy(opts->affinity, optarg, _MAX_AFFINITY_LEN - 1);
+                break;
+            case 'w': //modalità watch
+                opts->watch = 1;
+                break;
+            case 'i': //Collector come thread del MasterWorker
+                opts->inproc = 1;
+                break;
+            case 's': //ring in memoria condivisa tra Workers e Collector
+                opts->shm = 1;
+                break;
+            case 'D': //snapshot incrementali
+                opts->delta = 1;
+                break;
+            case 'b': //risultati per invio dei Workers
+                if(isNumber(optarg, &tmp_par) == 0 && tmp_par >= _MIN_BATCH_VALUE && tmp_par <= _MAX_BATCH_VALUE)
+                    opts->batch = tmp_par;
+                else
+                    print_error("option %c requires a number >= %d and <= %d (default value assigned: %d)\n", opt, _MIN_BATCH_VALUE, _MAX_BATCH_VALUE, _DEFAULT_BATCH_VALUE);
+                break;
+            case 'l': //latenza massima di invio dei risultati (ms)
+                if(isNumber(optarg, &tmp_par) == 0 && tmp_par >= _MIN_LATENCY_VALUE && tmp_par <= _MAX_LATENCY_VALUE)
+                    opts->latency = tmp_par;
+                else
+                    print_error("option %c requires a number >= %d and <= %d (default value assigned: %d)\n", opt, _MIN_LATENCY_VALUE, _MAX_LATENCY_VALUE, _DEFAULT_LATENCY_VALUE);
+                break;
+            case 'c': //thread di ingestione del Collector
+                if(isNumber(optarg, &tmp_par) == 0 && tmp_par >= _MIN_CTHREADS_VALUE && tmp_par <= _MAX_CTHREADS_VALUE)
+                    opts->cthreads = tmp_par;
+                else
+                    print_error("option %c requires a number >= %d and <= %d (default value assigned: %d)\n", opt, _MIN_CTHREADS_VALUE, _MAX_CTHREADS_VALUE, _DEFAULT_CTHREADS_VALUE);
+                break;
+            case 'R': //nodo remoto: i risultati vanno al Collector centrale host:porta
+            case 'L': //Collector centrale in ascolto sulla porta TCP
+                if(strlen(optarg) >= _MAX_NET_ADDR_LEN){
+                    print_error("option %c argument too long (ignored)\n", opt);
+                    break;
+                }
+                strncpy((opt == 'R') ? opts->remote : opts->tcp_port, optarg, _MAX_NET_ADDR_LEN - 1);
+                break;
+            case 'N': //nodi remoti attesi dal Collector centrale
+                if(isNumber(optarg, &tmp_par) == 0 && tmp_par >= _MIN_NNODES_VALUE && tmp_par <= _MAX_NNODES_VALUE)
+                    opts->nnodes = tmp_par;
+                else
+                    print_error("option %c requires a number >= %d and <= %d (default value assigned: %d)\n", opt, _MIN_NNODES_VALUE, _MAX_NNODES_VALUE, _DEFAULT_NNODES_VALUE);
+                break;
+            case 'm': //budget di memoria (KB) dei risultati nel Collector
+                if(isNumber(optarg, &tmp_par) == 0 && tmp_par >= _MIN_MEMBUDGET_VALUE && tmp_par <= _MAX_MEMBUDGET_VALUE)
+                    opts->membudget = tmp_par;
+                else
+                    print_error("option %c requires a number >= %d and <= %d (default value assigned: %d)\n", opt, _MIN_MEMBUDGET_VALUE, _MAX_MEMBUDGET_VALUE, _DEFAULT_MEMBUDGET_VALUE);
+                break;
+            case 'o': //file di uscita del Collector
+            case 'B': //file binario dei risultati
+            case 'Q': //socket di controllo del Collector
+            case 'M': //socket delle metriche del MasterWorker
+            case 'T': //file del trace (make tracefarm)
+            case 'S': //socket di controllo della modalità server
+                if(strlen(optarg) >= _MAX_OUTFILE_LEN){
+                    print_error("option %c argument too long (ignored)\n", opt);
+                    break;
+                }
+                strncpy((opt == 'o') ? opts->outfile : (opt == 'B') ? opts->binfile : (opt == 'Q') ? opts->ctrl : (opt == 'M') ? opts->metrics : (opt == 'T') ? opts->trace : opts->server, optarg, _MAX_OUTFILE_LEN - 1);
+                break;
             case ':': //opt senza valore quando invece `e richiesto
                 print_error("option %c requires a value (so it keeps default value)\n", optopt);
                 break;
@@ -508,7 +1077,7 @@ int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_
                 break;
             default:
                 //usage print
-                print_error("usage: %s [-n <nthread > 0>] [-q <qlen > 0>] {[-d <directory-name>] or [file-name-1, file-name-2, ..., file-name-m]} [-t <time delay>=0>]\n", programname);
+                print_error("usage: %s [-n <nthread > 0>] [-q <qlen > 0>] {[-d <directory-name>] or [file-name-1, file-name-2, ..., file-name-m]} [-t <time delay>=0>] [-a <compact|scatter|numa|cpu-list>] [-w] [-b <batch>] [-l <latency ms>] [-i] [-s] [-c <collector threads>] [-R <host:port>] [-L <port>] [-N <nodes>] [-m <memory budget KB>] [-o <output file>] [-B <binary result file>] [-D] [-Q <control socket>] [-M <metrics socket>] [-T <trace file>] [-S <server socket>]\n", programname);
                 return M_FAILURE;
         }
     }
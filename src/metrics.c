@@ -0,0 +1,255 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <metrics.h>
+#include <conn.h>
+
+/**
+ * \file metrics.c
+ * \brief Implementazione dell'interfaccia metrics.h
+ */
+
+volatile sig_atomic_t metrics_dump = 0;
+
+//dimensione iniziale del testo delle metriche (raddoppiata se non basta)
+#define _METRICS_TEXT_LEN 8192
+
+/** Testo delle metriche in costruzione
+ *
+ */
+typedef struct mtext
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+    int err;    // allocazione fallita
+} mtext_t;
+
+static void mprintf(mtext_t *t, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void mprintf(mtext_t *t, const char *fmt, ...){
+    while(!t->err){
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+        va_end(ap);
+        if(n < 0){
+            t->err = 1;
+            return;
+        }
+        if((size_t)n < t->cap - t->len){
+            t->len += n;
+            return;
+        }
+        char *tmp = realloc(t->buf, 2 * t->cap);
+        if(!tmp){
+            t->err = 1;
+            return;
+        }
+        t->buf = tmp;
+        t->cap *= 2;
+    }
+}
+
+//intestazione di una famiglia di metriche
+static void family(mtext_t *t, const char *name, const char *type, const char *help){
+    mprintf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static int flush_text(mtext_t *t, int fd){
+    int err = t->err || writen(fd, t->buf, t->len) == -1;
+    free(t->buf);
+    return err ? MT_FAILURE : MT_SUCCESS;
+}
+
+static int init_text(mtext_t *t){
+    memset(t, 0, sizeof(mtext_t));
+    t->cap = _METRICS_TEXT_LEN;
+    return (t->buf = malloc(t->cap)) ? MT_SUCCESS : MT_FAILURE;
+}
+
+//stima del tempo totale di una fase cronometrata su sampled dei total eventi
+static double scaled_sec(uint64_t ns, uint64_t sampled, uint64_t total){
+    return sampled ? (double)ns / 1e9 * ((double)total / sampled) : 0;
+}
+
+static void collector_text(mtext_t *t, collectorMetrics_t *c){
+    family(t, "farm_collector_results_total", "counter", "Results received by the Collector.");
+    mprintf(t, "farm_collector_results_total %lu\n", (unsigned long)METRIC_GET(c->results));
+    family(t, "farm_collector_errors_total", "counter", "Results received with an error status.");
+    mprintf(t, "farm_collector_errors_total %lu\n", (unsigned long)METRIC_GET(c->errors));
+    family(t, "farm_collector_bytes_total", "counter", "Frame bytes decoded by the Collector.");
+    mprintf(t, "farm_collector_bytes_total %lu\n", (unsigned long)METRIC_GET(c->bytes));
+    family(t, "farm_collector_snapshots_total", "counter", "Snapshots requested (SIGUSR1).");
+    mprintf(t, "farm_collector_snapshots_total %lu\n", (unsigned long)METRIC_GET(c->snapshots));
+    family(t, "farm_collector_queries_total", "counter", "Requests served on the control socket.");
+    mprintf(t, "farm_collector_queries_total %lu\n", (unsigned long)METRIC_GET(c->queries));
+    family(t, "farm_collector_cpu_seconds_total", "counter", "CPU time of the Collector main thread.");
+    mprintf(t, "farm_collector_cpu_seconds_total %.6f\n", thread_cpu_ns(&c->cpu) / 1e9);
+}
+
+/* ------------------- interfaccia delle metriche ------------------ */
+
+metrics_t *init_metrics(size_t nworkers){
+    metrics_t *m = calloc(1, sizeof(metrics_t));
+    if(!m)
+        return NULL;
+    //una cache line per Worker: i contatori di Workers diversi non condividono linee
+    void *w = NULL;
+    int err = posix_memalign(&w, 64, (nworkers ? nworkers : 1) * sizeof(workerMetrics_t));
+    if(err != 0){
+        free(m);
+        errno = err;
+        return NULL;
+    }
+    memset(w, 0, (nworkers ? nworkers : 1) * sizeof(workerMetrics_t));
+    m->workers = w;
+    m->nworkers = nworkers;
+    m->start_ns = now_ns(CLOCK_MONOTONIC);
+    return m;
+}
+
+void delete_metrics(metrics_t *m){
+    if(!m)
+        return;
+    free(m->workers);
+    free(m);
+}
+
+void bind_thread_clock(threadClock_t *c){
+    c->valid = (pthread_getcpuclockid(pthread_self(), &c->clock) == 0);
+    __atomic_store_n(&c->exited, 0, __ATOMIC_RELEASE);
+}
+
+void close_thread_clock(threadClock_t *c){
+    __atomic_store_n(&c->cpu_ns, now_ns(CLOCK_THREAD_CPUTIME_ID), __ATOMIC_RELAXED);
+    __atomic_store_n(&c->exited, 1, __ATOMIC_RELEASE);
+}
+
+uint64_t thread_cpu_ns(threadClock_t *c){
+    if(c->valid && !__atomic_load_n(&c->exited, __ATOMIC_ACQUIRE)){
+        struct timespec ts;
+        if(clock_gettime(c->clock, &ts) == 0) //fallisce se il thread ha appena terminato: vale il tempo salvato
+            return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+    return __atomic_load_n(&c->cpu_ns, __ATOMIC_RELAXED);
+}
+
+int write_metrics(metrics_t *m, int fd){
+    mtext_t t;
+    if(init_text(&t) != MT_SUCCESS)
+        return MT_FAILURE;
+
+    double up = (now_ns(CLOCK_MONOTONIC) - m->start_ns) / 1e9;
+    family(&t, "farm_uptime_seconds", "gauge", "Time since the MasterWorker started.");
+    mprintf(&t, "farm_uptime_seconds %.6f\n", up);
+
+    //visita del Master
+    masterMetrics_t *ms = &m->master;
+    uint64_t mfiles = METRIC_GET(ms->files), mbytes = METRIC_GET(ms->bytes);
+    family(&t, "farm_master_dirs_total", "counter", "Directories scanned by the Master.");
+    mprintf(&t, "farm_master_dirs_total %lu\n", (unsigned long)METRIC_GET(ms->dirs));
+    family(&t, "farm_master_files_total", "counter", "Files pushed into the queue.");
+    mprintf(&t, "farm_master_files_total %lu\n", (unsigned long)mfiles);
+    family(&t, "farm_master_bytes_total", "counter", "Bytes of the files pushed into the queue.");
+    mprintf(&t, "farm_master_bytes_total %lu\n", (unsigned long)mbytes);
+    family(&t, "farm_master_push_seconds_total", "counter", "Time spent pushing into the queue (estimated from 1 push in 16).");
+    mprintf(&t, "farm_master_push_seconds_total %.6f\n", scaled_sec(METRIC_GET(ms->push_ns), METRIC_GET(ms->pushes), mfiles));
+    family(&t, "farm_master_cpu_seconds_total", "counter", "CPU time of the Master thread.");
+    mprintf(&t, "farm_master_cpu_seconds_total %.6f\n", thread_cpu_ns(&ms->cpu) / 1e9);
+    family(&t, "farm_master_scan_done", "gauge", "1 once the initial scan is complete.");
+    mprintf(&t, "farm_master_scan_done %d\n", __atomic_load_n(&ms->scan_done, __ATOMIC_RELAXED));
+
+    //Workers: una famiglia alla volta (le righe di una famiglia devono essere consecutive)
+    static const char *phases[PHASE_N] = {"open", "read", "compute", "send"};
+    uint64_t files[m->nworkers ? m->nworkers : 1], sampled[m->nworkers ? m->nworkers : 1];
+    uint64_t done_files = 0, done_bytes = 0;
+    family(&t, "farm_worker_files_total", "counter", "Files processed by the Worker.");
+    for(size_t i = 0; i < m->nworkers; i++){
+        files[i] = METRIC_GET(m->workers[i].files);
+        sampled[i] = METRIC_GET(m->workers[i].sampled);
+        done_files += files[i];
+        mprintf(&t, "farm_worker_files_total{worker=\"%zu\"} %lu\n", i, (unsigned long)files[i]);
+    }
+    family(&t, "farm_worker_errors_total", "counter", "Files that could not be read or overflowed.");
+    for(size_t i = 0; i < m->nworkers; i++)
+        mprintf(&t, "farm_worker_errors_total{worker=\"%zu\"} %lu\n", i, (unsigned long)METRIC_GET(m->workers[i].errors));
+    family(&t, "farm_worker_bytes_total", "counter", "Bytes read by the Worker.");
+    for(size_t i = 0; i < m->nworkers; i++){
+        uint64_t b = METRIC_GET(m->workers[i].bytes);
+        done_bytes += b;
+        mprintf(&t, "farm_worker_bytes_total{worker=\"%zu\"} %lu\n", i, (unsigned long)b);
+    }
+    family(&t, "farm_worker_sends_total", "counter", "Batches sent to the Collector.");
+    for(size_t i = 0; i < m->nworkers; i++)
+        mprintf(&t, "farm_worker_sends_total{worker=\"%zu\"} %lu\n", i, (unsigned long)METRIC_GET(m->workers[i].sends));
+    family(&t, "farm_worker_phase_seconds_total", "counter", "Time per phase (open/read/compute estimated from 1 file in 16).");
+    double busy[m->nworkers ? m->nworkers : 1];
+    for(size_t i = 0; i < m->nworkers; i++){
+        busy[i] = 0;
+        for(int p = 0; p < PHASE_N; p++){
+            uint64_t ns = METRIC_GET(m->workers[i].phase_ns[p]);
+            double s = (p == PHASE_SEND) ? ns / 1e9 : scaled_sec(ns, sampled[i], files[i]);
+            busy[i] += s;
+            mprintf(&t, "farm_worker_phase_seconds_total{worker=\"%zu\",phase=\"%s\"} %.6f\n", i, phases[p], s);
+        }
+    }
+    family(&t, "farm_worker_busy_seconds_total", "counter", "Time spent outside the queue wait (sum of the phases).");
+    for(size_t i = 0; i < m->nworkers; i++)
+        mprintf(&t, "farm_worker_busy_seconds_total{worker=\"%zu\"} %.6f\n", i, busy[i]);
+    family(&t, "farm_worker_cpu_seconds_total", "counter", "CPU time of the Worker thread.");
+    for(size_t i = 0; i < m->nworkers; i++)
+        mprintf(&t, "farm_worker_cpu_seconds_total{worker=\"%zu\"} %.6f\n", i, thread_cpu_ns(&m->workers[i].cpu) / 1e9);
+
+    //avanzamento: byte in coda non ancora letti, alla velocita' media dall'avvio. I byte dei file con errore possono
+    //mancare (file rimosso, archivio non valido): calcolati tutti i file in coda, non resta niente da leggere
+    uint64_t remaining = (mbytes > done_bytes) ? mbytes - done_bytes : 0;
+    if(done_files >= mfiles && __atomic_load_n(&ms->scan_done, __ATOMIC_RELAXED))
+        remaining = 0;
+    double rate = (up > 0) ? done_bytes / up : 0;
+    family(&t, "farm_files_per_second", "gauge", "Average files per second since start.");
+    mprintf(&t, "farm_files_per_second %.3f\n", (up > 0) ? done_files / up : 0);
+    family(&t, "farm_bytes_per_second", "gauge", "Average bytes per second since start.");
+    mprintf(&t, "farm_bytes_per_second %.3f\n", rate);
+    family(&t, "farm_bytes_remaining", "gauge", "Bytes queued by the Master and not yet read by the Workers.");
+    mprintf(&t, "farm_bytes_remaining %lu\n", (unsigned long)remaining);
+    family(&t, "farm_progress_ratio", "gauge", "Bytes read over bytes queued (final once farm_master_scan_done is 1).");
+    mprintf(&t, "farm_progress_ratio %.4f\n", mbytes ? (double)(mbytes - remaining) / mbytes : 0);
+    family(&t, "farm_eta_seconds", "gauge", "Estimated time to read the remaining bytes at the average rate.");
+    if(remaining == 0)
+        mprintf(&t, "farm_eta_seconds 0\n");
+    else if(rate > 0)
+        mprintf(&t, "farm_eta_seconds %.3f\n", remaining / rate);
+    else
+        mprintf(&t, "farm_eta_seconds NaN\n");
+
+    if(m->collector)
+        collector_text(&t, m->collector);
+
+    return flush_text(&t, fd);
+}
+
+int write_collector_metrics(collectorMetrics_t *c, int fd){
+    mtext_t t;
+    if(init_text(&t) != MT_SUCCESS)
+        return MT_FAILURE;
+    collector_text(&t, c);
+    return flush_text(&t, fd);
+}
+
+char *collector_metrics_text(collectorMetrics_t *c, size_t *len){
+    mtext_t t;
+    if(init_text(&t) != MT_SUCCESS)
+        return NULL;
+    collector_text(&t, c);
+    if(t.err){
+        free(t.buf);
+        return NULL;
+    }
+    *len = t.len;
+    return t.buf;
+}
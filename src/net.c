@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net.h>
+#include <conn.h>
+#include <proto.h>
+#include <util.h>
+
+/**
+ * \file net.c
+ * \brief Implementazione dell'interfaccia net.h (socket TCP e handshake dei nodi)
+ */
+
+int tcp_listen(const char *port){
+    struct addrinfo hints, *res, *rp;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int err;
+    if((err = getaddrinfo(NULL, port, &hints, &res)) != 0){
+        print_error("getaddrinfo of port %s failed: %s\n", port, gai_strerror(err));
+        return N_FAILURE;
+    }
+
+    int fd = -1;
+    for(rp = res; rp != NULL; rp = rp->ai_next){
+        if((fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol)) == -1)
+            continue;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if(bind(fd, rp->ai_addr, rp->ai_addrlen) == 0 && listen(fd, MAXBACKLOG) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if(fd == -1){
+        perror("bind");
+        print_error("cannot listen on port %s\n", port);
+        return N_FAILURE;
+    }
+    return fd;
+}
+
+int tcp_connect(const char *addr, int retry_ms){
+    char host[_MAX_NET_ADDR_LEN];
+    if(strlen(addr) >= _MAX_NET_ADDR_LEN){
+        print_error("address %s too long\n", addr);
+        return N_FAILURE;
+    }
+    strcpy(host, addr);
+    char *port = strrchr(host, ':');
+    if(!port || port == host || port[1] == '\0'){
+        print_error("address %s is not in the form host:port\n", addr);
+        return N_FAILURE;
+    }
+    *port++ = '\0';
+
+    struct addrinfo hints, *res, *rp;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int err;
+    if((err = getaddrinfo(host, port, &hints, &res)) != 0){
+        print_error("getaddrinfo of %s failed: %s\n", addr, gai_strerror(err));
+        return N_FAILURE;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = retry_ms / 1000;
+    ts.tv_nsec = (retry_ms % 1000) * 1000000;
+
+    //provo a connettermi con attesa di retry_ms tra tentativi (il Collector centrale potrebbe non essere pronto)
+    int fd = -1;
+    for(int i = 0; i < _NET_CONNECT_RETRIES && fd == -1; i++){
+        for(rp = res; rp != NULL; rp = rp->ai_next){
+            if((fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol)) == -1)
+                continue;
+            if(connect(fd, rp->ai_addr, rp->ai_addrlen) == 0)
+                break;
+            close(fd);
+            fd = -1;
+        }
+        if(fd == -1)
+            nanosleep(&ts, NULL);
+    }
+    freeaddrinfo(res);
+
+    if(fd == -1){
+        perror("connect");
+        print_error("cannot connect to %s\n", addr);
+        return N_FAILURE;
+    }
+    return fd;
+}
+
+int node_hello(int fd, uint8_t role, uint32_t *node_id){
+    char buf[HELLO_LEN];
+    encode_hello(buf, role, (role == HELLO_MASTER) ? 0 : *node_id);
+    if(writen(fd, buf, HELLO_LEN) != 1){
+        perror("writen");
+        print_error("hello to the collector failed\n");
+        return N_FAILURE;
+    }
+    if(role != HELLO_MASTER)
+        return N_SUCCESS;
+
+    //il Collector risponde al Master con l'identificativo assegnato al nodo
+    uint8_t r;
+    if(readn(fd, buf, HELLO_LEN) <= 0 || decode_hello(buf, &r, node_id) != 0 || r != HELLO_MASTER){
+        print_error("node registration refused by the collector\n");
+        return N_FAILURE;
+    }
+    return N_SUCCESS;
+}
@@ -0,0 +1,233 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <query.h>
+#include <conn.h>
+#include <util.h>
+
+/**
+ * \file query.c
+ * \brief Implementazione dell'interfaccia query.h (socket di controllo del Collector)
+ */
+
+/** Risposta in costruzione, scritta direttamente nel buffer di uscita: righe "rank risultato path"
+ *          (starts contiene l'inizio di ogni riga, per top)
+ *
+ */
+typedef struct reply
+{
+    qOut_t *out;
+    size_t base;        // inizio della risposta in out->buf
+    int err;            // errore di allocazione
+    size_t rank;        // rank del prossimo elemento visitato
+    size_t starts[_QUERY_MAX_TOP];
+    size_t nlines;
+} reply_t;
+
+//spazio per altri len byte in out (riparte dall'inizio del buffer se tutto e' stato inviato)
+static int q_reserve(qOut_t *out, size_t len){
+    if(out->off > 0 && out->off == out->len)
+        out->off = out->len = 0;
+    if(out->len + len > out->cap){
+        size_t cap = out->cap ? out->cap : _QUERY_LINE_LEN;
+        while(cap < out->len + len)
+            cap *= 2;
+        char *tmp = realloc(out->buf, cap);
+        if(!tmp)
+            return Q_FAILURE;
+        out->buf = tmp;
+        out->cap = cap;
+    }
+    return Q_SUCCESS;
+}
+
+static void reply_line(reply_t *r, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void reply_line(reply_t *r, const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if(r->err || n < 0 || q_reserve(r->out, (size_t)n + 1) != Q_SUCCESS){
+        r->err = 1;
+        return;
+    }
+    va_start(ap, fmt);
+    vsnprintf(r->out->buf + r->out->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    r->out->len += n;
+}
+
+//SListVisit: aggiunge l'elemento alla risposta
+static int reply_entry(void *arg, long index, uint8_t status, const char *dir, size_t dir_len, const char *name){
+    reply_t *r = arg;
+    if(r->nlines < _QUERY_MAX_TOP)
+        r->starts[r->nlines] = r->out->len;
+    r->nlines++;
+    reply_line(r, "%zu %ld %.*s%s\n", r->rank++, index, (int)dir_len, dir, name);
+    return 0;
+}
+
+/**
+ * \brief legge un intero senza segno (tutta la stringa)
+ *
+ * \return 0 se s e' un numero valido, -1 altrimenti
+ */
+static int parse_size(const char *s, size_t *v){
+    char *end;
+    if(!s || *s == '\0' || *s == '-')
+        return -1;
+    errno = 0;
+    unsigned long long x = strtoull(s, &end, 10);
+    if(errno != 0 || *end != '\0')
+        return -1;
+    *v = x;
+    return 0;
+}
+
+int ctrl_listen(const char *path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= UNIX_PATH_MAX){
+        print_error("control socket name %s too long\n", path);
+        return Q_FAILURE;
+    }
+    strncpy(addr.sun_path, path, UNIX_PATH_MAX - 1);
+    unlink(path);
+
+    int fd, flags;
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
+        perror("socket");
+        return Q_FAILURE;
+    }
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, MAXBACKLOG) == -1
+        || (flags = fcntl(fd, F_GETFL, 0)) == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1){
+        perror("ctrl_listen");
+        close(fd);
+        return Q_FAILURE;
+    }
+    return fd;
+}
+
+int answer_query(SList *l, const char *req, qOut_t *out){
+    reply_t r;
+    memset(&r, 0, sizeof(r));
+    if(q_reserve(out, 0) != Q_SUCCESS)
+        return Q_FAILURE;
+    r.out = out;
+    r.base = out->len;
+
+    //comando e argomento (il resto della riga, per i path con spazi)
+    char cmd[16];
+    size_t cmd_len = strcspn(req, " ");
+    const char *arg = (req[cmd_len] == ' ') ? req + cmd_len + 1 : NULL;
+    snprintf(cmd, sizeof(cmd), "%.*s", (int)(cmd_len < sizeof(cmd) ? cmd_len : sizeof(cmd) - 1), req);
+    size_t n = countSList(l), v;
+
+    if(strcmp(cmd, "count") == 0 && !arg)
+        reply_line(&r, "%zu\n", n);
+    else if(strcmp(cmd, "path") == 0 && arg){
+        long index;
+        uint8_t status;
+        int found = findSList(l, arg, &index, &status);
+        if(found == 1 && status == 0){ //rank del primo risultato uguale
+            r.rank = (index == LONG_MIN) ? 0 : n - countAboveSList(l, index - 1);
+            reply_line(&r, "%zu %ld %s\n", r.rank, index, arg);
+        }
+        else if(found == -1)
+            reply_line(&r, "error: %s\n", strerror(errno));
+        else
+            reply_line(&r, "not found\n");
+    }
+    else if(strcmp(cmd, "rank") == 0 && parse_size(arg, &v) == 0){
+        r.rank = v;
+        if(v >= n || rangeSList(l, v, 1, reply_entry, &r) != 0 || r.nlines == 0)
+            reply_line(&r, "not found\n");
+    }
+    else if(strcmp(cmd, "pct") == 0 && arg){
+        char *end;
+        double p = strtod(arg, &end);
+        if(*end != '\0' || !(p >= 0 && p <= 100))
+            reply_line(&r, "error: percentile must be between 0 and 100\n");
+        else if(n == 0)
+            reply_line(&r, "not found\n");
+        else{ //nearest rank: il piu' piccolo risultato con almeno p% dei risultati <= di esso
+            size_t k = (size_t)ceil(p / 100.0 * n);
+            r.rank = (k > 0) ? k - 1 : 0;
+            if(rangeSList(l, r.rank, 1, reply_entry, &r) != 0 || r.nlines == 0)
+                reply_line(&r, "not found\n");
+        }
+    }
+    else if(strcmp(cmd, "above") == 0 && arg){
+        char *end;
+        errno = 0;
+        long value = strtol(arg, &end, 10);
+        if(*arg == '\0' || *end != '\0' || errno != 0)
+            reply_line(&r, "error: invalid value %s\n", arg);
+        else
+            reply_line(&r, "%zu\n", countAboveSList(l, value));
+    }
+    else if(strcmp(cmd, "top") == 0 && (!arg || parse_size(arg, &v) == 0)){
+        size_t k = arg ? v : _QUERY_DEFAULT_TOP;
+        if(k > _QUERY_MAX_TOP)
+            k = _QUERY_MAX_TOP;
+        if(k > n)
+            k = n;
+        r.rank = n - k;
+        if(k > 0 && rangeSList(l, n - k, k, reply_entry, &r) == 0 && !r.err && r.nlines <= _QUERY_MAX_TOP){ //righe in ordine inverso
+            size_t len = out->len - r.base;
+            char *rev = malloc(len);
+            if(rev){
+                size_t off = 0;
+                for(size_t i = r.nlines; i > 0; i--){
+                    size_t end = (i == r.nlines) ? out->len : r.starts[i];
+                    memcpy(rev + off, out->buf + r.starts[i - 1], end - r.starts[i - 1]);
+                    off += end - r.starts[i - 1];
+                }
+                memcpy(out->buf + r.base, rev, len);
+                free(rev);
+            }
+        }
+    }
+    else
+        reply_line(&r, "error: invalid query '%s' (count, path <path>, rank <k>, pct <p>, above <v>, top [k], metrics)\n", req);
+
+    reply_line(&r, "\n");
+    if(r.err){ //risposta incompleta: la tolgo dal buffer
+        out->len = r.base;
+        return Q_FAILURE;
+    }
+    return Q_SUCCESS;
+}
+
+int q_append(qOut_t *out, const char *data, size_t len){
+    if(q_reserve(out, len) != Q_SUCCESS)
+        return Q_FAILURE;
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+    return Q_SUCCESS;
+}
+
+int q_flush(qOut_t *out, int fd){
+    while(out->off < out->len){
+        ssize_t w = send(fd, out->buf + out->off, out->len - out->off, MSG_NOSIGNAL);
+        if(w == -1){
+            if(errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : Q_FAILURE;
+        }
+        out->off += w;
+    }
+    out->off = out->len = 0;
+    return 1;
+}
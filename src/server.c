@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <server.h>
+#include <master.h>
+#include <conn.h>
+#include <proto.h>
+#include <util.h>
+#include <pack_file.h>
+
+/**
+ * \file server.c
+ * \brief Implementazione dell'interfaccia server.h (job della modalita' server)
+ */
+
+jobTable_t *init_jobs(int max_path_len){
+    jobTable_t *jt = calloc(1, sizeof(jobTable_t));
+    if(!jt)
+        return NULL;
+    if(pthread_mutex_init(&jt->m, NULL) != 0 || pthread_cond_init(&jt->ready, NULL) != 0 || pthread_cond_init(&jt->done, NULL) != 0){
+        free(jt);
+        return NULL;
+    }
+    jt->max_path_len = max_path_len;
+    return jt;
+}
+
+void delete_jobs(jobTable_t *jt){
+    pthread_mutex_destroy(&jt->m);
+    pthread_cond_destroy(&jt->ready);
+    pthread_cond_destroy(&jt->done);
+    free(jt);
+}
+
+static void free_job(job_t *j){
+    if(j->tasks)
+        deleteBQueue(j->tasks);
+    if(j->l)
+        deleteSList(j->l);
+    free(j->errs);
+    free(j->argv);
+    free(j->req);
+    free(j);
+}
+
+//risposta immediata al client (richiesta non valida o job non avviato), poi chiude la connessione
+static void reply_error(int fd, const char *msg){
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "error: %s\n\n", msg);
+    writen(fd, buf, (n > 0 && (size_t)n < sizeof(buf)) ? (size_t)n : strlen(buf));
+    close(fd);
+}
+
+//aggiunge alla risposta del job la riga di errore di path, o la riga "error: <what>" se path e' NULL (con jt->m acquisito)
+static int add_error(job_t *j, const char *path, const char *what){
+    size_t need = (path ? strlen(path) : 0) + strlen(what) + 16;
+    if(j->errs_len + need > j->errs_cap){
+        size_t cap = (j->errs_cap == 0) ? 4096 : 2 * j->errs_cap;
+        while(cap < j->errs_len + need)
+            cap *= 2;
+        char *errs = realloc(j->errs, cap);
+        if(!errs)
+            return -1;
+        j->errs = errs;
+        j->errs_cap = cap;
+    }
+    if(path)
+        j->errs_len += snprintf(j->errs + j->errs_len, j->errs_cap - j->errs_len, "error: %s: %s\n", path, what);
+    else
+        j->errs_len += snprintf(j->errs + j->errs_len, j->errs_cap - j->errs_len, "error: %s\n", what);
+    return 0;
+}
+
+//job completato: tutti i task inseriti e un risultato per ogni file (con jt->m acquisito)
+static inline int job_complete(const job_t *j){
+    return j->dispatched && j->received == j->expected;
+}
+
+int job_result(jobTable_t *jt, uint16_t id, const char *path, long result, uint8_t status){
+    int ret = SV_FAILURE;
+    LOCK(&jt->m);
+    job_t *j = jt->slots[id % _SERVER_MAX_JOBS];
+    if(j && j->id == id){
+        if(status == FRAME_OK)
+            ret = (addNode(j->l, (char *)path, result) == -1) ? SV_FAILURE : SV_SUCCESS;
+        else
+            ret = (add_error(j, path, (status == FRAME_OVERFLOW) ? "overflow" : "file error") == -1) ? SV_FAILURE : SV_SUCCESS;
+        //contato anche se non registrato, cosi' il job termina comunque
+        j->received++;
+        jt->progress++;
+        if(job_complete(j))
+            BCAST(&jt->done);
+    }
+    UNLOCK(&jt->m);
+    return ret;
+}
+
+/**
+ * \brief Dispatcher: a turno preleva un task da ogni job (senza attendere) e lo inserisce, con l'identificativo
+ *          del job, nella coda dei Workers; conta i risultati attesi (uno per file, count per un task di un archivio).
+ *          Quando nessun job ha task pronti attende su ready, segnalata da job_task_ready ad ogni task inserito.
+ *          Dopo l'interruzione dei job (abort) scarta i task invece di inserirli.
+ *          Termina dopo stop_jobs, quando tutti i job hanno inserito i propri task
+ */
+static void *dispatcher(void *arg){
+    jobTable_t *jt = (jobTable_t *)arg;
+    const struct timespec past = {0, 0}; //scadenza gia' passata: timedPop non attende
+    char tagged[jt->max_path_len];
+
+    LOCK(&jt->m);
+    while(1){
+        job_t *j = NULL;
+        char *task = NULL;
+        int pending = 0; //job con task non ancora inseriti
+        for(size_t k = 0; k < _SERVER_MAX_JOBS && !task; k++){
+            size_t s = (jt->rr + k) % _SERVER_MAX_JOBS;
+            job_t *c = jt->slots[s];
+            if(!c || c->dispatched)
+                continue;
+            char *t = timedPop(c->tasks, &past);
+            if(t == EOS){ //scansione del job terminata: i risultati attesi sono definitivi
+                c->dispatched = 1;
+                if(job_complete(c))
+                    BCAST(&jt->done);
+            }
+            else if(t == QTIMEOUT || t == NULL)
+                pending = 1;
+            else{
+                task = t;
+                j = c;
+                jt->rr = s + 1;
+            }
+        }
+
+        if(task && jt->abort){ //job interrotti: il risultato del task non arriverebbe in tempo
+            free(task);
+            continue;
+        }
+        if(task){
+            uint64_t first, count = 1;
+            const char *pack_path;
+            if(task[0] == PK_TASK_MARK && pkParseTask(task, &first, &count, &pack_path) != PK_SUCCESS)
+                count = 1;
+            int fits = (svFormatTask(tagged, sizeof(tagged), j->id, task) == SV_SUCCESS);
+            if(fits) //contati prima dell'inserimento: il job non puo' risultare completo finche' EOS non e' prelevato
+                j->expected += count;
+            else
+                add_error(j, task, "path too long");
+            jt->pushing = j; //un job interrotto non viene liberato durante l'inserimento
+            UNLOCK(&jt->m);
+
+            int r = fits ? push(jt->q, tagged) : 0;
+            //coda dei Workers piena oltre WAIT_TIME_SECONDS: il server non termina, riprovo (tranne dopo abort)
+            while(r == -2 && !__atomic_load_n(&jt->abort, __ATOMIC_RELAXED))
+                r = push(jt->q, tagged);
+            free(task);
+
+            LOCK(&jt->m);
+            jt->pushing = NULL;
+            if(r == 0 && fits)
+                jt->progress++;
+            else if(r != 0){
+                if(r == -1)
+                    perror("push");
+                j->expected -= count;
+                add_error(j, tagged, "not queued");
+            }
+            if(jt->abort)
+                BCAST(&jt->done);
+            continue;
+        }
+
+        if(!pending && jt->stop)
+            break;
+        jt->idle = 1; //qualche job e' ancora in scansione, o nessun job: attendo un task, un job o stop_jobs
+        WAIT(&jt->ready, &jt->m);
+        jt->idle = 0;
+    }
+    UNLOCK(&jt->m);
+    return NULL;
+}
+
+void job_task_ready(jobTable_t *jt){
+    LOCK(&jt->m);
+    if(jt->idle)
+        SIGNAL(&jt->ready);
+    UNLOCK(&jt->m);
+}
+
+/**
+ * \brief Thread di un job: inserisce nella coda del job i task degli argomenti (scansione del Master), attende
+ *          la fine del job e scrive la risposta al client: i risultati ordinati, le righe di errore e una riga vuota
+ */
+static void *job_thread(void *arg){
+    job_t *j = (job_t *)arg;
+    jobTable_t *jt = j->jt;
+
+    masterArgs mARGS = *jt->mARGS;
+    int failed = 0; //un errore di push interrompe solo la scansione di questo job
+    mARGS.q = j->tasks;
+    mARGS.failed = &failed;
+    scan_args(j->argc, j->argv, 0, mARGS);
+    int r;
+    while((r = push(j->tasks, EOS)) == -2); //il dispatcher svuota la coda finche' il job non ha inserito EOS
+
+    LOCK(&jt->m);
+    if(r == -1){ //EOS non inserito: il dispatcher non preleva piu' i task del job, expected e' definitivo
+        perror("push");
+        failed = 1;
+        j->dispatched = 1;
+    }
+    if(failed)
+        add_error(j, NULL, "scan interrupted");
+    SIGNAL(&jt->ready);
+    //dopo abort il job viene chiuso appena il dispatcher non lo sta inserendo nella coda dei Workers
+    while(!job_complete(j) && (!jt->abort || jt->pushing == j))
+        WAIT(&jt->done, &jt->m);
+    if(!job_complete(j))
+        add_error(j, NULL, "job aborted");
+    //il job esce dalla tabella: il Collector thread non scrive piu' nel job e la risposta viene scritta senza lock
+    jt->slots[j->id % _SERVER_MAX_JOBS] = NULL;
+    UNLOCK(&jt->m);
+
+    //le scritture hanno una scadenza (_SERVER_SEND_MS, vedi submit_job): un client che non legge perde la risposta
+    if(printSList(j->l, j->fd) == -1 || (j->errs_len > 0 && writen(j->fd, j->errs, j->errs_len) == -1) || writen(j->fd, "\n", 1) == -1)
+        print_error("reply of job %d not sent\n", (int)j->id);
+    close(j->fd);
+    free_job(j);
+    LOCK(&jt->m);
+    jt->njobs--;
+    BCAST(&jt->done);
+    UNLOCK(&jt->m);
+    return NULL;
+}
+
+//crea un thread (detached se detach) con tutti i segnali mascherati: i segnali vengono gestiti dal Master
+static int start_thread(pthread_t *tid, void *(*fun)(void *), void *arg, int detach){
+    sigset_t mask, oldmask;
+    pthread_attr_t attr;
+    sigfillset(&mask);
+    if(pthread_attr_init(&attr) != 0)
+        return SV_FAILURE;
+    if(detach)
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+    int err = pthread_create(tid, &attr, fun, arg);
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    pthread_attr_destroy(&attr);
+    if(err != 0){
+        errno = err;
+        perror("pthread_create");
+        return SV_FAILURE;
+    }
+    return SV_SUCCESS;
+}
+
+int start_jobs(jobTable_t *jt, const struct mastArgs *mARGS){
+    jt->q = mARGS->q;
+    jt->mARGS = mARGS;
+    return start_thread(&jt->dispatcher, dispatcher, jt, 0);
+}
+
+//divide la richiesta in argomenti separati da spazi (in place)
+static int split_args(job_t *j){
+    size_t n = 0;
+    for(char *p = j->req; *p; p++)
+        n += (*p != ' ' && (p == j->req || p[-1] == ' '));
+    if(!(j->argv = malloc((n + 1) * sizeof(char *))))
+        return -1;
+    char *save;
+    for(char *tok = strtok_r(j->req, " ", &save); tok; tok = strtok_r(NULL, " ", &save))
+        j->argv[j->argc++] = tok;
+    j->argv[j->argc] = NULL;
+    return 0;
+}
+
+int submit_job(jobTable_t *jt, int fd, const char *req){
+    struct timeval tv = {_SERVER_SEND_MS / 1000, (_SERVER_SEND_MS % 1000) * 1000};
+    if(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == -1)
+        perror("setsockopt");
+    if(strncmp(req, "run ", 4) != 0){
+        reply_error(fd, "invalid request (run [-d <directory>] [<file>]...)");
+        return SV_FAILURE;
+    }
+    job_t *j = calloc(1, sizeof(job_t));
+    size_t len = strlen(req + 4);
+    if(!j || !(j->req = malloc(len + 1))){
+        free(j);
+        reply_error(fd, "out of memory");
+        return SV_FAILURE;
+    }
+    memcpy(j->req, req + 4, len + 1);
+    j->fd = fd;
+    j->jt = jt;
+    if(split_args(j) != 0 || !(j->tasks = initBQueue(_SERVER_JOB_QLEN, jt->max_path_len)) || !(j->l = initSList(jt->max_path_len))){
+        free_job(j);
+        reply_error(fd, "out of memory");
+        return SV_FAILURE;
+    }
+    if(j->argc == 0){
+        free_job(j);
+        reply_error(fd, "no input files / directory");
+        return SV_FAILURE;
+    }
+
+    //identificativo libero: lo slot id % _SERVER_MAX_JOBS deve essere vuoto
+    LOCK(&jt->m);
+    if(jt->stop || jt->njobs == _SERVER_MAX_JOBS){
+        UNLOCK(&jt->m);
+        free_job(j);
+        reply_error(fd, jt->stop ? "server shutting down" : "too many jobs");
+        return SV_FAILURE;
+    }
+    do{
+        jt->last_id = (jt->last_id == UINT16_MAX) ? 1 : jt->last_id + 1;
+    } while(jt->slots[jt->last_id % _SERVER_MAX_JOBS]);
+    j->id = jt->last_id;
+    jt->slots[j->id % _SERVER_MAX_JOBS] = j;
+    jt->njobs++;
+    SIGNAL(&jt->ready);
+    UNLOCK(&jt->m);
+
+    pthread_t tid;
+    if(start_thread(&tid, job_thread, j, 1) != SV_SUCCESS){
+        LOCK(&jt->m);
+        jt->slots[j->id % _SERVER_MAX_JOBS] = NULL;
+        jt->njobs--;
+        BCAST(&jt->done);
+        UNLOCK(&jt->m);
+        free_job(j);
+        reply_error(fd, "cannot start the job");
+        return SV_FAILURE;
+    }
+    return SV_SUCCESS;
+}
+
+void stop_jobs(jobTable_t *jt){
+    LOCK(&jt->m);
+    jt->stop = 1;
+    SIGNAL(&jt->ready);
+    size_t seen = jt->progress;
+    while(jt->njobs > 0){
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += _SERVER_STOP_MS / 1000;
+        ts.tv_nsec += (_SERVER_STOP_MS % 1000) * 1000000L;
+        if(ts.tv_nsec >= 1000000000L){
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        int r = pthread_cond_timedwait(&jt->done, &jt->m, &ts);
+        if(r != 0 && r != ETIMEDOUT){
+            fprintf(stderr, "ERRORE FATALE timed wait\n");
+            pthread_exit((void *)EXIT_FAILURE);
+        }
+        //nessun risultato e nessun task inserito per _SERVER_STOP_MS: i job rimasti non possono terminare
+        if(r == ETIMEDOUT && jt->progress == seen && !jt->abort){
+            print_error("%zu jobs aborted\n", jt->njobs);
+            __atomic_store_n(&jt->abort, 1, __ATOMIC_RELAXED);
+            BCAST(&jt->done);
+        }
+        seen = jt->progress;
+    }
+    UNLOCK(&jt->m);
+    CHECK_NEQ_EXIT("pthread_join", pthread_join(jt->dispatcher, NULL), 0, "pthread_join failed (dispatcher)\n");
+}
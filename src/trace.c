@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200112L
+#include <trace.h>
+
+#ifdef FARM_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <util.h>
+
+/**
+ * \file trace.c
+ * \brief File di implementazione del tracciamento del ciclo di vita dei file (vedi trace.h)
+ */
+
+/** Evento di un thread
+ *
+ */
+typedef struct traceEvent
+{
+    uint64_t start;
+    uint64_t end;
+    const char *path;   // copia nel buffer del thread, NULL se l'evento non riguarda un file
+    uint32_t n;         // risultati (invio e decodifica)
+    uint8_t type;
+} traceEvent_t;
+
+typedef struct traceBlock
+{
+    struct traceBlock *next;
+    size_t n;
+    traceEvent_t ev[_TRACE_BLOCK_EVENTS];
+} traceBlock_t;
+
+typedef struct traceChars
+{
+    struct traceChars *next;
+    size_t used;
+    char data[_TRACE_BLOCK_CHARS];
+} traceChars_t;
+
+/** Buffer di un thread: blocchi di eventi (in ordine) e blocchi dei path copiati
+ *
+ */
+typedef struct traceBuf
+{
+    struct traceBuf *next;  // lista globale dei buffer
+    int tid;                // identificativo del thread nel trace (ordine di registrazione)
+    char name[32];
+    traceBlock_t *first;
+    traceBlock_t *last;
+    traceChars_t *chars;    // blocco corrente in testa
+    size_t dropped;         // eventi persi per errore di allocazione
+} traceBuf_t;
+
+int trace_on = 0;
+static char trace_file[_MAX_TRACE_FILE_LEN];
+static char trace_part[_MAX_TRACE_FILE_LEN];    // eventi del Collector processo
+static traceBuf_t *buffers = NULL;   // inserimento in testa con compare-and-swap
+static int next_tid = 0;
+static uint64_t origin_ns;          // istante di trace_init, origine dei timestamp (ereditato dal Collector processo)
+static __thread traceBuf_t *tbuf = NULL;
+
+static uint64_t trace_now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int trace_init(const char *file){
+    if(strlen(file) + strlen(_TRACE_COLLECTOR_SUFFIX) >= _MAX_TRACE_FILE_LEN){
+        errno = ENAMETOOLONG;
+        return TR_FAILURE;
+    }
+    FILE *f = fopen(file, "w");
+    if(!f)
+        return TR_FAILURE;
+    fclose(f);
+    strcpy(trace_file, file);
+    strcat(strcpy(trace_part, file), _TRACE_COLLECTOR_SUFFIX);
+    origin_ns = trace_now();
+    trace_on = 1;
+    return TR_SUCCESS;
+}
+
+/**
+ * \brief Restituisce il buffer del thread chiamante, allocandolo e registrandolo alla prima chiamata
+ */
+static traceBuf_t *thread_buf(){
+    if(tbuf)
+        return tbuf;
+    traceBuf_t *b = calloc(1, sizeof(traceBuf_t));
+    if(!b)
+        return NULL;
+    b->tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+    snprintf(b->name, sizeof(b->name), "thread %d", b->tid);
+    b->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&buffers, &b->next, b, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return tbuf = b;
+}
+
+void trace_thread(const char *name, long idx){
+    traceBuf_t *b = thread_buf();
+    if(!b)
+        return;
+    if(idx < 0)
+        snprintf(b->name, sizeof(b->name), "%s", name);
+    else
+        snprintf(b->name, sizeof(b->name), "%s %ld", name, idx);
+}
+
+void trace_event(traceType_t type, uint64_t start, uint64_t end, const char *path, size_t n){
+    traceBuf_t *b = thread_buf();
+    if(!b)
+        return;
+    if(!b->last || b->last->n == _TRACE_BLOCK_EVENTS){
+        traceBlock_t *blk = malloc(sizeof(traceBlock_t));
+        if(!blk){
+            b->dropped++;
+            return;
+        }
+        blk->next = NULL;
+        blk->n = 0;
+        if(b->last)
+            b->last->next = blk;
+        else
+            b->first = blk;
+        b->last = blk;
+    }
+
+    const char *copy = NULL;
+    if(path){
+        size_t len = strlen(path) + 1;
+        if(len > _TRACE_BLOCK_CHARS)
+            len = _TRACE_BLOCK_CHARS;
+        if(!b->chars || b->chars->used + len > _TRACE_BLOCK_CHARS){
+            traceChars_t *c = malloc(sizeof(traceChars_t));
+            if(!c){
+                b->dropped++;
+                return;
+            }
+            c->next = b->chars;
+            c->used = 0;
+            b->chars = c;
+        }
+        char *dst = b->chars->data + b->chars->used;
+        memcpy(dst, path, len - 1);
+        dst[len - 1] = '\0';
+        b->chars->used += len;
+        copy = dst;
+    }
+
+    traceEvent_t *e = &b->last->ev[b->last->n++];
+    e->start = start;
+    e->end = end;
+    e->path = copy;
+    e->n = n;
+    e->type = type;
+}
+
+/* ------------------- scrittura del trace ------------------ */
+
+static const char *type_names[TR_N] = {"push", "pop", "open", "read", "compute", "send", "decode", "receive"};
+
+//hash FNV-1a del path: identificativo degli intervalli asincroni del file, uguale nei due processi
+static uint64_t path_id(const char *path){
+    uint64_t h = 14695981039346656037ULL;
+    for(; *path; path++){
+        h ^= (unsigned char)*path;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void json_string(FILE *f, const char *s){
+    fputc('"', f);
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static double us(uint64_t ns){
+    return (ns > origin_ns) ? (ns - origin_ns) / 1000.0 : 0;
+}
+
+//intervallo asincrono name (ph 'b' o 'e') del file path
+static void write_async(FILE *f, int pid, int tid, const char *name, char ph, uint64_t ts, const char *path){
+    fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"file\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"id2\":{\"global\":\"0x%016llx\"}",
+        name, ph, us(ts), pid, tid, (unsigned long long)path_id(path));
+    if(ph == 'b'){
+        fprintf(f, ",\"args\":{\"path\":");
+        json_string(f, path);
+        fputc('}', f);
+    }
+    fputc('}', f);
+}
+
+static void write_event(FILE *f, int pid, int tid, const traceEvent_t *e){
+    if(e->type != TR_RECEIVE){ //slice della fase sul thread
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{",
+            type_names[e->type], us(e->start), (e->end - e->start) / 1000.0, pid, tid);
+        if(e->path){
+            fprintf(f, "\"path\":");
+            json_string(f, e->path);
+        }
+        else
+            fprintf(f, "\"results\":%u", e->n);
+        fprintf(f, "}}");
+    }
+    if(!e->path)
+        return;
+    switch(e->type){
+        case TR_PUSH: write_async(f, pid, tid, "queued", 'b', e->end, e->path); break;
+        case TR_POP: write_async(f, pid, tid, "queued", 'e', e->end, e->path); break;
+        case TR_COMPUTE: write_async(f, pid, tid, "pending", 'b', e->end, e->path); break;
+        case TR_RECEIVE: write_async(f, pid, tid, "pending", 'e', e->start, e->path); break;
+        default: break;
+    }
+}
+
+/**
+ * \brief Accoda a f gli eventi scritti dal Collector processo (se presenti) e rimuove il file
+ */
+static int append_collector(FILE *f, const char *part){
+    FILE *in = fopen(part, "r");
+    if(!in)
+        return (errno == ENOENT) ? TR_SUCCESS : TR_FAILURE;
+    char buf[65536];
+    size_t r;
+    while((r = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, r, f);
+    int err = ferror(in);
+    fclose(in);
+    unlink(part);
+    return err ? TR_FAILURE : TR_SUCCESS;
+}
+
+int trace_write(int collector){
+    const char *name = collector ? trace_part : trace_file;
+    FILE *f;
+    CHECK_EQ_RETURN("fopen", f = fopen(name, "w"), NULL, TR_FAILURE, "cannot open trace file %s\n", name);
+
+    int pid = getpid();
+    //il primo evento del MasterWorker apre la lista: tutti gli altri (compresi quelli del Collector) sono preceduti da ','
+    if(!collector)
+        fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"farm MasterWorker\"}}", pid);
+    else
+        fprintf(f, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"farm Collector\"}}", pid);
+
+    size_t dropped = 0;
+    traceBuf_t *b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+    while(b){
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, b->tid);
+        json_string(f, b->name);
+        fprintf(f, "}}");
+        for(traceBlock_t *blk = b->first; blk; ){
+            for(size_t i = 0; i < blk->n; i++)
+                write_event(f, pid, b->tid, &blk->ev[i]);
+            traceBlock_t *next = blk->next;
+            free(blk);
+            blk = next;
+        }
+        for(traceChars_t *c = b->chars; c; ){
+            traceChars_t *next = c->next;
+            free(c);
+            c = next;
+        }
+        dropped += b->dropped;
+        traceBuf_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    buffers = NULL;
+    tbuf = NULL;
+
+    int ret = TR_SUCCESS;
+    if(!collector){
+        ret = append_collector(f, trace_part);
+        fprintf(f, "\n]}\n");
+    }
+    if(dropped > 0)
+        print_error("trace: %zu events dropped (alloc error)\n", dropped);
+    if(ferror(f))
+        ret = TR_FAILURE;
+    if(fclose(f) != 0)
+        ret = TR_FAILURE;
+    return ret;
+}
+
+#endif // FARM_TRACE
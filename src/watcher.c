@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <watcher.h>
+#include <util.h>
+
+#define WATCH_FILE_MASK (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define WATCH_DIR_MASK (WATCH_FILE_MASK | IN_CREATE | IN_ONLYDIR)
+
+/**
+ * \file watcher.c
+ * \brief Implementazione dell'interfaccia watcher.h (inotify)
+ */
+
+int init_watcher(watcher_t *w, size_t max_path_len){
+    memset(w, 0, sizeof(watcher_t));
+    w->max_path_len = max_path_len;
+    SYSCALL_RETURN("inotify_init1", w->fd, inotify_init1(IN_NONBLOCK | IN_CLOEXEC), W_FAILURE, "inotify_init1 failed\n");
+    return W_SUCCESS;
+}
+
+int add_watch_dir(watcher_t *w, const char *path){
+    int wd;
+    if((wd = inotify_add_watch(w->fd, path, WATCH_DIR_MASK)) == -1){
+        perror("inotify_add_watch");
+        print_error("cannot watch %s (errno=%d)\n", path, errno);
+        return W_FAILURE;
+    }
+
+    if(wd >= w->npaths){ //raddoppio la tabella wd -> path
+        int newsize = (w->npaths == 0) ? 16 : w->npaths;
+        while(newsize <= wd)
+            newsize *= 2;
+        char **tmp = realloc(w->paths, newsize * sizeof(char *));
+        if(!tmp){
+            perror("realloc");
+            inotify_rm_watch(w->fd, wd);
+            return W_FAILURE;
+        }
+        memset(tmp + w->npaths, 0, (newsize - w->npaths) * sizeof(char *));
+        w->paths = tmp;
+        w->npaths = newsize;
+    }
+
+    //la stessa directory puo' essere aggiunta piu' volte (stesso wd): se e' stata spostata aggiorno il path
+    char *dup;
+    CHECK_EQ_RETURN("strdup", dup = strdup(path), NULL, W_FAILURE, "strdup of %s failed\n", path);
+    free(w->paths[wd]);
+    w->paths[wd] = dup;
+
+    return W_SUCCESS;
+}
+
+long read_watch_events(watcher_t *w, char *buf){
+    long n;
+    while((n = read(w->fd, buf, _WATCH_EVENTS_BUF_LEN)) == -1){
+        if(errno == EINTR)
+            continue;
+        if(errno == EAGAIN)
+            return 0;
+        return -1;
+    }
+    return n;
+}
+
+watchEvent_t next_watch_event(watcher_t *w, const char *buf, long len, long *off, char *path){
+    while(*off < len){
+        const struct inotify_event *ev = (const struct inotify_event *)(buf + *off);
+        *off += sizeof(struct inotify_event) + ev->len;
+
+        if(ev->mask & IN_Q_OVERFLOW){
+            print_error("inotify queue overflow: some events were lost\n");
+            continue;
+        }
+        if(ev->wd < 0 || ev->wd >= w->npaths || w->paths[ev->wd] == NULL)
+            continue;
+        if(ev->mask & IN_IGNORED){ //directory rimossa o non piu' monitorata
+            free(w->paths[ev->wd]);
+            w->paths[ev->wd] = NULL;
+            continue;
+        }
+        if(ev->len == 0)
+            continue;
+
+        if(strlen(w->paths[ev->wd]) + strlen(ev->name) + 2 > w->max_path_len){
+            print_error("file or sub-directory %s/%s is too long\n", w->paths[ev->wd], ev->name);
+            continue;
+        }
+        snprintf(path, w->max_path_len, "%s/%s", w->paths[ev->wd], ev->name);
+
+        if(ev->mask & IN_ISDIR){
+            if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+                return WATCH_DIR;
+        }
+        else if(ev->mask & WATCH_FILE_MASK)
+            return WATCH_FILE;
+    }
+    return WATCH_NONE;
+}
+
+void delete_watcher(watcher_t *w){
+    if(!w)
+        return;
+    for(int i = 0; i < w->npaths; i++)
+        free(w->paths[i]);
+    free(w->paths);
+    w->paths = NULL;
+    w->npaths = 0;
+    if(w->fd > 0)
+        close(w->fd);
+}
@@ -1,112 +1,558 @@
+#define _POSIX_C_SOURCE 200112L
 #include <worker.h>
 #include <conc_queue.h>
 #include <conn.h>
 #include <string.h>
 #include <util.h>
-#include <math.h>
+#include <proto.h>
+#include <net.h>
+#include <trace.h>
+#include <compact_file.h>
+#include <pack_file.h>
+#include <server.h>
 
 #include <pthread.h>
+#include <sys/stat.h>
 
 #define OVERFLOW -2
 #define FILE_ERROR -1
 
+/**
+ * \brief Risultato dei len byte di un file (o di un'entry di un archivio) name: array di long o formato compatto
+ *
+ * \retval result se il risultato è stato calcolato senza problemi
+ * \retval OVERFLOW se è stato rilevato un overflow
+ * \retval FILE_ERROR se il file compatto non e' valido
+ */
+static long data_result(const void *data, size_t len, const char *name){
+    if(cfIsCompact(data, len)){ //formato compatto: decodifica e calcolo in un solo passaggio
+        long ret = cfCompute(data, len);
+        if(ret == CF_FAILURE)
+            print_error("invalid compact file %s\n", name);
+        return (ret == CF_OVERFLOW) ? OVERFLOW : (ret == CF_FAILURE) ? FILE_ERROR : ret;
+    }
+
+    const long *arr = data;
+    int num_elements = len / sizeof(long); //assumendo che i dati vengano interpretati come 'long'
+    long ret = 0;
+    for (int i = 0; i < num_elements; i++){ //effettuo calcolo
+        ret = safeAdd(ret, arr[i] * i);
+        if(ret < 0)
+            return OVERFLOW;
+    }
+    return ret;
+}
+
 /** 
- * \brief Task eseguito dal Worker
+ * \brief Task eseguito dal Worker: file grezzo (array di long) o in formato compatto (compact_file.h), riconosciuto dall'header
  *
  * \param file_to_calculate nome del file dal calcolare (task)
+ * \param buf buffer di lettura del Worker (riallocato se troppo piccolo)
+ * \param buf_size dimensione (in byte) di *buf
+ * \param size dimensione del file (0 se non e' stato possibile ricavarla)
+ * \param ts se non NULL, istanti (CLOCK_MONOTONIC) di inizio, apertura, lettura e fine del calcolo
  * 
  * \retval result se il risultato è stato calcolato senza problemi
  * \retval OVERFLOW se è stato rilevato un overflow
  * \retval FILE_ERROR se è stato rilevato un errore durante la gestione del file
  */
-static long compute_result(char* file_to_calculate){
-    long ret = 0;
+static long compute_result(char* file_to_calculate, long **buf, size_t *buf_size, long *size, uint64_t *ts){
     FILE *file;
+    *size = 0;
+    if(ts)
+        ts[0] = now_ns(CLOCK_MONOTONIC);
     CHECK_EQ_RETURN("fopen", file = fopen(file_to_calculate, "rb"), NULL, FILE_ERROR, "fopen error of %s\n", file_to_calculate);
 
-    CHECK_NEQ_RETURN("fseek", fseek(file, 0, SEEK_END), 0, FILE_ERROR, "fseek error of file %s\n", file_to_calculate);
+    if(fseek(file, 0, SEEK_END) != 0){
+        perror("fseek");
+        print_error("fseek error of file %s\n", file_to_calculate);
+        fclose(file);
+        return FILE_ERROR;
+    }
     long file_size;
     //recupero lunghezza file
-    CHECK_EQ_RETURN("ftell", file_size = ftell(file), -1, FILE_ERROR, "ftell error of file %s\n", file_to_calculate);
-    //per ottenere numero di elementi (assumendo che i dati vengano interpretati come 'long')
-    int num_elements = file_size / sizeof(long);
+    if((file_size = ftell(file)) == -1){
+        perror("ftell");
+        print_error("ftell error of file %s\n", file_to_calculate);
+        fclose(file);
+        return FILE_ERROR;
+    }
+    *size = file_size;
+    if(ts)
+        ts[1] = now_ns(CLOCK_MONOTONIC);
+    //riuso il buffer del Worker, riallocandolo solo se il file non ci sta (lungo un numero intero di long)
+    size_t need = (file_size + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+    if(need > *buf_size){
+        long *tmp = realloc(*buf, need);
+        if(!tmp){
+            perror("realloc");
+            print_error("realloc error");
+            fclose(file);
+            return FILE_ERROR;
+        }
+        *buf = tmp;
+        *buf_size = need;
+    }
+    long *arr = *buf;
 
-    long *arr;
-    CHECK_EQ_RETURN("malloc", arr = (long int *)malloc(num_elements * sizeof(long int)), NULL, FILE_ERROR, "malloc error");
+    //mi riposiziono in cima e leggo da file
+    if(fseek(file, 0, SEEK_SET) != 0 || fread(arr, 1, file_size, file) != file_size){
+        perror("fread");
+        print_error("fread error of file %s\n", file_to_calculate);
+        fclose(file);
+        return FILE_ERROR;
+    }
 
-    //mi riposiziono in cima
-    CHECK_NEQ_RETURN("fseek", fseek(file, 0, SEEK_SET), 0, FILE_ERROR, "fseek error of file %s\n", file_to_calculate);
-    //e leggo da file
-    CHECK_NEQ_RETURN("fread", fread(arr, sizeof(long int), num_elements, file), num_elements, FILE_ERROR, "fread error of file %s\n", file_to_calculate);
+    fclose(file);
+    if(ts)
+        ts[2] = now_ns(CLOCK_MONOTONIC);
 
-    for (int i = 0; i < num_elements; i++){ //effettuo calcolo
-        ret = safeAdd(ret, arr[i] * i);
-        if(ret < 0)
-            return OVERFLOW;
+    long ret = data_result(arr, file_size, file_to_calculate);
+    if(ts)
+        ts[3] = now_ns(CLOCK_MONOTONIC);
+
+    return ret;
+}
+
+/** Buffer di invio del Worker: header dei frame e path dei risultati non ancora inviati.
+ *  I path (allocati da pop) vengono inviati senza copie tramite writev e liberati dopo l'invio.
+ */
+typedef struct outBatch
+{
+    char (*hdrs)[FRAME_HEADER_LEN];
+    char **paths;
+    struct iovec *iov;
+    size_t n;                   // risultati nel buffer
+    size_t max;                 // capienza del buffer (-b)
+    size_t latency;             // permanenza massima (ms) di un risultato nel buffer (-l)
+    struct timespec deadline;   // istante entro cui il buffer va inviato (CLOCK_REALTIME)
+} outBatch_t;
+
+/**
+ * \brief Inizializza il buffer di invio
+ *
+ * \retval 0 in caso di successo
+ * \retval -1 in caso di errore di allocazione
+ */
+static int init_batch(outBatch_t *b, size_t max, size_t latency){
+    memset(b, 0, sizeof(outBatch_t));
+    b->max = (max == 0) ? 1 : max;
+    b->latency = latency;
+    b->hdrs = malloc(b->max * FRAME_HEADER_LEN);
+    b->paths = malloc(b->max * sizeof(char *));
+    b->iov = malloc(2 * b->max * sizeof(struct iovec));
+    if(!b->hdrs || !b->paths || !b->iov){
+        perror("malloc");
+        free(b->hdrs);
+        free(b->paths);
+        free(b->iov);
+        return -1;
     }
+    return 0;
+}
 
-    free(arr);
+/**
+ * \brief Aggiunge un risultato del job job (0 fuori dalla modalita' server) al buffer di invio
+ *          (il buffer diventa proprietario di path)
+ */
+static void batch_add(outBatch_t *b, long result, uint8_t status, char *path, size_t max_path_len, uint16_t job){
+    if(b->n == 0){ //primo risultato: fisso la scadenza del buffer
+        clock_gettime(CLOCK_REALTIME, &b->deadline);
+        b->deadline.tv_sec += b->latency / 1000;
+        b->deadline.tv_nsec += (b->latency % 1000) * 1000000;
+        if(b->deadline.tv_nsec >= 1000000000){
+            b->deadline.tv_sec++;
+            b->deadline.tv_nsec -= 1000000000;
+        }
+    }
+    size_t path_len = strlen(path);
+    if(path_len > max_path_len - 1)
+        path_len = max_path_len - 1;
+    encode_header(b->hdrs[b->n], result, status, path_len, job);
+    b->paths[b->n] = path;
+    b->iov[2 * b->n].iov_base = b->hdrs[b->n];
+    b->iov[2 * b->n].iov_len = FRAME_HEADER_LEN;
+    b->iov[2 * b->n + 1].iov_base = path;
+    b->iov[2 * b->n + 1].iov_len = path_len;
+    b->n++;
+}
 
-    fclose(file);
+/**
+ * \brief Controlla se il buffer va inviato (pieno o scaduto)
+ */
+static int batch_due(outBatch_t *b){
+    if(b->n == 0)
+        return 0;
+    if(b->n == b->max || b->latency == 0)
+        return 1;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (now.tv_sec > b->deadline.tv_sec) || (now.tv_sec == b->deadline.tv_sec && now.tv_nsec >= b->deadline.tv_nsec);
+}
 
-    return ret;
+/**
+ * \brief Invia al Collector tutti i risultati del buffer: con una sola writev sul socket oppure,
+ *          in modalità -i, come unico messaggio sulla coda del Collector thread (nessuna syscall);
+ *          in modalità -s i frame vengono scritti direttamente negli slot del ring condiviso
+ *
+ * \param b buffer di invio
+ * \param sockfd socket connesso al Collector (ignorato se mq != NULL o ring != NULL)
+ * \param mq coda del Collector thread (NULL se si usa il socket)
+ * \param ring ring condiviso con il Collector (NULL se si usa il socket)
+ * \param m metriche del Worker (tempo di invio e numero di invii)
+ *
+ * \retval 0 in caso di successo
+ * \retval -1 in caso di errore di scrittura
+ */
+static int batch_flush(outBatch_t *b, int sockfd, MQueue_t *mq, SRing_t *ring, workerMetrics_t *m){
+    if(b->n == 0)
+        return 0;
+    uint64_t start = now_ns(CLOCK_MONOTONIC);
+    int ret = 1;
+    if(ring){ //riempio uno slot alla volta con frame completi (uno slot contiene sempre almeno un frame)
+        size_t i = 0;
+        while(i < b->n){
+            uint64_t ticket;
+            char *slot = sringReserve(ring, &ticket);
+            if(!slot){ //Collector terminato: come EPIPE sul socket
+                ret = -1;
+                break;
+            }
+            size_t used = 0;
+            while(i < b->n && used + FRAME_HEADER_LEN + b->iov[2 * i + 1].iov_len <= ring->sh->slot_size){
+                memcpy(slot + used, b->hdrs[i], FRAME_HEADER_LEN);
+                memcpy(slot + used + FRAME_HEADER_LEN, b->paths[i], b->iov[2 * i + 1].iov_len);
+                used += FRAME_HEADER_LEN + b->iov[2 * i + 1].iov_len;
+                i++;
+            }
+            sringPublish(ring, ticket, used);
+        }
+    }
+    else if(mq){
+        size_t len = 0;
+        for(size_t i = 0; i < 2 * b->n; i++)
+            len += b->iov[i].iov_len;
+        MQNode_t *node = allocMQNode(MQ_FRAMES, len);
+        if(node){
+            char *p = node->data;
+            for(size_t i = 0; i < 2 * b->n; i++){
+                memcpy(p, b->iov[i].iov_base, b->iov[i].iov_len);
+                p += b->iov[i].iov_len;
+            }
+            ret = (mqPush(mq, node) == 0) ? 1 : -1;
+        }
+        else
+            ret = -1;
+    }
+    else
+        ret = writevn(sockfd, b->iov, 2 * b->n);
+    uint64_t stop = now_ns(CLOCK_MONOTONIC);
+    TRACE_EVENT(TR_SEND, start, stop, NULL, b->n);
+    for(size_t i = 0; i < b->n; i++)
+        free(b->paths[i]);
+    b->n = 0;
+    METRIC_ADD(m->phase_ns[PHASE_SEND], stop - start);
+    METRIC_ADD(m->sends, 1);
+    return (ret == 1) ? 0 : -1;
 }
 
 /**
- * \brief Funzione che rappresenta il ciclo di vita del Worker
+ * \brief Libera il buffer di invio (ed eventuali path non inviati)
+ */
+static void delete_batch(outBatch_t *b){
+    for(size_t i = 0; i < b->n; i++)
+        free(b->paths[i]);
+    free(b->hdrs);
+    free(b->paths);
+    free(b->iov);
+}
+
+/** Archivio mappato dal Worker: resta mappato finche' i task sono dello stesso archivio
+ *
+ */
+typedef struct workerPack
+{
+    Pack_t pack;
+    char *path;     // NULL se nessun archivio e' mappato
+} workerPack_t;
+
+/**
+ * \brief Copia di name (al piu' max_path_len - 1 caratteri), di cui diventa proprietario il buffer di invio
+ */
+static char *copy_name(const char *name, size_t max_path_len){
+    size_t len = strlen(name);
+    if(len > max_path_len - 1)
+        len = max_path_len - 1;
+    char *copy = malloc(len + 1);
+    if(copy){
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * \brief Task di un archivio: calcola le entry [first, first + count) dell'archivio del task (mappato una sola volta)
+ *          ed aggiunge i risultati al buffer di invio con il nome logico di ogni entry
+ *
+ * \retval 0 se tutte le entry sono state calcolate
+ * \retval 1 in caso di errore di calcolo (overflow, entry non valida o archivio non valido, comunicati al Collector;
+ *          per un archivio non valido un errore per ogni entry del task se il task e' di un job):
+ *          come per un file il Worker termina (tranne in modalita' server), dopo aver calcolato tutte le entry del task
+ * \retval -1 in caso di errore di invio o di allocazione
+ */
+static int compute_pack_task(const char *task, uint16_t job, workerPack_t *wp, outBatch_t *out, int sockfd, MQueue_t *mq, SRing_t *ring, workerMetrics_t *m, size_t max_path_len){
+    uint64_t first, count;
+    const char *path;
+    if(pkParseTask(task, &first, &count, &path) != PK_SUCCESS)
+        return -1;
+    if(!wp->path || strcmp(wp->path, path) != 0){ //archivio diverso dal precedente: lo mappo
+        pkClose(&wp->pack);
+        free(wp->path);
+        wp->path = NULL;
+        if(pkOpen(&wp->pack, path) != PK_SUCCESS || first + count > wp->pack.h->nentries){
+            print_error("invalid pack %s\n", path);
+            pkClose(&wp->pack);
+            //le entry del task non sono calcolabili: contano come file con errore (i byte non sono noti)
+            METRIC_ADD(m->files, count);
+            METRIC_ADD(m->errors, count);
+            //un errore con il path dell'archivio, uno per entry in modalita' server (il job attende count risultati)
+            for(uint64_t i = 0; i < (job ? count : 1); i++){
+                char *name = copy_name(path, max_path_len);
+                if(!name)
+                    return -1;
+                batch_add(out, FILE_ERROR, FRAME_FILE_ERROR, name, max_path_len, job);
+                if(out->n == out->max && batch_flush(out, sockfd, mq, ring, m) != 0)
+                    return -1;
+            }
+            return 1;
+        }
+        if(!(wp->path = copy_name(path, max_path_len)))
+            return -1;
+    }
+
+    int err = 0;
+    for(uint64_t i = first; i < first + count; i++){
+        const char *name = pkName(&wp->pack, i);
+        uint64_t length = wp->pack.idx[i].length;
+        int sample = (m->files % _METRICS_SAMPLE) == 0 || TRACE_ON;
+        uint64_t start = sample ? now_ns(CLOCK_MONOTONIC) : 0;
+        long result = data_result(pkData(&wp->pack, i), length, name);
+        uint8_t status = (result == OVERFLOW) ? FRAME_OVERFLOW : (result < 0) ? FRAME_FILE_ERROR : FRAME_OK;
+
+        METRIC_ADD(m->files, 1);
+        METRIC_ADD(m->bytes, length);
+        if(status != FRAME_OK){
+            METRIC_ADD(m->errors, 1);
+            err = 1;
+        }
+        else if(sample){ //nessuna apertura o lettura: l'entry e' gia' in memoria
+            uint64_t stop = now_ns(CLOCK_MONOTONIC);
+            METRIC_ADD(m->phase_ns[PHASE_COMPUTE], stop - start);
+            METRIC_ADD(m->sampled, 1);
+            TRACE_EVENT(TR_COMPUTE, start, stop, name, 0);
+        }
+
+        char *copy = copy_name(name, max_path_len);
+        if(!copy)
+            return -1;
+        batch_add(out, result, status, copy, max_path_len, job);
+        if(out->n == out->max && batch_flush(out, sockfd, mq, ring, m) != 0)
+            return -1;
+    }
+    return err;
+}
+
+/**
+ * \brief Ciclo di vita del Worker: preleva i file dalla coda, li calcola e invia i risultati al Collector fino a EOS
  *
  * \param arg argomento del Worker void* (in questo caso viene passato threadArgs_t)
  */
-void *main_worker(void *arg){
+static void *worker_loop(void *arg){
     BQueue_t *q = ((threadArgs_t*)arg)->q;
     int max_path_len = ((threadArgs_t *)arg)->max_path_len;
     const char* sockname = ((threadArgs_t *)arg)->sockname;
+    size_t id = ((threadArgs_t *)arg)->id;
+    const affinity_t *aff = ((threadArgs_t *)arg)->aff;
+    workerMetrics_t *m = ((threadArgs_t *)arg)->metrics;
+    int server = ((threadArgs_t *)arg)->server;
 
-    const size_t MAX_WORKER_MESS_LEN = max_path_len + 1 + 10; //+1 term char + 10 long size
+    //pinning del Worker (se richiesto con -a) prima di allocare il buffer di lettura
+    pin_worker(aff, id);
 
-    int sockfd;
-    SYSCALL_RETURN("socket", sockfd, socket(AF_UNIX, SOCK_STREAM, 0), NULL, "socket error\n");
+    //buffer di lettura riusato per tutti i file; lo azzero subito cosi' le pagine
+    //vengono toccate per la prima volta da questo thread (first-touch sul nodo NUMA locale)
+    size_t buf_size = _WORKER_BUF_INIT_SIZE;
+    long *buf;
+    CHECK_EQ_RETURN("malloc", buf = malloc(buf_size), NULL, NULL, "malloc error");
+    memset(buf, 0, buf_size);
 
-    struct sockaddr_un server_addr;
-    server_addr.sun_family = AF_UNIX;
-    CHECK_NEQ_RETURN("strcpy", strcpy(server_addr.sun_path, sockname), server_addr.sun_path, NULL, "strcpy of %s failed\n", sockname);
+    MQueue_t *mq = ((threadArgs_t *)arg)->mq;
+    SRing_t *ring = ((threadArgs_t *)arg)->ring;
 
-    int notused;
-    //mi connetto a Collector
-    SYSCALL_RETURN("connect", notused, connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)), NULL, "connect error\n");
+    const char *remote = ((threadArgs_t *)arg)->remote;
 
-    char buff[MAX_WORKER_MESS_LEN];
+    int sockfd = -1;
+    if(remote){ //nodo remoto: mi connetto al Collector centrale via TCP e mi presento con l'identificativo del nodo
+        uint32_t node_id = ((threadArgs_t *)arg)->node_id;
+        if((sockfd = tcp_connect(remote, _WORKER_RETRY_MS)) == N_FAILURE || node_hello(sockfd, HELLO_WORKER, &node_id) != N_SUCCESS){
+            print_error("connection to the collector %s failed\n", remote);
+            if(sockfd != N_FAILURE)
+                close(sockfd);
+            free(buf);
+            return NULL;
+        }
+    }
+    else if(!mq && !ring){ //modalità standard: mi connetto al Collector via socket
+        if((sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
+            perror("socket");
+            print_error("socket error\n");
+            free(buf);
+            return NULL;
+        }
+
+        struct sockaddr_un server_addr;
+        server_addr.sun_family = AF_UNIX;
+        CHECK_NEQ_RETURN("strcpy", strcpy(server_addr.sun_path, sockname), server_addr.sun_path, NULL, "strcpy of %s failed\n", sockname);
+
+        int notused;
+        //mi connetto a Collector
+        if((notused = connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr))) == -1){
+            perror("connect");
+            print_error("connect error\n");
+            close(sockfd);
+            free(buf);
+            return NULL;
+        }
+    }
+
+    //buffer di invio: i risultati vengono spediti insieme quando il buffer e' pieno,
+    //quando il piu' vecchio supera la latenza massima oppure a fine stream
+    outBatch_t out;
+    if(init_batch(&out, ((threadArgs_t *)arg)->batch, ((threadArgs_t *)arg)->latency) != 0){
+        if(sockfd != -1)
+            close(sockfd);
+        free(buf);
+        return NULL;
+    }
+    workerPack_t wp;
+    memset(&wp, 0, sizeof(wp));
 
     while(1){
-        char* file_to_calculate = pop(q); //estraggo file
+        //con risultati in attesa di invio non resto bloccato oltre la loro scadenza
+        uint64_t pop_start = TRACE_ON ? now_ns(CLOCK_MONOTONIC) : 0;
+        char* file_to_calculate = (out.n == 0) ? pop(q) : timedPop(q, &out.deadline);
         if(!file_to_calculate) //q parametro non valido or calloc error
-            return NULL;
+            break;
+
+        if(file_to_calculate == QTIMEOUT){ //scaduta la latenza massima: invio il buffer
+            if(batch_flush(&out, sockfd, mq, ring, m) != 0){
+                print_error("no readers in the channel\n");
+                break;
+            }
+            continue;
+        }
             
         if(file_to_calculate == EOS) //se si tratta di EOS termino vita Worker
             break;
 
-        CHECK_NEQ_RETURN("memset", memset(buff, 0, MAX_WORKER_MESS_LEN), buff, NULL, "memset failed\n");
+        TRACE_EVENT(TR_POP, pop_start, now_ns(CLOCK_MONOTONIC), file_to_calculate, 0);
 
-        long result = compute_result(file_to_calculate);
-        if(result < 0){ //error
+        //modalita' server: il task porta il job a cui appartiene, riportato nei frame
+        uint16_t job = svParseTask(file_to_calculate);
+
+        if(file_to_calculate[0] == PK_TASK_MARK){ //task di un archivio: piu' entry per task
+            int r = compute_pack_task(file_to_calculate, job, &wp, &out, sockfd, mq, ring, m, max_path_len);
             free(file_to_calculate);
-            break; 
+            if(r == -1)
+                print_error("no readers in the channel\n");
+            if(r == -1 || (r == 1 && !server)) //error: comunico l'esito al Collector (vedi sotto) e termino il Worker
+                break;
+            if(batch_due(&out) && batch_flush(&out, sockfd, mq, ring, m) != 0){
+                print_error("no readers in the channel\n");
+                break;
+            }
+            continue;
         }
 
-        int res_len = (int) log10(result) + 1;
-        CHECK_NEQ_RETURN("sprintf", sprintf(buff, "%ld%s", result, file_to_calculate), res_len + strlen(file_to_calculate), NULL, "sprintf error\n");
-        free(file_to_calculate);
-        if((writen(sockfd, buff, MAX_WORKER_MESS_LEN)) == -1) {
-            print_error("no readers in the channel\n");
-            close(sockfd);
-            return NULL;
+        //le fasi vengono cronometrate su un file ogni _METRICS_SAMPLE (4 letture del clock per file costerebbero troppo sui file piccoli),
+        //su tutti con il trace attivo
+        uint64_t ts[4];
+        int sample = (m->files % _METRICS_SAMPLE) == 0 || TRACE_ON;
+        long size;
+        long result = compute_result(file_to_calculate, &buf, &buf_size, &size, sample ? ts : NULL);
+        uint8_t status = FRAME_OK;
+        if(result == OVERFLOW)
+            status = FRAME_OVERFLOW;
+        else if(result < 0)
+            status = FRAME_FILE_ERROR;
+
+        //file non leggibile: conto comunque la sua dimensione (se nota), come il Master che l'ha messo in coda,
+        //cosi' i byte rimanenti delle metriche si azzerano
+        struct stat st;
+        if(status == FRAME_FILE_ERROR && size == 0 && stat(file_to_calculate, &st) == 0)
+            size = st.st_size;
+        METRIC_ADD(m->files, 1);
+        METRIC_ADD(m->bytes, size);
+        if(status != FRAME_OK)
+            METRIC_ADD(m->errors, 1);
+        else if(sample){
+            METRIC_ADD(m->phase_ns[PHASE_OPEN], ts[1] - ts[0]);
+            METRIC_ADD(m->phase_ns[PHASE_READ], ts[2] - ts[1]);
+            METRIC_ADD(m->phase_ns[PHASE_COMPUTE], ts[3] - ts[2]);
+            METRIC_ADD(m->sampled, 1);
+            TRACE_EVENT(TR_OPEN, ts[0], ts[1], file_to_calculate, 0);
+            TRACE_EVENT(TR_READ, ts[1], ts[2], file_to_calculate, 0);
+            TRACE_EVENT(TR_COMPUTE, ts[2], ts[3], file_to_calculate, 0);
         }
 
+        batch_add(&out, result, status, file_to_calculate, max_path_len, job);
+
+        //error: comunico l'esito al Collector (vedi sotto) e termino il Worker (in modalita' server l'esito va al job)
+        if(status != FRAME_OK && !server)
+            break;
+
         #ifdef RETURN_AFTER_ONE_TASK //test purposes (vedi relazione test 7)
+            batch_flush(&out, sockfd, mq, ring, m);
+            if(sockfd != -1)
+                close(sockfd); //il Collector attende la chiusura di tutte le connessioni dei Workers
+            delete_batch(&out);
+            pkClose(&wp.pack);
+            free(wp.path);
+            free(buf);
             return NULL;
         #endif
+
+        if(batch_due(&out) && batch_flush(&out, sockfd, mq, ring, m) != 0){
+            print_error("no readers in the channel\n");
+            break;
+        }
     }
 
-    close(sockfd);
+    //invio i risultati rimasti nel buffer (EOS, errore di calcolo)
+    if(batch_flush(&out, sockfd, mq, ring, m) != 0)
+        print_error("no readers in the channel\n");
+
+    if(sockfd != -1)
+        close(sockfd);
+    delete_batch(&out);
+    pkClose(&wp.pack);
+    free(wp.path);
+    free(buf);
     return NULL;
 }
+
+/**
+ * \brief Funzione che rappresenta il ciclo di vita del Worker
+ *
+ * \param arg argomento del Worker void* (in questo caso viene passato threadArgs_t)
+ */
+void *main_worker(void *arg){
+    //il tempo di CPU del Worker resta leggibile dal thread delle metriche anche dopo la sua terminazione
+    workerMetrics_t *m = ((threadArgs_t *)arg)->metrics;
+    bind_thread_clock(&m->cpu);
+    TRACE_THREAD("worker", (long)((threadArgs_t *)arg)->id);
+    void *ret = worker_loop(arg);
+    close_thread_clock(&m->cpu);
+    return ret;
+}
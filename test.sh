@@ -195,4 +195,434 @@ else
         echo "test7 passed"
     fi
     rm file0.txt
-fi
\ No newline at end of file
+fi
+
+#
+# esecuzione con workers legati alle cpu (-a): i risultati devono coincidere con expected.txt
+# per tutte le politiche di affinity (compact, scatter, numa e lista esplicita di cpu)
+#
+res=0
+for policy in compact scatter numa 0; do
+    ./farm -n 4 -q 4 -a $policy file* -d testdir | grep "file*" | awk '{print $1,$2}' | diff - expected.txt
+    if [[ $? != 0 ]]; then
+        res=1
+    fi
+done
+if [[ $res != 0 ]]; then
+    echo "test8 failed"
+else
+    echo "test8 passed"
+fi
+
+#
+# modalità watch (-w): dopo la scansione iniziale (watchdir vuota) farm resta in ascolto;
+# il file generato successivamente deve essere calcolato, poi farm viene terminato con SIGTERM
+#
+mkdir -p watchdir
+./farm -w -d watchdir > watch_out.txt 2>&1 &
+pid=$!
+sleep 1
+exp=$(./generafile watchdir/file200.dat 1000 | awk '{print $3}')
+sleep 1
+kill $pid
+wait $pid
+echo "$exp watchdir/file200.dat" | diff - watch_out.txt
+if [[ $? != 0 ]]; then
+    echo "test9 failed"
+else
+    echo "test9 passed"
+fi
+rm -r watchdir
+
+#
+# esecuzione con Collector thread nello stesso processo (-i), senza socket
+#
+./farm -i -n 4 -q 4 file* -d testdir | grep "file*" | awk '{print $1,$2}' | diff - expected.txt
+if [[ $? != 0 ]]; then
+    echo "test10 failed"
+else
+    echo "test10 passed"
+fi
+
+#
+# esecuzione con ring in memoria condivisa tra Workers e Collector (-s), anche con batch di un solo risultato
+#
+res=0
+for b in 64 1; do
+    ./farm -s -b $b -n 4 -q 4 file* -d testdir | grep "file*" | awk '{print $1,$2}' | diff - expected.txt
+    if [[ $? != 0 ]]; then
+        res=1
+    fi
+done
+if [[ $res != 0 ]]; then
+    echo "test11 failed"
+else
+    echo "test11 passed"
+fi
+
+#
+# Collector con thread di ingestione (-c), anche insieme al ring in memoria condivisa
+#
+res=0
+for opt in "-c 2" "-c 3 -b 1" "-c 2 -s"; do
+    ./farm $opt -n 4 -q 4 file* -d testdir | grep "file*" | awk '{print $1,$2}' | diff - expected.txt
+    if [[ $? != 0 ]]; then
+        res=1
+    fi
+done
+if [[ $res != 0 ]]; then
+    echo "test12 failed"
+else
+    echo "test12 passed"
+fi
+
+#
+# modalità distribuita su loopback: Collector centrale (-L) con due nodi remoti (-R),
+# ognuno con una parte dei file; il Collector centrale stampa i risultati di tutti i nodi
+#
+port=47213
+./farm -L $port -N 2 file1* > nodes_out.txt &
+pid=$!
+./farm -R 127.0.0.1:$port -n 2 file[2-9]*
+./farm -R localhost:$port -d testdir
+wait $pid
+grep "file*" nodes_out.txt | awk '{print $1,$2}' | diff - expected.txt
+if [[ $? != 0 ]]; then
+    echo "test13 failed"
+else
+    echo "test13 passed"
+fi
+
+#
+# budget di memoria del Collector (-m): i risultati vengono scritti su disco e fusi alla stampa,
+# anche con thread di ingestione, Collector thread e ring in memoria condivisa
+#
+res=0
+for opt in "-m 1" "-m 1 -c 2" "-m 1 -i" "-m 4 -s -b 1"; do
+    ./farm $opt -n 4 -q 4 file* -d testdir | grep "file*" | awk '{print $1,$2}' | diff - expected.txt
+    if [[ $? != 0 ]]; then
+        res=1
+    fi
+done
+if [[ $res != 0 ]]; then
+    echo "test14 failed"
+else
+    echo "test14 passed"
+fi
+
+#
+# stampa dei risultati su file (-o), anche con Collector thread e con budget di memoria
+#
+res=0
+for opt in "" "-i" "-m 1"; do
+    ./farm $opt -o results_out.txt -n 4 -q 4 file* -d testdir > /dev/null
+    grep "file*" results_out.txt | awk '{print $1,$2}' | diff - expected.txt
+    if [[ $? != 0 ]]; then
+        res=1
+    fi
+done
+if [[ $res != 0 ]]; then
+    echo "test15 failed"
+else
+    echo "test15 passed"
+fi
+
+#
+# file binario indicizzato dei risultati (-B): lettura completa con farmres e ricerca per path, rank e valore
+#
+res=0
+./farm -B results.frs -n 4 -q 4 file* -d testdir > /dev/null
+./farmres results.frs | grep "file*" | awk '{print $1,$2}' | diff - expected.txt || res=1
+read value path < <(tail -n 1 expected.txt)
+last=$(( $(wc -l < expected.txt) - 1 ))
+[[ "$(./farmres results.frs -p $path | awk '{print $1,$2,$3}')" == "$last $value ok" ]] || res=1
+[[ "$(./farmres results.frs -r $last | awk '{print $2,$4}')" == "$value $path" ]] || res=1
+[[ "$(./farmres results.frs -v $value | awk '{print $2}')" == "$value" ]] || res=1
+./farmres results.frs -p not_a_result.dat > /dev/null && res=1
+rm -f results.frs
+if [[ $res != 0 ]]; then
+    echo "test16 failed"
+else
+    echo "test16 passed"
+fi
+
+#
+# snapshot non bloccanti (SIGUSR1) stampati da un thread del Collector, completi e incrementali (-D):
+# ogni riga degli snapshot e' un risultato atteso, con -D nessun risultato compare in due snapshot
+# e la stampa finale resta completa
+#
+res=0
+n=$(wc -l < expected.txt)
+for opt in "" "-D" "-D -i" "-D -c 2 -m 1"; do
+    ./farm $opt -o results_snap.txt -n 2 -q 4 -t 100 file* -d testdir > /dev/null &
+    pid=$!
+    for i in 1 2; do
+        sleep .7
+        kill -USR1 $pid 2> /dev/null
+    done
+    wait $pid
+    tail -n $n results_snap.txt | awk '{print $1,$2}' | diff - expected.txt > /dev/null || res=1
+    head -n -$n results_snap.txt | awk '{print $1,$2}' | grep -v -x -F -f expected.txt && res=1
+    if [[ "$opt" != "" && -n "$(head -n -$n results_snap.txt | sort | uniq -d)" ]]; then
+        res=1
+    fi
+done
+rm -f results_snap.txt
+if [[ $res != 0 ]]; then
+    echo "test17 failed"
+else
+    echo "test17 passed"
+fi
+
+#
+# socket di controllo del Collector (-Q): farm in modalità watch resta in esecuzione dopo aver calcolato tutti i file,
+# le interrogazioni (rank, percentile, path, soglia, top) vengono confrontate con expected.txt
+#
+res=0
+n=$(wc -l < expected.txt)
+for opt in "" "-c 2" "-m 1"; do
+    ./farm -w $opt -Q farm_ctrl.sck -n 4 -q 4 file* -d testdir > /dev/null &
+    pid=$!
+    for i in $(seq 50); do
+        [[ "$(./farmq farm_ctrl.sck count 2> /dev/null)" == "$n" ]] && break
+        sleep .1
+    done
+    [[ "$(./farmq farm_ctrl.sck rank 0)" == "0 $(head -n 1 expected.txt)" ]] || res=1
+    [[ "$(./farmq farm_ctrl.sck top 1)" == "$((n - 1)) $(tail -n 1 expected.txt)" ]] || res=1
+    [[ "$(./farmq farm_ctrl.sck top 3 | awk '{print $2}')" == "$(tail -n 3 expected.txt | tac | awk '{print $1}')" ]] || res=1
+    [[ "$(./farmq farm_ctrl.sck pct 50)" == "10 $(sed -n 11p expected.txt)" ]] || res=1
+    read value path < <(sed -n 11p expected.txt)
+    [[ "$(./farmq farm_ctrl.sck above $value)" == "$((n - 11))" ]] || res=1
+    [[ "$(./farmq farm_ctrl.sck path testdir/file8.dat)" == "$(grep -n " testdir/file8.dat" expected.txt | awk -F: '{print $1 - 1, $2}')" ]] || res=1
+    ./farmq farm_ctrl.sck path not_a_result.dat > /dev/null && res=1
+    kill $pid
+    wait $pid
+    [[ -e farm_ctrl.sck ]] && res=1
+done
+if [[ $res != 0 ]]; then
+    echo "test18 failed"
+else
+    echo "test18 passed"
+fi
+
+#
+# metriche (-M e SIGUSR2): a calcolo terminato i contatori di Master, Workers e Collector corrispondono ai file
+# di expected.txt, l'avanzamento e' completo e la stampa finale non cambia
+#
+res=0
+n=$(wc -l < expected.txt)
+for opt in "" "-i"; do
+    ./farm -w $opt -M farm_metrics.sck -Q farm_ctrl.sck -n 4 -q 4 file* -d testdir > results_metrics.txt 2> metrics_err.txt &
+    pid=$!
+    for i in $(seq 50); do
+        ./farmq farm_metrics.sck metrics > metrics.txt 2> /dev/null
+        [[ "$opt" == "" ]] && ./farmq farm_ctrl.sck metrics >> metrics.txt 2> /dev/null
+        [[ "$(grep -E '^farm_(collector_results_total|worker_files_total)' metrics.txt | awk '{s += $2} END {print s}')" == "$((2 * n))" ]] && break
+        sleep .1
+    done
+    ./farmq farm_metrics.sck metrics > metrics.txt
+    grep -q -x "farm_master_files_total $n" metrics.txt || res=1
+    grep -q -x "farm_bytes_remaining 0" metrics.txt || res=1
+    grep -q -x "farm_progress_ratio 1.0000" metrics.txt || res=1
+    [[ "$(grep '^farm_worker_files_total' metrics.txt | wc -l)" == "4" ]] || res=1
+    [[ "$(grep '^farm_worker_cpu_seconds_total' metrics.txt | wc -l)" == "4" ]] || res=1
+    [[ "$opt" == "-i" ]] && { grep -q -x "farm_collector_results_total $n" metrics.txt || res=1; }
+    [[ "$opt" == "" ]] && { [[ "$(./farmq farm_ctrl.sck metrics | grep '^farm_collector_results_total')" == "farm_collector_results_total $n" ]] || res=1; }
+    kill -USR2 $pid
+    sleep .3
+    kill $pid
+    wait $pid
+    grep -q -x "farm_master_files_total $n" metrics_err.txt || res=1
+    grep -q -x "farm_collector_results_total $n" metrics_err.txt || res=1
+    awk '{print $1,$2}' results_metrics.txt | diff - expected.txt > /dev/null || res=1
+    [[ -e farm_metrics.sck ]] && res=1
+done
+rm -f results_metrics.txt metrics_err.txt metrics.txt
+if [[ $res != 0 ]]; then
+    echo "test19 failed"
+else
+    echo "test19 passed"
+fi
+
+#
+# trace del ciclo di vita dei file (tracefarm -T): per ogni file di expected.txt il trace contiene le fasi del Worker
+# e gli intervalli "queued" e "pending" (questi ultimi chiusi dal Collector, processo o thread); la stampa non cambia
+#
+res=0
+n=$(wc -l < expected.txt)
+[[ -x ./tracefarm ]] || make -s tracefarm > /dev/null 2>&1
+for opt in "" "-i"; do
+    ./tracefarm $opt -T farm_trace.json -n 4 -q 4 file* -d testdir > results_trace.txt 2> /dev/null || res=1
+    awk '{print $1,$2}' results_trace.txt | diff - expected.txt > /dev/null || res=1
+    for ev in '"name":"queued","cat":"file","ph":"b"' '"name":"queued","cat":"file","ph":"e"' '"name":"pending","cat":"file","ph":"b"' '"name":"pending","cat":"file","ph":"e"' '"name":"compute","cat":"phase","ph":"X"'; do
+        [[ "$(grep -c -F "$ev" farm_trace.json)" == "$n" ]] || res=1
+    done
+    tail -n 1 farm_trace.json | grep -q -x "]}" || res=1
+    [[ -e farm_trace.json.collector ]] && res=1
+done
+rm -f results_trace.txt farm_trace.json
+if [[ $res != 0 ]]; then
+    echo "test20 failed"
+else
+    echo "test20 passed"
+fi
+
+#
+# generatore parallelo di alberi di file: con lo stesso seme l'albero (ed il manifest) non dipende dal numero di thread,
+# e la stampa di farm (ordinata) coincide con il manifest dei risultati attesi; i file non .dat vengono scartati
+#
+res=0
+./generatree -d gentree -n 500 -s lognormal:1024:1.5 -D 2 -F 3 -x 0.1 -j 1 -m gentree1.manifest 2> /dev/null || res=1
+rm -rf gentree
+./generatree -d gentree -n 500 -s lognormal:1024:1.5 -D 2 -F 3 -x 0.1 -j 4 2> /dev/null || res=1
+diff gentree1.manifest gentree.manifest > /dev/null || res=1
+./farm -d gentree 2> /dev/null | LC_ALL=C sort -k1,1n -k2,2 | diff - gentree.manifest > /dev/null || res=1
+[[ "$(find gentree -name '*.dat' | wc -l)" == "$(wc -l < gentree.manifest)" ]] || res=1
+rm -rf gentree gentree1.manifest gentree.manifest
+if [[ $res != 0 ]]; then
+    echo "test21 failed"
+else
+    echo "test21 passed"
+fi
+
+#
+# formato compatto: i file di expected.txt convertiti con farmconv (codifica scelta, 2 e 8 byte, delta varint)
+# danno gli stessi risultati dei .dat grezzi, e la riconversione (-r) restituisce il file originale
+#
+res=0
+rm -rf compactdir
+i=0
+while read -r r f; do
+    mkdir -p "compactdir/$(dirname "$f")"
+    case $((i % 4)) in
+        0) opt="" ;;
+        1) opt="-w 2" ;;
+        2) opt="-w 8" ;;
+        3) opt="-e delta" ;;
+    esac
+    ./farmconv $opt "$f" "compactdir/$f" 2> /dev/null || res=1
+    ./farmconv -r "compactdir/$f" compact_raw.dat 2> /dev/null && cmp -s compact_raw.dat "$f" || res=1
+    i=$((i + 1))
+done < expected.txt
+./farm -n 4 -d compactdir 2> /dev/null | awk '{print $1,$2}' | sed 's#compactdir/##' | diff - expected.txt > /dev/null || res=1
+./farm -i -s -d compactdir 2> /dev/null | awk '{print $1,$2}' | sed 's#compactdir/##' | diff - expected.txt > /dev/null || res=1
+rm -rf compactdir compact_raw.dat
+if [[ $res != 0 ]]; then
+    echo "test22 failed"
+else
+    echo "test22 passed"
+fi
+
+#
+# archivio di input: farm sull'archivio dei file di expected.txt (con un file compatto) stampa gli stessi risultati
+# con i path originali (ordinati anche per path: file2.dat e pack_c.dat hanno lo stesso risultato); un archivio troncato
+# viene scartato
+#
+res=0
+./farmconv -w 4 file2.dat pack_c.dat 2> /dev/null || res=1
+./farmpack test.fpk $(awk '{print $2}' expected.txt) pack_c.dat 2> /dev/null || res=1
+(cat expected.txt; echo "$(awk '$2 == "file2.dat" {print $1}' expected.txt) pack_c.dat") | LC_ALL=C sort -k1,1n -k2,2 > pack_expected.txt
+./farm -n 4 -q 1 test.fpk 2> /dev/null | awk '{print $1,$2}' | LC_ALL=C sort -k1,1n -k2,2 | diff - pack_expected.txt > /dev/null || res=1
+./farm -i -b 2 test.fpk 2> /dev/null | awk '{print $1,$2}' | LC_ALL=C sort -k1,1n -k2,2 | diff - pack_expected.txt > /dev/null || res=1
+head -c 100 test.fpk > test_bad.fpk
+[[ "$(./farm test_bad.fpk file1.dat 2> /dev/null)" == "153259244 file1.dat" ]] || res=1
+rm -f test.fpk test_bad.fpk pack_c.dat pack_expected.txt
+if [[ $res != 0 ]]; then
+    echo "test23 failed"
+else
+    echo "test23 passed"
+fi
+
+#
+# modalita' server: job concorrenti sullo stesso MasterWorker, ognuno con i propri risultati; una richiesta non valida
+# riceve un errore; con SIGTERM il server termina con exit status 0 e rimuove il socket
+#
+res=0
+rm -f farm_srv.sck
+./farm -n 2 -q 2 -S farm_srv.sck 2> /dev/null &
+pid=$!
+for i in $(seq 1 50); do
+    [[ -S farm_srv.sck ]] && break
+    sleep 0.1
+done
+clients=""
+for k in 1 2 3; do
+    ./farmq farm_srv.sck run $(awk '{print $2}' expected.txt) > srv_all$k.txt &
+    clients="$clients $!"
+done
+./farmq farm_srv.sck run file1.dat -d testdir/testdir2 > srv_part.txt || res=1
+wait $clients
+for k in 1 2 3; do
+    diff srv_all$k.txt expected.txt > /dev/null || res=1
+done
+grep -E " (file1.dat|testdir/testdir2/.*)$" expected.txt | diff - srv_part.txt > /dev/null || res=1
+./farmq farm_srv.sck count > /dev/null 2>&1 && res=1
+kill -TERM $pid
+wait $pid || res=1
+[[ -e farm_srv.sck ]] && res=1
+rm -f srv_all*.txt srv_part.txt farm_srv.sck
+if [[ $res != 0 ]]; then
+    echo "test24 failed"
+else
+    echo "test24 passed"
+fi
+
+#
+# ring in memoria condivisa (-s): se il Collector processo termina, i Workers smettono di attendere gli slot
+# e farm termina invece di restare bloccato
+#
+res=0
+rm -rf ringdir farm_sock.sck
+mkdir ringdir
+for i in $(seq 1 1000); do
+    printf '\x01\x00\x00\x00\x00\x00\x00\x00' > ringdir/r$i.dat
+done
+./farm -s -b 1 -n 2 -q 4 -t 2 -d ringdir > /dev/null 2>&1 &
+pid=$!
+sleep 0.3
+pkill -KILL -P $pid || res=1
+for i in $(seq 1 200); do
+    kill -0 $pid 2> /dev/null || break
+    sleep 0.1
+done
+if kill -0 $pid 2> /dev/null; then
+    res=1
+    kill -KILL $pid
+fi
+wait $pid
+rm -rf ringdir farm_sock.sck
+if [[ $res != 0 ]]; then
+    echo "test25 failed"
+else
+    echo "test25 passed"
+fi
+
+#
+# modalità watch (-w): un file riscritto sostituisce il proprio risultato, anche nella stampa con SIGUSR1;
+# un file di una sotto-directory creata dopo l'avvio (trovato sia dalla scansione che dagli eventi) viene stampato una volta
+#
+res=0
+rm -rf watchdir
+mkdir -p watchdir
+./farm -w -d watchdir > watch_out.txt 2>&1 &
+pid=$!
+sleep 1
+./generafile watchdir/a.dat 100 > /dev/null
+sleep 1
+exp=$(./generafile watchdir/a.dat 200 | awk '{print $3}')
+mkdir watchdir/sub
+exp2=$(./generafile watchdir/sub/b.dat 300 | awk '{print $3}')
+sleep 1
+kill -USR1 $pid
+sleep 1
+kill $pid
+wait $pid
+printf "%s\n%s\n" "$exp watchdir/a.dat" "$exp2 watchdir/sub/b.dat" | sort > watch_exp.txt
+sort watch_out.txt | uniq -c | awk '{print $1}' | grep -qv '^2$' && res=1
+sort -u watch_out.txt | diff - watch_exp.txt > /dev/null || res=1
+rm -rf watchdir watch_out.txt watch_exp.txt
+if [[ $res != 0 ]]; then
+    echo "test26 failed"
+else
+    echo "test26 passed"
+fi
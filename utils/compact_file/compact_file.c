@@ -0,0 +1,282 @@
+#define _GNU_SOURCE
+#include <compact_file.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <proto.h>
+#include <util.h>
+
+/**
+ * @file compact_file.c
+ * @brief File di implementazione dell'interfaccia per il formato compatto dei file di input
+ */
+
+/* ------------------- header -------------------- */
+
+//header valido e dimensione coerente con count: restituisce il puntatore agli elementi, NULL altrimenti
+static const unsigned char *checkHeader(const void *data, size_t len, cfHeader_t *h){
+    if(len < sizeof(cfHeader_t))
+        return NULL;
+    memcpy(h, data, sizeof(cfHeader_t));
+    if(memcmp(h->magic, CF_MAGIC, sizeof(h->magic)) != 0 || h->version != CF_VERSION || h->byte_order != host_byte_order())
+        return NULL;
+    size_t payload = len - sizeof(cfHeader_t);
+    if(h->encoding == CF_PLAIN){
+        if((h->width != 1 && h->width != 2 && h->width != 4 && h->width != 8) || payload / h->width != h->count || payload % h->width != 0)
+            return NULL;
+    }
+    else if(h->encoding != CF_DELTA || h->width != 0 || h->count > payload) //almeno un byte per elemento
+        return NULL;
+    if(h->count > (uint64_t)__LONG_MAX__)
+        return NULL;
+    return (const unsigned char *)data + sizeof(cfHeader_t);
+}
+
+int cfIsCompact(const void *data, size_t len){
+    return len >= sizeof(cfHeader_t) && memcmp(data, CF_MAGIC, sizeof(CF_MAGIC)) == 0;
+}
+
+long cfCount(const void *data, size_t len){
+    cfHeader_t h;
+    return checkHeader(data, len, &h) ? (long)h.count : CF_FAILURE;
+}
+
+/* ------------------- kernel di decodifica e somma -------------------- */
+
+/* Kernel specializzato per gli elementi di tipo type (CF_PLAIN): stesso risultato del ciclo del Worker sui long,
+ * safeAdd(ret, arr[i] * i) con overflow se la somma diventa negativa.
+ * Un blocco con tutti i valori non negativi e la cui somma massima (max_type * indice massimo * elementi) non puo'
+ * superare LONG_MAX - ret ha somme parziali crescenti e rappresentabili: viene sommato senza controlli per elemento
+ * (il ciclo non ha uscite e viene vettorizzato) ed accettato se non ha trovato valori negativi; altrimenti il blocco
+ * viene rifatto elemento per elemento. La somma del blocco e' base * somma(v) + somma(v * (k - base)): con k - base
+ * < CF_BLOCK il secondo prodotto sta in prod_t (int32_t per gli elementi da 1 e 2 byte, moltiplicazione vettoriale
+ * disponibile anche con SSE2, che non ha quella a 64 bit). */
+#define CF_PLAIN_KERNEL(name, type, type_max, prod_t)                                   \
+static long name(const unsigned char *p, uint64_t n){                                   \
+    long ret = 0;                                                                       \
+    for(uint64_t i = 0; i < n; ){                                                       \
+        uint64_t end = (n - i < CF_BLOCK) ? n : i + CF_BLOCK;                           \
+        if((double)(type_max) * (double)(end - 1) * (double)(end - i) < (__LONG_MAX__ - ret) / 2.0){ \
+            const unsigned char *b = p + i * sizeof(type);                              \
+            int m = end - i;                                                            \
+            long s1 = 0, s2 = 0;                                                        \
+            type neg = 0;                                                               \
+            for(int k = 0; k < m; k++){                                                 \
+                type v;                                                                 \
+                memcpy(&v, b + k * sizeof(type), sizeof(type));                         \
+                neg |= v;                                                               \
+                s1 += v;                                                                \
+                s2 += (prod_t)v * (prod_t)k;                                            \
+            }                                                                           \
+            if(neg >= 0){                                                               \
+                ret += s1 * (long)i + s2;                                               \
+                i = end;                                                                \
+                continue;                                                               \
+            }                                                                           \
+        }                                                                               \
+        for(; i < end; i++){                                                            \
+            type v;                                                                     \
+            memcpy(&v, p + i * sizeof(type), sizeof(type));                             \
+            ret = safeAdd(ret, (long)v * (long)i);                                      \
+            if(ret < 0)                                                                 \
+                return CF_OVERFLOW;                                                     \
+        }                                                                               \
+    }                                                                                   \
+    return ret;                                                                         \
+}
+
+CF_PLAIN_KERNEL(sum8, int8_t, INT8_MAX, int32_t)
+CF_PLAIN_KERNEL(sum16, int16_t, INT16_MAX, int32_t)
+CF_PLAIN_KERNEL(sum32, int32_t, INT32_MAX, long)
+CF_PLAIN_KERNEL(sum64, int64_t, INT64_MAX, long)
+
+//legge un varint da *p (al piu' 10 byte, senza superare end): 0 se valido
+static inline int readVarint(const unsigned char **p, const unsigned char *end, uint64_t *u){
+    uint64_t x = 0;
+    for(int shift = 0; shift < 64 && *p < end; shift += 7){
+        unsigned char b = *(*p)++;
+        x |= (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)){
+            *u = x;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+//elemento successivo della codifica CF_DELTA (aritmetica modulo 2^64 come nella codifica)
+static inline uint64_t unzigzag(uint64_t prev, uint64_t u){
+    return prev + ((u >> 1) ^ (0 - (u & 1)));
+}
+
+static long sumDelta(const unsigned char *p, const unsigned char *end, uint64_t n){
+    long ret = 0;
+    uint64_t prev = 0, u;
+    for(uint64_t i = 0; i < n; i++){
+        if(readVarint(&p, end, &u) != 0)
+            return CF_FAILURE;
+        prev = unzigzag(prev, u);
+        ret = safeAdd(ret, (long)prev * (long)i);
+        if(ret < 0){
+            //overflow solo se il resto del file e' valido: un file troncato resta un errore di formato
+            for(i++; i < n; i++)
+                if(readVarint(&p, end, &u) != 0)
+                    return CF_FAILURE;
+            return (p == end) ? CF_OVERFLOW : CF_FAILURE;
+        }
+    }
+    return (p == end) ? ret : CF_FAILURE;
+}
+
+long cfCompute(const void *data, size_t len){
+    cfHeader_t h;
+    const unsigned char *p = checkHeader(data, len, &h);
+    if(!p)
+        return CF_FAILURE;
+    if(h.encoding == CF_DELTA)
+        return sumDelta(p, (const unsigned char *)data + len, h.count);
+    switch(h.width){
+        case 1: return sum8(p, h.count);
+        case 2: return sum16(p, h.count);
+        case 4: return sum32(p, h.count);
+        default: return sum64(p, h.count);
+    }
+}
+
+int cfDecode(const void *data, size_t len, long *out){
+    cfHeader_t h;
+    const unsigned char *p = checkHeader(data, len, &h), *end = (const unsigned char *)data + len;
+    if(!p)
+        return CF_FAILURE;
+    if(h.encoding == CF_DELTA){
+        uint64_t prev = 0, u;
+        for(uint64_t i = 0; i < h.count; i++){
+            if(readVarint(&p, end, &u) != 0)
+                return CF_FAILURE;
+            out[i] = (long)(prev = unzigzag(prev, u));
+        }
+        return (p == end) ? CF_SUCCESS : CF_FAILURE;
+    }
+    for(uint64_t i = 0; i < h.count; i++, p += h.width){
+        int8_t v8; int16_t v16; int32_t v32; int64_t v64;
+        switch(h.width){
+            case 1: memcpy(&v8, p, 1); out[i] = v8; break;
+            case 2: memcpy(&v16, p, 2); out[i] = v16; break;
+            case 4: memcpy(&v32, p, 4); out[i] = v32; break;
+            default: memcpy(&v64, p, 8); out[i] = v64; break;
+        }
+    }
+    return CF_SUCCESS;
+}
+
+/* ------------------- scrittura -------------------- */
+
+int cfMinWidth(const long *v, size_t n){
+    int width = 1;
+    for(size_t i = 0; i < n && width < 8; i++){
+        if(v[i] < INT32_MIN || v[i] > INT32_MAX)
+            width = 8;
+        else if((v[i] < INT16_MIN || v[i] > INT16_MAX) && width < 4)
+            width = 4;
+        else if((v[i] < INT8_MIN || v[i] > INT8_MAX) && width < 2)
+            width = 2;
+    }
+    return width;
+}
+
+static inline uint64_t zigzag(uint64_t prev, long v){
+    int64_t d = (int64_t)((uint64_t)v - prev);
+    return ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+}
+
+static inline size_t varintLen(uint64_t u){
+    size_t len = 1;
+    while(u >= 0x80){
+        u >>= 7;
+        len++;
+    }
+    return len;
+}
+
+size_t cfSize(const long *v, size_t n, int width, int encoding){
+    if(encoding == CF_PLAIN)
+        return sizeof(cfHeader_t) + n * width;
+    size_t len = sizeof(cfHeader_t);
+    uint64_t prev = 0;
+    for(size_t i = 0; i < n; i++){
+        len += varintLen(zigzag(prev, v[i]));
+        prev = (uint64_t)v[i];
+    }
+    return len;
+}
+
+static int writeAll(int fd, const unsigned char *buf, size_t len){
+    size_t done = 0;
+    while(done < len){
+        ssize_t w = write(fd, buf + done, len - done);
+        if(w == -1){
+            if(errno == EINTR)
+                continue;
+            return CF_FAILURE;
+        }
+        done += w;
+    }
+    return CF_SUCCESS;
+}
+
+int cfWrite(int fd, const long *v, size_t n, int width, int encoding){
+    if((encoding != CF_PLAIN && encoding != CF_DELTA) ||
+        (encoding == CF_PLAIN && ((width != 1 && width != 2 && width != 4 && width != 8) || width < cfMinWidth(v, n)))){
+        errno = EINVAL;
+        return CF_FAILURE;
+    }
+    cfHeader_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CF_MAGIC, sizeof(h.magic));
+    h.version = CF_VERSION;
+    h.byte_order = host_byte_order();
+    h.width = (encoding == CF_PLAIN) ? width : 0;
+    h.encoding = encoding;
+    h.count = n;
+
+    unsigned char *buf = malloc(CF_BUF_LEN);
+    if(!buf)
+        return CF_FAILURE;
+    memcpy(buf, &h, sizeof(h));
+    size_t len = sizeof(h);
+    uint64_t prev = 0;
+    for(size_t i = 0; i < n; i++){
+        if(len + 10 > CF_BUF_LEN){ //spazio per l'elemento piu' lungo (varint da 10 byte)
+            if(writeAll(fd, buf, len) != CF_SUCCESS){
+                free(buf);
+                return CF_FAILURE;
+            }
+            len = 0;
+        }
+        if(encoding == CF_DELTA){
+            uint64_t u = zigzag(prev, v[i]);
+            prev = (uint64_t)v[i];
+            while(u >= 0x80){
+                buf[len++] = (unsigned char)(u | 0x80);
+                u >>= 7;
+            }
+            buf[len++] = (unsigned char)u;
+        }
+        else{
+            int8_t v8 = v[i]; int16_t v16 = v[i]; int32_t v32 = v[i]; int64_t v64 = v[i];
+            switch(width){
+                case 1: memcpy(buf + len, &v8, 1); break;
+                case 2: memcpy(buf + len, &v16, 2); break;
+                case 4: memcpy(buf + len, &v32, 4); break;
+                default: memcpy(buf + len, &v64, 8); break;
+            }
+            len += width;
+        }
+    }
+    int ret = writeAll(fd, buf, len);
+    free(buf);
+    return ret;
+}
@@ -0,0 +1,105 @@
+#if !defined(COMPACT_FILE_H)
+#define COMPACT_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CF_SUCCESS 0
+#define CF_FAILURE -1
+#define CF_OVERFLOW -2          // come OVERFLOW del Worker
+
+#define CF_MAGIC "FARMCMP"      // 8 byte compreso il terminatore
+#define CF_VERSION 1
+#define CF_PLAIN 0              // elementi di width byte con segno
+#define CF_DELTA 1              // differenze con l'elemento precedente, zigzag e varint (LEB128)
+//elementi per blocco dei kernel: con valori non negativi e somma massima del blocco rappresentabile
+//il blocco viene sommato senza controlli per elemento (ciclo vettorizzabile)
+#define CF_BLOCK 1024
+//buffer di scrittura del convertitore
+#define CF_BUF_LEN (1 << 20)
+
+/**
+ * @file compact_file.h
+ * @brief Formato compatto dei file di input di farm, riconosciuto dal Worker accanto ai .dat grezzi (array di long):
+ *
+ *          | header (24) | elementi |
+ *
+ *          Gli elementi sono count interi con segno di width byte (CF_PLAIN) oppure, con CF_DELTA, le differenze
+ *          con l'elemento precedente (il primo rispetto a 0) codificate zigzag in varint da 1-10 byte: i valori da 16 o 32
+ *          bit occupano 2-4 volte meno dei long, le sequenze lente ancora meno. Come i .dat, i campi sono in byte order
+ *          dell'host che ha scritto il file (indicato nell'header).
+ *          Il risultato e' quello del file grezzo con gli stessi elementi (somma di i * elemento, con lo stesso controllo
+ *          di overflow del Worker): i kernel decodificano e sommano in un solo passaggio, senza espandere i long in memoria,
+ *          e sono specializzati a tempo di compilazione per ogni width.
+ *          Un .dat grezzo viene scambiato per compatto solo se il suo primo long coincide con CF_MAGIC.
+ */
+
+/** Header del file
+ *
+ */
+typedef struct cfHeader
+{
+    char magic[8];          // CF_MAGIC
+    uint16_t version;       // CF_VERSION
+    uint8_t byte_order;     // 1 little endian, 2 big endian
+    uint8_t width;          // byte per elemento (1, 2, 4, 8) con CF_PLAIN, 0 con CF_DELTA
+    uint8_t encoding;       // CF_PLAIN o CF_DELTA
+    uint8_t pad[3];
+    uint64_t count;         // numero di elementi
+} cfHeader_t;
+
+/**
+ * \brief Controlla se i primi len byte di un file iniziano con l'header del formato compatto
+ *
+ * \retval 1 se il file e' in formato compatto
+ * \retval 0 altrimenti (file grezzo)
+ */
+int cfIsCompact(const void *data, size_t len);
+
+/**
+ * \brief Calcola il risultato del file compatto di len byte in data (decodifica e somma in un solo passaggio)
+ *
+ * \retval result (>= 0) se il risultato e' stato calcolato
+ * \retval CF_OVERFLOW se e' stato rilevato un overflow
+ * \retval CF_FAILURE se il file non e' valido (header, dimensione o codifica)
+ */
+long cfCompute(const void *data, size_t len);
+
+/**
+ * \brief Numero di elementi del file compatto di len byte in data
+ *
+ * \retval count se l'header e' valido
+ * \retval CF_FAILURE altrimenti
+ */
+long cfCount(const void *data, size_t len);
+
+/**
+ * \brief Decodifica gli elementi del file compatto di len byte in data in out (cfCount elementi)
+ *
+ * \retval CF_SUCCESS se il file e' stato decodificato
+ * \retval CF_FAILURE se il file non e' valido
+ */
+int cfDecode(const void *data, size_t len, long *out);
+
+/**
+ * \brief Minimo numero di byte (1, 2, 4, 8) che rappresenta con segno tutti gli n valori di v
+ */
+int cfMinWidth(const long *v, size_t n);
+
+/**
+ * \brief Dimensione (in byte, header compreso) del file compatto degli n valori di v con la codifica encoding
+ */
+size_t cfSize(const long *v, size_t n, int width, int encoding);
+
+/**
+ * \brief Scrive su fd il file compatto degli n valori di v
+ *
+ * \param width byte per elemento (1, 2, 4, 8, almeno cfMinWidth) con CF_PLAIN, ignorato con CF_DELTA
+ * \param encoding CF_PLAIN o CF_DELTA
+ *
+ * \retval CF_SUCCESS se il file e' stato scritto
+ * \retval CF_FAILURE in caso di errore (errno settato, EINVAL se width non rappresenta i valori)
+ */
+int cfWrite(int fd, const long *v, size_t n, int width, int encoding);
+
+#endif // COMPACT_FILE_H
@@ -62,12 +62,9 @@ static void errorHandler(BQueue_t *q)
         }
         free(q->queue);
     }
-    if (&q->m)
-        pthread_mutex_destroy(&q->m);
-    if (&q->cfull)
-        pthread_cond_destroy(&q->cfull);
-    if (&q->cempty)
-        pthread_cond_destroy(&q->cempty);
+    pthread_mutex_destroy(&q->m);
+    pthread_cond_destroy(&q->cfull);
+    pthread_cond_destroy(&q->cempty);
     free(q);
     errno = myerrno;
 }
@@ -143,12 +140,9 @@ void deleteBQueue(BQueue_t *q)
                 free(q->queue[i]);
         free(q->queue);
     }
-    if (&q->m)
-        pthread_mutex_destroy(&q->m);
-    if (&q->cfull)
-        pthread_cond_destroy(&q->cfull);
-    if (&q->cempty)
-        pthread_cond_destroy(&q->cempty);
+    pthread_mutex_destroy(&q->m);
+    pthread_cond_destroy(&q->cfull);
+    pthread_cond_destroy(&q->cempty);
     free(q);
 }
 
@@ -186,19 +180,12 @@ int push(BQueue_t *q, char *data)
     return 0;
 }
 
-char *pop(BQueue_t *q)
+/**
+ * \brief Estrae la stringa in testa (la coda deve essere non vuota e la lock acquisita).
+ *          La lock viene rilasciata dalla funzione.
+ */
+static char *extractHead(BQueue_t *q)
 {
-    if (!q)
-    {
-        errno = EINVAL;
-        return NULL;
-    }
-
-    LockQueue(q); // lock su mutex
-
-    while (q->qlen == 0)  // condizione di attesa (coda vuota)
-        WaitToConsume(q); // attesa su variabile di condizione
-
     // estrazione stringa dalla coda
 
     char *data;
@@ -206,6 +193,7 @@ char *pop(BQueue_t *q)
         data = (char *)calloc(q->str_len, sizeof(char));
         if(!data){
             perror("calloc");
+            UnlockQueue(q);
             return NULL;
         }
         strncpy(data, q->queue[q->head], q->str_len);
@@ -223,3 +211,44 @@ char *pop(BQueue_t *q)
 
     return data;
 }
+
+char *pop(BQueue_t *q)
+{
+    if (!q)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    LockQueue(q); // lock su mutex
+
+    while (q->qlen == 0)  // condizione di attesa (coda vuota)
+        WaitToConsume(q); // attesa su variabile di condizione
+
+    return extractHead(q);
+}
+
+char *timedPop(BQueue_t *q, const struct timespec *abstime)
+{
+    if (!q || !abstime)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    LockQueue(q); // lock su mutex
+
+    while (q->qlen == 0){ // condizione di attesa (coda vuota)
+        int r = pthread_cond_timedwait(&q->cempty, &q->m, abstime);
+        if (r == ETIMEDOUT){
+            UnlockQueue(q);
+            return QTIMEOUT;
+        }
+        if (r != 0){
+            fprintf(stderr, "ERRORE FATALE timed wait\n");
+            pthread_exit((void *)EXIT_FAILURE);
+        }
+    }
+
+    return extractHead(q);
+}
@@ -2,9 +2,12 @@
 #define CONQ_QUEUE_H
 
 #include <pthread.h>
+#include <time.h>
 
 // End-Of-Stream (EOS): valore speciale per la terminazione
 #define EOS (void*)0x1   
+// valore speciale restituito da timedPop se la coda resta vuota fino alla scadenza
+#define QTIMEOUT (void*)0x2
 //tempo di attesa massimo da parte del Producer in caso di coda piena
 #define WAIT_TIME_SECONDS 3
 
@@ -56,4 +59,12 @@ int push(BQueue_t *q, char *data);
  */
 char *pop(BQueue_t *q);
 
+/** Come pop, ma attende al massimo fino all'istante assoluto abstime (CLOCK_REALTIME).
+ *
+ *  \retval stringa puntatore alla stringa restituita.
+ *  \retval QTIMEOUT se la coda e' rimasta vuota fino ad abstime
+ *  \retval null in caso di errore (errno settato opportunamente)
+ */
+char *timedPop(BQueue_t *q, const struct timespec *abstime);
+
 #endif /* CONQ_QUEUE_H */
@@ -32,7 +32,7 @@ DArray *initDArray(size_t init_size, size_t strings_size){
         if (!d->data[i])
         {
             perror("calloc buf");
-            for (int j = i-1; j >= 0; j++){
+            for (int j = i-1; j >= 0; j--){
                 free(d->data[j]);
             }
             free(d->data);
@@ -79,9 +79,9 @@ int addDData(DArray *d, char *data){
         d->asize *= 2;
 
         char **new_data = realloc(d->data, d->asize * sizeof(void *));
-        if(d->data == new_data){ //realloc error
+        if(new_data == NULL){ //realloc error (d->data resta valido: lo stesso puntatore se riallocato sul posto)
             perror("realloc");
-            for (int i = 0; i < d->asize; i++)
+            for (int i = 0; i < oldsize; i++)
                 free(d->data[i]);
             free(d->data);
             free(d);
@@ -97,7 +97,7 @@ int addDData(DArray *d, char *data){
             if (d->data[i] == NULL)
             {
                 perror("calloc");
-                for (int j = i-1; j >= 0; j++)
+                for (int j = i-1; j >= 0; j--)
                     free(d->data[j]);
                 free(d->data);
                 free(d);
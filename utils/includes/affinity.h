@@ -0,0 +1,99 @@
+#if !defined(AFFINITY_H)
+#define AFFINITY_H
+
+#include <stddef.h>
+
+#define A_SUCCESS 0
+#define A_FAILURE -1
+
+//consts
+#define _MAX_AFFINITY_LEN 256
+#define _MAX_NUMA_NODES 64
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+
+/**
+ * @file affinity.h
+ * @brief Interfaccia per la gestione dell'affinity (CPU e NUMA) dei thread del MasterWorker e del Collector.
+ *          La topologia viene letta da sysfs (nessuna dipendenza da libnuma).
+ */
+
+/** Politiche di affinity accettate dall'opzione -a
+ *
+ */
+typedef enum affPolicy
+{
+    AFF_NONE = 0,   // nessun pinning (comportamento di default)
+    AFF_COMPACT,    // workers su cpu adiacenti (stesso core/socket)
+    AFF_SCATTER,    // workers distribuiti su socket/core diversi
+    AFF_LIST,       // lista esplicita di cpu (es. "0,2,4-6")
+    AFF_NUMA        // workers distribuiti sui nodi NUMA, ognuno legato alle cpu del proprio nodo
+} affPolicy_t;
+
+/** Piano di affinity calcolato a partire dalla topologia e dalla politica scelta
+ *
+ */
+typedef struct affinity
+{
+    affPolicy_t policy;
+    size_t nworkers;
+    int *worker_cpu;    // cpu assegnata a ciascun worker (-1 se legato all'intero nodo)
+    int *worker_node;   // nodo NUMA di ciascun worker
+    int *node_cpus;     // cpu di ogni nodo, concatenate (vedi node_off)
+    int node_off[_MAX_NUMA_NODES + 1];
+    int nnodes;
+    int *free_cpus;     // cpu non usate dai workers (per Master e Collector)
+    int nfree;
+} affinity_t;
+
+/**
+ * \brief Calcola il piano di affinity per nworkers workers secondo la politica policy
+ *
+ * \param a struttura in cui viene salvato il piano
+ * \param policy stringa della politica ("compact", "scatter", "numa" oppure lista di cpu); NULL o "" equivale a nessun pinning
+ * \param nworkers numero di workers
+ *
+ * \retval A_SUCCESS in caso di successo
+ * \retval A_FAILURE se la politica non è valida o la topologia non è leggibile
+ */
+int init_affinity(affinity_t *a, const char *policy, size_t nworkers);
+
+/**
+ * \brief Lega il thread corrente alle cpu previste per il worker id (se la politica lo richiede)
+ *
+ * \param a piano di affinity
+ * \param id indice del worker
+ *
+ * \retval A_SUCCESS in caso di successo (o se non è previsto pinning)
+ * \retval A_FAILURE in caso di errore
+ */
+int pin_worker(const affinity_t *a, size_t id);
+
+/**
+ * \brief Lega il processo/thread corrente ad una cpu non usata dai workers (Master e Collector).
+ *          Se non ci sono cpu libere non viene effettuato alcun pinning.
+ *
+ * \param a piano di affinity
+ * \param slot indice della cpu libera da usare (0 Master, 1 Collector, modulo il numero di cpu libere)
+ *
+ * \retval A_SUCCESS in caso di successo
+ * \retval A_FAILURE in caso di errore
+ */
+int pin_outside_workers(const affinity_t *a, int slot);
+
+/**
+ * \brief Restituisce il nodo NUMA del worker id (-1 se sconosciuto)
+ *
+ * \param a piano di affinity
+ * \param id indice del worker
+ */
+int get_worker_node(const affinity_t *a, size_t id);
+
+/**
+ * \brief Libera la memoria del piano di affinity
+ *
+ * \param a piano di affinity
+ */
+void delete_affinity(affinity_t *a);
+
+#endif // AFFINITY_H
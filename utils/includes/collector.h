@@ -7,13 +7,54 @@
 #define _MIN_MESS_LEN 1
 #define _MAX_MESS_LEN 2048
 
+//dimensione del buffer di lettura condiviso dalle connessioni con i Workers (contiene piu' frame)
+#define _COLLECTOR_READ_LEN 65536
+//eventi restituiti da una singola epoll_wait
+#define _COLLECTOR_MAX_EVENTS 256
+//snapshot (SIGUSR1) in attesa di stampa: oltre questo numero il Collector attende il thread di stampa
+#define _COLLECTOR_MAX_SNAPS 8
+
+#include <pthread.h>
 #include <sor_list.h>
+#include <mpsc_queue.h>
+#include <shm_ring.h>
+#include <affinity.h>
+#include <metrics.h>
+#include <server.h>
 
 /**
  * \file collector.h
  * \brief Interfaccia per il Collector. 
  */
 
+/** Argomenti del Collector thread (modalità -i)
+ *
+ */
+typedef struct collectorArgs
+{
+    SList *l;               // lista in cui vengono salvati i risultati
+    MQueue_t *mq;           // coda alimentata da Workers e Master
+    int max_path_len;
+    const affinity_t *aff;  // piano di affinity (per il pinning del Collector thread)
+    int outfd;              // file descriptor su cui stampare i risultati (stdout o il file di -o)
+    int delta;              // snapshot con i soli risultati arrivati dallo snapshot precedente (-D)
+    jobTable_t *jobs;       // job della modalita' server (-S), NULL se non attiva
+} collectorArgs_t;
+
+/** Opzioni del Collector processo
+ *
+ */
+typedef struct collectorOpts
+{
+    SRing_t *ring;          // ring in memoria condivisa alimentato dai Workers (modalità -s), NULL se si usano i socket
+    size_t nith;            // thread di ingestione (modalità -c), 0 per leggere tutte le connessioni nel Collector
+    const char *tcp_port;   // porta TCP su cui accettare i nodi remoti (modalità -L), NULL se non usata
+    size_t nnodes;          // nodi remoti che devono registrarsi e terminare prima della stampa finale (-N)
+    int outfd;              // file descriptor su cui stampare gli snapshot (SIGUSR1)
+    int delta;              // snapshot con i soli risultati arrivati dallo snapshot precedente (-D)
+    const char *ctrl;       // socket di controllo per le interrogazioni sui risultati (-Q), NULL se non usato
+} collectorOpts_t;
+
 /**
  * \brief funzione che raccoglie i risultati dai Workers e li salva in SList 'l'
  *
@@ -21,11 +62,39 @@
  * \param max_path_len massima lunghezza dei path ricevuti dai Workers
  * \param max_comms_len massima lunghezza delle comunicazioni ricevute dal Master
  * \param sockname nome del socket a cui collegarsi
+ * \param copts opzioni del Collector (controllare definizione di collectorOpts_t). Con copts->nith > 0 ogni thread
+ *          di ingestione legge un sottoinsieme delle connessioni dei Workers in una propria lista, unita a 'l' per le stampe;
+ *          con copts->tcp_port il Collector accetta anche i nodi remoti e termina solo dopo la fine di copts->nnodes nodi
  * 
  * \return C_SUCCESS se tutto va bene, C_FAILURE in caso di errore
  */
 
-int receive_results(SList *l, int max_path_len, int max_comms_len, const char* sockname);
+int receive_results(SList *l, int max_path_len, int max_comms_len, const char* sockname, const collectorOpts_t *copts);
+
+/**
+ * \brief ciclo di vita del Collector thread (modalità -i): raccoglie i risultati dalla coda cARGS->mq fino a MQ_QUIT
+ *
+ * \param arg argomenti del Collector thread (collectorArgs_t)
+ */
+
+void *collector_thread(void *arg);
+
+/**
+ * \brief avvia il Collector thread con tutti i segnali mascherati
+ *
+ * \param tid identificatore del thread avviato
+ * \param cARGS argomenti del Collector thread
+ * 
+ * \return C_SUCCESS se tutto va bene, C_FAILURE in caso di errore
+ */
+
+int start_collector_thread(pthread_t *tid, collectorArgs_t *cARGS);
+
+/**
+ * \brief metriche del Collector del processo (per il MasterWorker in modalità -i, che le espone insieme alle proprie)
+ */
+
+collectorMetrics_t *get_collector_metrics();
 
 /**
  * \brief funzione di gestione segnali del collector
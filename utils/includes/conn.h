@@ -14,9 +14,9 @@
 #if !defined(UNIX_PATH_MAX)
 #define UNIX_PATH_MAX     108
 #endif
-//numero massimo di Workers: 256
+//i Workers si connettono tutti all'avvio (il kernel limita comunque il valore a somaxconn)
 #if !defined(MAXBACKLOG)
-#define MAXBACKLOG   256 + 1
+#define MAXBACKLOG   4096
 #endif
 
 /** Evita letture parziali
@@ -63,5 +63,31 @@ static inline int writen(long fd, void *buf, size_t size) {
     return 1;
 }
 
+/** Evita scritture parziali con writev (iov viene modificato)
+ *
+ *   \retval -1   errore (errno settato)
+ *   \retval  0   se durante la scrittura la writev ritorna 0
+ *   \retval  1   se la scrittura termina con successo
+ */
+static inline int writevn(long fd, struct iovec *iov, int iovcnt) {
+    ssize_t r;
+    while(iovcnt>0) {
+	if ((r=writev((int)fd, iov, iovcnt)) == -1) {
+	    if (errno == EINTR) continue;
+	    return -1;
+	}
+	if (r == 0) return 0;
+	while(iovcnt>0 && (size_t)r >= iov->iov_len) { //salto gli iovec scritti completamente
+	    r -= iov->iov_len;
+	    iov++;
+	    iovcnt--;
+	}
+	if(iovcnt>0) {
+	    iov->iov_base = (char*)iov->iov_base + r;
+	    iov->iov_len -= r;
+	}
+    }
+    return 1;
+}
 
 #endif /* CONN_H */
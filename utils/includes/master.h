@@ -8,22 +8,47 @@
 #define _DEFAULT_NTHREAD_VALUE 4
 #define _DEFAULT_QLEN_VALUE 8
 #define _DEFAULT_DELAY_VALUE 0
+#define _DEFAULT_BATCH_VALUE 64
+#define _DEFAULT_LATENCY_VALUE 10
+#define _DEFAULT_CTHREADS_VALUE 0
+#define _DEFAULT_NNODES_VALUE 1
+#define _DEFAULT_MEMBUDGET_VALUE 0 //KB, 0 per nessun limite
 #define _MIN_NTHREAD_VALUE 1
 #define _MIN_QLEN_VALUE 1
 #define _MIN_DELAY_VALUE 0
+#define _MIN_BATCH_VALUE 1
+#define _MIN_LATENCY_VALUE 0
+#define _MIN_CTHREADS_VALUE 0
+#define _MIN_NNODES_VALUE 0
+#define _MIN_MEMBUDGET_VALUE 0
 #define _MIN_SOCKNAME_LEN 5
 #define _MIN_PATH_LEN 5
 #define _MIN_MCOMMS_LEN 2
-#define _MAX_NTHREAD_VALUE 256
+#define _MAX_NTHREAD_VALUE 4096 //entro il limite di file descriptor (RLIMIT_NOFILE, vedi _NTHREAD_FDS)
 #define _MAX_QLEN_VALUE 256
 #define _MAX_DELAY_VALUE 8192
+#define _MAX_BATCH_VALUE 512 //2 iovec per risultato, entro IOV_MAX (1024)
+#define _MAX_LATENCY_VALUE 4096
+#define _MAX_CTHREADS_VALUE 64
+#define _MAX_NNODES_VALUE 1024
+#define _MAX_MEMBUDGET_VALUE 1073741824 //1 TB
 #define _MAX_SOCKNAME_LEN 256
 #define _MAX_PATH_LEN 512
 #define _MAX_MCOMMS_LEN 256
 #define _MAX_EXT_LEN 5
+#define _MAX_OUTFILE_LEN 4096
+//file descriptor per Worker (socket verso il Collector e file in lettura) e riservati al resto del processo
+#define _NTHREAD_FDS 2
+#define _RESERVED_FDS 64
 
 #include <conc_queue.h>
 #include <dyn_array.h>
+#include <affinity.h>
+#include <watcher.h>
+#include <mpsc_queue.h>
+#include <shm_ring.h>
+#include <net.h>
+#include <metrics.h>
 
 /**
  * @file master.h
@@ -31,9 +56,47 @@
  *          Essa conterrà tutti i metodi necessari per inizializzare ed eseguire il Master.
  */
 
+/** Opzioni aggiuntive del MasterWorker e del Collector (parsate prima della fork)
+ *
+ */
+typedef struct farmOpts
+{
+    char affinity[_MAX_AFFINITY_LEN]; // politica di affinity dei workers (-a)
+    int watch;                        // modalità watch: dopo la scansione iniziale resto in ascolto sulle directories (-w)
+    size_t batch;                     // numero massimo di risultati accumulati da un Worker prima dell'invio (-b)
+    size_t latency;                   // tempo massimo (in ms) per cui un risultato resta nel buffer del Worker (-l)
+    int inproc;                       // Collector come thread del MasterWorker, senza socket (-i)
+    int shm;                          // risultati dei Workers verso il Collector tramite ring in memoria condivisa (-s)
+    size_t cthreads;                  // thread di ingestione del Collector processo (-c), 0 per un solo thread
+    char remote[_MAX_NET_ADDR_LEN];   // indirizzo host:porta del Collector centrale: il processo e' un nodo remoto (-R)
+    char tcp_port[_MAX_NET_ADDR_LEN]; // porta TCP su cui il Collector accetta i nodi remoti (-L)
+    size_t nnodes;                    // nodi remoti attesi dal Collector centrale (-N)
+    size_t membudget;                 // memoria massima (in KB) dei risultati nel Collector, oltre la quale vanno su disco (-m)
+    char outfile[_MAX_OUTFILE_LEN];   // file su cui il Collector stampa i risultati al posto di stdout (-o)
+    char binfile[_MAX_OUTFILE_LEN];   // file binario indicizzato dei risultati finali, scritto dal Collector (-B)
+    int delta;                        // gli snapshot (SIGUSR1) contengono solo i risultati arrivati dal precedente (-D)
+    char ctrl[_MAX_OUTFILE_LEN];      // socket di controllo del Collector per le interrogazioni sui risultati (-Q)
+    char metrics[_MAX_OUTFILE_LEN];   // socket delle metriche del MasterWorker (-M)
+    char trace[_MAX_OUTFILE_LEN];     // file del trace del ciclo di vita dei file, solo con FARM_TRACE (-T)
+    char server[_MAX_OUTFILE_LEN];    // socket di controllo della modalità server: il MasterWorker esegue i job ricevuti (-S)
+} farmOpts_t;
+
 typedef struct mastArgs
 {
     BQueue_t *q;
+    const affinity_t *aff;
+    watcher_t *w;       // watcher inotify (NULL se non in modalità watch)
+    MQueue_t *mq;       // coda verso il Collector thread (NULL se il Collector e' un processo)
+    SRing_t *ring;      // ring condiviso con il Collector processo (NULL se si usa il socket)
+    const char *remote; // indirizzo del Collector centrale (NULL se il Collector e' locale)
+    uint32_t node_id;   // identificativo assegnato al nodo dal Collector centrale
+    metrics_t *metrics; // contatori di Master e Workers
+    const char *metrics_sock; // socket delle metriche (-M), NULL se non richiesto
+    const char *server; // socket di controllo della modalità server (-S), NULL se non attiva
+    struct jobTable *jobs; // job della modalità server, condivisi con il Collector thread
+    int *failed;        // modalità server: scansione del job interrotta da un errore di push (NULL fuori dai job)
+    size_t batch;
+    size_t latency;
     size_t delay;
     size_t threadpool_size;
     int max_path_len;
@@ -58,6 +121,14 @@ void handle_master_signals();
  */
 void send_to_sockfd(int sockfd, const char* msg, const int max_mcomms_len);
 
+/**
+ * \brief Funzione di invio comando msg al Collector (socket oppure coda del Collector thread in modalità -i)
+ *
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ * \param msg comando da inviare
+ */
+void notify_collector(const masterArgs *mARGS, const char* msg);
+
 /**
  * \brief Funzione che avvia l'inserimento dei files da argv nella coda concorrente (dopo aver inserito quelli presenti in dirs)
  *
@@ -72,6 +143,17 @@ void send_to_sockfd(int sockfd, const char* msg, const int max_mcomms_len);
  */
 int execute_master(masterArgs mArgs, int argc, char **argv, int argc_index, DArray *dirs);
 
+/**
+ * \brief Inserisce in mARGS.q i file (e gli archivi) di argv a partire da opt_index e quelli delle directories
+ *          precedute da "-d", come per gli argomenti di farm. Usata anche dai job della modalità server
+ *
+ * \param argc int che indica dimensione di argv
+ * \param argv argomenti (file e "-d" seguito da una directory)
+ * \param opt_index indice del primo argomento
+ * \param mARGS argomenti del master (controllare definizione di masterArgs)
+ */
+void scan_args(int argc, char **argv, int opt_index, masterArgs mARGS);
+
 /**
  * \brief Funzione di connessione da parte del Master utilizzando sock_name (chiamata bloccante)
  *
@@ -102,7 +184,7 @@ int connect_master(const char* sock_name, const int retry_timeout);
 int init_master_args(masterArgs *mARGS, BQueue_t *q, size_t nthread, int collectorfd, const char* sockname, const char* ext, size_t delay, int max_path_len, int max_mcomms_len);
 
 /**
- * \brief Funzione di parsing argomenti -n -q -t -d (andiamo a salvare gli argomenti di -d in dirs)
+ * \brief Funzione di parsing argomenti -n -q -t -d -a -w -b -l -i -s -c -R -L -N -m -o -B -D -Q -M -T -S (andiamo a salvare gli argomenti di -d in dirs)
  *
  * \param argc intero che indica dimensione di argv
  * \param argv array contenente gli argomenti inseriti sulla command line durante l'avvio del programma
@@ -111,11 +193,12 @@ int init_master_args(masterArgs *mARGS, BQueue_t *q, size_t nthread, int collect
  * \param delay specifica delay tra richieste del Master (in ms)
  * \param argc_index intero che a fine funzione conterr`a il valore di optind
  * \param dirs array dinamico in cui verranno salvati i nomi delle directories 
+ * \param opts opzioni aggiuntive (controllare definizione di farmOpts_t)
  * 
  * \retval M_SUCCESS se gli args sono stati parsati correttamente
  * \retval M_FAILURE altrimenti
  */
-int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_t *delay, int *argc_index, DArray *dirs);
+int parse_first_args(int argc, char **argv, size_t *nthread, size_t *qlen, size_t *delay, int *argc_index, DArray *dirs, farmOpts_t *opts);
 
 
 #endif // MASTER_H
\ No newline at end of file
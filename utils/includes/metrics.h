@@ -0,0 +1,170 @@
+#if !defined(METRICS_H)
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <signal.h>
+
+#define MT_SUCCESS 0
+#define MT_FAILURE -1
+
+//le fasi open/read/compute vengono cronometrate su un file ogni _METRICS_SAMPLE (la stima viene riscalata sul totale)
+#define _METRICS_SAMPLE 16
+//attesa massima (ms) della richiesta di un client del socket delle metriche
+#define _METRICS_CLIENT_MS 1000
+
+/**
+ * @file metrics.h
+ * @brief Metriche del MasterWorker e del Collector: contatori per thread (un solo scrittore, letti senza lock; i contatori
+ *          del Master in modalità server, aggiornati dai thread dei job, con incrementi atomici),
+ *          tempo di CPU per thread e stima di avanzamento, esposti in formato testuale Prometheus.
+ *
+ *          Il MasterWorker le stampa su stderr alla ricezione di SIGUSR2 e le restituisce ai client del socket -M
+ *          (richiesta "metrics", risposta terminata da una riga vuota come per il socket di controllo, vedi query.h);
+ *          il Collector processo risponde alla stessa richiesta sul socket -Q e stampa le proprie su stderr con SIGUSR2.
+ */
+
+enum { PHASE_OPEN, PHASE_READ, PHASE_COMPUTE, PHASE_SEND, PHASE_N };
+
+//incremento di un contatore con un solo scrittore: nessuna istruzione atomica, solo la garanzia di letture non spezzate
+#define METRIC_ADD(field, v) __atomic_store_n(&(field), (field) + (v), __ATOMIC_RELAXED)
+//incremento di un contatore con piu' scrittori (contatori del Master in modalità server)
+#define METRIC_ADD_SHARED(field, v) __atomic_fetch_add(&(field), (v), __ATOMIC_RELAXED)
+#define METRIC_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+/** Clock di CPU di un thread: registrato dal thread stesso all'avvio e letto da qualunque altro thread
+ *  finche' il thread e' vivo; alla terminazione il thread salva il proprio tempo di CPU finale
+ */
+typedef struct threadClock
+{
+    clockid_t clock;
+    int valid;          // clock registrato
+    int exited;         // il thread ha terminato: vale cpu_ns
+    uint64_t cpu_ns;
+} threadClock_t;
+
+/** Metriche di un Worker (una cache line per Worker, nessuna condivisione tra Workers)
+ *
+ */
+typedef struct workerMetrics
+{
+    uint64_t files;                 // file calcolati (anche con errore)
+    uint64_t errors;                // file con errore di lettura o overflow
+    uint64_t bytes;                 // byte letti
+    uint64_t sampled;               // file con le fasi open/read/compute cronometrate
+    uint64_t phase_ns[PHASE_N];     // tempo delle fasi: open/read/compute dei file cronometrati, send di tutti gli invii
+    uint64_t sends;                 // invii al Collector
+    threadClock_t cpu;
+} __attribute__((aligned(64))) workerMetrics_t;
+
+/** Metriche della visita del Master
+ *
+ */
+typedef struct masterMetrics
+{
+    uint64_t dirs;      // directory visitate
+    uint64_t files;     // file inseriti in coda
+    uint64_t bytes;     // byte dei file inseriti in coda
+    uint64_t pushes;    // push cronometrate (una ogni _METRICS_SAMPLE)
+    uint64_t push_ns;   // tempo delle push cronometrate (attesa della coda piena)
+    int scan_done;      // visita iniziale terminata: i byte in coda sono il totale (salvo la modalità -w)
+    threadClock_t cpu;
+} masterMetrics_t;
+
+/** Metriche del Collector (processo o thread)
+ *
+ */
+typedef struct collectorMetrics
+{
+    uint64_t results;   // risultati ricevuti (anche con errore)
+    uint64_t errors;    // risultati con errore
+    uint64_t bytes;     // byte dei frame decodificati
+    uint64_t snapshots; // snapshot richiesti (SIGUSR1)
+    uint64_t queries;   // richieste sul socket di controllo
+    threadClock_t cpu;  // thread principale del Collector
+} collectorMetrics_t;
+
+/** Metriche del MasterWorker
+ *
+ */
+typedef struct metrics
+{
+    uint64_t start_ns;                      // avvio (CLOCK_MONOTONIC)
+    masterMetrics_t master;
+    workerMetrics_t *workers;
+    size_t nworkers;
+    collectorMetrics_t *collector;          // Collector thread (-i), NULL se il Collector e' un processo
+} metrics_t;
+
+//richiesta di stampa delle metriche (SIGUSR2), servita dal thread delle metriche
+extern volatile sig_atomic_t metrics_dump;
+
+/**
+ * \brief Istante corrente in ns del clock c
+ */
+static inline uint64_t now_ns(clockid_t c){
+    struct timespec ts;
+    clock_gettime(c, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * \brief Alloca le metriche del MasterWorker (contatori a zero)
+ *
+ * \param nworkers numero di Workers
+ *
+ * \retval m metriche allocate
+ * \retval NULL in caso di errore (errno settato)
+ */
+metrics_t *init_metrics(size_t nworkers);
+
+/**
+ * \brief Libera le metriche allocate con init_metrics
+ */
+void delete_metrics(metrics_t *m);
+
+/**
+ * \brief Registra il clock di CPU del thread chiamante (CLOCK_THREAD_CPUTIME_ID visto dagli altri thread)
+ */
+void bind_thread_clock(threadClock_t *c);
+
+/**
+ * \brief Salva il tempo di CPU finale del thread chiamante (da chiamare prima che il thread termini)
+ */
+void close_thread_clock(threadClock_t *c);
+
+/**
+ * \brief Tempo di CPU (ns) del thread di c, letto da qualunque thread
+ */
+uint64_t thread_cpu_ns(threadClock_t *c);
+
+/**
+ * \brief Scrive su fd le metriche del MasterWorker: visita del Master, Workers, avanzamento (byte in coda non ancora
+ *          letti, velocita' media e tempo stimato) e, con il Collector thread, quelle del Collector
+ *
+ * \retval MT_SUCCESS se il testo e' stato scritto
+ * \retval MT_FAILURE in caso di errore di allocazione o di scrittura
+ */
+int write_metrics(metrics_t *m, int fd);
+
+/**
+ * \brief Scrive su fd le metriche del Collector processo
+ *
+ * \retval MT_SUCCESS se il testo e' stato scritto
+ * \retval MT_FAILURE in caso di errore di allocazione o di scrittura
+ */
+int write_collector_metrics(collectorMetrics_t *c, int fd);
+
+/**
+ * \brief Testo delle metriche del Collector (per le risposte del socket di controllo, inviate senza bloccare)
+ *
+ * \param c metriche del Collector
+ * \param len lunghezza del testo
+ *
+ * \retval text testo allocato (da liberare con free)
+ * \retval NULL in caso di errore di allocazione
+ */
+char *collector_metrics_text(collectorMetrics_t *c, size_t *len);
+
+#endif // METRICS_H
@@ -0,0 +1,53 @@
+#if !defined(NET_H)
+#define NET_H
+
+#include <stdint.h>
+
+#define N_SUCCESS 0
+#define N_FAILURE -1
+
+//consts
+#define _MAX_NET_ADDR_LEN 256
+#define _NET_CONNECT_RETRIES 200 //tentativi di connessione al Collector centrale (uno ogni retry_ms)
+
+/**
+ * @file net.h
+ * @brief Interfaccia per la modalità distribuita su TCP: un Collector centrale (-L) raccoglie i risultati
+ *          di piu' MasterWorker remoti (-R), ognuno registrato come nodo tramite un handshake (vedi proto.h).
+ */
+
+/**
+ * \brief Crea un socket TCP in ascolto su tutte le interfacce
+ *
+ * \param port porta (numero o nome del servizio)
+ *
+ * \retval fd file descriptor del socket in ascolto
+ * \retval N_FAILURE in caso di errore
+ */
+int tcp_listen(const char *port);
+
+/**
+ * \brief Si connette a un Collector centrale, ritentando finche' non e' in ascolto
+ *
+ * \param addr indirizzo nel formato host:porta
+ * \param retry_ms attesa (in ms) tra due tentativi
+ *
+ * \retval fd file descriptor del socket connesso
+ * \retval N_FAILURE in caso di errore o dopo _NET_CONNECT_RETRIES tentativi falliti
+ */
+int tcp_connect(const char *addr, int retry_ms);
+
+/**
+ * \brief Handshake con il Collector centrale: il Master di un nodo riceve l'identificativo assegnato al nodo,
+ *          i Workers lo presentano sulle proprie connessioni
+ *
+ * \param fd socket connesso al Collector centrale
+ * \param role HELLO_MASTER o HELLO_WORKER
+ * \param node_id identificativo del nodo (in uscita per HELLO_MASTER, in ingresso per HELLO_WORKER)
+ *
+ * \retval N_SUCCESS se l'handshake e' andato a buon fine
+ * \retval N_FAILURE altrimenti
+ */
+int node_hello(int fd, uint8_t role, uint32_t *node_id);
+
+#endif // NET_H
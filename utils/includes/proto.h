@@ -0,0 +1,164 @@
+#if !defined(PROTO_H)
+#define PROTO_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @file proto.h
+ * @brief Protocollo binario tra Workers e Collector.
+ *          Ogni risultato viene inviato come frame: header di dimensione fissa seguito dai byte del path
+ *          (senza terminatore). I campi sono in byte order dell'host (Workers e Collector girano sulla stessa macchina).
+ *
+ *          | version (1) | status (1) | job (2) | path_len (4) | result (8) | path (path_len) |
+ *
+ *          Il campo job (riservato nella versione 1) identifica il job della modalita' server (-S) a cui appartiene
+ *          il risultato, 0 fuori dalla modalita' server.
+ */
+
+//versione del formato; il Collector scarta i frame con versione diversa
+#define PROTO_VERSION 2
+
+//esito del calcolo del Worker
+#define FRAME_OK 0
+#define FRAME_OVERFLOW 1
+#define FRAME_FILE_ERROR 2
+
+#define FRAME_HEADER_LEN 16
+
+/** Header del frame (la serializzazione avviene campo per campo, senza dipendere dal padding)
+ *
+ */
+typedef struct frameHeader
+{
+    uint8_t version;
+    uint8_t status;     // FRAME_OK, FRAME_OVERFLOW o FRAME_FILE_ERROR
+    uint16_t job;       // job della modalita' server (-S), 0 altrimenti
+    uint32_t path_len;  // lunghezza del path (senza '\0')
+    int64_t result;
+} frameHeader_t;
+
+/**
+ * \brief Serializza l'header di un frame in buf
+ *
+ * \param buf buffer di destinazione (almeno FRAME_HEADER_LEN byte)
+ * \param result risultato del calcolo
+ * \param status esito del calcolo
+ * \param path_len lunghezza del path che segue l'header
+ * \param job job della modalita' server (0 fuori dalla modalita' server)
+ */
+static inline void encode_header(char *buf, int64_t result, uint8_t status, uint32_t path_len, uint16_t job){
+    uint8_t version = PROTO_VERSION;
+    memcpy(buf, &version, 1);
+    memcpy(buf + 1, &status, 1);
+    memcpy(buf + 2, &job, 2);
+    memcpy(buf + 4, &path_len, 4);
+    memcpy(buf + 8, &result, 8);
+}
+
+/**
+ * \brief Serializza un frame in buf
+ *
+ * \param buf buffer di destinazione (almeno FRAME_HEADER_LEN + path_len byte)
+ * \param result risultato del calcolo
+ * \param status esito del calcolo
+ * \param path path del file
+ * \param path_len lunghezza del path
+ * \param job job della modalita' server (0 fuori dalla modalita' server)
+ *
+ * \return numero di byte scritti in buf
+ */
+static inline size_t encode_frame(char *buf, int64_t result, uint8_t status, const char *path, uint32_t path_len, uint16_t job){
+    encode_header(buf, result, status, path_len, job);
+    memcpy(buf + FRAME_HEADER_LEN, path, path_len);
+    return FRAME_HEADER_LEN + path_len;
+}
+
+/**
+ * \brief Deserializza l'header di un frame
+ *
+ * \param buf buffer contenente almeno FRAME_HEADER_LEN byte
+ * \param h header in cui vengono salvati i campi
+ * \param max_path_len lunghezza massima accettata per il path
+ *
+ * \retval 0 se l'header è valido
+ * \retval -1 se la versione non è supportata o path_len non è valido
+ */
+static inline int decode_header(const char *buf, frameHeader_t *h, size_t max_path_len){
+    memcpy(&h->version, buf, 1);
+    memcpy(&h->status, buf + 1, 1);
+    memcpy(&h->job, buf + 2, 2);
+    memcpy(&h->path_len, buf + 4, 4);
+    memcpy(&h->result, buf + 8, 8);
+    if(h->version != PROTO_VERSION || h->path_len == 0 || h->path_len >= max_path_len)
+        return -1;
+    return 0;
+}
+
+/*
+ * Handshake della modalità distribuita (TCP): ogni connessione verso il Collector centrale inizia con un hello
+ * di dimensione fissa. Il Master di un nodo lo invia con node_id 0 e riceve in risposta l'hello con l'identificativo
+ * assegnato al nodo; i Workers del nodo lo presentano sulle proprie connessioni prima dei frame.
+ * I frame restano in byte order dell'host: il Collector rifiuta i nodi con byte order diverso dal proprio.
+ *
+ *          | magic (1) | version (1) | role (1) | byte order (1) | node_id (4) |
+ */
+
+#define HELLO_LEN 8
+#define HELLO_MAGIC 'F'
+
+//ruolo della connessione
+#define HELLO_MASTER 1
+#define HELLO_WORKER 2
+
+/**
+ * \brief Restituisce 1 se l'host e' little endian, 2 se e' big endian
+ */
+static inline uint8_t host_byte_order(){
+    uint16_t one = 1;
+    uint8_t first;
+    memcpy(&first, &one, 1);
+    return first ? 1 : 2;
+}
+
+/**
+ * \brief Serializza un hello in buf (almeno HELLO_LEN byte)
+ *
+ * \param buf buffer di destinazione
+ * \param role HELLO_MASTER o HELLO_WORKER
+ * \param node_id identificativo del nodo (0 nella richiesta di registrazione del Master)
+ */
+static inline void encode_hello(char *buf, uint8_t role, uint32_t node_id){
+    uint8_t magic = HELLO_MAGIC, version = PROTO_VERSION, order = host_byte_order();
+    memcpy(buf, &magic, 1);
+    memcpy(buf + 1, &version, 1);
+    memcpy(buf + 2, &role, 1);
+    memcpy(buf + 3, &order, 1);
+    memcpy(buf + 4, &node_id, 4);
+}
+
+/**
+ * \brief Deserializza un hello
+ *
+ * \param buf buffer contenente almeno HELLO_LEN byte
+ * \param role ruolo della connessione
+ * \param node_id identificativo del nodo
+ *
+ * \retval 0 se l'hello è valido
+ * \retval -1 se magic, versione, ruolo o byte order non sono validi
+ */
+static inline int decode_hello(const char *buf, uint8_t *role, uint32_t *node_id){
+    uint8_t magic, version, order;
+    memcpy(&magic, buf, 1);
+    memcpy(&version, buf + 1, 1);
+    memcpy(role, buf + 2, 1);
+    memcpy(&order, buf + 3, 1);
+    memcpy(node_id, buf + 4, 4);
+    if(magic != HELLO_MAGIC || version != PROTO_VERSION || order != host_byte_order())
+        return -1;
+    if(*role != HELLO_MASTER && *role != HELLO_WORKER)
+        return -1;
+    return 0;
+}
+
+#endif // PROTO_H
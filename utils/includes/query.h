@@ -0,0 +1,88 @@
+#if !defined(QUERY_H)
+#define QUERY_H
+
+#include <sor_list.h>
+
+#define Q_SUCCESS 0
+#define Q_FAILURE -1
+
+//massima lunghezza di una richiesta (compreso '\n')
+#define _QUERY_LINE_LEN 512
+//massimo numero di risultati della richiesta top
+#define _QUERY_MAX_TOP 100
+#define _QUERY_DEFAULT_TOP 20
+//connessioni di controllo aperte contemporaneamente
+#define _QUERY_MAX_CONNS 16
+
+/**
+ * @file query.h
+ * @brief Interfaccia del socket di controllo del Collector (-Q): interrogazioni puntuali sui risultati raccolti
+ *          finora, servite dal ciclo di eventi del Collector senza interrompere la raccolta.
+ *
+ *          Protocollo testuale: una richiesta per riga, la risposta e' composta da una o piu' righe seguite da una
+ *          riga vuota. Gli elementi vengono restituiti come "rank risultato path", con rank (da 0) nell'ordinamento
+ *          della stampa; vengono considerati solo i risultati validi (quelli stampati).
+ *
+ *          count           numero di risultati
+ *          path <path>     ultimo risultato ricevuto per path (O(1) atteso, indice hash dei path)
+ *          rank <k>        risultato di rank k (O(log n), contatori dei sottoalberi del B+-tree)
+ *          pct <p>         percentile p (0-100, nearest rank), es. "pct 99"
+ *          above <v>       numero di risultati > v (O(log n))
+ *          top [k]         i k risultati maggiori in ordine decrescente (default 20, max 100)
+ *          metrics         metriche del Collector in formato testuale Prometheus (vedi metrics.h)
+ *
+ *          Se un risultato non esiste la risposta e' "not found", per una richiesta non valida "error: <motivo>".
+ */
+
+/** Risposte di una connessione di controllo non ancora inviate: il ciclo di eventi le invia senza bloccarsi
+ *  (con EPOLLOUT quando il client non le legge subito)
+ *
+ */
+typedef struct qOut
+{
+    char *buf;
+    size_t len;     // byte accodati
+    size_t off;     // byte gia' inviati
+    size_t cap;
+} qOut_t;
+
+/**
+ * \brief Crea il socket AF_UNIX di controllo in ascolto (non bloccante), rimuovendo un eventuale file con lo stesso nome
+ *
+ * \param path nome del socket
+ *
+ * \retval fd file descriptor del socket in ascolto
+ * \retval Q_FAILURE in caso di errore
+ */
+int ctrl_listen(const char *path);
+
+/**
+ * \brief Risponde a una richiesta (senza '\n') accodando la risposta a out
+ *
+ * \param l lista dei risultati
+ * \param req richiesta
+ * \param out risposte da inviare della connessione
+ *
+ * \retval Q_SUCCESS se la risposta e' stata accodata (anche per richieste non valide)
+ * \retval Q_FAILURE in caso di errore di allocazione
+ */
+int answer_query(SList *l, const char *req, qOut_t *out);
+
+/**
+ * \brief Accoda len byte di data alle risposte da inviare
+ *
+ * \retval Q_SUCCESS se accodati
+ * \retval Q_FAILURE in caso di errore di allocazione
+ */
+int q_append(qOut_t *out, const char *data, size_t len);
+
+/**
+ * \brief Invia senza bloccarsi (fd non bloccante) le risposte accodate in out
+ *
+ * \retval 1 se tutte le risposte sono state inviate
+ * \retval 0 se restano byte da inviare (il client non li legge ancora)
+ * \retval Q_FAILURE in caso di errore di scrittura (errno settato)
+ */
+int q_flush(qOut_t *out, int fd);
+
+#endif // QUERY_H
@@ -0,0 +1,186 @@
+#if !defined(SERVER_H)
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <conc_queue.h>
+#include <sor_list.h>
+
+#define SV_SUCCESS 0
+#define SV_FAILURE -1
+
+//job attivi contemporaneamente (in scansione, in calcolo o in attesa dei risultati)
+#define _SERVER_MAX_JOBS 64
+//lunghezza della coda dei task di ogni job, riempita dal thread del job e svuotata dal dispatcher
+#define _SERVER_JOB_QLEN 64
+//intervallo (in ms) con cui il Master ricontrolla i segnali mentre attende le richieste
+#define _SERVER_POLL_MS 100
+//attesa massima (in ms) della richiesta di un client
+#define _SERVER_CLIENT_MS 1000
+//connessioni accettate di cui il Master sta ancora leggendo la richiesta
+#define _SERVER_MAX_PENDING 64
+//attesa massima (in ms) di ogni scrittura della risposta: un client che non legge non blocca il thread del job
+#define _SERVER_SEND_MS 5000
+//alla terminazione, i job senza nuovi risultati per _SERVER_STOP_MS (in ms) vengono interrotti
+#define _SERVER_STOP_MS 5000
+//massima lunghezza di una richiesta (compreso '\n')
+#define _SERVER_LINE_LEN 65536
+//primo carattere dei task di un job nella coda dei Workers (i path dei file non lo contengono)
+#define SV_TASK_MARK '\x1f'
+
+/**
+ * @file server.h
+ * @brief Modalita' server (-S): il MasterWorker resta attivo, con threadpool, coda e Collector thread, ed esegue i job
+ *          ricevuti sul socket di controllo AF_UNIX.
+ *
+ *          Protocollo testuale (come query.h): una richiesta per riga, la risposta termina con una riga vuota.
+ *
+ *          run <arg>...    esegue un job: gli argomenti sono file .dat o .fpk e directory precedute da -d, come sulla
+ *                          riga di comando di farm. La risposta arriva alla fine del job: i risultati ordinati, come
+ *                          la stampa di farm, seguiti da una riga "error: <path>: overflow|file error" per ogni file
+ *                          non calcolato dai Workers (gli argomenti scartati dalla scansione sono segnalati, come da
+ *                          farm, sullo stderr del server) e dalla riga "error: scan interrupted" se un errore della
+ *                          coda del job ha interrotto la scansione (solo di quel job)
+ *
+ *          Ogni job ha una coda di task, riempita dal proprio thread con la scansione del Master, e una lista di
+ *          risultati. Il dispatcher inserisce nella coda dei Workers un task per job a turno (round robin), cosi' la
+ *          coda, corta, resta divisa tra i job attivi. I task portano l'identificativo del job (SV_TASK_MARK), che i
+ *          Workers riportano nei frame (campo job, vedi proto.h) e il Collector thread usa per smistare i risultati.
+ *          Un job termina quando il dispatcher ha inserito tutti i suoi task ed e' arrivato un risultato per ogni file.
+ *          Alla terminazione del server, un job che non riceve risultati per _SERVER_STOP_MS (ad esempio per un Worker
+ *          terminato) viene interrotto: la risposta contiene i risultati arrivati e la riga "error: job aborted".
+ */
+
+struct mastArgs;
+
+/** Job in corso
+ *
+ */
+typedef struct job
+{
+    uint16_t id;            // identificativo nei frame (1-65535)
+    int fd;                 // connessione del client, su cui viene scritta la risposta
+    BQueue_t *tasks;        // task prodotti dalla scansione, terminati da EOS
+    SList *l;               // risultati del job
+    char *errs;             // righe di errore della risposta
+    size_t errs_len;
+    size_t errs_cap;
+    size_t expected;        // risultati attesi per i task inseriti dal dispatcher
+    size_t received;        // risultati arrivati al Collector thread
+    int dispatched;         // il dispatcher ha prelevato EOS: expected e' definitivo
+    int argc;               // argomenti della richiesta (puntano dentro req)
+    char **argv;
+    char *req;
+    struct jobTable *jt;
+} job_t;
+
+/** Tabella dei job, condivisa da Master, thread dei job, dispatcher e Collector thread
+ *
+ */
+typedef struct jobTable
+{
+    pthread_mutex_t m;
+    pthread_cond_t ready;   // nuovi job per il dispatcher
+    pthread_cond_t done;    // job completati e job rimossi
+    job_t *slots[_SERVER_MAX_JOBS]; // job di identificativo id nello slot id % _SERVER_MAX_JOBS
+    size_t njobs;
+    uint16_t last_id;
+    size_t rr;              // prossimo slot servito dal dispatcher
+    int stop;               // nessun nuovo job: il dispatcher termina quando tutti i task sono inseriti
+    int abort;              // job interrotti da stop_jobs: il dispatcher non inserisce piu' task nella coda dei Workers
+    int idle;               // il dispatcher attende su ready
+    struct job *pushing;    // job di cui il dispatcher sta inserendo un task (senza jt->m)
+    size_t progress;        // risultati registrati e task inseriti, per riconoscere i job che non possono terminare
+    int max_path_len;
+    pthread_t dispatcher;
+    BQueue_t *q;            // coda dei Workers
+    const struct mastArgs *mARGS; // argomenti del master, copiati dai thread dei job per la scansione
+} jobTable_t;
+
+/**
+ * \brief Scrive in buf (lungo len) il task task del job job
+ *
+ * \retval SV_SUCCESS se il task sta in buf
+ * \retval SV_FAILURE altrimenti
+ */
+static inline int svFormatTask(char *buf, size_t len, uint16_t job, const char *task){
+    int r = snprintf(buf, len, "%c%u %s", SV_TASK_MARK, (unsigned)job, task);
+    return (r > 0 && (size_t)r < len) ? SV_SUCCESS : SV_FAILURE;
+}
+
+/**
+ * \brief Se task e' il task di un job ne toglie l'identificativo (in place), lasciando il task originale
+ *
+ * \return identificativo del job, 0 se task non e' il task di un job
+ */
+static inline uint16_t svParseTask(char *task){
+    if(task[0] != SV_TASK_MARK)
+        return 0;
+    char *end;
+    unsigned long id = strtoul(task + 1, &end, 10);
+    if(*end != ' ' || id == 0 || id > UINT16_MAX)
+        return 0;
+    memmove(task, end + 1, strlen(end + 1) + 1);
+    return (uint16_t)id;
+}
+
+/**
+ * \brief Inizializza la tabella dei job
+ *
+ * \retval jt tabella allocata
+ * \retval NULL in caso di errore
+ */
+jobTable_t *init_jobs(int max_path_len);
+
+/**
+ * \brief Cancella la tabella dei job (senza job attivi)
+ */
+void delete_jobs(jobTable_t *jt);
+
+/**
+ * \brief Registra il risultato di un file del job id (chiamata dal Collector thread)
+ *
+ * \param path path del file
+ * \param result risultato del calcolo
+ * \param status esito del calcolo (FRAME_OK, FRAME_OVERFLOW o FRAME_FILE_ERROR)
+ *
+ * \retval SV_SUCCESS se il risultato e' stato registrato
+ * \retval SV_FAILURE se il job non esiste o in caso di errore di allocazione
+ */
+int job_result(jobTable_t *jt, uint16_t id, const char *path, long result, uint8_t status);
+
+/**
+ * \brief Segnala al dispatcher un task inserito nella coda di un job (chiamata dalla scansione del job dopo la push)
+ */
+void job_task_ready(jobTable_t *jt);
+
+/**
+ * \brief Avvia il dispatcher, che inserisce i task dei job nella coda dei Workers mARGS->q
+ *
+ * \param mARGS argomenti del master (controllare definizione di masterArgs), validi fino a stop_jobs
+ *
+ * \retval SV_SUCCESS in caso di successo
+ * \retval SV_FAILURE in caso di errore
+ */
+int start_jobs(jobTable_t *jt, const struct mastArgs *mARGS);
+
+/**
+ * \brief Esegue la richiesta req (senza '\n') del client fd, di cui diventa proprietario: avvia il thread del job,
+ *          che scrive la risposta alla fine del job, oppure risponde subito con un errore
+ *
+ * \retval SV_SUCCESS se il job e' stato avviato
+ * \retval SV_FAILURE se la richiesta non e' valida o in caso di errore (risposta "error: <motivo>")
+ */
+int submit_job(jobTable_t *jt, int fd, const char *req);
+
+/**
+ * \brief Rifiuta i nuovi job, attende la fine di quelli in corso e termina il dispatcher; se per _SERVER_STOP_MS
+ *          non arrivano risultati ne' vengono inseriti task, interrompe i job rimasti
+ */
+void stop_jobs(jobTable_t *jt);
+
+#endif // SERVER_H
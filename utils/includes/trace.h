@@ -0,0 +1,83 @@
+#if !defined(TRACE_H)
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TR_SUCCESS 0
+#define TR_FAILURE -1
+
+//eventi per blocco del buffer di un thread e byte per blocco dei path copiati
+#define _TRACE_BLOCK_EVENTS 4096
+#define _TRACE_BLOCK_CHARS (64 * 1024)
+//lunghezza massima del nome del file di trace (compreso il suffisso del Collector)
+#define _MAX_TRACE_FILE_LEN (4096 + sizeof(_TRACE_COLLECTOR_SUFFIX))
+//suffisso del file in cui il Collector processo scrive i propri eventi (accodati al trace dal MasterWorker)
+#define _TRACE_COLLECTOR_SUFFIX ".collector"
+
+/**
+ * @file trace.h
+ * @brief Tracciamento del ciclo di vita dei file, compilato solo con -D FARM_TRACE (make tracefarm) ed attivato con -T <file>.
+ *          Eventi: push in coda (Master), pop, open, read, compute ed invio (Worker), decodifica e ricezione (Collector).
+ *          Ogni thread scrive in un proprio buffer a blocchi (un solo scrittore, nessuna lock), registrato in una lista
+ *          globale con una compare-and-swap alla prima scrittura del thread.
+ *          A fine esecuzione il MasterWorker scrive il trace in formato JSON di Chrome/Perfetto (chrome://tracing,
+ *          ui.perfetto.dev): una slice per fase sul thread che l'ha eseguita e, per ogni file, gli intervalli asincroni
+ *          "queued" (dalla push alla pop) e "pending" (dalla fine del calcolo alla ricezione nel Collector), identificati
+ *          dall'hash del path. Il Collector processo scrive i propri eventi in <file>.collector, che il MasterWorker
+ *          accoda al trace dopo averne atteso la terminazione (i timestamp sono di CLOCK_MONOTONIC, comune ai processi).
+ *          Senza FARM_TRACE le macro non generano codice e non valutano i propri argomenti.
+ */
+
+typedef enum { TR_PUSH, TR_POP, TR_OPEN, TR_READ, TR_COMPUTE, TR_SEND, TR_DECODE, TR_RECEIVE, TR_N } traceType_t;
+
+#ifdef FARM_TRACE
+
+//tracciamento attivo (-T)
+extern int trace_on;
+
+/**
+ * \brief Attiva il tracciamento verso file (da chiamare prima della fork del Collector)
+ *
+ * \retval TR_SUCCESS se il file e' scrivibile
+ * \retval TR_FAILURE altrimenti (errno settato)
+ */
+int trace_init(const char *file);
+
+/**
+ * \brief Assegna al buffer del thread chiamante il nome "name idx" (idx < 0 per il solo name)
+ */
+void trace_thread(const char *name, long idx);
+
+/**
+ * \brief Registra un evento del thread chiamante: fase type da start a end (ns, CLOCK_MONOTONIC) sul file path
+ *          (copiato, puo' essere NULL) o su n risultati
+ */
+void trace_event(traceType_t type, uint64_t start, uint64_t end, const char *path, size_t n);
+
+/**
+ * \brief Scrive gli eventi di tutti i thread (che devono aver terminato) e libera i buffer: il trace completo
+ *          dal MasterWorker (collector == 0), il file <file>.collector dal Collector processo (collector == 1)
+ *
+ * \retval TR_SUCCESS se il file e' stato scritto
+ * \retval TR_FAILURE in caso di errore di scrittura
+ */
+int trace_write(int collector);
+
+#define TRACE_ON trace_on
+#define TRACE_INIT(file) trace_init(file)
+#define TRACE_THREAD(name, idx) do{ if(trace_on) trace_thread(name, idx); }while(0)
+#define TRACE_EVENT(type, start, end, path, n) do{ if(trace_on) trace_event(type, start, end, path, n); }while(0)
+#define TRACE_WRITE(collector) (trace_on ? trace_write(collector) : TR_SUCCESS)
+
+#else
+
+#define TRACE_ON 0
+#define TRACE_INIT(file) ((void)sizeof(file), errno = ENOTSUP, TR_FAILURE)
+#define TRACE_THREAD(name, idx) do{ (void)sizeof(name); (void)sizeof(idx); }while(0)
+#define TRACE_EVENT(type, start, end, path, n) do{ (void)sizeof(start); (void)sizeof(end); (void)sizeof(path); (void)sizeof(n); }while(0)
+#define TRACE_WRITE(collector) TR_SUCCESS
+
+#endif // FARM_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,92 @@
+#if !defined(WATCHER_H)
+#define WATCHER_H
+
+#include <stddef.h>
+
+#define W_SUCCESS 0
+#define W_FAILURE -1
+
+//consts
+#define _WATCH_EVENTS_BUF_LEN 65536
+#define _WATCH_POLL_MS 1000 //timeout della poll, per ricontrollare i flag dei segnali
+
+/**
+ * @file watcher.h
+ * @brief Interfaccia per la modalità watch (-w): monitoraggio delle directories tramite inotify.
+ */
+
+/** Struttura del watcher: file descriptor inotify e path di ogni watch descriptor
+ *
+ */
+typedef struct watcher
+{
+    int fd;         // file descriptor inotify
+    char **paths;   // path della directory monitorata, indicizzato per watch descriptor
+    int npaths;     // dimensione di paths
+    size_t max_path_len;
+} watcher_t;
+
+/** Tipi di evento restituiti da next_watch_event
+ *
+ */
+typedef enum watchEvent
+{
+    WATCH_NONE = 0, // nessun altro evento nel buffer
+    WATCH_FILE,     // file chiuso dopo una scrittura o spostato in una directory monitorata
+    WATCH_DIR       // nuova sotto-directory (creata o spostata) da monitorare e scansionare
+} watchEvent_t;
+
+/**
+ * \brief Inizializza il watcher
+ *
+ * \param w watcher da inizializzare
+ * \param max_path_len lunghezza massima dei path
+ *
+ * \retval W_SUCCESS in caso di successo
+ * \retval W_FAILURE in caso di errore (errno settato)
+ */
+int init_watcher(watcher_t *w, size_t max_path_len);
+
+/**
+ * \brief Aggiunge un watch sulla directory path (non ricorsivo: le sotto-directory vengono aggiunte dal chiamante)
+ *
+ * \param w watcher
+ * \param path directory da monitorare
+ *
+ * \retval W_SUCCESS in caso di successo
+ * \retval W_FAILURE in caso di errore
+ */
+int add_watch_dir(watcher_t *w, const char *path);
+
+/**
+ * \brief Legge un blocco di eventi da inotify (chiamata non bloccante)
+ *
+ * \param w watcher
+ * \param buf buffer in cui vengono letti gli eventi (allineato e lungo almeno _WATCH_EVENTS_BUF_LEN)
+ *
+ * \retval n numero di byte letti (0 se non ci sono eventi)
+ * \retval -1 in caso di errore (errno settato)
+ */
+long read_watch_events(watcher_t *w, char *buf);
+
+/**
+ * \brief Estrae il prossimo evento rilevante dal buffer letto con read_watch_events
+ *
+ * \param w watcher
+ * \param buf buffer degli eventi
+ * \param len numero di byte validi in buf
+ * \param off offset del prossimo evento (aggiornato dalla funzione)
+ * \param path buffer (lungo max_path_len) in cui viene scritto il path completo del file/directory
+ *
+ * \return tipo dell'evento (WATCH_NONE se il buffer è stato consumato)
+ */
+watchEvent_t next_watch_event(watcher_t *w, const char *buf, long len, long *off, char *path);
+
+/**
+ * \brief Chiude il watcher e libera la memoria
+ *
+ * \param w watcher
+ */
+void delete_watcher(watcher_t *w);
+
+#endif // WATCHER_H
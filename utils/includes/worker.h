@@ -3,6 +3,15 @@
 
 #include <pthread.h>
 #include <conc_queue.h>
+#include <affinity.h>
+#include <mpsc_queue.h>
+#include <shm_ring.h>
+#include <metrics.h>
+
+//dimensione iniziale del buffer di lettura di ogni Worker (allocato dopo il pinning, first-touch sul nodo locale)
+#define _WORKER_BUF_INIT_SIZE 65536
+//attesa (in ms) tra due tentativi di connessione al Collector centrale (modalità -R)
+#define _WORKER_RETRY_MS 50
 
 /**
  * \file worker.h
@@ -17,6 +26,16 @@ typedef struct threadArgs // tipo di dato usato per passare gli argomenti al thr
     BQueue_t *q;
     int max_path_len;
     const char* sockname;
+    MQueue_t *mq;           // coda verso il Collector thread (modalità -i), NULL se si usa il socket
+    SRing_t *ring;          // ring condiviso con il Collector (modalità -s), NULL se si usa il socket
+    const char *remote;     // indirizzo del Collector centrale (modalità -R), NULL se il Collector e' locale
+    uint32_t node_id;       // identificativo del nodo, presentato nell'hello al Collector centrale
+    size_t batch;           // numero massimo di risultati per invio
+    size_t latency;         // tempo massimo (ms) di permanenza di un risultato nel buffer di invio
+    size_t id;              // indice del Worker nel threadpool
+    const affinity_t *aff;  // piano di affinity (NULL se non richiesto)
+    workerMetrics_t *metrics; // contatori del Worker (scritti solo dal Worker)
+    int server;             // modalita' server (-S): il Worker non termina dopo un errore di calcolo
 } threadArgs_t;
 
 /**
@@ -0,0 +1,128 @@
+#include <mpsc_queue.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <util.h>
+
+/**
+ * \file mpsc_queue.c
+ * \brief File di implementazione dell'interfaccia per la coda multi-producer single-consumer
+ */
+
+/* ------------------- interfaccia della coda ------------------ */
+
+MQueue_t *initMQueue()
+{
+    MQueue_t *q = (MQueue_t *)calloc(1, sizeof(MQueue_t));
+    if (!q)
+    {
+        perror("calloc");
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&q->m, NULL) != 0)
+    {
+        perror("pthread_mutex_init");
+        free(q);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&q->cnotempty, NULL) != 0)
+    {
+        perror("pthread_cond_init");
+        pthread_mutex_destroy(&q->m);
+        free(q);
+        return NULL;
+    }
+
+    q->stack = NULL;
+    q->sleeping = 0;
+    return q;
+}
+
+void deleteMQueue(MQueue_t *q)
+{
+    if (!q)
+    {
+        errno = EINVAL;
+        return;
+    }
+    MQNode_t *n = q->stack;
+    while (n != NULL){
+        MQNode_t *next = n->next;
+        free(n);
+        n = next;
+    }
+    pthread_mutex_destroy(&q->m);
+    pthread_cond_destroy(&q->cnotempty);
+    free(q);
+}
+
+MQNode_t *allocMQNode(int type, size_t len)
+{
+    MQNode_t *n = (MQNode_t *)malloc(sizeof(MQNode_t) + len);
+    if (!n)
+    {
+        perror("malloc");
+        return NULL;
+    }
+    n->next = NULL;
+    n->type = type;
+    n->len = len;
+    return n;
+}
+
+int mqPush(MQueue_t *q, MQNode_t *n)
+{
+    if (!q || !n)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // inserimento lock-free in testa allo stack
+    MQNode_t *old = __atomic_load_n(&q->stack, __ATOMIC_RELAXED);
+    do {
+        n->next = old;
+    } while (!__atomic_compare_exchange_n(&q->stack, &old, n, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    // sveglio il consumatore solo se sta dormendo
+    if (__atomic_load_n(&q->sleeping, __ATOMIC_SEQ_CST)){
+        LOCK(&q->m);
+        SIGNAL(&q->cnotempty);
+        UNLOCK(&q->m);
+    }
+
+    return 0;
+}
+
+MQNode_t *mqPopAll(MQueue_t *q)
+{
+    if (!q)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    MQNode_t *list = __atomic_exchange_n(&q->stack, NULL, __ATOMIC_SEQ_CST);
+    if (list == NULL){ // coda vuota: attendo un producer
+        LOCK(&q->m);
+        __atomic_store_n(&q->sleeping, 1, __ATOMIC_SEQ_CST);
+        while ((list = __atomic_exchange_n(&q->stack, NULL, __ATOMIC_SEQ_CST)) == NULL)
+            WAIT(&q->cnotempty, &q->m);
+        __atomic_store_n(&q->sleeping, 0, __ATOMIC_SEQ_CST);
+        UNLOCK(&q->m);
+    }
+
+    // lo stack contiene i messaggi in ordine inverso: lo ribalto per restituirli in ordine FIFO
+    MQNode_t *fifo = NULL;
+    while (list != NULL){
+        MQNode_t *next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    return fifo;
+}
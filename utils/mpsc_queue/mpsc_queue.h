@@ -0,0 +1,70 @@
+#if !defined(MPSC_QUEUE_H)
+#define MPSC_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+//tipi di messaggio
+#define MQ_FRAMES 0 // blocco di frame (vedi proto.h) prodotto da un Worker
+#define MQ_CMD 1    // comando del Master (es. "usr1")
+#define MQ_QUIT 2   // fine dello stream: il consumatore termina dopo aver processato i messaggi precedenti
+
+/** Messaggio della coda: i dati sono allocati insieme al nodo
+ *
+ */
+typedef struct mq_node
+{
+    struct mq_node *next;
+    int type;
+    size_t len;   // byte validi in data
+    char data[];
+} MQNode_t;
+
+/** Coda illimitata multi-producer single-consumer.
+ *  I producer inseriscono con una sola operazione atomica (nessuna lock e nessuna syscall se il consumatore
+ *  e' attivo); il consumatore preleva tutti i messaggi presenti in un colpo solo, in ordine FIFO.
+ */
+typedef struct mqueue
+{
+    MQNode_t *stack;    // messaggi inseriti (in ordine inverso)
+    int sleeping;       // 1 se il consumatore e' in attesa sulla condition variable
+    pthread_mutex_t m;
+    pthread_cond_t cnotempty;
+} MQueue_t;
+
+/** Alloca ed inizializza una coda vuota
+ *
+ *   \retval NULL se si sono verificati problemi nell'allocazione (errno settato)
+ *   \retval q puntatore alla coda allocata
+ */
+MQueue_t *initMQueue();
+
+/** Cancella una coda allocata con initMQueue (e gli eventuali messaggi non prelevati).
+ *
+ *   \param q puntatore alla coda da cancellare
+ */
+void deleteMQueue(MQueue_t *q);
+
+/** Alloca un messaggio con spazio per len byte di dati
+ *
+ *   \retval NULL in caso di errore di allocazione
+ *   \retval n puntatore al messaggio (len gia' settato)
+ */
+MQNode_t *allocMQNode(int type, size_t len);
+
+/** Inserisce un messaggio nella coda (la coda ne diventa proprietaria).
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente)
+ */
+int mqPush(MQueue_t *q, MQNode_t *n);
+
+/** Preleva tutti i messaggi presenti, attendendo se la coda e' vuota.
+ *  I messaggi sono concatenati tramite next in ordine di inserimento e vanno liberati con free.
+ *
+ *  \retval lista dei messaggi
+ *  \retval NULL in caso di errore (errno settato opportunamente)
+ */
+MQNode_t *mqPopAll(MQueue_t *q);
+
+#endif /* MPSC_QUEUE_H */
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include <pack_file.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <proto.h>
+
+/**
+ * @file pack_file.c
+ * @brief File di implementazione dell'interfaccia per gli archivi di file di input
+ */
+
+#define PK_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+/* ------------------- lettura -------------------- */
+
+int pkOpen(Pack_t *p, const char *path){
+    memset(p, 0, sizeof(Pack_t));
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return PK_FAILURE;
+    struct stat st;
+    if(fstat(fd, &st) == -1){
+        close(fd);
+        return PK_FAILURE;
+    }
+    if((size_t)st.st_size < sizeof(pkHeader_t)){
+        close(fd);
+        errno = EINVAL;
+        return PK_FAILURE;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return PK_FAILURE;
+
+    const pkHeader_t *h = map;
+    uint64_t len = st.st_size;
+    int ok = memcmp(h->magic, PK_MAGIC, sizeof(h->magic)) == 0 && h->version == PK_VERSION && h->byte_order == host_byte_order()
+        && h->index_off % 8 == 0 && h->index_off <= len && h->nentries <= (len - h->index_off) / sizeof(pkEntry_t)
+        && h->names_off <= len && h->names_len <= len - h->names_off;
+    const pkEntry_t *idx = (const pkEntry_t *)((const char *)map + h->index_off);
+    const char *names = (const char *)map + h->names_off;
+    //ogni nome terminato da '\0' nella sezione dei nomi ed ogni dato allineato e nel file
+    //(i limiti sono confrontati per sottrazione: offset e lunghezze letti dal file non possono causare overflow)
+    for(uint64_t i = 0; ok && i < h->nentries; i++)
+        ok = idx[i].name_off < h->names_len && idx[i].name_len < h->names_len - idx[i].name_off
+            && names[idx[i].name_off + idx[i].name_len] == '\0' && idx[i].data_off % 8 == 0
+            && idx[i].data_off <= len && idx[i].length <= len - idx[i].data_off;
+    if(!ok){
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return PK_FAILURE;
+    }
+    //le entry vengono lette in ordine dai Worker
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    p->map = map;
+    p->len = st.st_size;
+    p->h = h;
+    p->idx = idx;
+    p->names = names;
+    return PK_SUCCESS;
+}
+
+void pkClose(Pack_t *p){
+    if(p->map)
+        munmap(p->map, p->len);
+    memset(p, 0, sizeof(Pack_t));
+}
+
+/* ------------------- scrittura -------------------- */
+
+/** Scrittura sequenziale tramite un buffer
+ *
+ */
+typedef struct pk_stream
+{
+    int fd;
+    char *buf;
+    size_t len;
+} PKStream;
+
+static int streamFlush(PKStream *s){
+    size_t done = 0;
+    while(done < s->len){
+        ssize_t w = write(s->fd, s->buf + done, s->len - done);
+        if(w == -1){
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += w;
+    }
+    s->len = 0;
+    return 0;
+}
+
+static int streamWrite(PKStream *s, const void *data, size_t len){
+    while(len > 0){
+        if(s->len == PK_BUF_LEN && streamFlush(s) != 0)
+            return -1;
+        size_t chunk = (len < PK_BUF_LEN - s->len) ? len : PK_BUF_LEN - s->len;
+        memcpy(s->buf + s->len, data, chunk);
+        s->len += chunk;
+        data = (const char *)data + chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+//copia i length byte del file path nello stream
+static int copyFile(PKStream *s, const char *path, uint64_t length){
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return -1;
+    uint64_t done = 0;
+    while(done < length){
+        if(s->len == PK_BUF_LEN && streamFlush(s) != 0)
+            break;
+        ssize_t r = read(fd, s->buf + s->len, (length - done < PK_BUF_LEN - s->len) ? length - done : PK_BUF_LEN - s->len);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r <= 0){
+            if(r == 0) //file accorciato dopo la stat
+                errno = EIO;
+            break;
+        }
+        s->len += r;
+        done += r;
+    }
+    int e = errno;
+    close(fd);
+    errno = e;
+    return (done == length) ? 0 : -1;
+}
+
+int pkWrite(int fd, char **names, char **paths, size_t n, size_t max_name_len){
+    pkEntry_t *idx = calloc(n ? n : 1, sizeof(pkEntry_t));
+    if(!idx)
+        return PK_FAILURE;
+
+    pkHeader_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PK_MAGIC, sizeof(h.magic));
+    h.version = PK_VERSION;
+    h.byte_order = host_byte_order();
+    h.nentries = n;
+    h.index_off = PK_ALIGN(sizeof(pkHeader_t));
+    h.names_off = h.index_off + n * sizeof(pkEntry_t);
+
+    //dimensioni note prima della scrittura: nomi e offset dei dati
+    for(size_t i = 0; i < n; i++){
+        struct stat st;
+        size_t name_len = strlen(names[i]);
+        if(name_len == 0 || name_len >= max_name_len){
+            free(idx);
+            errno = ENAMETOOLONG;
+            return PK_FAILURE;
+        }
+        if(stat(paths[i], &st) == -1){
+            free(idx);
+            return PK_FAILURE;
+        }
+        idx[i].name_off = h.names_len;
+        idx[i].name_len = name_len;
+        idx[i].length = st.st_size;
+        h.names_len += name_len + 1;
+    }
+    h.data_off = PK_ALIGN(h.names_off + h.names_len);
+    uint64_t off = h.data_off;
+    for(size_t i = 0; i < n; i++){
+        idx[i].data_off = off;
+        off = PK_ALIGN(off + idx[i].length);
+    }
+
+    //dimensione finale nota in anticipo: preallocazione (best effort)
+    fallocate(fd, 0, 0, off);
+
+    static const char zeros[8];
+    PKStream s = {fd, malloc(PK_BUF_LEN), 0};
+    int err = !s.buf || streamWrite(&s, &h, sizeof(h)) != 0 || streamWrite(&s, zeros, h.index_off - sizeof(h)) != 0
+        || streamWrite(&s, idx, n * sizeof(pkEntry_t)) != 0;
+    for(size_t i = 0; !err && i < n; i++)
+        err = streamWrite(&s, names[i], idx[i].name_len + 1) != 0;
+    err = err || streamWrite(&s, zeros, h.data_off - h.names_off - h.names_len) != 0;
+    for(size_t i = 0; !err && i < n; i++)
+        err = copyFile(&s, paths[i], idx[i].length) != 0 || streamWrite(&s, zeros, PK_ALIGN(idx[i].length) - idx[i].length) != 0;
+    err = err || streamFlush(&s) != 0;
+
+    int e = errno;
+    free(s.buf);
+    free(idx);
+    errno = e;
+    return err ? PK_FAILURE : PK_SUCCESS;
+}
+
+/* ------------------- task del Master -------------------- */
+
+int pkFormatTask(char *buf, size_t len, const char *path, uint64_t first, uint64_t count){
+    int r = snprintf(buf, len, "%c%" PRIu64 " %" PRIu64 " %s", PK_TASK_MARK, first, count, path);
+    return (r > 0 && (size_t)r < len) ? PK_SUCCESS : PK_FAILURE;
+}
+
+int pkParseTask(const char *task, uint64_t *first, uint64_t *count, const char **path){
+    if(task[0] != PK_TASK_MARK)
+        return PK_FAILURE;
+    int consumed = 0;
+    if(sscanf(task + 1, "%" SCNu64 " %" SCNu64 " %n", first, count, &consumed) != 2 || consumed == 0)
+        return PK_FAILURE;
+    *path = task + 1 + consumed;
+    return PK_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#if !defined(PACK_FILE_H)
+#define PACK_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PK_SUCCESS 0
+#define PK_FAILURE -1
+
+#define PK_MAGIC "FARMPCK"      // 8 byte compreso il terminatore
+#define PK_VERSION 1
+#define PK_EXT "fpk"            // estensione degli archivi, riconosciuti dal Master accanto ai file .dat
+//entry per task: il Master inserisce in coda un task ogni PK_TASK_ENTRIES entry dell'archivio
+#define PK_TASK_ENTRIES 256
+//primo carattere dei task di un archivio nella coda del Master (i path dei file non lo contengono)
+#define PK_TASK_MARK '\x1e'
+//buffer di copia del packer
+#define PK_BUF_LEN (1 << 20)
+
+/**
+ * @file pack_file.h
+ * @brief Archivio di molti file di input piccoli, pensato per essere mappato in memoria (mmap) dai Worker:
+ *          un solo file al posto di milioni, senza visita delle directory, stat ed open per file.
+ *          Tutti i campi sono in byte order dell'host che lo ha scritto (indicato nell'header); le sezioni ed i dati
+ *          di ogni entry sono allineati a 8 byte.
+ *
+ *          | header (56) | indice (32 * nentries) | nomi (names_len) | dati |
+ *
+ *          Ogni entry dell'indice ha il nome logico del file originale (terminato da '\0' nella sezione dei nomi,
+ *          stampato da farm al posto del path dell'archivio), l'offset e la lunghezza dei suoi dati: il contenuto
+ *          del file originale, un array di long o un file in formato compatto (compact_file.h).
+ *          Il Master inserisce in coda task da PK_TASK_ENTRIES entry (PK_TASK_MARK, prima entry, numero di entry e path
+ *          dell'archivio); il Worker mappa l'archivio una volta e calcola tutte le entry del task.
+ */
+
+/** Header dell'archivio
+ *
+ */
+typedef struct pkHeader
+{
+    char magic[8];          // PK_MAGIC
+    uint32_t version;       // PK_VERSION
+    uint32_t byte_order;    // 1 little endian, 2 big endian
+    uint64_t nentries;
+    uint64_t index_off;     // offset dell'indice
+    uint64_t names_off;     // offset della sezione dei nomi
+    uint64_t names_len;
+    uint64_t data_off;      // offset dei dati
+} pkHeader_t;
+
+/** Entry dell'indice
+ *
+ */
+typedef struct pkEntry
+{
+    uint64_t name_off;      // offset del nome nella sezione dei nomi
+    uint64_t data_off;      // offset dei dati nel file (allineato a 8 byte)
+    uint64_t length;        // lunghezza dei dati (in byte)
+    uint32_t name_len;      // lunghezza del nome (senza '\0')
+    uint32_t pad;
+} pkEntry_t;
+
+/** Archivio aperto in lettura (mappato in memoria)
+ *
+ */
+typedef struct pack
+{
+    void *map;
+    size_t len;
+    const pkHeader_t *h;
+    const pkEntry_t *idx;
+    const char *names;
+} Pack_t;
+
+/**
+ * \brief Mappa in memoria l'archivio path e ne controlla header ed indice (nomi e dati di ogni entry nel file)
+ *
+ * \retval PK_SUCCESS se l'archivio e' valido
+ * \retval PK_FAILURE altrimenti (errno settato, EINVAL se il file non e' un archivio valido)
+ */
+int pkOpen(Pack_t *p, const char *path);
+
+/**
+ * \brief Rilascia un archivio aperto con pkOpen
+ */
+void pkClose(Pack_t *p);
+
+/**
+ * \brief Nome logico dell'entry i (terminato da '\0')
+ */
+static inline const char *pkName(const Pack_t *p, uint64_t i){
+    return p->names + p->idx[i].name_off;
+}
+
+/**
+ * \brief Dati dell'entry i (allineati a 8 byte)
+ */
+static inline const void *pkData(const Pack_t *p, uint64_t i){
+    return (const char *)p->map + p->idx[i].data_off;
+}
+
+/**
+ * \brief Scrive su fd l'archivio degli n file paths, con i nomi logici names
+ *
+ * \param fd file descriptor di un file regolare aperto in scrittura (a partire dall'offset 0)
+ * \param names nomi logici (al piu' max_name_len - 1 caratteri)
+ * \param paths file da copiare nell'archivio
+ *
+ * \retval PK_SUCCESS se l'archivio e' stato scritto
+ * \retval PK_FAILURE in caso di errore (errno settato)
+ */
+int pkWrite(int fd, char **names, char **paths, size_t n, size_t max_name_len);
+
+/**
+ * \brief Scrive in buf (lungo len) il task delle count entry dell'archivio path a partire da first
+ *
+ * \retval PK_SUCCESS se il task sta in buf
+ * \retval PK_FAILURE altrimenti
+ */
+int pkFormatTask(char *buf, size_t len, const char *path, uint64_t first, uint64_t count);
+
+/**
+ * \brief Legge il task task (scritto da pkFormatTask): *path punta al path dell'archivio dentro task
+ *
+ * \retval PK_SUCCESS se task e' un task di un archivio
+ * \retval PK_FAILURE altrimenti
+ */
+int pkParseTask(const char *task, uint64_t *first, uint64_t *count, const char **path);
+
+#endif // PACK_FILE_H
@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include <res_file.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <proto.h>
+
+/**
+ * @file res_file.c
+ * @brief File di implementazione dell'interfaccia per il file binario dei risultati
+ */
+
+/* ------------------- funzioni di utilita' -------------------- */
+
+#define RF_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static inline uint64_t fnvAdd(uint64_t h, const char *s, size_t len){
+    for(size_t i = 0; i < len; i++){
+        h ^= (unsigned char)s[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+/** Sezione del file scritta in sequenza tramite un buffer
+ *
+ */
+typedef struct rf_stream
+{
+    int fd;
+    uint64_t off;   // offset del file a cui va scritto buf
+    char *buf;
+    size_t len;
+} RFStream;
+
+static int streamFlush(RFStream *s){
+    size_t done = 0;
+    while(done < s->len){
+        ssize_t w = pwrite(s->fd, s->buf + done, s->len - done, s->off + done);
+        if(w == -1){
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += w;
+    }
+    s->off += s->len;
+    s->len = 0;
+    return 0;
+}
+
+static int streamWrite(RFStream *s, const void *data, size_t len){
+    if(s->len + len > RF_BUF_LEN && streamFlush(s) != 0)
+        return -1;
+    if(len > RF_BUF_LEN){ //non entra nel buffer: scrittura diretta
+        RFStream d = {s->fd, s->off, (char *)data, len};
+        if(streamFlush(&d) != 0)
+            return -1;
+        s->off = d.off;
+        return 0;
+    }
+    memcpy(s->buf + s->len, data, len);
+    s->len += len;
+    return 0;
+}
+
+/** Stato della scrittura: un record, il path nella string table e il rank nell'indice hash per ogni elemento
+ *
+ */
+typedef struct rf_writer
+{
+    RFStream rec;
+    RFStream str;
+    uint64_t nrecords;
+    uint64_t str_len;
+    uint32_t *slots;
+    uint64_t nslots;
+} RFWriter;
+
+static int writeEntry(void *arg, long index, uint8_t status, const char *dir, size_t dir_len, const char *name){
+    RFWriter *w = arg;
+    size_t name_len = strlen(name);
+    if(w->nrecords == w->nslots / 2){ //la lista ha piu' elementi di quelli dichiarati
+        errno = EIO;
+        return -1;
+    }
+
+    rfRecord_t r;
+    memset(&r, 0, sizeof(r));
+    r.result = index;
+    r.path_off = w->str_len;
+    r.path_len = dir_len + name_len;
+    r.status = status;
+    if(streamWrite(&w->rec, &r, sizeof(r)) != 0)
+        return -1;
+    if(streamWrite(&w->str, dir, dir_len) != 0 || streamWrite(&w->str, name, name_len + 1) != 0)
+        return -1;
+    w->str_len += r.path_len + 1;
+
+    uint64_t j = fnvAdd(fnvAdd(FNV_OFFSET, dir, dir_len), name, name_len) & (w->nslots - 1);
+    while(w->slots[j] != 0)
+        j = (j + 1) & (w->nslots - 1);
+    w->slots[j] = ++w->nrecords;
+    return 0;
+}
+
+/* ------------------- interfaccia del file dei risultati ------------------ */
+
+int writeResultFile(SList *l, int fd){
+    if(!l || fd < 0){
+        errno = EINVAL;
+        return RF_FAILURE;
+    }
+
+    RFWriter w;
+    memset(&w, 0, sizeof(w));
+    w.nslots = 16;
+    while(w.nslots < 2 * l->lsize + 2)
+        w.nslots *= 2;
+
+    rfHeader_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, RF_MAGIC, sizeof(h.magic));
+    h.version = RF_VERSION;
+    h.byte_order = host_byte_order();
+    h.nrecords = l->lsize;
+    h.rec_off = RF_ALIGN(sizeof(rfHeader_t));
+    h.str_off = RF_ALIGN(h.rec_off + l->lsize * sizeof(rfRecord_t));
+    h.str_len = l->path_bytes + l->lsize;
+    h.hash_off = RF_ALIGN(h.str_off + h.str_len);
+    h.nslots = w.nslots;
+
+    //dimensione finale nota in anticipo: preallocazione (best effort)
+    fallocate(fd, 0, 0, h.hash_off + h.nslots * sizeof(uint32_t));
+
+    w.rec.fd = w.str.fd = fd;
+    w.rec.off = h.rec_off;
+    w.str.off = h.str_off;
+    w.rec.buf = malloc(RF_BUF_LEN);
+    w.str.buf = malloc(RF_BUF_LEN);
+    w.slots = calloc(w.nslots, sizeof(uint32_t));
+    int err = (!w.rec.buf || !w.str.buf || !w.slots);
+
+    if(!err)
+        err = (visitSList(l, writeEntry, &w) != 0 || streamFlush(&w.rec) != 0 || streamFlush(&w.str) != 0);
+    if(!err && (w.nrecords != h.nrecords || w.str_len != h.str_len)){
+        errno = EIO;
+        err = 1;
+    }
+    if(!err){ //indice hash e infine l'header
+        RFStream s = {fd, h.hash_off, (char *)w.slots, w.nslots * sizeof(uint32_t)};
+        err = (streamFlush(&s) != 0);
+        s.off = 0;
+        s.buf = (char *)&h;
+        s.len = sizeof(h);
+        err = err || (streamFlush(&s) != 0);
+    }
+
+    int e = errno;
+    free(w.rec.buf);
+    free(w.str.buf);
+    free(w.slots);
+    errno = e;
+    return err ? RF_FAILURE : RF_SUCCESS;
+}
+
+RFile_t *openResultFile(const char *name){
+    int fd = open(name, O_RDONLY);
+    if(fd == -1)
+        return NULL;
+    struct stat st;
+    if(fstat(fd, &st) == -1){
+        close(fd);
+        return NULL;
+    }
+    if((size_t)st.st_size < sizeof(rfHeader_t)){
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    const rfHeader_t *h = map;
+    uint64_t len = st.st_size;
+    if(memcmp(h->magic, RF_MAGIC, sizeof(h->magic)) != 0 || h->version != RF_VERSION || h->byte_order != host_byte_order()
+        || h->rec_off > len || h->nrecords > (len - h->rec_off) / sizeof(rfRecord_t) || h->str_off > len || h->str_len > len - h->str_off
+        || h->hash_off > len || h->nslots > (len - h->hash_off) / sizeof(uint32_t) || h->nslots == 0 || (h->nslots & (h->nslots - 1)) != 0){
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    //path di ogni record dentro la sezione delle stringhe e terminato da '\0': rfPath non controlla i record
+    const rfRecord_t *rec = (const rfRecord_t *)((const char *)map + h->rec_off);
+    const char *str = (const char *)map + h->str_off;
+    for(uint64_t i = 0; i < h->nrecords; i++){
+        if(rec[i].path_off >= h->str_len || rec[i].path_len >= h->str_len - rec[i].path_off || str[rec[i].path_off + rec[i].path_len] != '\0'){
+            munmap(map, st.st_size);
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    RFile_t *rf = malloc(sizeof(RFile_t));
+    if(!rf){
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    rf->map = map;
+    rf->len = st.st_size;
+    rf->h = h;
+    rf->rec = rec;
+    rf->str = str;
+    rf->slots = (const uint32_t *)((const char *)map + h->hash_off);
+    return rf;
+}
+
+void closeResultFile(RFile_t *rf){
+    if(!rf){
+        errno = EINVAL;
+        return;
+    }
+    munmap(rf->map, rf->len);
+    free(rf);
+}
+
+const rfRecord_t *rfByRank(const RFile_t *rf, uint64_t rank){
+    return (rank < rf->h->nrecords) ? &rf->rec[rank] : NULL;
+}
+
+const char *rfPath(const RFile_t *rf, const rfRecord_t *r){
+    return rf->str + r->path_off;
+}
+
+long rfFindPath(const RFile_t *rf, const char *path){
+    size_t len = strlen(path);
+    uint64_t mask = rf->h->nslots - 1;
+    uint64_t j = fnvAdd(FNV_OFFSET, path, len) & mask;
+    for(uint64_t probes = 0; probes < rf->h->nslots && rf->slots[j] != 0; probes++, j = (j + 1) & mask){
+        uint64_t rank = rf->slots[j] - 1;
+        if(rank >= rf->h->nrecords) //file corrotto
+            return -1;
+        const rfRecord_t *r = &rf->rec[rank];
+        if(r->path_len == len && r->path_off < rf->h->str_len && len < rf->h->str_len - r->path_off && memcmp(rf->str + r->path_off, path, len) == 0)
+            return rank;
+    }
+    return -1;
+}
+
+uint64_t rfLowerBound(const RFile_t *rf, int64_t result){
+    uint64_t lo = 0, hi = rf->h->nrecords;
+    while(lo < hi){
+        uint64_t mid = lo + (hi - lo) / 2;
+        if(rf->rec[mid].result < result)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    //i record con errori hanno risultato 0: sono contigui ai risultati validi uguali a 0 e vengono saltati
+    while(lo < rf->h->nrecords && rf->rec[lo].status != FRAME_OK)
+        lo++;
+    return lo;
+}
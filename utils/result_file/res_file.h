@@ -0,0 +1,128 @@
+#if !defined(RES_FILE_H)
+#define RES_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sor_list.h>
+
+#define RF_SUCCESS 0
+#define RF_FAILURE -1
+
+#define RF_MAGIC "FARMRES"      // 8 byte compreso il terminatore
+#define RF_VERSION 1
+//buffer di scrittura dei record e della string table
+#define RF_BUF_LEN (1 << 20)
+
+/**
+ * @file res_file.h
+ * @brief File binario dei risultati del Collector, pensato per essere mappato in memoria (mmap) dai consumatori.
+ *          Tutti i campi sono in byte order dell'host che lo ha scritto (indicato nell'header); le sezioni sono
+ *          allineate a 8 byte.
+ *
+ *          | header (64) | record (24 * nrecords) | string table (str_len) | indice hash (4 * nslots) |
+ *
+ *          I record sono ordinati per risultato come la stampa del Collector (a parita' di risultato, l'ultimo
+ *          ricevuto per primo) e comprendono anche i file con errori (status != 0, risultato 0).
+ *          La string table contiene i path terminati da '\0'. L'indice hash (FNV-1a a 64 bit del path, sondaggio
+ *          lineare, nslots potenza di 2) contiene per ogni slot 1 + rank del record, 0 se vuoto.
+ */
+
+/** Header del file
+ *
+ */
+typedef struct rfHeader
+{
+    char magic[8];          // RF_MAGIC
+    uint32_t version;       // RF_VERSION
+    uint32_t byte_order;    // 1 little endian, 2 big endian
+    uint64_t nrecords;
+    uint64_t rec_off;       // offset dei record
+    uint64_t str_off;       // offset della string table
+    uint64_t str_len;
+    uint64_t hash_off;      // offset dell'indice hash
+    uint64_t nslots;
+} rfHeader_t;
+
+/** Record di un risultato
+ *
+ */
+typedef struct rfRecord
+{
+    int64_t result;
+    uint64_t path_off;      // offset del path nella string table
+    uint32_t path_len;      // lunghezza del path (senza '\0')
+    uint8_t status;         // esito del calcolo (FRAME_OK, FRAME_OVERFLOW, FRAME_FILE_ERROR di proto.h)
+    uint8_t pad[3];
+} rfRecord_t;
+
+/** File dei risultati aperto in lettura (mappato in memoria)
+ *
+ */
+typedef struct rfile
+{
+    void *map;
+    size_t len;
+    const rfHeader_t *h;
+    const rfRecord_t *rec;
+    const char *str;
+    const uint32_t *slots;
+} RFile_t;
+
+/**
+ * \brief Scrive su fd il file binario dei risultati di l, con una sola visita ordinata della lista
+ *          (record e string table vengono scritti in parallelo nelle rispettive sezioni, l'indice hash alla fine)
+ *
+ * \param l lista dei risultati
+ * \param fd file descriptor di un file regolare aperto in scrittura (a partire dall'offset 0)
+ *
+ * \retval RF_SUCCESS se il file e' stato scritto
+ * \retval RF_FAILURE in caso di errore (errno settato)
+ */
+int writeResultFile(SList *l, int fd);
+
+/**
+ * \brief Apre e mappa in memoria un file dei risultati, controllandone header, dimensioni e il path di ogni record
+ *          (O(n) all'apertura: rfPath e farmres possono usare i path senza controlli)
+ *
+ * \param name nome del file
+ *
+ * \retval rf file aperto
+ * \retval NULL in caso di errore (errno settato, EINVAL se il formato non e' valido)
+ */
+RFile_t *openResultFile(const char *name);
+
+/**
+ * \brief Chiude un file aperto con openResultFile
+ */
+void closeResultFile(RFile_t *rf);
+
+/**
+ * \brief Record di posizione rank nell'ordinamento (O(1))
+ *
+ * \retval NULL se rank >= numero di record
+ */
+const rfRecord_t *rfByRank(const RFile_t *rf, uint64_t rank);
+
+/**
+ * \brief Path di un record
+ */
+const char *rfPath(const RFile_t *rf, const rfRecord_t *r);
+
+/**
+ * \brief Cerca un path con l'indice hash (O(1) atteso)
+ *
+ * \retval rank del primo record con quel path
+ * \retval -1 se il path non e' presente
+ */
+long rfFindPath(const RFile_t *rf, const char *path);
+
+/**
+ * \brief Rank del primo record valido (status FRAME_OK) con risultato >= result (ricerca binaria, O(log n)
+ *          piu' i record con errori a risultato 0 che vengono saltati)
+ *
+ * \return rank (uguale al numero di record se non ci sono risultati validi >= result)
+ */
+uint64_t rfLowerBound(const RFile_t *rf, int64_t result);
+
+#endif // RES_FILE_H
@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+#include <shm_ring.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+
+//tentativi di sched_yield prima di dormire quando il ring e' pieno
+#define SRING_SPIN 64
+#define SRING_BACKOFF_NS 50000
+//attese di SRING_BACKOFF_NS tra due controlli del consumatore (circa ogni 50 ms)
+#define SRING_CHECK 1024
+
+/**
+ * \file shm_ring.c
+ * \brief File di implementazione dell'interfaccia per il ring in memoria condivisa
+ */
+
+/* ------------------- funzioni di utilita' -------------------- */
+
+static inline SRingSlot_t *slotAt(SRing_t *r, uint64_t ticket)
+{
+    return (SRingSlot_t *)(r->slots + (ticket % r->sh->nslots) * r->stride);
+}
+
+/* ------------------- interfaccia del ring ------------------ */
+
+SRing_t *initSRing(size_t nslots, size_t slot_size)
+{
+    if (nslots == 0 || slot_size == 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    SRing_t *r = (SRing_t *)calloc(1, sizeof(SRing_t));
+    if (!r)
+    {
+        perror("calloc");
+        return NULL;
+    }
+
+    r->stride = (sizeof(SRingSlot_t) + slot_size + 63) & ~(size_t)63;
+    r->map_len = sizeof(SRingShared_t) + nslots * r->stride;
+
+    int fd = memfd_create("farm_ring", MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        perror("memfd_create");
+        free(r);
+        return NULL;
+    }
+    if (ftruncate(fd, r->map_len) == -1)
+    {
+        perror("ftruncate");
+        close(fd);
+        free(r);
+        return NULL;
+    }
+    void *p = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // la mappatura resta valida (e viene ereditata con la fork)
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        free(r);
+        return NULL;
+    }
+
+    if ((r->efd = eventfd(0, EFD_CLOEXEC)) == -1)
+    {
+        perror("eventfd");
+        munmap(p, r->map_len);
+        free(r);
+        return NULL;
+    }
+
+    r->sh = (SRingShared_t *)p;
+    r->slots = (char *)p + sizeof(SRingShared_t);
+    r->sh->nslots = nslots;
+    r->sh->slot_size = slot_size;
+    r->sh->head = r->sh->tail = 0;
+    r->sh->sleeping = 0;
+    for (size_t i = 0; i < nslots; i++)
+        slotAt(r, i)->seq = i; // slot i libero per il ticket i
+
+    return r;
+}
+
+void deleteSRing(SRing_t *r)
+{
+    if (!r)
+    {
+        errno = EINVAL;
+        return;
+    }
+    munmap(r->sh, r->map_len);
+    close(r->efd);
+    free(r);
+}
+
+// 1 se il consumatore registrato e' terminato (senza raccoglierne lo stato: resta al processo padre)
+static int consumerDead(SRing_t *r)
+{
+    siginfo_t si;
+    si.si_pid = 0;
+    return r->consumer > 0 && waitid(P_PID, r->consumer, &si, WEXITED | WNOHANG | WNOWAIT) == 0 && si.si_pid == r->consumer;
+}
+
+void sringSetConsumer(SRing_t *r, pid_t pid)
+{
+    r->consumer = pid;
+}
+
+char *sringReserve(SRing_t *r, uint64_t *ticket)
+{
+    uint64_t t = __atomic_fetch_add(&r->sh->head, 1, __ATOMIC_RELAXED);
+    SRingSlot_t *s = slotAt(r, t);
+
+    // attendo che il consumatore liberi lo slot (ring pieno), controllando ogni tanto che sia ancora vivo
+    uint64_t spins = 0;
+    while (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != t){
+        if (spins++ < SRING_SPIN)
+            sched_yield();
+        else{
+            if ((spins - SRING_SPIN) % SRING_CHECK == 0 && consumerDead(r)){
+                errno = EPIPE;
+                return NULL;
+            }
+            struct timespec ts = {0, SRING_BACKOFF_NS};
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    *ticket = t;
+    return s->data;
+}
+
+void sringPublish(SRing_t *r, uint64_t ticket, size_t len)
+{
+    SRingSlot_t *s = slotAt(r, ticket);
+    s->len = len;
+    __atomic_store_n(&s->seq, ticket + 1, __ATOMIC_SEQ_CST);
+
+    // suono il doorbell solo se il consumatore sta dormendo
+    if (__atomic_load_n(&r->sh->sleeping, __ATOMIC_SEQ_CST)){
+        uint64_t one = 1;
+        while (write(r->efd, &one, sizeof(one)) == -1 && errno == EINTR);
+    }
+}
+
+char *sringPeek(SRing_t *r, size_t *len)
+{
+    uint64_t t = r->sh->tail; // unico consumatore: lettura non atomica
+    SRingSlot_t *s = slotAt(r, t);
+    if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != t + 1)
+        return NULL;
+    *len = s->len;
+    return s->data;
+}
+
+void sringRelease(SRing_t *r)
+{
+    uint64_t t = r->sh->tail;
+    SRingSlot_t *s = slotAt(r, t);
+    __atomic_store_n(&s->seq, t + r->sh->nslots, __ATOMIC_RELEASE); // libero per il giro successivo
+    __atomic_store_n(&r->sh->tail, t + 1, __ATOMIC_RELEASE);
+}
+
+int sringPrepareWait(SRing_t *r)
+{
+    __atomic_store_n(&r->sh->sleeping, 1, __ATOMIC_SEQ_CST);
+    SRingSlot_t *s = slotAt(r, r->sh->tail);
+    if (__atomic_load_n(&s->seq, __ATOMIC_SEQ_CST) == r->sh->tail + 1){
+        __atomic_store_n(&r->sh->sleeping, 0, __ATOMIC_SEQ_CST);
+        return 1;
+    }
+    return 0;
+}
+
+void sringWakeup(SRing_t *r)
+{
+    uint64_t v;
+    __atomic_store_n(&r->sh->sleeping, 0, __ATOMIC_SEQ_CST);
+    while (read(r->efd, &v, sizeof(v)) == -1 && errno == EINTR);
+}
@@ -0,0 +1,123 @@
+#if !defined(SHM_RING_H)
+#define SHM_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+//numero e dimensione (in byte) di default degli slot del ring
+#define SRING_DEFAULT_SLOTS 256
+#define SRING_DEFAULT_SLOT_SIZE 16384
+
+/** Slot del ring: seq indica lo stato (libero per il ticket t se seq == t, pubblicato se seq == t + 1)
+ *
+ */
+typedef struct sring_slot
+{
+    uint64_t seq;
+    uint64_t len;   // byte validi in data
+    char data[];
+} SRingSlot_t;
+
+/** Header del ring, in memoria condivisa (contatori su cache line separate)
+ *
+ */
+typedef struct sring_shared
+{
+    uint64_t nslots;
+    uint64_t slot_size;
+    char pad0[48];
+    uint64_t head;      // prossimo ticket dei producer
+    char pad1[56];
+    uint64_t tail;      // prossimo slot del consumatore
+    char pad2[56];
+    uint32_t sleeping;  // 1 se il consumatore attende sul doorbell
+    char pad3[60];
+} SRingShared_t;
+
+/** Ring multi-producer single-consumer in memoria condivisa tra processi (memfd + mmap), con un eventfd
+ *  come doorbell: i producer lo usano solo se il consumatore sta dormendo.
+ *  Va creato prima della fork; i Workers (producer) e il Collector (consumatore) vivono in processi diversi.
+ */
+typedef struct sring
+{
+    SRingShared_t *sh;  // header condiviso
+    char *slots;        // area degli slot condivisa
+    size_t map_len;
+    size_t stride;      // dimensione di uno slot (header incluso)
+    int efd;            // doorbell (eventfd)
+    pid_t consumer;     // processo consumatore, figlio dei producer (0 se non controllato)
+} SRing_t;
+
+/** Alloca il ring in memoria condivisa
+ *
+ *   \param nslots numero di slot
+ *   \param slot_size dimensione massima dei dati di uno slot
+ *
+ *   \retval NULL se memfd/mmap/eventfd non sono disponibili (errno settato)
+ *   \retval r puntatore al ring
+ */
+SRing_t *initSRing(size_t nslots, size_t slot_size);
+
+/** Rilascia il ring (nel processo chiamante)
+ *
+ *   \param r puntatore al ring
+ */
+void deleteSRing(SRing_t *r);
+
+/** Registra il consumatore, processo figlio dei producer (dopo la fork, nel processo dei producer):
+ *  sringReserve smette di attendere uno slot se il consumatore termina
+ *
+ *   \param r puntatore al ring
+ *   \param pid pid del consumatore
+ */
+void sringSetConsumer(SRing_t *r, pid_t pid);
+
+/** Riserva il prossimo slot (producer); attende se il ring e' pieno
+ *
+ *   \param r puntatore al ring
+ *   \param ticket ticket dello slot, da passare a sringPublish
+ *
+ *   \retval data puntatore all'area dati dello slot (lunga slot_size)
+ *   \retval NULL se il ring e' pieno e il consumatore registrato e' terminato (errno = EPIPE): il ring non e' piu' utilizzabile
+ */
+char *sringReserve(SRing_t *r, uint64_t *ticket);
+
+/** Pubblica uno slot riservato con sringReserve (producer) e, se serve, sveglia il consumatore
+ *
+ *   \param r puntatore al ring
+ *   \param ticket ticket dello slot
+ *   \param len byte validi scritti nello slot
+ */
+void sringPublish(SRing_t *r, uint64_t ticket, size_t len);
+
+/** Restituisce il prossimo slot pubblicato, senza attendere (consumatore)
+ *
+ *   \param r puntatore al ring
+ *   \param len byte validi nello slot
+ *
+ *   \retval data puntatore ai dati dello slot
+ *   \retval NULL se non ci sono slot pubblicati
+ */
+char *sringPeek(SRing_t *r, size_t *len);
+
+/** Libera lo slot restituito da sringPeek (consumatore)
+ *
+ *   \param r puntatore al ring
+ */
+void sringRelease(SRing_t *r);
+
+/** Prepara il consumatore all'attesa sul doorbell: dopo questa chiamata i producer suoneranno il doorbell.
+ *
+ *   \retval 1 se ci sono gia' slot pubblicati (non bisogna attendere)
+ *   \retval 0 se il consumatore puo' attendere su r->efd
+ */
+int sringPrepareWait(SRing_t *r);
+
+/** Chiamata dal consumatore dopo il risveglio (azzera il doorbell)
+ *
+ *   \param r puntatore al ring
+ */
+void sringWakeup(SRing_t *r);
+
+#endif /* SHM_RING_H */
@@ -1,14 +1,1375 @@
+#define _GNU_SOURCE
 #include <sor_list.h>
 
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 /**
  * @file sor_list.c
- * @brief File di implementazione dell'interfaccia per la lista ordinata
+ * @brief File di implementazione dell'interfaccia per la lista ordinata (B+-tree)
+ *
+ *        Formato di un record di una run su disco: index (long), status (uint8_t), seq (uint64_t), lunghezza della
+ *        stringa (uint32_t), stringa (senza terminatore). Le run sono file temporanei gia' rimossi dal filesystem,
+ *        letti solo da questo processo.
  */
 
+//ordine di inserimento dei risultati, comune a tutte le liste (i risultati passano da una lista all'altra con mergeSList)
+static uint64_t slist_seq = 0;
+
+/* ------------------- funzioni di utilita' -------------------- */
+
+/** Restituisce la prima posizione di a (lungo n) con valore >= index
+ *
+ */
+static inline int lowerBound(const long *a, int n, long index){
+    int lo = 0, hi = n;
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(a[mid] < index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** Numero di caratteri di index in base 10 (segno compreso)
+ *
+ */
+static inline size_t numLen(long index){
+    size_t n = (index < 0) ? 2 : 1;
+    unsigned long u = (index < 0) ? -(unsigned long)index : (unsigned long)index;
+    while(u >= 10){
+        u /= 10;
+        n++;
+    }
+    return n;
+}
+
+/** Byte della riga "'index' 'stringa'\n" di un elemento
+ *
+ */
+static inline size_t lineLen(long index, size_t len){
+    return numLen(index) + len + 2;
+}
+
+/* ------------------- string arena e directory -------------------- */
+
+/** Copia len byte di s (aggiungendo il terminatore) nella string arena di l
+ *
+ */
+static char *arenaCopy(SList *l, const char *s, size_t len){
+    SChunk *c = l->arena;
+    if(!c || c->used + len + 1 > c->cap){
+        size_t cap = c ? 2 * c->cap : SLIST_CHUNK_MIN_LEN;
+        if(cap > SLIST_CHUNK_LEN)
+            cap = SLIST_CHUNK_LEN;
+        if(cap < len + 1)
+            cap = len + 1;
+        if(!(c = malloc(sizeof(SChunk) + cap))){
+            perror("malloc");
+            return NULL;
+        }
+        c->used = 0;
+        c->cap = cap;
+        c->refs = 1;
+        c->next = l->arena; //il riferimento della lista al blocco precedente passa al nuovo blocco
+        l->arena = c;
+        l->mem += sizeof(SChunk) + cap;
+    }
+    char *p = c->data + c->used;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    c->used += len + 1;
+    return p;
+}
+
+static inline uint32_t hashBytes(uint32_t h, const char *s, size_t len){
+    for(size_t i = 0; i < len; i++){
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline uint32_t hashDir(const char *s, size_t len){
+    return hashBytes(2166136261u, s, len); //FNV-1a
+}
+
+//hash del path completo (directory seguita dal nome del file) per l'indice dei path
+static inline uint32_t hashPath(const char *dir, size_t dir_len, const char *base, size_t base_len){
+    return hashBytes(hashDir(dir, dir_len), base, base_len);
+}
+
+/** Raddoppia la tabella hash delle directory
+ *
+ */
+static int growDirHash(SList *l){
+    uint32_t cap = l->hash_cap ? 2 * l->hash_cap : 64;
+    uint32_t *h = calloc(cap, sizeof(uint32_t));
+    if(!h){
+        perror("calloc");
+        return -1;
+    }
+    for(uint32_t id = 0; id < l->ndirs; id++){
+        uint32_t j = hashDir(l->dirs[id], l->dir_len[id]) & (cap - 1);
+        while(h[j] != 0)
+            j = (j + 1) & (cap - 1);
+        h[j] = id + 1;
+    }
+    free(l->dir_hash);
+    l->mem += (cap - l->hash_cap) * sizeof(uint32_t);
+    l->dir_hash = h;
+    l->hash_cap = cap;
+    return 0;
+}
+
+/** Restituisce l'indice della directory dir (lunga len), -1 se non presente
+ *
+ */
+static long findDir(const SList *l, const char *dir, size_t len){
+    if(l->hash_cap == 0)
+        return -1;
+    for(uint32_t j = hashDir(dir, len) & (l->hash_cap - 1); l->dir_hash[j] != 0; j = (j + 1) & (l->hash_cap - 1)){
+        uint32_t id = l->dir_hash[j] - 1;
+        if(l->dir_len[id] == len && memcmp(l->dirs[id], dir, len) == 0)
+            return id;
+    }
+    return -1;
+}
+
+/** Restituisce l'indice della directory dir (lunga len), aggiungendola se non presente; -1 se errore
+ *
+ */
+static long internDir(SList *l, const char *dir, size_t len){
+    if(2 * (l->ndirs + 1) > l->hash_cap && growDirHash(l) != 0)
+        return -1;
+
+    uint32_t j = hashDir(dir, len) & (l->hash_cap - 1);
+    for(; l->dir_hash[j] != 0; j = (j + 1) & (l->hash_cap - 1)){
+        uint32_t id = l->dir_hash[j] - 1;
+        if(l->dir_len[id] == len && memcmp(l->dirs[id], dir, len) == 0)
+            return id;
+    }
+
+    if(l->ndirs == l->dirs_cap){
+        uint32_t cap = l->dirs_cap ? 2 * l->dirs_cap : 32;
+        char **dirs = realloc(l->dirs, cap * sizeof(char *));
+        if(!dirs)
+            return -1;
+        l->dirs = dirs;
+        uint32_t *dir_len = realloc(l->dir_len, cap * sizeof(uint32_t));
+        if(!dir_len)
+            return -1;
+        l->dir_len = dir_len;
+        l->mem += (cap - l->dirs_cap) * (sizeof(char *) + sizeof(uint32_t));
+        l->dirs_cap = cap;
+    }
+    char *copy = arenaCopy(l, dir, len);
+    if(!copy)
+        return -1;
+    l->dirs[l->ndirs] = copy;
+    l->dir_len[l->ndirs] = len;
+    l->dir_hash[j] = l->ndirs + 1;
+    return l->ndirs++;
+}
+
+/** Rilascia un riferimento al blocco c, liberando i blocchi non piu' riferiti
+ *
+ */
+static void releaseChunks(SChunk *c){
+    while(c && __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) == 0){
+        SChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+/** Libera la string arena (se non condivisa con snapshot) e la tabella delle directory
+ *
+ */
+static void freeStore(SList *l){
+    releaseChunks(l->arena);
+    l->arena = NULL;
+    free(l->dirs);
+    free(l->dir_len);
+    free(l->dir_hash);
+    l->dirs = NULL;
+    l->dir_len = l->dir_hash = NULL;
+    l->ndirs = l->dirs_cap = l->hash_cap = 0;
+}
+
+/* ------------------- indice dei path -------------------- */
+
+/** Slot dell'indice per il path dirs[dir] + base: lo slot che lo contiene o il primo slot vuoto
+ *
+ */
+static SSlot *indexSlot(const SList *l, uint32_t dir, const char *base, size_t base_len){
+    size_t mask = l->idx_cap - 1;
+    size_t j = hashPath(l->dirs[dir], l->dir_len[dir], base, base_len) & mask;
+    while(l->path_idx[j].base && (l->path_idx[j].dir != dir || strncmp(l->path_idx[j].base, base, base_len) != 0 || l->path_idx[j].base[base_len] != '\0'))
+        j = (j + 1) & mask;
+    return &l->path_idx[j];
+}
+
+/** Raddoppia l'indice dei path (almeno a cap slot)
+ *
+ */
+static int growIndex(SList *l, size_t cap){
+    size_t want = cap;
+    cap = 64;
+    while(cap < want || cap < 2 * l->idx_cap) //potenza di 2 (maschera di indexSlot)
+        cap *= 2;
+    SSlot *old = l->path_idx;
+    size_t old_cap = l->idx_cap;
+    if(!(l->path_idx = calloc(cap, sizeof(SSlot)))){
+        perror("calloc");
+        l->path_idx = old;
+        return -1;
+    }
+    l->idx_cap = cap;
+    for(size_t i = 0; i < old_cap; i++)
+        if(old[i].base)
+            *indexSlot(l, old[i].dir, old[i].base, strlen(old[i].base)) = old[i];
+    free(old);
+    return 0;
+}
+
+/** Registra nell'indice (gia' dimensionato) l'ultimo risultato del path dirs[dir] + base
+ *
+ */
+static void indexEntry(SList *l, long index, uint8_t status, uint64_t seq, uint32_t dir, const char *base, size_t base_len){
+    SSlot *s = indexSlot(l, dir, base, base_len);
+    if(!s->base)
+        l->idx_used++;
+    else if(s->seq > seq) //gli elementi fusi da un'altra lista non arrivano in ordine di inserimento
+        return;
+    s->base = base;
+    s->seq = seq;
+    s->index = index;
+    s->dir = dir;
+    s->status = status;
+}
+
+/* ------------------- B+-tree -------------------- */
+
+/** Alloca un nodo vuoto (foglia se leaf == 1)
+ *
+ */
+static void *allocNode(int leaf){
+    void *n = calloc(1, leaf ? sizeof(SLeaf) : sizeof(SInner));
+    if (!n)
+        perror("calloc");
+    else if(leaf)
+        ((SLeaf *)n)->refs = 1;
+    return n;
+}
+
+/** Rilascia un riferimento alla foglia, liberandola se non e' piu' contenuta in una lista o in uno snapshot
+ *
+ */
+static void releaseLeaf(SLeaf *leaf){
+    if(__atomic_sub_fetch(&leaf->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(leaf);
+}
+
+/** Prima della modifica della foglia *slot di l (figlio di un nodo interno o radice), la sostituisce con una copia
+ *  se e' condivisa con uno snapshot, aggiornando i collegamenti delle foglie vicine (che appartengono a l)
+ */
+static int ownLeaf(SList *l, void **slot){
+    SLeaf *leaf = *slot;
+    if(__atomic_load_n(&leaf->refs, __ATOMIC_ACQUIRE) == 1)
+        return 0;
+    SLeaf *copy = malloc(sizeof(SLeaf));
+    if(!copy){
+        perror("malloc");
+        return -1;
+    }
+    memcpy(copy, leaf, sizeof(SLeaf));
+    copy->refs = 1;
+    if(copy->prev)
+        copy->prev->next = copy;
+    else
+        l->first = copy;
+    if(copy->next)
+        copy->next->prev = copy;
+    else
+        l->last = copy;
+    *slot = copy;
+    releaseLeaf(leaf);
+    return 0;
+}
+
+/** Copia tutte le foglie condivise del sottoalbero *slot (di livello level); un errore lascia le foglie gia' copiate
+ *
+ */
+static int ownLeaves(SList *l, void **slot, int level){
+    if(level == 0)
+        return ownLeaf(l, slot);
+    SInner *in = *slot;
+    for(int i = 0; i <= in->n; i++)
+        if(ownLeaves(l, &in->child[i], level - 1) != 0)
+            return -1;
+    return 0;
+}
+
+//prima foglia di l: uno snapshot visita le foglie (condivise) con il proprio vettore, le altre liste con i collegamenti
+static inline SLeaf *firstLeaf(const SList *l){
+    return l->leaves ? l->leaves[0] : l->first;
+}
+
+//foglia successiva a leaf, che in uno snapshot e' in posizione *pos (aggiornata)
+static inline SLeaf *nextLeaf(const SList *l, const SLeaf *leaf, size_t *pos){
+    if(!l->leaves)
+        return leaf->next;
+    return (++*pos < l->nleaves) ? l->leaves[*pos] : NULL;
+}
+
+static inline int isFull(void *node, int level){
+    return ((level == 0) ? ((SLeaf *)node)->n : ((SInner *)node)->n) == SLIST_ORDER;
+}
+
+/** Numero di elementi validi del sottoalbero node (di livello level)
+ *
+ */
+static size_t subtreeCount(const void *node, int level){
+    size_t c = 0;
+    if(level == 0){
+        const SLeaf *leaf = node;
+        for(int i = 0; i < leaf->n; i++)
+            c += (leaf->status[i] == 0);
+    }
+    else{
+        const SInner *in = node;
+        for(int i = 0; i <= in->n; i++)
+            c += in->cnt[i];
+    }
+    return c;
+}
+
+//memoria dei nodi del sottoalbero node (di livello level)
+static size_t nodesMem(void *node, int level){
+    if(level == 0)
+        return sizeof(SLeaf);
+    SInner *in = node;
+    size_t m = sizeof(SInner);
+    for(int i = 0; i <= in->n; i++)
+        m += nodesMem(in->child[i], level - 1);
+    return m;
+}
+
+/** Libera ricorsivamente i nodi (le foglie condivise con uno snapshot restano a lui)
+ *
+ */
+static void freeNodes(void *node, int level){
+    if(level == 0){
+        releaseLeaf(node);
+        return;
+    }
+    SInner *in = node;
+    for(int i = 0; i <= in->n; i++)
+        freeNodes(in->child[i], level - 1);
+    free(node);
+}
+
+/** Divide il figlio pieno parent->child[i] (di livello level, foglia non condivisa) spostando la meta' superiore in sib
+ *
+ */
+static void splitChild(SList *l, SInner *parent, int i, void *sib, int level){
+    long sep;
+    if(level == 0){
+        SLeaf *left = parent->child[i], *right = sib;
+        int half = SLIST_ORDER / 2;
+        right->n = SLIST_ORDER - half;
+        memcpy(right->index, left->index + half, right->n * sizeof(long));
+        memcpy(right->dir, left->dir + half, right->n * sizeof(uint32_t));
+        memcpy(right->status, left->status + half, right->n * sizeof(uint8_t));
+        memcpy(right->base, left->base + half, right->n * sizeof(char *));
+        memcpy(right->seq, left->seq + half, right->n * sizeof(uint64_t));
+        left->n = half;
+        sep = right->index[0];
+
+        right->next = left->next;
+        right->prev = left;
+        if(left->next)
+            left->next->prev = right;
+        else
+            l->last = right;
+        left->next = right;
+    }
+    else{ //la chiave centrale sale nel padre
+        SInner *left = parent->child[i], *right = sib;
+        int mid = SLIST_ORDER / 2;
+        sep = left->key[mid];
+        right->n = SLIST_ORDER - mid - 1;
+        memcpy(right->key, left->key + mid + 1, right->n * sizeof(long));
+        memcpy(right->child, left->child + mid + 1, (right->n + 1) * sizeof(void *));
+        memcpy(right->cnt, left->cnt + mid + 1, (right->n + 1) * sizeof(size_t));
+        left->n = mid;
+    }
+
+    memmove(parent->key + i + 1, parent->key + i, (parent->n - i) * sizeof(long));
+    memmove(parent->child + i + 2, parent->child + i + 1, (parent->n - i) * sizeof(void *));
+    memmove(parent->cnt + i + 2, parent->cnt + i + 1, (parent->n - i) * sizeof(size_t));
+    parent->key[i] = sep;
+    parent->child[i + 1] = sib;
+    parent->cnt[i] = subtreeCount(parent->child[i], level);
+    parent->cnt[i + 1] = subtreeCount(sib, level);
+    parent->n++;
+}
+
+/** Aggiorna i contatori di l per un elemento (path lungo len) aggiunto (sign = 1) o tolto (sign = -1)
+ *
+ */
+static void accountEntry(SList *l, long index, uint8_t status, size_t len, int sign){
+    l->lsize += sign;
+    l->path_bytes += sign * (long)len;
+    if(status == 0){
+        l->nvalid += sign;
+        l->text_len += sign * (long)lineLen(index, len);
+    }
+}
+
+/** Inserisce (index, dirs[dir] + base) prima di tutti gli elementi con lo stesso index (base e' nella string arena).
+ *  I nodi pieni vengono divisi durante la discesa, quindi un errore di allocazione lascia la lista invariata.
+ *
+ */
+static int insertEntry(SList *l, long index, uint8_t status, uint64_t seq, uint32_t dir, const char *base, size_t base_len){
+    if(l->height == 0 && ownLeaf(l, &l->root) != 0)
+        return -1;
+    if(isFull(l->root, l->height)){ //la radice piena viene divisa sotto una nuova radice
+        SInner *root = allocNode(0);
+        void *sib = allocNode(l->height == 0);
+        if(!root || !sib){
+            free(root);
+            free(sib);
+            return -1;
+        }
+        l->mem += sizeof(SInner) + ((l->height == 0) ? sizeof(SLeaf) : sizeof(SInner));
+        root->child[0] = l->root;
+        splitChild(l, root, 0, sib, l->height);
+        l->root = root;
+        l->height++;
+    }
+
+    void *node = l->root;
+    for(int level = l->height; level > 0; level--){
+        SInner *in = node;
+        int i = lowerBound(in->key, in->n, index); //numero di chiavi < index
+        if(level == 1 && ownLeaf(l, &in->child[i]) != 0)
+            return -1;
+        if(isFull(in->child[i], level - 1)){
+            void *sib = allocNode(level - 1 == 0);
+            if(!sib)
+                return -1;
+            l->mem += (level - 1 == 0) ? sizeof(SLeaf) : sizeof(SInner);
+            splitChild(l, in, i, sib, level - 1);
+            if(in->key[i] < index)
+                i++;
+        }
+        if(status == 0) //da qui l'inserimento non puo' fallire
+            in->cnt[i]++;
+        node = in->child[i];
+    }
+
+    SLeaf *leaf = node;
+    int pos = lowerBound(leaf->index, leaf->n, index);
+    memmove(leaf->index + pos + 1, leaf->index + pos, (leaf->n - pos) * sizeof(long));
+    memmove(leaf->dir + pos + 1, leaf->dir + pos, (leaf->n - pos) * sizeof(uint32_t));
+    memmove(leaf->status + pos + 1, leaf->status + pos, (leaf->n - pos) * sizeof(uint8_t));
+    memmove(leaf->base + pos + 1, leaf->base + pos, (leaf->n - pos) * sizeof(char *));
+    memmove(leaf->seq + pos + 1, leaf->seq + pos, (leaf->n - pos) * sizeof(uint64_t));
+    leaf->index[pos] = index;
+    leaf->dir[pos] = dir;
+    leaf->status[pos] = status;
+    leaf->base[pos] = base;
+    leaf->seq[pos] = seq;
+    leaf->n++;
+    accountEntry(l, index, status, l->dir_len[dir] + base_len, 1);
+    return 0;
+}
+
+/** Stacca dalla catena delle foglie e libera il sottoalbero node (di livello level), che contiene una sola foglia vuota
+ *
+ */
+static void detachNode(SList *l, void *node, int level){
+    SLeaf *leaf = node;
+    for(int k = level; k > 0; k--)
+        leaf = ((SInner *)leaf)->child[0];
+    if(leaf->prev)
+        leaf->prev->next = leaf->next;
+    else
+        l->first = leaf->next;
+    if(leaf->next)
+        leaf->next->prev = leaf->prev;
+    else
+        l->last = leaf->prev;
+    l->mem -= nodesMem(node, level);
+    freeNodes(node, level);
+}
+
+/** Toglie dal sottoalbero *slot (di livello level) l'elemento (index, seq), con esito status. I figli rimasti vuoti
+ *  vengono staccati dal padre (se ha altri figli), senza ribilanciare: le chiavi dei nodi interni restano limiti validi.
+ *  \retval 1 elemento tolto, 2 elemento tolto e sottoalbero vuoto, 0 elemento non presente, -1 errore
+ */
+static int removeNode(SList *l, void **slot, int level, long index, uint64_t seq, uint8_t status){
+    if(level == 0){
+        SLeaf *leaf = *slot;
+        int pos = lowerBound(leaf->index, leaf->n, index);
+        while(pos < leaf->n && leaf->index[pos] == index && leaf->seq[pos] != seq)
+            pos++;
+        if(pos == leaf->n || leaf->index[pos] != index)
+            return 0;
+        if(ownLeaf(l, slot) != 0)
+            return -1;
+        leaf = *slot;
+        int k = leaf->n - pos - 1;
+        memmove(leaf->index + pos, leaf->index + pos + 1, k * sizeof(long));
+        memmove(leaf->dir + pos, leaf->dir + pos + 1, k * sizeof(uint32_t));
+        memmove(leaf->status + pos, leaf->status + pos + 1, k * sizeof(uint8_t));
+        memmove(leaf->base + pos, leaf->base + pos + 1, k * sizeof(char *));
+        memmove(leaf->seq + pos, leaf->seq + pos + 1, k * sizeof(uint64_t));
+        leaf->n--;
+        return (leaf->n == 0) ? 2 : 1;
+    }
+
+    //a parita' di index gli elementi possono essere in piu' figli consecutivi
+    SInner *in = *slot;
+    for(int i = lowerBound(in->key, in->n, index); i <= in->n; i++){
+        int r = removeNode(l, &in->child[i], level - 1, index, seq, status);
+        if(r == 0){
+            if(i < in->n && in->key[i] > index)
+                break;
+            continue;
+        }
+        if(r < 0)
+            return -1;
+        if(status == 0)
+            in->cnt[i]--;
+        if(r == 2 && in->n > 0){
+            detachNode(l, in->child[i], level - 1);
+            int j = (i > 0) ? i - 1 : 0; //chiave che separava il figlio tolto
+            memmove(in->key + j, in->key + j + 1, (in->n - j - 1) * sizeof(long));
+            memmove(in->child + i, in->child + i + 1, (in->n - i) * sizeof(void *));
+            memmove(in->cnt + i, in->cnt + i + 1, (in->n - i) * sizeof(size_t));
+            in->n--;
+            r = 1;
+        }
+        return r;
+    }
+    return 0;
+}
+
+/** Toglie da l il risultato old (sostituito da uno piu' recente): dal B+-tree se presente, altrimenti e' in una run
+ *  e viene saltato in lettura. La radice con un solo figlio viene tolta
+ */
+static int dropEntry(SList *l, const SSlot *old){
+    if(removeNode(l, &l->root, l->height, old->index, old->seq, old->status) < 0)
+        return -1;
+    accountEntry(l, old->index, old->status, l->dir_len[old->dir] + strlen(old->base), -1);
+    while(l->height > 0 && ((SInner *)l->root)->n == 0){
+        SInner *root = l->root;
+        l->root = root->child[0];
+        l->height--;
+        l->mem -= sizeof(SInner);
+        free(root);
+    }
+    return 0;
+}
+
+/** Copia directory e nome del file nella string arena di l e inserisce l'elemento
+ *
+ */
+static int storeEntry(SList *l, long index, uint8_t status, uint64_t seq, const char *dir, size_t dir_len, const char *base, size_t base_len){
+    if(l->path_idx && 2 * (l->idx_used + 1) > l->idx_cap && growIndex(l, 0) != 0)
+        return -1;
+    long id = internDir(l, dir, dir_len);
+    if(id < 0)
+        return -1;
+    SSlot old = {0};
+    if(l->replace){ //un solo risultato per path: il nome e' gia' nella string arena se il path e' noto
+        old = *indexSlot(l, id, base, base_len);
+        if(old.base && old.seq >= seq) //sostituito da un risultato piu' recente
+            return 0;
+    }
+    const char *copy = old.base ? old.base : arenaCopy(l, base, base_len);
+    if(!copy || insertEntry(l, index, status, seq, id, copy, base_len) != 0)
+        return -1;
+    if(l->path_idx)
+        indexEntry(l, index, status, seq, id, copy, base_len);
+    //tolto dopo l'inserimento: un errore lascia anche il risultato precedente, non nessuno dei due
+    if(old.base && dropEntry(l, &old) != 0)
+        perror("removal of the replaced result");
+    return 0;
+}
+
+/** Con la sostituzione attiva registra in l il record (di una run passata a l da mergeSList) con path completo path:
+ *  il risultato precedente del path viene tolto, il record viene saltato in lettura se non e' il piu' recente
+ */
+static void indexRun(SList *l, long index, uint8_t status, uint64_t seq, const char *path){
+    size_t len = strlen(path), dir_len = len;
+    while(dir_len > 0 && path[dir_len - 1] != '/')
+        dir_len--;
+    long id;
+    if((2 * (l->idx_used + 1) > l->idx_cap && growIndex(l, 0) != 0) || (id = internDir(l, path, dir_len)) < 0){
+        perror("index of the merged runs");
+        return;
+    }
+    SSlot old = *indexSlot(l, id, path + dir_len, len - dir_len);
+    if(old.base && old.seq >= seq)
+        return;
+    const char *copy = old.base ? old.base : arenaCopy(l, path + dir_len, len - dir_len);
+    if(!copy){
+        perror("index of the merged runs");
+        return;
+    }
+    indexEntry(l, index, status, seq, id, copy, len - dir_len);
+    accountEntry(l, index, status, len, 1);
+    if(old.base && dropEntry(l, &old) != 0)
+        perror("removal of the replaced result");
+}
+
+//record sostituito da un risultato piu' recente (solo con la sostituzione attiva): non viene letto dalle run
+static int deadRecord(const SList *l, const char *path, uint64_t seq){
+    if(!l->replace)
+        return 0;
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) + 1 : 0;
+    long dir = findDir(l, path, dir_len);
+    if(dir < 0)
+        return 0;
+    SSlot *s = indexSlot(l, dir, path + dir_len, strlen(path + dir_len));
+    return s->base && s->seq != seq;
+}
+
+/** Svuota il B+-tree sostituendolo con la foglia vuota empty
+ *
+ */
+static void resetNodes(SList *l, SLeaf *empty){
+    freeNodes(l->root, l->height);
+    free(l->leaves);
+    l->leaves = NULL;
+    l->nleaves = 0;
+    l->root = l->first = l->last = empty;
+    l->height = 0;
+    l->mem = sizeof(SLeaf);
+}
+
+/** Svuota il B+-tree e la string arena sostituendoli con la foglia vuota empty
+ *
+ */
+static void resetTree(SList *l, SLeaf *empty){
+    resetNodes(l, empty);
+    freeStore(l);
+    if(l->path_idx){ //i nomi indicizzati erano nella string arena
+        memset(l->path_idx, 0, l->idx_cap * sizeof(SSlot));
+        l->idx_used = 0;
+    }
+}
+
+/** Crea un file temporaneo anonimo (rimosso subito dal filesystem) in $TMPDIR o /tmp
+ *
+ */
+static FILE *tmpRun(){
+    const char *dir = getenv("TMPDIR");
+    if(!dir || dir[0] == '\0')
+        dir = "/tmp";
+    char name[4096];
+    if(snprintf(name, sizeof(name), "%s/farm_slist_XXXXXX", dir) >= (int)sizeof(name)){
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    int fd = mkstemp(name);
+    if(fd == -1)
+        return NULL;
+    unlink(name);
+    FILE *f = fdopen(fd, "w+");
+    if(!f)
+        close(fd);
+    return f;
+}
+
+static int writeRecord(FILE *f, long index, uint8_t status, uint64_t seq, const char *dir, size_t dir_len, const char *base){
+    size_t base_len = strlen(base);
+    uint32_t len = dir_len + base_len;
+    if(fwrite(&index, sizeof(long), 1, f) != 1 || fwrite(&status, 1, 1, f) != 1 || fwrite(&seq, sizeof(uint64_t), 1, f) != 1
+        || fwrite(&len, sizeof(uint32_t), 1, f) != 1)
+        return -1;
+    if((dir_len > 0 && fwrite(dir, 1, dir_len, f) != dir_len) || (base_len > 0 && fwrite(base, 1, base_len, f) != base_len))
+        return -1;
+    return 0;
+}
+
+/** Legge il prossimo record di f in buf (lungo almeno str_len)
+ *  \retval 1 record letto, 0 fine della run, -1 errore
+ */
+static int readRecord(FILE *f, long *index, uint8_t *status, uint64_t *seq, char *buf, size_t str_len){
+    uint32_t len;
+    if(fread(index, sizeof(long), 1, f) != 1)
+        return ferror(f) ? -1 : 0;
+    if(fread(status, 1, 1, f) != 1 || fread(seq, sizeof(uint64_t), 1, f) != 1 || fread(&len, sizeof(uint32_t), 1, f) != 1 || len >= str_len || (len > 0 && fread(buf, 1, len, f) != len)){
+        errno = EIO;
+        return -1;
+    }
+    buf[len] = '\0';
+    return 1;
+}
+
+/** Aggiunge f alle run di l (come run piu' recente)
+ *
+ */
+static int pushRun(SList *l, FILE *f){
+    if(l->nruns == l->runs_cap){
+        int cap = l->runs_cap ? 2 * l->runs_cap : 4;
+        FILE **runs = realloc(l->runs, cap * sizeof(FILE *));
+        if(!runs)
+            return -1;
+        l->runs = runs;
+        l->runs_cap = cap;
+    }
+    l->runs[l->nruns++] = f;
+    return 0;
+}
+
+//sorgente della fusione a k vie: il B+-tree (leaf != NULL) oppure una run su disco
+typedef struct merge_src
+{
+    SLeaf *leaf;
+    int i;
+    size_t pos;         // posizione di leaf (per gli snapshot)
+    FILE *f;
+    long index;         // index dell'elemento corrente
+    uint8_t status;
+    uint64_t seq;
+    const char *dir;    // directory dell'elemento corrente ("" per le run, che contengono il path completo)
+    size_t dir_len;
+    const char *string; // nome del file (o path completo) dell'elemento corrente
+    char *buf;          // buffer di lettura della run
+} MergeSrc;
+
+//funzione chiamata dalla fusione per ogni elemento (la sorgente s e' posizionata sull'elemento)
+typedef int (*MergeEmit)(void *arg, const MergeSrc *s);
+
+//visita pubblica (SListVisit) durante la fusione
+typedef struct visit_arg
+{
+    SListVisit visit;
+    void *arg;
+} VisitArg;
+
+static int emitVisit(void *arg, const MergeSrc *s){
+    VisitArg *v = arg;
+    return v->visit(v->arg, s->index, s->status, s->dir, s->dir_len, s->string);
+}
+
+
+/** Porta la sorgente s (di l) all'elemento successivo: 1 se presente, 0 se esaurita, -1 se errore
+ *
+ */
+static int advance(const SList *l, MergeSrc *s){
+    if(s->f){
+        s->dir = "";
+        s->dir_len = 0;
+        s->string = s->buf;
+        int r;
+        while((r = readRecord(s->f, &s->index, &s->status, &s->seq, s->buf, l->str_len)) > 0 && deadRecord(l, s->buf, s->seq))
+            ;
+        return r;
+    }
+    while(s->leaf && s->i >= s->leaf->n){
+        s->leaf = nextLeaf(l, s->leaf, &s->pos);
+        s->i = 0;
+    }
+    if(!s->leaf)
+        return 0;
+    s->index = s->leaf->index[s->i];
+    s->status = s->leaf->status[s->i];
+    s->seq = s->leaf->seq[s->i];
+    s->dir = l->dirs[s->leaf->dir[s->i]];
+    s->dir_len = l->dir_len[s->leaf->dir[s->i]];
+    s->string = s->leaf->base[s->i];
+    s->i++;
+    return 1;
+}
+
+//il min-heap e' ordinato per (index, posizione della sorgente): a parita' di index vince la sorgente piu' recente
+static inline int srcLess(const MergeSrc *src, int a, int b){
+    return src[a].index < src[b].index || (src[a].index == src[b].index && a < b);
+}
+
+static void siftDown(const MergeSrc *src, int *heap, int n, int i){
+    for(;;){
+        int m = i, c = 2 * i + 1;
+        if(c < n && srcLess(src, heap[c], heap[m]))
+            m = c;
+        if(c + 1 < n && srcLess(src, heap[c + 1], heap[m]))
+            m = c + 1;
+        if(m == i)
+            return;
+        int t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+/** Fusione a k vie ordinata del B+-tree (se with_tree == 1) e delle run di l a partire dalla run first,
+ *  passando ogni elemento a emit. Le sorgenti sono ordinate dalla piu' recente (il B+-tree) alla piu' vecchia,
+ *  cosi' a parita' di index l'ordine e' lo stesso che si avrebbe senza run su disco.
+ */
+static int mergeRuns(SList *l, int with_tree, int first, MergeEmit emit, void *arg){
+    int k = l->nruns - first + 1, err = 0;
+    MergeSrc *src = calloc(k, sizeof(MergeSrc));
+    int *heap = malloc(k * sizeof(int));
+    char *bufs = malloc((k - 1) * l->str_len + 1);
+    if(!src || !heap || !bufs){
+        free(src); free(heap); free(bufs);
+        return -1;
+    }
+
+    int n = 0;
+    src[0].leaf = with_tree ? firstLeaf(l) : NULL;
+    for(int s = 1; s < k; s++){
+        src[s].f = l->runs[l->nruns - s];
+        src[s].buf = bufs + (s - 1) * l->str_len;
+        rewind(src[s].f);
+    }
+    for(int s = 0; s < k && !err; s++){
+        int r = advance(l, &src[s]);
+        if(r < 0)
+            err = 1;
+        else if(r > 0)
+            heap[n++] = s;
+    }
+    for(int i = n / 2 - 1; i >= 0; i--)
+        siftDown(src, heap, n, i);
+
+    while(n > 0 && !err){
+        MergeSrc *s = &src[heap[0]];
+        if(emit(arg, s) != 0){
+            err = 1;
+            break;
+        }
+        int r = advance(l, s);
+        if(r < 0)
+            err = 1;
+        else if(r == 0)
+            heap[0] = heap[--n];
+        siftDown(src, heap, n, 0);
+    }
+
+    free(src); free(heap); free(bufs);
+    return err ? -1 : 0;
+}
+
+//fusione del B+-tree (se with_tree == 1) e di tutte le run
+static int mergeSources(SList *l, int with_tree, MergeEmit emit, void *arg){
+    return mergeRuns(l, with_tree, 0, emit, arg);
+}
+
+/** Buffer di uscita di printSList
+ *
+ */
+typedef struct out_buf
+{
+    int fd;
+    char *buf;
+    size_t len;
+} OutBuf;
+
+static int outFlush(OutBuf *o){
+    size_t off = 0;
+    while(off < o->len){
+        ssize_t w = write(o->fd, o->buf + off, o->len - off);
+        if(w == -1){
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        off += w;
+    }
+    o->len = 0;
+    return 0;
+}
+
+//aggiunge la riga "'index' 'stringa'\n" al buffer (formattazione dell'intero senza printf)
+static int emitPrint(void *arg, long index, uint8_t status, const char *dir, size_t dir_len, const char *string){
+    OutBuf *o = arg;
+    if(status != 0) //risultato non valido: non viene stampato
+        return 0;
+    size_t slen = strlen(string);
+    if(o->len + dir_len + slen + 24 > SLIST_OUT_BUF_LEN && outFlush(o) != 0)
+        return -1;
+
+    char digits[24];
+    int nd = 0;
+    unsigned long u = (index < 0) ? -(unsigned long)index : (unsigned long)index;
+    do{
+        digits[nd++] = '0' + u % 10;
+        u /= 10;
+    } while(u > 0);
+    char *p = o->buf + o->len;
+    if(index < 0)
+        *p++ = '-';
+    while(nd > 0)
+        *p++ = digits[--nd];
+    *p++ = ' ';
+    memcpy(p, dir, dir_len);
+    p += dir_len;
+    memcpy(p, string, slen);
+    p += slen;
+    *p++ = '\n';
+    o->len = p - o->buf;
+    return 0;
+}
+
+static int emitPrintSrc(void *arg, const MergeSrc *s){
+    return emitPrint(arg, s->index, s->status, s->dir, s->dir_len, s->string);
+}
+
+static int emitRecord(void *arg, const MergeSrc *s){
+    return writeRecord(arg, s->index, s->status, s->seq, s->dir, s->dir_len, s->string);
+}
+
+//dimensione in byte di una run
+static off_t runSize(FILE *f){
+    struct stat st;
+    return (fstat(fileno(f), &st) == 0) ? st.st_size : 0;
+}
+
+/** Fonde le SLIST_RUN_FANIN run piu' recenti di l quando hanno dimensioni simili (entro un fattore SLIST_RUN_RATIO):
+ *  la run fusa e' almeno SLIST_RUN_FANIN / SLIST_RUN_RATIO volte piu' grande di ognuna delle run fuse, quindi ogni
+ *  elemento viene riscritto O(log n) volte in tutto, invece di una volta per ogni fusione. La run fusa puo' a sua volta
+ *  completare un gruppo di run simili. Oltre SLIST_MAX_RUNS run le piu' recenti vengono fuse comunque, cosi' la stampa
+ *  fonde al piu' SLIST_MAX_RUNS run. Le run fuse sono consecutive: l'ordine tra run (a parita' di index) non cambia.
+ */
+static int compactRuns(SList *l){
+    while(l->nruns >= SLIST_RUN_FANIN){
+        int first = l->nruns - SLIST_RUN_FANIN;
+        off_t min = runSize(l->runs[first]), max = min;
+        for(int i = first + 1; i < l->nruns; i++){
+            off_t len = runSize(l->runs[i]);
+            min = (len < min) ? len : min;
+            max = (len > max) ? len : max;
+        }
+        if(max > SLIST_RUN_RATIO * min && l->nruns < SLIST_MAX_RUNS)
+            return 0;
+
+        FILE *f = tmpRun();
+        if(!f)
+            return -1;
+        if(mergeRuns(l, 0, first, emitRecord, f) != 0 || fflush(f) != 0){
+            fclose(f);
+            return -1;
+        }
+        for(int i = first; i < l->nruns; i++)
+            fclose(l->runs[i]);
+        l->runs[first] = f;
+        l->nruns = first + 1;
+    }
+    return 0;
+}
+
+/** Scrive il contenuto del B+-tree in una nuova run e libera la memoria
+ *
+ */
+static int spill(SList *l){
+    SLeaf *empty = allocNode(1);
+    FILE *f = tmpRun();
+    if(!empty || !f){
+        free(empty);
+        if(f)
+            fclose(f);
+        return -1;
+    }
+
+    size_t pos = 0;
+    for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos))
+        for(int i = 0; i < leaf->n; i++)
+            if(writeRecord(f, leaf->index[i], leaf->status[i], leaf->seq[i], l->dirs[leaf->dir[i]], l->dir_len[leaf->dir[i]], leaf->base[i]) != 0){
+                fclose(f);
+                free(empty);
+                return -1;
+            }
+    if(fflush(f) != 0 || pushRun(l, f) != 0){
+        fclose(f);
+        free(empty);
+        return -1;
+    }
+    //con la sostituzione attiva nomi e indice dei path restano (non piu' addebitati): decidono quali record sono validi
+    if(l->replace)
+        resetNodes(l, empty);
+    else
+        resetTree(l, empty);
+
+    return compactRuns(l);
+}
+
+//memoria addebitata al budget di l: B+-tree, delta e liste staccate non ancora cancellate
+static size_t budgetMem(SList *l){
+    size_t m = l->mem + __atomic_load_n(&l->held, __ATOMIC_RELAXED);
+    if(l->delta)
+        m += l->delta->mem + __atomic_load_n(&l->delta->held, __ATOMIC_RELAXED);
+    return m;
+}
+
+/** Se la memoria addebitata al budget di l lo supera, scrive su disco il piu' grande tra B+-tree (se tree == 1) e delta
+ *  finche' non rientra o restano solo liste piccole (SLIST_SPILL_SHARE); in caso di errore i dati restano in memoria
+ *  e il budget viene disattivato (per non ritentare a ogni inserimento)
+ */
+static void enforceBudget(SList *l, int tree){
+    while(l->budget != 0 && budgetMem(l) > l->budget){
+        SList *x = l->delta;
+        if(tree && (!x || l->mem >= x->mem))
+            x = l;
+        if(!x || x->mem < l->budget / SLIST_SPILL_SHARE || (x->height == 0 && ((SLeaf *)x->root)->n == 0))
+            return;
+        if(spill(x) != 0){
+            perror("spill of the sorted list");
+            fprintf(stderr, "memory budget disabled, results kept in memory\n");
+            l->budget = 0;
+        }
+    }
+}
+
+//controllo del budget dopo un inserimento in l (o nella sua delta, che pesa sul budget della lista madre)
+static void checkBudget(SList *l){
+    enforceBudget((l->owner && l->owner->delta == l) ? l->owner : l, 1);
+}
+
+//addebita a owner la memoria di una lista staccata (snapshot o delta restituita) fino alla sua cancellazione
+static void chargeOwner(SList *s, SList *owner, size_t mem){
+    s->owner = owner;
+    s->charged = mem;
+    __atomic_add_fetch(&owner->held, mem, __ATOMIC_RELAXED);
+}
+
+/** Aggiunge un elemento alla lista delta arg (SListVisit) durante mergeSList: un errore fa perdere l'elemento solo
+ *  nella delta. Puo' essere scritta su disco solo la delta: il B+-tree della lista madre riceve in quel momento gli
+ *  elementi piu' recenti delle run di src, e viene controllato alla fine della fusione
+ */
+static void deltaEntry(SList *d, long index, uint8_t status, uint64_t seq, const char *dir, size_t dir_len, const char *name){
+    if(storeEntry(d, index, status, seq, dir, dir_len, name, strlen(name)) != 0)
+        perror("insertion in the delta list");
+    else
+        enforceBudget(d->owner ? d->owner : d, 0);
+}
+
+static int emitDelta(void *arg, const MergeSrc *s){
+    deltaEntry(arg, s->index, s->status, s->seq, s->dir, s->dir_len, s->string);
+    return 0;
+}
+
+static int emitIndexRun(void *arg, const MergeSrc *s){
+    indexRun(arg, s->index, s->status, s->seq, s->string);
+    return 0;
+}
+
+/* ------------------- snapshot ------------------ */
+
+//prima chiave del sottoalbero node (di livello level)
+static long firstKey(void *node, int level){
+    for(; level > 0; level--)
+        node = ((SInner *)node)->child[0];
+    return ((SLeaf *)node)->index[0];
+}
+
+/** Costruisce (dal basso) i nodi interni sopra gli n nodi in nodes (foglie), prendendoli da pool gia' allocati;
+ *  restituisce la radice e in height il numero di livelli interni (nodes viene riutilizzato per i livelli superiori)
+ */
+static void *buildInner(void **nodes, size_t n, void **pool, int *height){
+    int level = 0;
+    while(n > 1){
+        size_t m = 0;
+        for(size_t i = 0; i < n; i += SLIST_ORDER + 1){
+            SInner *in = *pool++;
+            size_t k = (n - i < SLIST_ORDER + 1) ? n - i : SLIST_ORDER + 1;
+            in->child[0] = nodes[i];
+            in->cnt[0] = subtreeCount(nodes[i], level);
+            for(size_t j = 1; j < k; j++){
+                in->child[j] = nodes[i + j];
+                in->key[j - 1] = firstKey(nodes[i + j], level);
+                in->cnt[j] = subtreeCount(nodes[i + j], level);
+            }
+            in->n = k - 1;
+            nodes[m++] = in;
+        }
+        n = m;
+        level++;
+    }
+    *height = level;
+    return nodes[0];
+}
+
+SList *snapSList(SList *l){
+    if (!l)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    SList *s = initSList(l->str_len);
+    if(!s)
+        return NULL;
+    s->lsize = l->lsize;
+    s->nvalid = l->nvalid;
+    s->text_len = l->text_len;
+    s->path_bytes = l->path_bytes;
+
+    //le foglie vengono condivise (l le copia alla prima modifica): alloco il vettore delle foglie e i nodi interni
+    size_t nleaves = 0, ninner = 0, pos = 0;
+    for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos))
+        nleaves++;
+    for(size_t n = nleaves; n > 1; n = (n + SLIST_ORDER) / (SLIST_ORDER + 1))
+        ninner += (n + SLIST_ORDER) / (SLIST_ORDER + 1);
+    SLeaf **leaves = malloc(nleaves * sizeof(SLeaf *));
+    void **nodes = malloc(nleaves * sizeof(void *));
+    void **pool = calloc(ninner + 1, sizeof(void *));
+    int ok = (leaves && nodes && pool);
+    for(size_t i = 0; ok && i < ninner; i++)
+        ok = ((pool[i] = allocNode(0)) != NULL);
+    if(!ok){
+        for(size_t i = 0; pool && i < ninner; i++)
+            free(pool[i]);
+        free(pool);
+        free(nodes);
+        free(leaves);
+        deleteSList(s);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pos = 0;
+    size_t i = 0;
+    for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos), i++){
+        __atomic_add_fetch(&leaf->refs, 1, __ATOMIC_RELAXED);
+        leaves[i] = nodes[i] = leaf;
+    }
+    freeNodes(s->root, 0);
+    s->leaves = leaves;
+    s->nleaves = nleaves;
+    s->first = leaves[0];
+    s->last = leaves[nleaves - 1];
+    s->root = buildInner(nodes, nleaves, pool, &s->height);
+    s->mem = ninner * sizeof(SInner) + nleaves * sizeof(SLeaf *);
+    free(nodes);
+    free(pool);
+
+    //directory (le stringhe sono nella string arena condivisa)
+    if(l->ndirs > 0){
+        s->dirs = malloc(l->ndirs * sizeof(char *));
+        s->dir_len = malloc(l->ndirs * sizeof(uint32_t));
+        ok = (s->dirs && s->dir_len);
+        if(ok){
+            memcpy(s->dirs, l->dirs, l->ndirs * sizeof(char *));
+            memcpy(s->dir_len, l->dir_len, l->ndirs * sizeof(uint32_t));
+            s->ndirs = s->dirs_cap = l->ndirs;
+        }
+    }
+    if((s->arena = l->arena) != NULL)
+        __atomic_add_fetch(&s->arena->refs, 1, __ATOMIC_RELAXED);
+
+    //con la sostituzione attiva i record validi delle run sono decisi dall'indice dei path, copiato (O(path distinti))
+    //con la tabella delle directory
+    if(ok && l->replace && l->nruns > 0){
+        s->path_idx = malloc(l->idx_cap * sizeof(SSlot));
+        s->dir_hash = malloc(l->hash_cap * sizeof(uint32_t));
+        ok = (s->path_idx && s->dir_hash);
+        if(ok){
+            memcpy(s->path_idx, l->path_idx, l->idx_cap * sizeof(SSlot));
+            memcpy(s->dir_hash, l->dir_hash, l->hash_cap * sizeof(uint32_t));
+            s->idx_cap = l->idx_cap;
+            s->idx_used = l->idx_used;
+            s->hash_cap = l->hash_cap;
+            s->replace = 1;
+        }
+    }
+
+    //run su disco: riaperte con un proprio offset (i file non hanno nome, restano raggiungibili da /proc/self/fd)
+    for(int r = 0; ok && r < l->nruns; r++){
+        char name[64];
+        snprintf(name, sizeof(name), "/proc/self/fd/%d", fileno(l->runs[r]));
+        FILE *f = fopen(name, "r");
+        if(!f || pushRun(s, f) != 0){
+            if(f)
+                fclose(f);
+            ok = 0;
+        }
+    }
+
+    if(!ok){
+        int e = errno;
+        deleteSList(s);
+        errno = e;
+        return NULL;
+    }
+
+    //lo snapshot pesa sul budget di l: foglie condivise e string arena (che restano allocate anche se l le copia o le libera),
+    //nodi interni e directory
+    size_t mem = s->mem + nleaves * sizeof(SLeaf) + s->ndirs * (sizeof(char *) + sizeof(uint32_t)) + s->idx_cap * sizeof(SSlot)
+                 + s->hash_cap * sizeof(uint32_t);
+    for(SChunk *c = s->arena; c != NULL; c = c->next)
+        mem += sizeof(SChunk) + c->cap;
+    chargeOwner(s, l, mem);
+    checkBudget(l);
+    return s;
+}
+
+int setSListDelta(SList *l, int on){
+    if (!l)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(on && !l->delta){
+        if(!(l->delta = initSList(l->str_len)))
+            return -1;
+        l->delta->owner = l; //nessun budget proprio: la delta pesa sul budget di l
+        if(l->replace && setSListReplace(l->delta, 1) != 0){
+            deleteSList(l->delta);
+            l->delta = NULL;
+            return -1;
+        }
+    }
+    else if(!on && l->delta){
+        deleteSList(l->delta);
+        l->delta = NULL;
+    }
+    return 0;
+}
+
+SList *takeSListDelta(SList *l){
+    if (!l || !l->delta)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    SList *fresh = initSList(l->str_len);
+    if(!fresh)
+        return NULL;
+    if(l->replace && setSListReplace(fresh, 1) != 0){
+        deleteSList(fresh);
+        return NULL;
+    }
+    fresh->owner = l;
+    SList *d = l->delta;
+    l->delta = fresh;
+    chargeOwner(d, l, d->mem);
+    return d;
+}
+
+/* ------------------- fusione lineare ------------------ */
+
+/** Fonde il B+-tree di src in quello di dst in O(n + m): le foglie dei due alberi vengono fuse in foglie nuove
+ *  (a parita' di index gli elementi di src precedono quelli di dst, come in mergeSList) e i nodi interni ricostruiti
+ *  dal basso. I nomi di src vengono prima copiati nella string arena di dst: un errore lascia dst invariata
+ *  (salvo le copie gia' fatte nella string arena) e src intatta. Non aggiorna lsize, nvalid, text_len e path_bytes.
+ */
+static int mergeLinear(SList *dst, SList *src){
+    size_t n = 0, m = 0;
+    for(SLeaf *leaf = dst->first; leaf != NULL; leaf = leaf->next)
+        n += leaf->n;
+    for(SLeaf *leaf = src->first; leaf != NULL; leaf = leaf->next)
+        m += leaf->n;
+    if(m == 0)
+        return 0;
+
+    //alloco prima foglie, nodi interni e copie dei nomi
+    size_t nleaves = (n + m + SLIST_ORDER - 1) / SLIST_ORDER, ninner = 0;
+    for(size_t k = nleaves; k > 1; k = (k + SLIST_ORDER) / (SLIST_ORDER + 1))
+        ninner += (k + SLIST_ORDER) / (SLIST_ORDER + 1);
+    const char **base = malloc(m * sizeof(char *));
+    uint32_t *dir = malloc(m * sizeof(uint32_t));
+    void **nodes = malloc(nleaves * sizeof(void *));
+    void **pool = calloc(nleaves + ninner, sizeof(void *));
+    int ok = (base && dir && nodes && pool);
+    for(size_t i = 0; ok && i < nleaves + ninner; i++)
+        ok = ((pool[i] = allocNode(i < nleaves)) != NULL);
+    if(ok && dst->path_idx && 2 * (dst->idx_used + m) > dst->idx_cap)
+        ok = (growIndex(dst, 2 * (dst->idx_used + m)) == 0);
+    size_t j = 0;
+    for(SLeaf *leaf = src->first; ok && leaf != NULL; leaf = leaf->next)
+        for(int i = 0; ok && i < leaf->n; i++, j++){
+            uint32_t d = leaf->dir[i];
+            long id = internDir(dst, src->dirs[d], src->dir_len[d]);
+            ok = (id >= 0 && (base[j] = arenaCopy(dst, leaf->base[i], strlen(leaf->base[i]))) != NULL);
+            dir[j] = id;
+        }
+    if(!ok){
+        for(size_t i = 0; pool && i < nleaves + ninner; i++)
+            free(pool[i]);
+        free(pool);
+        free(nodes);
+        free(base);
+        free(dir);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    //fusione delle due sequenze ordinate nelle foglie nuove (piene, collegate in ordine)
+    SLeaf *a = dst->first, *b = src->first;
+    int ai = 0, bi = 0;
+    size_t bj = 0;
+    SLeaf *prev = NULL;
+    for(size_t k = 0; k < nleaves; k++){
+        SLeaf *out = pool[k];
+        while(out->n < SLIST_ORDER){
+            while(a && ai == a->n){
+                a = a->next;
+                ai = 0;
+            }
+            while(b && bi == b->n){
+                b = b->next;
+                bi = 0;
+            }
+            if(!a && !b)
+                break;
+            int o = out->n++;
+            if(b && (!a || b->index[bi] <= a->index[ai])){
+                out->index[o] = b->index[bi];
+                out->status[o] = b->status[bi];
+                out->dir[o] = dir[bj];
+                out->base[o] = base[bj];
+                out->seq[o] = b->seq[bi];
+                if(dst->path_idx)
+                    indexEntry(dst, b->index[bi], b->status[bi], b->seq[bi], dir[bj], base[bj], strlen(base[bj]));
+                bi++;
+                bj++;
+            }
+            else{
+                out->index[o] = a->index[ai];
+                out->status[o] = a->status[ai];
+                out->dir[o] = a->dir[ai];
+                out->base[o] = a->base[ai];
+                out->seq[o] = a->seq[ai];
+                ai++;
+            }
+        }
+        out->prev = prev;
+        if(prev)
+            prev->next = out;
+        prev = out;
+        nodes[k] = out;
+    }
+
+    dst->mem -= nodesMem(dst->root, dst->height);
+    freeNodes(dst->root, dst->height);
+    dst->first = pool[0];
+    dst->last = prev;
+    dst->root = buildInner(nodes, nleaves, pool + nleaves, &dst->height);
+    dst->mem += nleaves * sizeof(SLeaf) + ninner * sizeof(SInner);
+    free(pool);
+    free(nodes);
+    free(base);
+    free(dir);
+    return 0;
+}
+
 /* ------------------- interfaccia della lista ------------------ */
 
 SList *initSList(size_t max_str_len){
@@ -19,9 +1380,34 @@ SList *initSList(size_t max_str_len){
         return NULL;
     }
 
-    l->head = NULL;
+    if (!(l->root = allocNode(1)))
+    {
+        free(l);
+        return NULL;
+    }
+    l->first = l->last = l->root;
+    l->height = 0;
     l->lsize = 0;
     l->str_len = max_str_len;
+    l->mem = sizeof(SLeaf);
+    l->text_len = 0;
+    l->path_bytes = 0;
+    l->budget = 0;
+    l->runs = NULL;
+    l->nruns = l->runs_cap = 0;
+    l->arena = NULL;
+    l->dirs = NULL;
+    l->dir_len = l->dir_hash = NULL;
+    l->ndirs = l->dirs_cap = l->hash_cap = 0;
+    l->delta = NULL;
+    l->nvalid = 0;
+    l->path_idx = NULL;
+    l->idx_cap = l->idx_used = 0;
+    l->owner = NULL;
+    l->charged = l->held = 0;
+    l->leaves = NULL;
+    l->nleaves = 0;
+    l->replace = 0;
 
     return l;
 }
@@ -33,62 +1419,443 @@ void deleteSList(SList *l){
         return;
     }
 
-    SNode *current_node = l->head;
-    SNode *previous_node = NULL;
+    freeNodes(l->root, l->height);
+    freeStore(l);
+    free(l->leaves);
+    for(int i = 0; i < l->nruns; i++)
+        fclose(l->runs[i]);
+    free(l->runs);
+    if(l->delta)
+        deleteSList(l->delta);
+    free(l->path_idx);
+    if(l->owner && l->charged > 0)
+        __atomic_sub_fetch(&l->owner->held, l->charged, __ATOMIC_RELAXED);
+    free(l);
+}
+
+int addNode(SList *l, char *string, long index){
+    return addNodeStatus(l, string, index, 0);
+}
+
+int addNodeStatus(SList *l, char *string, long index, uint8_t status){
+    if (!l || !string || l->str_len == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if(l->leaves){ //snapshot: sola lettura
+        errno = EPERM;
+        return -1;
+    }
+
+    //al piu' str_len - 1 caratteri, divisi in directory (fino all'ultimo '/' compreso) e nome del file
+    size_t len = strlen(string);
+    if(len > l->str_len - 1)
+        len = l->str_len - 1;
+    size_t dir_len = len;
+    while(dir_len > 0 && string[dir_len - 1] != '/')
+        dir_len--;
 
-    while (current_node != NULL){
-        previous_node = current_node;
-        current_node = current_node->next;
-        free(previous_node->string);
-        free(previous_node);
+    uint64_t seq = __atomic_add_fetch(&slist_seq, 1, __ATOMIC_RELAXED);
+    if(storeEntry(l, index, status, seq, string, dir_len, string + dir_len, len - dir_len) != 0)
+        return -1;
+    if(l->delta){ //la copia nella delta e' best effort: l'elemento e' gia' nella lista
+        if(storeEntry(l->delta, index, status, seq, string, dir_len, string + dir_len, len - dir_len) != 0)
+            perror("insertion in the delta list");
     }
+    checkBudget(l);
+    return 0;
+}
 
-    free(l);
+int mergeSList(SList *dst, SList *src){
+    if (!dst || !src)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if(dst->leaves || src->leaves){ //snapshot: sola lettura
+        errno = EPERM;
+        return -1;
+    }
+
+    SLeaf *empty = allocNode(1);
+    if(!empty)
+        return -1;
+    //spazio per le run di src (spostate dopo quelle di dst, come piu' recenti)
+    while(dst->runs_cap < dst->nruns + src->nruns){
+        int cap = dst->runs_cap ? 2 * dst->runs_cap : 4;
+        FILE **runs = realloc(dst->runs, cap * sizeof(FILE *));
+        if(!runs){
+            free(empty);
+            return -1;
+        }
+        dst->runs = runs;
+        dst->runs_cap = cap;
+    }
+
+    //src grande rispetto a dst: fusione lineare delle foglie, O(n + m); altrimenti (o con la sostituzione attiva,
+    //che confronta ogni elemento con il risultato precedente del path) m inserimenti, O(m log n)
+    int linear = (src->lsize * SLIST_MERGE_RATIO >= dst->lsize && !dst->replace);
+    if(!linear && ownLeaves(src, &src->root, src->height) != 0){ //le foglie di src vengono svuotate una alla volta
+        free(empty);
+        return -1;
+    }
+    if(linear){
+        if(mergeLinear(dst, src) != 0){
+            free(empty);
+            return -1;
+        }
+        if(dst->delta)
+            for(SLeaf *leaf = src->first; leaf != NULL; leaf = leaf->next)
+                for(int i = 0; i < leaf->n; i++)
+                    deltaEntry(dst->delta, leaf->index[i], leaf->status[i], leaf->seq[i], src->dirs[leaf->dir[i]], src->dir_len[leaf->dir[i]], leaf->base[i]);
+    }
+
+    //inserisco gli elementi di src dall'ultimo al primo: ogni inserimento precede gli elementi con lo stesso index,
+    //quindi a parita' di index resta l'ordine di src, seguito dagli elementi gia' presenti in dst
+    for(SLeaf *leaf = src->last; !linear && leaf != NULL; leaf = leaf->prev){
+        while(leaf->n > 0){
+            int i = leaf->n - 1;
+            uint32_t d = leaf->dir[i];
+            size_t base_len = strlen(leaf->base[i]);
+            if(storeEntry(dst, leaf->index[i], leaf->status[i], leaf->seq[i], src->dirs[d], src->dir_len[d], leaf->base[i], base_len) != 0){
+                free(empty);
+                return -1;
+            }
+            if(dst->delta)
+                deltaEntry(dst->delta, leaf->index[i], leaf->status[i], leaf->seq[i], src->dirs[d], src->dir_len[d], leaf->base[i]);
+            src->path_bytes -= src->dir_len[d] + base_len;
+            if(leaf->status[i] == 0){
+                src->text_len -= lineLen(leaf->index[i], src->dir_len[d] + base_len);
+                src->nvalid--;
+            }
+            leaf->n--;
+            src->lsize--;
+        }
+    }
+
+    //restano in src solo gli elementi delle run su disco (copiati anche nella delta di dst e, con la sostituzione
+    //attiva, registrati nell'indice di dst, che li conta)
+    if(dst->delta && src->nruns > 0 && mergeSources(src, 0, emitDelta, dst->delta) != 0)
+        perror("copy of the runs in the delta list");
+    if(dst->replace && src->nruns > 0 && mergeSources(src, 0, emitIndexRun, dst) != 0)
+        perror("index of the merged runs");
+    for(int i = 0; i < src->nruns; i++)
+        dst->runs[dst->nruns++] = src->runs[i];
+    if(!dst->replace){
+        dst->lsize += src->lsize;
+        dst->nvalid += src->nvalid;
+        dst->text_len += src->text_len;
+        dst->path_bytes += src->path_bytes;
+    }
+    src->nruns = 0;
+    src->lsize = 0;
+    src->nvalid = 0;
+    src->text_len = 0;
+    src->path_bytes = 0;
+    resetTree(src, empty);
+
+    if(compactRuns(dst) != 0)
+        perror("compaction of the sorted list");
+    checkBudget(dst);
+
+    return 0;
 }
 
-int addNode(SList *l, char *string, long index){
-    SNode *new_node = malloc(sizeof(SNode));
-    if (!new_node)
+int setSListBudget(SList *l, size_t budget){
+    if (!l)
     {
-        perror("malloc");
+        errno = EINVAL;
         return -1;
     }
-    new_node->string = (char *)calloc(l->str_len, sizeof(char));
-    if (!new_node->string)
+
+    l->budget = budget;
+    checkBudget(l);
+    return 0;
+}
+
+int printSList(SList *l, int fd)
+{
+    if (!l || fd < 0)
     {
-        perror("calloc");
+        errno = EINVAL;
         return -1;
     }
-    strncpy(new_node->string, string, l->str_len);
-    new_node->index = index;
 
-    SNode *current_node = l->head;
-    SNode *previous_node = NULL;
+    OutBuf o = {fd, malloc(SLIST_OUT_BUF_LEN), 0};
+    if(!o.buf)
+        return -1;
 
-    //itero puntatore fino alla posizione ordinata per index
-    while(current_node != NULL && index > current_node->index){
-        previous_node = current_node;
-        current_node = current_node->next;
+    //preallocazione della stampa (senza cambiare la dimensione del file): meno frammentazione e metadati per write()
+    struct stat st;
+    off_t off;
+    if(l->text_len > 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (off = lseek(fd, 0, SEEK_CUR)) != (off_t)-1)
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, off, l->text_len); //best effort (non supportata da tutti i filesystem)
+
+    //le stampe precedenti fatte con stdio devono precedere la lista
+    fflush(stdout);
+
+    int err = 0;
+    if(l->nruns == 0){ //niente su disco: visita delle foglie
+        size_t pos = 0;
+        for(SLeaf *leaf = firstLeaf(l); leaf != NULL && !err; leaf = nextLeaf(l, leaf, &pos))
+            for(int i = 0; i < leaf->n && !err; i++)
+                err = emitPrint(&o, leaf->index[i], leaf->status[i], l->dirs[leaf->dir[i]], l->dir_len[leaf->dir[i]], leaf->base[i]);
     }
+    else
+        err = mergeSources(l, 1, emitPrintSrc, &o);
+    if(!err)
+        err = outFlush(&o);
 
-    if(previous_node == NULL){
-        new_node->next = l->head;
-        l->head = new_node;
+    int e = errno;
+    free(o.buf);
+    errno = e;
+    return err ? -1 : 0;
+}
+
+int visitSList(SList *l, SListVisit visit, void *arg){
+    if (!l || !visit)
+    {
+        errno = EINVAL;
+        return -1;
     }
-    else{
-        previous_node->next = new_node;
-        new_node->next = current_node;
+
+    VisitArg v = {visit, arg};
+    return mergeSources(l, 1, emitVisit, &v);
+}
+
+int setSListIndex(SList *l, int on){
+    if (!l)
+    {
+        errno = EINVAL;
+        return -1;
     }
 
+    if(!on && l->replace){ //la sostituzione usa l'indice
+        errno = EBUSY;
+        return -1;
+    }
+    if(!on){
+        free(l->path_idx);
+        l->path_idx = NULL;
+        l->idx_cap = l->idx_used = 0;
+        return 0;
+    }
+    if(l->path_idx)
+        return 0;
+
+    size_t n = 0, pos = 0;
+    for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos))
+        n += leaf->n;
+    if(growIndex(l, 2 * n + 2) != 0)
+        return -1;
+    pos = 0;
+    for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos))
+        for(int i = 0; i < leaf->n; i++)
+            indexEntry(l, leaf->index[i], leaf->status[i], leaf->seq[i], leaf->dir[i], leaf->base[i], strlen(leaf->base[i]));
+    return 0;
+}
+
+int setSListReplace(SList *l, int on){
+    if (!l || l->leaves)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if(l->lsize > 0 || l->nruns > 0){ //gli elementi presenti potrebbero avere lo stesso path
+        errno = EBUSY;
+        return -1;
+    }
+
+    if(on && setSListIndex(l, 1) != 0)
+        return -1;
+    if(l->delta && setSListReplace(l->delta, on) != 0)
+        return -1;
+    l->replace = on;
     return 0;
 }
 
-void printSList(SList *l)
+int findSList(SList *l, const char *path, long *index, uint8_t *status){
+    if (!l || !path || !index || !status)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //l'ultimo risultato ricevuto e' quello con seq piu' alto: nelle foglie e nelle run gli elementi sono ordinati per index
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) + 1 : 0;
+    const char *base = path + dir_len;
+    long dir = findDir(l, path, dir_len);
+    int found = 0;
+    uint64_t best = 0;
+
+    if(l->path_idx){ //l'indice contiene l'ultimo elemento del B+-tree per ogni path
+        SSlot *s = (dir >= 0) ? indexSlot(l, dir, base, strlen(base)) : NULL;
+        if(s && s->base){
+            *index = s->index;
+            *status = s->status;
+            best = s->seq;
+            found = 1;
+        }
+    }
+    else if(dir >= 0){ //scansione delle foglie
+        size_t pos = 0;
+        for(SLeaf *leaf = firstLeaf(l); leaf != NULL; leaf = nextLeaf(l, leaf, &pos))
+            for(int i = 0; i < leaf->n; i++)
+                if(leaf->dir[i] == (uint32_t)dir && (!found || leaf->seq[i] > best) && strcmp(leaf->base[i], base) == 0){
+                    *index = leaf->index[i];
+                    *status = leaf->status[i];
+                    best = leaf->seq[i];
+                    found = 1;
+                }
+    }
+
+    //run su disco: scansione completa (le run fuse da altre liste non sono in ordine di inserimento), tranne con la
+    //sostituzione attiva, in cui l'indice contiene anche i risultati delle run
+    if(l->nruns == 0 || l->replace)
+        return found;
+    char *buf = malloc(l->str_len + 1);
+    if(!buf)
+        return -1;
+    int r = 0;
+    for(int k = l->nruns - 1; k >= 0 && r >= 0; k--){
+        long idx;
+        uint8_t st;
+        uint64_t seq;
+        rewind(l->runs[k]);
+        while((r = readRecord(l->runs[k], &idx, &st, &seq, buf, l->str_len)) > 0)
+            if((!found || seq > best) && strcmp(buf, path) == 0){
+                *index = idx;
+                *status = st;
+                best = seq;
+                found = 1;
+            }
+    }
+    free(buf);
+    return (r < 0) ? -1 : found;
+}
+
+size_t countSList(SList *l){
+    return l ? l->nvalid : 0;
+}
+
+/** Numero di elementi validi con index > value nelle run su disco (scansione)
+ *
+ */
+static size_t countAboveRuns(SList *l, long value){
+    char *buf = malloc(l->str_len + 1);
+    if(!buf)
+        return 0;
+    size_t c = 0;
+    long index;
+    uint8_t status;
+    for(int k = 0; k < l->nruns; k++){
+        rewind(l->runs[k]);
+        int r;
+        uint64_t seq;
+        while((r = readRecord(l->runs[k], &index, &status, &seq, buf, l->str_len)) > 0)
+            c += (status == 0 && index > value && !deadRecord(l, buf, seq));
+        if(r < 0)
+            break;
+    }
+    free(buf);
+    return c;
+}
+
+size_t countAboveSList(SList *l, long value){
+    if (!l)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+
+    //nei figli precedenti a quello di discesa ogni elemento e' <= value, nei successivi ogni elemento e' > value
+    size_t c = 0;
+    void *node = l->root;
+    for(int level = l->height; level > 0; level--){
+        SInner *in = node;
+        int i = 0;
+        while(i < in->n && in->key[i] <= value)
+            i++;
+        for(int j = i + 1; j <= in->n; j++)
+            c += in->cnt[j];
+        node = in->child[i];
+    }
+    SLeaf *leaf = node;
+    for(int i = 0; i < leaf->n; i++)
+        c += (leaf->status[i] == 0 && leaf->index[i] > value);
+
+    if(l->nruns > 0)
+        c += countAboveRuns(l, value);
+    return c;
+}
+
+//stato di rangeSList con run su disco: visita degli elementi validi di rank [from, to)
+typedef struct range_visit
 {
-    SNode *head = l->head;
+    size_t rank;
+    size_t from;
+    size_t to;
+    int done;
+    SListVisit visit;
+    void *arg;
+} RangeVisit;
 
-    while (head != NULL) {
-        printf("%ld %s\n", head->index, head->string);
-        head = head->next;
+static int rangeEntry(void *arg, long index, uint8_t status, const char *dir, size_t dir_len, const char *name){
+    RangeVisit *r = arg;
+    if(status != 0)
+        return 0;
+    if(r->rank >= r->to){ //interrompe la fusione
+        r->done = 1;
+        return 1;
     }
-}
\ No newline at end of file
+    if(r->rank++ >= r->from)
+        return r->visit(r->arg, index, status, dir, dir_len, name);
+    return 0;
+}
+
+int rangeSList(SList *l, size_t rank, size_t n, SListVisit visit, void *arg){
+    if (!l || !visit)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if(n == 0 || rank >= l->nvalid)
+        return 0;
+
+    if(l->nruns > 0){
+        RangeVisit r = {0, rank, rank + n, 0, visit, arg};
+        VisitArg v = {rangeEntry, &r};
+        int err = mergeSources(l, 1, emitVisit, &v);
+        return (err != 0 && !r.done) ? -1 : 0;
+    }
+
+    //discesa con i contatori dei sottoalberi fino alla foglia che contiene il rank cercato; in uno snapshot i nodi interni
+    //hanno tutti SLIST_ORDER + 1 figli (tranne l'ultimo di ogni livello), quindi la posizione della foglia e' il numero
+    //in base SLIST_ORDER + 1 dei figli scelti
+    void *node = l->root;
+    size_t pos = 0;
+    for(int level = l->height; level > 0; level--){
+        SInner *in = node;
+        int i = 0;
+        while(i < in->n && rank >= in->cnt[i])
+            rank -= in->cnt[i++];
+        node = in->child[i];
+        pos = pos * (SLIST_ORDER + 1) + i;
+    }
+    SLeaf *leaf = node;
+    int i = 0;
+    for(;; i++)
+        if(leaf->status[i] == 0 && rank-- == 0)
+            break;
+
+    for(; leaf != NULL && n > 0; leaf = nextLeaf(l, leaf, &pos), i = 0)
+        for(; i < leaf->n && n > 0; i++)
+            if(leaf->status[i] == 0){
+                if(visit(arg, leaf->index[i], leaf->status[i], l->dirs[leaf->dir[i]], l->dir_len[leaf->dir[i]], leaf->base[i]) != 0)
+                    return -1;
+                n--;
+            }
+    return 0;
+}
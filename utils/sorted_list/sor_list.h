@@ -1,30 +1,130 @@
 #if !defined(SOR_LIST_H)
-#define SOR_LIST
+#define SOR_LIST_H
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
 
-/** Struttura dati singolo nodo
+//numero massimo di chiavi per nodo del B+-tree (i nodi pieni vengono divisi durante la discesa)
+#define SLIST_ORDER 64
+//le run su disco vengono fuse SLIST_RUN_FANIN alla volta, tra run di dimensioni simili (entro un fattore SLIST_RUN_RATIO),
+//e non superano SLIST_MAX_RUNS (file aperti e fusione della stampa)
+#define SLIST_RUN_FANIN 8
+#define SLIST_RUN_RATIO 4
+#define SLIST_MAX_RUNS 64
+//oltre il budget viene scritto su disco il piu' grande tra B+-tree e delta, solo se occupa almeno 1 / SLIST_SPILL_SHARE
+//del budget (la memoria delle liste staccate non puo' essere scritta: si libera quando vengono cancellate)
+#define SLIST_SPILL_SHARE 8
+//mergeSList fonde le foglie in O(n + m) se src ha almeno 1 / SLIST_MERGE_RATIO degli elementi di dst,
+//altrimenti inserisce gli m elementi di src in O(m log n)
+#define SLIST_MERGE_RATIO 16
+//buffer di uscita di printSList, svuotato con write()
+#define SLIST_OUT_BUF_LEN (1 << 20)
+//dimensione dei blocchi della string arena (raddoppia a ogni blocco, dal minimo al massimo)
+#define SLIST_CHUNK_MIN_LEN 1024
+#define SLIST_CHUNK_LEN (64 * 1024)
+
+/** Foglia del B+-tree: coppie (index, path) ordinate per index; le foglie sono collegate in entrambe le direzioni.
+ *  Il path e' dirs[dir[i]] seguito da base[i]: la directory e' condivisa da tutti i path che la contengono.
+ *  Le foglie sono condivise con gli snapshot (snapSList): refs conta la lista e gli snapshot che contengono la foglia,
+ *  che viene copiata dalla lista alla prima modifica (copy-on-write). I collegamenti next e prev appartengono
+ *  alla lista: gli snapshot visitano le foglie con il proprio vettore SList.leaves.
+ */
+typedef struct list_leaf
+{
+    int n;
+    long index[SLIST_ORDER];
+    uint32_t dir[SLIST_ORDER];          // directory (indice in SList.dirs)
+    uint8_t status[SLIST_ORDER];        // esito del risultato: 0 se valido (solo questi vengono stampati)
+    const char *base[SLIST_ORDER];      // nome del file, nella string arena
+    uint64_t seq[SLIST_ORDER];          // ordine di inserimento (contatore globale): il piu' alto e' l'ultimo ricevuto
+    int refs;                           // liste e snapshot che contengono la foglia (aggiornato anche da altri thread)
+    struct list_leaf *next;
+    struct list_leaf *prev;
+} SLeaf;
+
+/** Blocco della string arena: le stringhe vengono solo aggiunte e liberate tutte insieme.
+ *  I blocchi sono condivisi con gli snapshot (snapSList): refs conta la lista o lo snapshot che ha il blocco in testa
+ *  e il blocco successivo, ed un blocco viene liberato (insieme ai precedenti non piu' riferiti) quando refs arriva a 0.
+ */
+typedef struct list_chunk
+{
+    struct list_chunk *next;
+    size_t used;
+    size_t cap;
+    int refs;
+    char data[];
+} SChunk;
+
+/** Nodo interno del B+-tree: key[i] e' la prima chiave del sottoalbero child[i + 1];
+ *  cnt[i] e' il numero di elementi validi (status 0) del sottoalbero child[i] (statistiche d'ordine in O(log n))
+ */
+typedef struct list_inner
+{
+    int n;
+    long key[SLIST_ORDER];
+    void *child[SLIST_ORDER + 1];
+    size_t cnt[SLIST_ORDER + 1];
+} SInner;
+
+/** Slot dell'indice hash dei path (setSListIndex): ultimo risultato ricevuto per il path dirs[dir] + base
  *
  */
-typedef struct list_node
+typedef struct list_slot
 {
-    char* string;
+    const char *base;   // nome del file nella string arena, NULL se lo slot e' vuoto
     long index;
-    struct list_node *next;
-} SNode;
+    uint64_t seq;       // ordine di inserimento del risultato
+    uint32_t dir;
+    uint8_t status;
+} SSlot;
 
-/** Lista ordinata (per index) di nodi contenenti un index value e una stringa lunga str_len
- *
+/** Lista ordinata (per index) di nodi contenenti un index value e una stringa lunga al piu' str_len,
+ *  implementata come B+-tree: inserimento in O(log n), visita ordinata in O(n) scorrendo le foglie.
+ *  A parita' di index l'ultimo elemento inserito precede gli altri.
+ *  Le stringhe sono divise in directory (prefisso fino all'ultimo '/', memorizzato una sola volta in una tabella hash)
+ *  e nome del file, copiato in una string arena a blocchi: nessuna allocazione per elemento.
+ *  Con un budget di memoria (setSListBudget), al superamento del budget il contenuto ordinato viene scritto
+ *  in una run su file temporaneo e la memoria liberata; la stampa fonde le run con il B+-tree.
+ *  Il budget comprende la lista delta e le liste staccate da l (snapshot e delta restituite) finche' non vengono cancellate.
  */
 typedef struct sorted_list
 {
-    SNode *head;
+    void *root;     // radice (SLeaf se height == 0, altrimenti SInner)
+    SLeaf *first;   // foglia piu' a sinistra
+    SLeaf *last;    // foglia piu' a destra
+    int height;     // livelli di nodi interni
     size_t lsize; // dimensione attuale lista
     size_t str_len;
+    size_t budget;  // memoria massima (in byte) del B+-tree, della delta e delle liste staccate, 0 se illimitata
+    size_t mem;     // memoria attuale (nodi e stringhe) del B+-tree
+    size_t text_len; // byte della stampa completa della lista (per preallocare il file di uscita)
+    size_t path_bytes; // byte di tutti i path (senza terminatore)
+    FILE **runs;    // run ordinate su disco, dalla piu' vecchia alla piu' recente
+    int nruns;
+    int runs_cap;
+    SChunk *arena;      // string arena (blocco corrente in testa)
+    char **dirs;        // directory distinte (nella string arena), indicizzate da SLeaf.dir
+    uint32_t *dir_len;
+    uint32_t ndirs;
+    uint32_t dirs_cap;
+    uint32_t *dir_hash; // tabella hash ad indirizzamento aperto: 1 + indice in dirs, 0 se vuota
+    uint32_t hash_cap;  // potenza di 2
+    struct sorted_list *delta; // se non NULL riceve una copia degli elementi inseriti dall'ultimo takeSListDelta
+    size_t nvalid;      // elementi validi (status 0), compresi quelli su disco
+    SSlot *path_idx;    // indice hash (sondaggio lineare) dei path nel B+-tree, NULL se non attivo
+    size_t idx_cap;     // potenza di 2
+    size_t idx_used;
+    struct sorted_list *owner; // lista al cui budget e' addebitata la memoria (delta, snapshot e delta restituite), NULL se nessuna
+    size_t charged;     // memoria addebitata a owner->held da uno snapshot o da una delta restituita
+    size_t held;        // memoria delle liste staccate non ancora cancellate (aggiornata anche da altri thread)
+    SLeaf **leaves;     // foglie in ordine di uno snapshot (condivise, senza collegamenti propri), NULL per le altre liste
+    size_t nleaves;
+    int replace;        // un solo risultato per path (setSListReplace): l'indice dei path decide quali record sono validi
 } SList;
 
 /** Alloca ed inizializza una lista ordinata vuota di stringhe lunghe max_path_len
- * 
+ *
  *   \param max_path_len lunghezza massima delle stringhe
  *
  *   \retval NULL se si sono verificati problemi nell'allocazione (errno settato)
@@ -41,17 +141,163 @@ void deleteSList(SList *l);
 /** Inserisce un nodo nella lista ordinata in modo ordinato.
  *   \param l puntatore alla lista
  *   \param string puntatore alla stringa da inserire
- *   \param index index della stringa 
+ *   \param index index della stringa
  *
  *   \retval 0 se successo
  *   \retval -1 se errore (errno settato opportunamente)
  */
 int addNode(SList *l, char *path, long result);
 
-/**  Stampa tutta la lista con il formato "'index' 'stringa'"
+/** Inserisce nella lista un risultato con esito status; i risultati con status != 0 (es. file non leggibili)
+ *   vengono mantenuti ma non stampati da printSList.
+ *   \param l puntatore alla lista
+ *   \param string puntatore alla stringa da inserire
+ *   \param index index della stringa
+ *   \param status esito (0 se valido)
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente)
+ */
+int addNodeStatus(SList *l, char *path, long result, uint8_t status);
+
+/** Sposta tutti i nodi di src in dst mantenendo l'ordinamento: fusione delle foglie in O(n + m) se src non e' piccola
+ *   rispetto a dst (SLIST_MERGE_RATIO), altrimenti m inserimenti in O(log n);
+ *   a parita' di index i nodi di src precedono quelli di dst, come se fossero stati inseriti dopo.
+ *   Le run su disco di src passano a dst.
+ *   \param dst puntatore alla lista di destinazione
+ *   \param src puntatore alla lista da svuotare
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente); in caso di errore gli elementi non ancora spostati restano in src
+ */
+int mergeSList(SList *dst, SList *src);
+
+/** Imposta il budget di memoria della lista: quando viene superato, gli elementi in memoria vengono scritti
+ *   (gia' ordinati) in un file temporaneo in $TMPDIR (o /tmp), rimosso alla chiusura.
+ *   Il budget e' condiviso con la lista delta (setSListDelta) e comprende gli snapshot (snapSList) e le delta
+ *   restituite (takeSListDelta) finche' non vengono cancellate: l deve essere cancellata dopo di loro.
+ *   \param l puntatore alla lista
+ *   \param budget memoria massima in byte (0 per nessun limite)
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente)
+ */
+int setSListBudget(SList *l, size_t budget);
+
+/** Crea uno snapshot di l: una lista di sola lettura (da stampare, visitare e cancellare, anche da un altro thread
+ *   mentre l viene modificata) con gli stessi elementi. Le foglie e la string arena vengono condivise e le run su disco
+ *   riaperte: il costo e' quello dei nodi interni, O(n / SLIST_ORDER), e l copia una foglia condivisa solo alla prima
+ *   modifica. addNode e mergeSList su uno snapshot falliscono con EPERM.
+ *   \param l puntatore alla lista
+ *
+ *   \retval NULL se errore (errno settato opportunamente)
+ *   \retval s snapshot, da cancellare con deleteSList
+ */
+SList *snapSList(SList *l);
+
+/** Attiva (on == 1) o disattiva la lista delta di l, che riceve una copia di ogni elemento inserito (anche con mergeSList)
+ *   \param l puntatore alla lista
+ *   \param on 1 per attivare, 0 per disattivare
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente)
+ */
+int setSListDelta(SList *l, int on);
+
+/** Restituisce gli elementi inseriti in l dall'ultima chiamata (o dall'attivazione con setSListDelta),
+ *   sostituendo la lista delta con una vuota.
+ *   \param l puntatore alla lista (con delta attiva)
+ *
+ *   \retval NULL se errore (errno settato opportunamente)
+ *   \retval d lista degli elementi nuovi, da cancellare con deleteSList
+ */
+SList *takeSListDelta(SList *l);
+
+/** Funzione chiamata da visitSList per ogni elemento: il path e' dir (lunga dir_len, non terminata) seguita da name.
+ *   Un valore di ritorno diverso da 0 interrompe la visita.
+ */
+typedef int (*SListVisit)(void *arg, long index, uint8_t status, const char *dir, size_t dir_len, const char *name);
+
+/** Visita in ordine tutti gli elementi della lista (compresi quelli su disco e quelli con status != 0)
+ *   \param l puntatore alla lista
+ *   \param visit funzione chiamata per ogni elemento
+ *   \param arg argomento passato a visit
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore di lettura delle run o se visit ha restituito un valore diverso da 0
+ */
+int visitSList(SList *l, SListVisit visit, void *arg);
+
+/** Attiva (on == 1) o disattiva l'indice hash dei path di l, usato da findSList. L'indice copre gli elementi in memoria
+ *   (viene svuotato quando il B+-tree viene scritto su disco, salvo con setSListReplace) e non e' contato nel budget
+ *   di memoria. Non puo' essere disattivato con la sostituzione attiva (EBUSY).
+ *   \param l puntatore alla lista
+ *   \param on 1 per attivare, 0 per disattivare
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente)
+ */
+int setSListIndex(SList *l, int on);
+
+/** Attiva (on == 1) o disattiva la sostituzione dei risultati di l: ogni path conserva solo l'ultimo risultato
+ *   ricevuto (quello con seq piu' alto), anche se arrivato prima con mergeSList, e il precedente viene tolto dal B+-tree.
+ *   Attiva l'indice dei path, che non viene svuotato quando il B+-tree viene scritto su disco: i nomi restano nella
+ *   string arena (una copia per path) e i record sostituiti delle run vengono saltati in lettura. mergeSList inserisce
+ *   gli elementi uno alla volta, O(m log n). La lista delta eredita la sostituzione; l deve essere vuota.
+ *   \param l puntatore alla lista
+ *   \param on 1 per attivare, 0 per disattivare
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore (errno settato opportunamente, EBUSY se l non e' vuota)
+ */
+int setSListReplace(SList *l, int on);
+
+/** Cerca l'ultimo risultato ricevuto per path (quello con seq piu' alto): O(1) atteso con l'indice attivo e per gli
+ *   elementi in memoria, altrimenti scansione del B+-tree; con run su disco vengono scandite tutte.
+ *   \param l puntatore alla lista
+ *   \param path path cercato
+ *   \param index risultato del path (se trovato)
+ *   \param status esito del path (se trovato)
+ *
+ *   \retval 1 se trovato
+ *   \retval 0 se non presente
+ *   \retval -1 se errore di lettura delle run (errno settato opportunamente)
+ */
+int findSList(SList *l, const char *path, long *index, uint8_t *status);
+
+/** Numero di elementi validi (status 0, quelli stampati da printSList)
+ *
+ */
+size_t countSList(SList *l);
+
+/** Numero di elementi validi con index > value: O(log n) sul B+-tree, scansione per le run su disco
+ *   \retval n numero di elementi (0 anche in caso di errore di lettura delle run, con errno settato)
+ */
+size_t countAboveSList(SList *l, long value);
+
+/** Visita in ordine gli elementi validi di rank [rank, rank + n) nell'ordinamento di printSList (rank da 0):
+ *   il primo viene raggiunto in O(log n) con i contatori dei nodi interni, se non ci sono run su disco
+ *   \param l puntatore alla lista
+ *   \param rank rank del primo elemento
+ *   \param n numero di elementi
+ *   \param visit funzione chiamata per ogni elemento
+ *   \param arg argomento passato a visit
+ *
+ *   \retval 0 se successo
+ *   \retval -1 se errore di lettura delle run o se visit ha restituito un valore diverso da 0
+ */
+int rangeSList(SList *l, size_t rank, size_t n, SListVisit visit, void *arg);
+
+/**  Stampa tutta la lista con il formato "'index' 'stringa'" (fusione a k vie delle run su disco e del B+-tree).
+ *   Le righe vengono formattate in un buffer di SLIST_OUT_BUF_LEN byte scritto con write(), senza passare da stdio;
+ *   se fd e' un file regolare lo spazio della stampa viene preallocato.
  *
  *  \param l puntatore alla lista
+ *  \param fd file descriptor su cui stampare (es. STDOUT_FILENO)
+ *
+ *  \retval 0 se successo
+ *  \retval -1 se errore di scrittura o di lettura delle run (errno settato opportunamente)
  */
-void printSList(SList *l);
+int printSList(SList *l, int fd);
 
-#endif // SOR_LIST
\ No newline at end of file
+#endif // SOR_LIST_H